@@ -14,54 +14,330 @@
 
 #include "lldb-eval/api.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "lldb-eval/bytecode.h"
+#include "lldb-eval/constant_folding.h"
 #include "lldb-eval/context.h"
+#include "lldb-eval/dependency_tracker.h"
 #include "lldb-eval/eval.h"
+#include "lldb-eval/frame_index.h"
+#include "lldb-eval/memory_provider.h"
 #include "lldb-eval/parser.h"
 #include "lldb-eval/parser_context.h"
+#include "lldb-eval/scalar_program.h"
+#include "lldb-eval/serialization.h"
+#include "lldb-eval/stats.h"
+#include "lldb-eval/target_cache.h"
+#include "lldb-eval/trace.h"
 #include "lldb-eval/value.h"
+#include "lldb/API/SBAddress.h"
+#include "lldb/API/SBBlock.h"
+#include "lldb/API/SBData.h"
 #include "lldb/API/SBError.h"
+#include "lldb/API/SBEvent.h"
 #include "lldb/API/SBExecutionContext.h"
 #include "lldb/API/SBFrame.h"
+#include "lldb/API/SBProcess.h"
 #include "lldb/API/SBTarget.h"
 #include "lldb/API/SBValue.h"
 #include "lldb/lldb-enumerations.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
 
 namespace lldb_eval {
 
-static std::unordered_map<std::string, TypeSP> ConvertToTypeMap(
-    ContextArgumentList context_args) {
-  std::unordered_map<std::string, TypeSP> ret;
+namespace {
+
+// Returns the type name or an empty string for invalid types.
+llvm::StringRef GetTypeName(lldb::SBType type) {
+  const char* name = type.IsValid() ? type.GetName() : nullptr;
+  return name ? llvm::StringRef(name) : llvm::StringRef();
+}
+
+// Everything that affects the result of parsing an expression in the value
+// scope and the passes run on it. Types are identified by their names, the
+// same way `CompareTypes` does it.
+struct CompiledExprKey {
+  lldb::SBTarget target;
+  // Unique ID of the process of the target. The global variables bound during
+  // the compilation refer to the process, so a relaunch needs a recompilation.
+  uint32_t process_id;
+  std::string scope;
+  std::string expr;
+  bool allow_side_effects;
+  bool fold_constants;
+  bool use_bytecode;
+  uint32_t scalar_tier_threshold;
+  std::vector<std::pair<std::string, std::string>> args;
+
+  bool operator==(const CompiledExprKey& other) const {
+    return target == other.target && process_id == other.process_id &&
+           scope == other.scope &&
+           expr == other.expr &&
+           allow_side_effects == other.allow_side_effects &&
+           fold_constants == other.fold_constants &&
+           use_bytecode == other.use_bytecode &&
+           scalar_tier_threshold == other.scalar_tier_threshold &&
+           args == other.args;
+  }
+};
+
+struct CompiledExprKeyHash {
+  size_t operator()(const CompiledExprKey& key) const {
+    llvm::hash_code hash = llvm::hash_combine(
+        key.process_id, key.scope, key.expr, key.allow_side_effects,
+        key.fold_constants, key.use_bytecode, key.scalar_tier_threshold);
+    for (const auto& [name, type] : key.args) {
+      hash = llvm::hash_combine(hash, name, type);
+    }
+    return hash;
+  }
+};
+
+// Process-wide LRU cache of compiled expressions.
+class CompiledExprCache {
+ public:
+  static CompiledExprCache& Instance() {
+    static CompiledExprCache* cache = new CompiledExprCache();
+    return *cache;
+  }
+
+  std::shared_ptr<CompiledExpr> Lookup(const CompiledExprKey& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      return nullptr;
+    }
+    // Move the entry to the front, it's the most recently used now.
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->expr;
+  }
+
+  void Insert(CompiledExprKey key, std::shared_ptr<CompiledExpr> expr) {
+    // The size is measured on the insertion, the later growth of the
+    // expression (e.g. the scalar program) isn't accounted.
+    size_t bytes = GetKeyMemoryUsage(key) + expr->GetMemoryUsage();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (max_entries_ == 0) {
+      return;
+    }
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      bytes_ = bytes_ - it->second->bytes + bytes;
+      it->second->expr = std::move(expr);
+      it->second->bytes = bytes;
+      entries_.splice(entries_.begin(), entries_, it->second);
+      EvictIfNeeded();
+      return;
+    }
+    entries_.push_front({std::move(key), std::move(expr), bytes});
+    index_.emplace(entries_.front().key, entries_.begin());
+    bytes_ += bytes;
+    EvictIfNeeded();
+  }
+
+  void SetMaxEntries(size_t max_entries) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_entries_ = max_entries;
+    EvictIfNeeded();
+  }
+
+  void SetMaxBytes(size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+    EvictIfNeeded();
+  }
+
+  size_t GetMemoryUsage() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+  }
+
+  void Invalidate(lldb::SBTarget target) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      if (it->key.target == target) {
+        bytes_ -= it->bytes;
+        index_.erase(it->key);
+        it = entries_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    index_.clear();
+    entries_.clear();
+    bytes_ = 0;
+  }
+
+ private:
+  struct Entry {
+    CompiledExprKey key;
+    std::shared_ptr<CompiledExpr> expr;
+    // Estimated size of the key and the expression.
+    size_t bytes;
+  };
+
+  CompiledExprCache() = default;
+
+  static size_t GetKeyMemoryUsage(const CompiledExprKey& key) {
+    // Twice the key, it's stored in the list and in the index.
+    size_t bytes = sizeof(key) + key.scope.size() + key.expr.size();
+    for (const auto& [name, type] : key.args) {
+      bytes += sizeof(key.args.front()) + name.size() + type.size();
+    }
+    return 2 * bytes + sizeof(Entry);
+  }
+
+  // Evicts the least recently used entries (at the back) while there are too
+  // many of them or they take too much memory. Requires `mutex_`.
+  void EvictIfNeeded() {
+    while (entries_.size() > max_entries_ ||
+           (max_bytes_ != 0 && bytes_ > max_bytes_)) {
+      bytes_ -= entries_.back().bytes;
+      index_.erase(entries_.back().key);
+      entries_.pop_back();
+    }
+  }
+
+  std::mutex mutex_;
+  size_t max_entries_ = 256;
+  // Zero means no limit.
+  size_t max_bytes_ = 0;
+  size_t bytes_ = 0;
+  // Most recently used entries are at the front.
+  std::list<Entry> entries_;
+  std::unordered_map<CompiledExprKey, std::list<Entry>::iterator,
+                     CompiledExprKeyHash>
+      index_;
+};
+
+CompiledExprKey CreateCompiledExprKey(lldb::SBTarget target,
+                                      lldb::SBType scope,
+                                      const char* expression,
+                                      const Options& opts) {
+  CompiledExprKey key{target, target.GetProcess().GetUniqueID(),
+                      GetTypeName(scope).str(), expression,
+                      opts.allow_side_effects, opts.fold_constants,
+                      opts.use_bytecode, opts.scalar_tier_threshold, {}};
+  key.args.reserve(opts.context_args.size + opts.context_vars.size);
+  for (size_t i = 0; i < opts.context_args.size; ++i) {
+    const ContextArgument& arg = opts.context_args.data[i];
+    key.args.emplace_back(arg.name, GetTypeName(arg.type).str());
+  }
+  for (size_t i = 0; i < opts.context_vars.size; ++i) {
+    const ContextVariable& var = opts.context_vars.data[i];
+    key.args.emplace_back(var.name, GetTypeName(var.value.GetType()).str());
+  }
+  return key;
+}
+
+}  // namespace
+
+// Returns the context arguments in the order of their slots: the context
+// arguments followed by the context variables.
+static std::vector<std::pair<std::string, TypeSP>> ConvertToArgList(
+    ContextArgumentList context_args, ContextVariableList context_vars) {
+  std::vector<std::pair<std::string, TypeSP>> ret;
+  ret.reserve(context_args.size + context_vars.size);
   for (size_t i = 0; i < context_args.size; ++i) {
     lldb::SBType type = context_args.data[i].type;
-    ret.emplace(context_args.data[i].name, LLDBType::CreateSP(type));
+    ret.emplace_back(context_args.data[i].name, LLDBType::CreateSP(type));
+  }
+  for (size_t i = 0; i < context_vars.size; ++i) {
+    lldb::SBValue value = context_vars.data[i].value;
+    ret.emplace_back(context_vars.data[i].name,
+                     LLDBType::CreateSP(value.GetType()));
   }
   return ret;
 }
 
-static std::unordered_map<std::string, TypeSP> ConvertToTypeMap(
-    ContextVariableList context_vars) {
-  std::unordered_map<std::string, TypeSP> ret;
-  for (size_t i = 0; i < context_vars.size; ++i) {
-    lldb::SBValue value = context_vars.data[i].value;
-    ret.emplace(context_vars.data[i].name, LLDBType::CreateSP(value.GetType()));
+// Binds the context variables to the slots of the compiled expression by their
+// names. Compares every slot (one per `$name` the expression refers to) with
+// every passed variable, which is cheaper than building a map for the few
+// variables of a watch or a breakpoint condition. Callers passing many
+// variables on every evaluation should bind them by position instead (see
+// `EvaluateBoundExpression()`).
+static std::vector<Value> BindContextVars(const CompiledExpr& expression,
+                                          ContextVariableList context_vars) {
+  std::vector<Value> ret;
+  if (context_vars.size == 0) {
+    return ret;
+  }
+  ret.resize(expression.context_slots.size());
+  for (size_t slot = 0; slot < ret.size(); ++slot) {
+    const std::string& name = expression.context_slots[slot];
+    for (size_t i = 0; i < context_vars.size; ++i) {
+      if (name == context_vars.data[i].name) {
+        ret[slot] = Value(context_vars.data[i].value);
+        break;
+      }
+    }
   }
   return ret;
 }
 
-static std::unordered_map<std::string, Value> ConvertToValueMap(
-    ContextVariableList context_vars) {
-  std::unordered_map<std::string, Value> ret;
-  for (size_t i = 0; i < context_vars.size; ++i) {
-    ret.emplace(context_vars.data[i].name, Value(context_vars.data[i].value));
+static std::vector<Value> BindContextValues(ContextValueList context_values) {
+  std::vector<Value> ret;
+  ret.reserve(context_values.size);
+  for (size_t i = 0; i < context_values.size; ++i) {
+    ret.emplace_back(context_values.data[i]);
   }
   return ret;
 }
 
+static std::shared_ptr<Context> CreateFrameContext(
+    std::shared_ptr<SourceManager> source, lldb::SBFrame frame,
+    const Options& opts) {
+  if (opts.use_frame_index) {
+    return Context::Create(std::move(source), FrameIndex::Get(frame));
+  }
+  return Context::Create(std::move(source), frame);
+}
+
+// Address identifying the lexical block (and the function) the frame is
+// stopped in.
+static lldb::addr_t GetFrameBlock(lldb::SBFrame frame, lldb::SBTarget target) {
+  return frame.GetBlock().GetRangeStartAddress(0).GetLoadAddress(target);
+}
+
+// Whether the expression compiled in the block `compiled` can be evaluated in
+// a frame stopped in the block `current`. The frames without the blocks (e.g.
+// in the functions without debug information) can't be told apart, so they
+// are never compatible.
+static bool IsSameBlock(lldb::addr_t compiled, lldb::addr_t current) {
+  return compiled != LLDB_INVALID_ADDRESS && compiled == current;
+}
+
+static EvaluationBudget GetBudget(const Options& opts) {
+  EvaluationBudget budget;
+  budget.max_node_evaluations = opts.max_node_evaluations;
+  budget.max_bytes_read = opts.max_bytes_read;
+  budget.max_eval_time = opts.max_eval_time;
+  return budget;
+}
+
 static lldb::SBError CreateError(ErrorCode code, const char* message) {
   lldb::SBError error;
   error.SetError(static_cast<uint32_t>(code), lldb::eErrorTypeGeneric);
@@ -69,40 +345,85 @@ static lldb::SBError CreateError(ErrorCode code, const char* message) {
   return error;
 }
 
+static lldb::SBError CreateError(const Error& err, bool format_message) {
+  return CreateError(err.code(), format_message ? err.message().c_str()
+                                                : err.description().c_str());
+}
+
+// Compiles the expression in the context `ctx`. `frame_block` is the block of
+// the frame for the expressions compiled in a frame, see
+// `CompiledExpr::frame_block`.
 static std::shared_ptr<CompiledExpr> CompileExpressionImpl(
     std::shared_ptr<SourceManager> source, std::shared_ptr<Context> ctx,
-    Options opts, lldb::SBType scope, lldb::SBError& error) {
+    Options opts, lldb::SBType scope, lldb::SBError& error,
+    lldb::addr_t frame_block = LLDB_INVALID_ADDRESS) {
+  TraceEvent trace("CompileExpression");
   error.Clear();
+  CountStat(&EvaluationStats::num_compilations);
 
   // Handle parsing options.
-  std::unordered_map<std::string, TypeSP> context_args =
-      ConvertToTypeMap(opts.context_args);
-  context_args.merge(ConvertToTypeMap(opts.context_vars));
+  auto context_args = ConvertToArgList(opts.context_args, opts.context_vars);
+  std::vector<std::string> context_slots;
+  context_slots.reserve(context_args.size());
+  for (const auto& arg : context_args) {
+    context_slots.push_back(arg.first);
+  }
   ctx->SetContextArgs(std::move(context_args));
   ctx->SetAllowSideEffects(opts.allow_side_effects);
 
   Error err;
-  Parser p(ctx);
-  ExprResult tree = p.Run(err);
+  Parser p(ctx, ParserEngine::GetForTriple(ctx->GetTargetFacts().triple),
+           opts.use_builtin_lexer ? LexerKind::kBuiltin : LexerKind::kClang);
+  ExprResult tree;
+  {
+    PhaseTimer timer(&EvaluationStats::parse_ns);
+    tree = p.Run(err);
+  }
   if (err) {
-    error = CreateError(err.code(), err.message().c_str());
+    error = CreateError(err, opts.format_error_messages);
     return nullptr;
   }
 
-  return std::make_shared<CompiledExpr>(source, std::move(tree), scope);
+  if (opts.fold_constants) {
+    FoldConstants(tree, ctx->GetExecutionContext().GetTarget(), source);
+  }
+
+  // The bytecode refers to the nodes of the tree, moving the tree doesn't
+  // invalidate them.
+  std::shared_ptr<const Bytecode> bytecode;
+  if (opts.use_bytecode) {
+    bytecode = Bytecode::Compile(tree.get());
+  }
+  std::shared_ptr<ScalarTier> scalar_tier;
+  if (opts.scalar_tier_threshold > 0) {
+    scalar_tier = std::make_shared<ScalarTier>(opts.scalar_tier_threshold);
+  }
+  return std::make_shared<CompiledExpr>(
+      source, std::move(tree), scope, std::move(bytecode),
+      std::move(context_slots), std::move(scalar_tier), frame_block);
 }
 
 static lldb::SBValue EvaluateExpressionImpl(
-    std::shared_ptr<CompiledExpr> parsed_expr, ContextVariableList context_vars,
-    lldb::SBTarget target, Value scope, lldb::SBError& error) {
-  Interpreter eval(target, parsed_expr->source, scope);
-  if (context_vars.size > 0) {
-    eval.SetContextVars(ConvertToValueMap(context_vars));
-  }
+    std::shared_ptr<CompiledExpr> parsed_expr, Interpreter& eval,
+    lldb::SBError& error, bool format_message = true) {
+  CountStat(&EvaluationStats::num_evaluations);
+  PhaseTimer timer(&EvaluationStats::eval_ns);
+
   Error err;
-  Value ret = eval.Eval(parsed_expr->tree.get(), err);
+  Value ret;
+  const ScalarProgram* program =
+      parsed_expr->scalar_tier
+          ? parsed_expr->scalar_tier->Get(parsed_expr->tree.get(),
+                                          eval.target())
+          : nullptr;
+  if (program && eval.TryEval(*program, ret)) {
+    CountStat(&EvaluationStats::scalar_evaluations);
+  } else {
+    ret = parsed_expr->bytecode ? eval.Eval(*parsed_expr->bytecode, err)
+                                : eval.Eval(parsed_expr->tree.get(), err);
+  }
   if (err) {
-    error = CreateError(err.code(), err.message().c_str());
+    error = CreateError(err, format_message);
     return ret.inner_value();
   }
 
@@ -114,13 +435,146 @@ static lldb::SBValue EvaluateExpressionImpl(
   return value;
 }
 
+static lldb::SBValue EvaluateExpressionImpl(
+    std::shared_ptr<CompiledExpr> parsed_expr, std::vector<Value> context_vars,
+    lldb::SBTarget target, Value scope, EvaluationBudget budget,
+    const EvaluationInterrupt* interrupt, lldb::SBError& error,
+    bool format_message = true) {
+  Interpreter eval(target, parsed_expr->source, scope);
+  eval.SetContextVars(std::move(context_vars));
+  eval.SetBudget(budget);
+  eval.SetInterrupt(interrupt);
+  return EvaluateExpressionImpl(parsed_expr, eval, error, format_message);
+}
+
+// Cache of the scope cast paths of a compiled expression, keyed by the scope
+// type. The scopes of one expression are e.g. the elements of a container of
+// base class pointers, rarely of more than a few derived types. At most
+// `kMaxEntries` types are kept (the oldest one is dropped first), and they are
+// compared one by one since `lldb::SBType` can't be hashed.
+class ScopeCastCache {
+ public:
+  static constexpr size_t kMaxEntries = 16;
+
+  // Returns whether the value of `scope_type` can be casted to `context_type`,
+  // and the path of the child indices doing the cast.
+  bool GetPath(lldb::SBType scope_type, lldb::SBType context_type,
+               std::vector<uint32_t>* path) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& entry : entries_) {
+        if (entry.type == scope_type) {
+          *path = entry.path;
+          return entry.is_valid;
+        }
+      }
+    }
+
+    path->clear();
+    bool is_valid = GetPathToBaseType(LLDBType::CreateSP(scope_type),
+                                      LLDBType::CreateSP(context_type), path,
+                                      /*offset*/ nullptr);
+    std::reverse(path->begin(), path->end());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.size() == kMaxEntries) {
+      entries_.erase(entries_.begin());
+    }
+    entries_.push_back({scope_type, *path, is_valid});
+    return is_valid;
+  }
+
+  size_t GetMemoryUsage() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t bytes = sizeof(*this) + entries_.capacity() * sizeof(Entry);
+    for (const auto& entry : entries_) {
+      bytes += entry.path.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+  }
+
+ private:
+  struct Entry {
+    lldb::SBType type;
+    std::vector<uint32_t> path;
+    bool is_valid;
+  };
+
+  std::mutex mutex_;
+  std::vector<Entry> entries_;
+};
+
+// Computes the path of child indices casting a value of `scope_type` to the
+// context type of the compiled expression. This is allowed only in cases when
+// `scope_type` is equal to the context type or it is derived from the context
+// type.
+static bool GetScopeCastPath(lldb::SBType scope_type,
+                             const CompiledExpr& expression,
+                             std::vector<uint32_t>* path) {
+  // Common case, the scope has exactly the type the expression is compiled
+  // for.
+  lldb::SBType context_type = expression.scope;
+  if (scope_type == context_type) {
+    path->clear();
+    return true;
+  }
+  return expression.scope_casts->GetPath(scope_type, context_type, path);
+}
+
+static lldb::SBValue CastScope(lldb::SBValue scope,
+                               const std::vector<uint32_t>& path) {
+  for (const auto idx : path) {
+    scope = scope.GetChildAtIndex(idx);
+  }
+  assert(scope.IsValid() && "failed to cast scope variable");
+  return scope;
+}
+
+static lldb::SBError CreateIncompatibleScopeError() {
+  return CreateError(
+      ErrorCode::kUnknown,
+      "expression isn't parsed in the context of compatible type");
+}
+
+static lldb::SBError CreateIncompatibleFrameError() {
+  return CreateError(
+      ErrorCode::kUnknown,
+      "expression isn't parsed in the lexical block of the frame");
+}
+
 CompiledExpr::CompiledExpr(std::shared_ptr<SourceManager> source,
-                           std::unique_ptr<AstNode> tree, lldb::SBType scope)
+                           std::unique_ptr<const AstNode> tree,
+                           lldb::SBType scope,
+                           std::shared_ptr<const Bytecode> bytecode,
+                           std::vector<std::string> context_slots,
+                           std::shared_ptr<ScalarTier> scalar_tier,
+                           lldb::addr_t frame_block)
     : source(std::move(source)),
       tree(std::move(tree)),
-      scope(std::move(scope)) {
+      scope(std::move(scope)),
+      result_type(ToSBType(this->tree->result_type())),
+      bytecode(std::move(bytecode)),
+      scalar_tier(std::move(scalar_tier)),
+      context_slots(std::move(context_slots)),
+      scope_casts(std::make_shared<ScopeCastCache>()),
+      frame_block(frame_block) {
   assert(this->tree && this->tree->result_type() && "ast node should be valid");
-  result_type = ToSBType(this->tree->result_type());
+}
+
+size_t CompiledExpr::GetMemoryUsage() const {
+  size_t bytes = sizeof(*this) + source->GetMemoryUsage() +
+                 tree->arena().GetMemoryUsage() +
+                 scope_casts->GetMemoryUsage();
+  if (bytecode) {
+    bytes += bytecode->GetMemoryUsage();
+  }
+  if (scalar_tier) {
+    bytes += scalar_tier->GetMemoryUsage();
+  }
+  for (const auto& slot : context_slots) {
+    bytes += sizeof(slot) + slot.size();
+  }
+  return bytes;
 }
 
 lldb::SBValue EvaluateExpression(lldb::SBFrame frame, const char* expression,
@@ -128,10 +582,16 @@ lldb::SBValue EvaluateExpression(lldb::SBFrame frame, const char* expression,
   return EvaluateExpression(frame, expression, Options{}, error);
 }
 
-lldb::SBValue EvaluateExpression(lldb::SBFrame frame, const char* expression,
-                                 Options opts, lldb::SBError& error) {
-  auto source = SourceManager::Create(expression);
-  auto context = Context::Create(source, frame);
+static lldb::SBValue EvaluateInFrame(lldb::SBFrame frame,
+                                     const char* expression, Options opts,
+                                     const EvaluationInterrupt* interrupt,
+                                     lldb::SBError& error) {
+  StatsScope stats_scope(opts.stats);
+  TraceScope trace_scope(opts.trace_sink);
+  // The expression is compiled and evaluated right away, so the source can
+  // borrow the caller's string.
+  auto source = SourceManager::CreateBorrowed(expression);
+  auto context = CreateFrameContext(source, frame, opts);
   auto compiled_expr =
       CompileExpressionImpl(source, context, opts, lldb::SBType(), error);
 
@@ -140,8 +600,97 @@ lldb::SBValue EvaluateExpression(lldb::SBFrame frame, const char* expression,
   }
 
   auto target = frame.GetThread().GetProcess().GetTarget();
-  return EvaluateExpressionImpl(compiled_expr, opts.context_vars, target,
-                                Value(), error);
+  Interpreter eval(target, compiled_expr->source);
+  eval.SetFrame(frame);
+  if (opts.use_frame_index) {
+    eval.SetFrameIndex(FrameIndex::Get(frame));
+  }
+  eval.SetContextVars(BindContextVars(*compiled_expr, opts.context_vars));
+  eval.SetBudget(GetBudget(opts));
+  eval.SetInterrupt(interrupt);
+  if (opts.memory_provider) {
+    eval.SetMemoryProvider(opts.memory_provider);
+  }
+  return EvaluateExpressionImpl(compiled_expr, eval, error,
+                                opts.format_error_messages);
+}
+
+lldb::SBValue EvaluateExpression(lldb::SBFrame frame, const char* expression,
+                                 Options opts, lldb::SBError& error) {
+  return EvaluateInFrame(frame, expression, opts, /*interrupt*/ nullptr,
+                         error);
+}
+
+void EvaluateExpressions(lldb::SBFrame frame, ExpressionList expressions,
+                         Options opts, std::vector<EvaluationResult>& results) {
+  StatsScope stats_scope(opts.stats);
+  TraceScope trace_scope(opts.trace_sink);
+  results.clear();
+  results.resize(expressions.size);
+
+  auto target = frame.GetThread().GetProcess().GetTarget();
+
+  // Context and interpreter are shared by all expressions in the batch, so
+  // identifiers and types are resolved only once.
+  std::shared_ptr<Context> context;
+  std::unique_ptr<Interpreter> eval;
+  // All expressions are compiled with the same options, so they have the same
+  // context slots.
+  bool context_vars_bound = false;
+
+  for (size_t i = 0; i < expressions.size; ++i) {
+    auto source = SourceManager::CreateBorrowed(expressions.data[i]);
+    if (!context) {
+      context = CreateFrameContext(source, frame, opts);
+      eval = std::make_unique<Interpreter>(target, source);
+      eval->SetFrame(frame);
+      if (opts.use_frame_index) {
+        eval->SetFrameIndex(FrameIndex::Get(frame));
+      }
+      eval->SetBudget(GetBudget(opts));
+      if (opts.memory_provider) {
+        eval->SetMemoryProvider(opts.memory_provider);
+      }
+    } else {
+      context->SetSourceManager(source);
+      eval->SetSourceManager(source);
+    }
+
+    EvaluationResult& result = results[i];
+    auto compiled_expr = CompileExpressionImpl(source, context, opts,
+                                               lldb::SBType(), result.error);
+    if (!compiled_expr) {
+      continue;
+    }
+    if (!context_vars_bound) {
+      eval->SetContextVars(BindContextVars(*compiled_expr, opts.context_vars));
+      context_vars_bound = true;
+    }
+    result.value = EvaluateExpressionImpl(compiled_expr, *eval, result.error,
+                                          opts.format_error_messages);
+  }
+}
+
+static lldb::SBValue EvaluateInScope(
+    lldb::SBValue scope, std::shared_ptr<CompiledExpr> expression,
+    std::vector<Value> context_vars, EvaluationBudget budget,
+    const EvaluationInterrupt* interrupt, lldb::SBError& error,
+    bool format_message = true) {
+  StatsScope stats_scope(nullptr);
+
+  // The `scope` value should be casted to the context type used for parsing.
+  std::vector<uint32_t> path;
+  if (!GetScopeCastPath(scope.GetType(), *expression, &path)) {
+    // If it's not possible to cast the given `scope` value to the type context
+    // of parsed expression, return with an error.
+    error = CreateIncompatibleScopeError();
+    return lldb::SBValue();
+  }
+  scope = CastScope(scope, path);
+
+  return EvaluateExpressionImpl(expression, std::move(context_vars),
+                                scope.GetTarget(), Value(scope), budget,
+                                interrupt, error, format_message);
 }
 
 lldb::SBValue EvaluateExpression(lldb::SBValue scope, const char* expression,
@@ -151,12 +700,17 @@ lldb::SBValue EvaluateExpression(lldb::SBValue scope, const char* expression,
 
 lldb::SBValue EvaluateExpression(lldb::SBValue scope, const char* expression,
                                  Options opts, lldb::SBError& error) {
+  StatsScope stats_scope(opts.stats);
+  TraceScope trace_scope(opts.trace_sink);
   auto compiled_expr = CompileExpression(scope.GetTarget(), scope.GetType(),
                                          expression, opts, error);
   if (error.GetError()) {
     return lldb::SBValue();
   }
-  return EvaluateExpression(scope, compiled_expr, opts.context_vars, error);
+  return EvaluateInScope(scope, compiled_expr,
+                         BindContextVars(*compiled_expr, opts.context_vars),
+                         GetBudget(opts), /*interrupt*/ nullptr, error,
+                         opts.format_error_messages);
 }
 
 std::shared_ptr<CompiledExpr> CompileExpression(lldb::SBTarget target,
@@ -171,9 +725,43 @@ std::shared_ptr<CompiledExpr> CompileExpression(lldb::SBTarget target,
                                                 const char* expression,
                                                 Options opts,
                                                 lldb::SBError& error) {
+  StatsScope stats_scope(opts.stats);
+  TraceScope trace_scope(opts.trace_sink);
+  if (!opts.use_compiled_expr_cache) {
+    auto source = SourceManager::Create(expression);
+    auto context = Context::Create(source, target, LLDBType::CreateSP(scope));
+    return CompileExpressionImpl(source, context, opts, scope, error);
+  }
+
+  CompiledExprKey key = CreateCompiledExprKey(target, scope, expression, opts);
+  if (auto compiled_expr = CompiledExprCache::Instance().Lookup(key)) {
+    error.Clear();
+    return compiled_expr;
+  }
+
   auto source = SourceManager::Create(expression);
   auto context = Context::Create(source, target, LLDBType::CreateSP(scope));
-  return CompileExpressionImpl(source, context, opts, scope, error);
+  auto compiled_expr =
+      CompileExpressionImpl(source, context, opts, scope, error);
+  // Only successfully compiled expressions are cached.
+  if (compiled_expr) {
+    CompiledExprCache::Instance().Insert(std::move(key), compiled_expr);
+  }
+  return compiled_expr;
+}
+
+std::shared_ptr<CompiledExpr> CompileExpression(lldb::SBFrame frame,
+                                                const char* expression,
+                                                Options opts,
+                                                lldb::SBError& error) {
+  StatsScope stats_scope(opts.stats);
+  TraceScope trace_scope(opts.trace_sink);
+  auto source = SourceManager::Create(expression);
+  auto context = CreateFrameContext(source, frame, opts);
+  context->SetBindVariablesByDeclaration(true);
+  return CompileExpressionImpl(
+      source, context, opts, lldb::SBType(), error,
+      GetFrameBlock(frame, frame.GetThread().GetProcess().GetTarget()));
 }
 
 lldb::SBValue EvaluateExpression(lldb::SBValue scope,
@@ -186,31 +774,926 @@ lldb::SBValue EvaluateExpression(lldb::SBValue scope,
                                  std::shared_ptr<CompiledExpr> expression,
                                  ContextVariableList context_vars,
                                  lldb::SBError& error) {
-  // The `scope` value should be casted to the context type used for parsing.
-  // This is allowed only in cases when the `scope`'s type is equal to the
-  // context type or it is derived from the context type.
+  return EvaluateInScope(scope, expression,
+                         BindContextVars(*expression, context_vars),
+                         EvaluationBudget{}, /*interrupt*/ nullptr, error);
+}
 
-  std::vector<uint32_t> path;
-  if (!GetPathToBaseType(LLDBType::CreateSP(scope.GetType()),
-                         LLDBType::CreateSP(expression->scope), &path,
-                         /*offset*/ nullptr)) {
-    // If it's not possible to cast the given `scope` value to the type context
-    // of parsed expression, return with an error.
-    error = CreateError(
-        ErrorCode::kUnknown,
-        "expression isn't parsed in the context of compatible type");
+lldb::SBValue EvaluateBoundExpression(lldb::SBValue scope,
+                                      std::shared_ptr<CompiledExpr> expression,
+                                      ContextValueList context_values,
+                                      lldb::SBError& error) {
+  return EvaluateInScope(scope, expression, BindContextValues(context_values),
+                         EvaluationBudget{}, /*interrupt*/ nullptr, error);
+}
+
+lldb::SBValue EvaluateExpression(lldb::SBFrame frame,
+                                 std::shared_ptr<CompiledExpr> expression,
+                                 ContextVariableList context_vars,
+                                 lldb::SBError& error) {
+  StatsScope stats_scope(nullptr);
+  auto target = frame.GetThread().GetProcess().GetTarget();
+  // Identifiers of the frame are resolved by the interpreter, but only in the
+  // block of the compilation they refer to the same declarations.
+  if (expression->scope.IsValid() ||
+      !IsSameBlock(expression->frame_block, GetFrameBlock(frame, target))) {
+    error = CreateIncompatibleFrameError();
     return lldb::SBValue();
   }
 
-  // Cast the given `scope` to the expected type.
-  std::reverse(path.begin(), path.end());
-  for (const auto idx : path) {
-    scope = scope.GetChildAtIndex(idx);
+  Interpreter eval(target, expression->source);
+  eval.SetFrame(frame);
+  eval.SetContextVars(BindContextVars(*expression, context_vars));
+  return EvaluateExpressionImpl(expression, eval, error);
+}
+
+void EvaluateCondition(lldb::SBFrame frame,
+                       std::shared_ptr<CompiledExpr> expression, bool& result,
+                       lldb::SBError& error) {
+  StatsScope stats_scope(nullptr);
+  CountStat(&EvaluationStats::num_evaluations);
+  PhaseTimer timer(&EvaluationStats::eval_ns);
+  result = false;
+  error.Clear();
+
+  TypeSP type = expression->tree->result_type_deref();
+  if (!type->IsContextuallyConvertibleToBool()) {
+    std::string message = "value of type " + TypeDescription(type) +
+                          " is not contextually convertible to 'bool'";
+    error = CreateError(ErrorCode::kInvalidOperandType, message.c_str());
+    return;
   }
-  assert(scope.IsValid() && "failed to cast scope variable");
 
-  return EvaluateExpressionImpl(expression, context_vars, scope.GetTarget(),
-                                Value(scope), error);
+  auto target = frame.GetThread().GetProcess().GetTarget();
+  Value scope;
+  if (expression->scope.IsValid()) {
+    lldb::SBValue self = frame.FindVariable("this").Dereference();
+    std::vector<uint32_t> path;
+    if (!self.IsValid() ||
+        !GetScopeCastPath(self.GetType(), *expression, &path)) {
+      error = CreateIncompatibleScopeError();
+      return;
+    }
+    scope = Value(CastScope(self, path));
+  } else if (!IsSameBlock(expression->frame_block,
+                          GetFrameBlock(frame, target))) {
+    error = CreateIncompatibleFrameError();
+    return;
+  }
+
+  Interpreter eval(target, expression->source, scope);
+  eval.SetFrame(frame);
+
+  const ScalarProgram* program =
+      expression->scalar_tier
+          ? expression->scalar_tier->Get(expression->tree.get(),
+                                         eval.target())
+          : nullptr;
+  if (program && eval.TryEvalCondition(*program, result)) {
+    CountStat(&EvaluationStats::scalar_evaluations);
+    return;
+  }
+
+  Error err;
+  Value ret = expression->bytecode ? eval.Eval(*expression->bytecode, err)
+                                   : eval.Eval(expression->tree.get(), err);
+  if (err) {
+    error = CreateError(err, /*format_message*/ true);
+    return;
+  }
+  // Scalars computed by the interpreter and read via the memory cache are
+  // converted without creating lldb::SBValue.
+  result = ret.GetBool();
+}
+
+// Process-wide pool of the threads running the workers of `RunWorkers()`. The
+// threads are created on the first use and kept for the lifetime of the
+// process, so the batch evaluations don't start new threads on every call. The
+// pool grows to the largest number of the tasks posted at once.
+class WorkerPool {
+ public:
+  static WorkerPool& Instance() {
+    static WorkerPool* pool = new WorkerPool();
+    return *pool;
+  }
+
+  // Runs each of the `tasks` on a thread of the pool. Doesn't wait for them.
+  void Post(std::vector<std::function<void()>> tasks) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (; num_threads_ < tasks.size(); ++num_threads_) {
+      std::thread([this] { RunTasks(); }).detach();
+    }
+    for (auto& task : tasks) {
+      tasks_.push_back(std::move(task));
+    }
+    tasks_cv_.notify_all();
+  }
+
+ private:
+  WorkerPool() = default;
+
+  void RunTasks() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      tasks_cv_.wait(lock, [this] { return !tasks_.empty(); });
+      std::function<void()> task = std::move(tasks_.front());
+      tasks_.pop_front();
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable tasks_cv_;
+  std::deque<std::function<void()>> tasks_;
+  size_t num_threads_ = 0;
+};
+
+// Runs `worker` on `num_threads` threads, the calling one and the ones of the
+// `WorkerPool`, and waits for all of them. Workers running on other threads
+// collect their stats separately, they are added to the stats of the caller
+// when the workers are done.
+static void RunWorkers(size_t num_threads, llvm::function_ref<void()> worker) {
+  EvaluationStats* stats = StatsScope::Current();
+  TraceSink* trace_sink = TraceScope::Current();
+  std::vector<EvaluationStats> worker_stats(num_threads - 1);
+
+  // The tasks refer to the locals of this call, so it waits until all of them
+  // have returned, not only until the work is done.
+  std::mutex mutex;
+  std::condition_variable done_cv;
+  size_t num_running = num_threads - 1;
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 1; i < num_threads; ++i) {
+    EvaluationStats* thread_stats = stats ? &worker_stats[i - 1] : nullptr;
+    tasks.push_back([&, thread_stats] {
+      {
+        WorkerStatsScope worker_stats_scope(thread_stats);
+        TraceScope trace_scope(trace_sink);
+        worker();
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--num_running == 0) {
+        done_cv.notify_one();
+      }
+    });
+  }
+  WorkerPool::Instance().Post(std::move(tasks));
+  worker();
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [&num_running] { return num_running == 0; });
+  }
+
+  if (stats) {
+    for (const auto& thread_stats : worker_stats) {
+      *stats += thread_stats;
+    }
+  }
+}
+
+void EvaluateOverRange(std::shared_ptr<CompiledExpr> expression,
+                       lldb::SBValue container, uint32_t begin, uint32_t end,
+                       std::vector<EvaluationResult>& results) {
+  EvaluateOverRange(expression, container, begin, end, ContextVariableList{},
+                    /*num_threads*/ 1, results);
+}
+
+void EvaluateOverRange(std::shared_ptr<CompiledExpr> expression,
+                       lldb::SBValue container, uint32_t begin, uint32_t end,
+                       ContextVariableList context_vars, size_t num_threads,
+                       std::vector<EvaluationResult>& results) {
+  StatsScope stats_scope(nullptr);
+  results.clear();
+  end = std::min(end, container.GetNumChildren());
+  if (begin >= end) {
+    return;
+  }
+  results.resize(end - begin);
+
+  // Elements are evaluated in chunks. Memory of the elements in the chunk is
+  // read at once (if they are close enough to each other).
+  static constexpr uint32_t kChunkSize = 64;
+  static constexpr uint64_t kMaxPrefetchSize = 256 * 1024;
+
+  uint32_t num_chunks = (end - begin + kChunkSize - 1) / kChunkSize;
+  std::atomic<uint32_t> next_chunk(0);
+  auto bound_context_vars = BindContextVars(*expression, context_vars);
+  lldb::SBTarget target = container.GetTarget();
+
+  auto worker = [&]() {
+    // Evaluation state is created once per worker and re-used for all the
+    // elements. The elements usually have the same type, so the scope cast
+    // path is computed only when the type changes.
+    Interpreter eval(target, expression->source);
+    eval.SetContextVars(bound_context_vars);
+    lldb::SBType cast_type;
+    std::vector<uint32_t> cast_path;
+    bool cast_ok = false;
+
+    std::vector<lldb::SBValue> elements;
+    for (uint32_t chunk = next_chunk++; chunk < num_chunks;
+         chunk = next_chunk++) {
+      uint32_t chunk_begin = begin + chunk * kChunkSize;
+      uint32_t chunk_end = std::min(chunk_begin + kChunkSize, end);
+
+      elements.clear();
+      lldb::addr_t min_addr = LLDB_INVALID_ADDRESS;
+      lldb::addr_t max_addr = 0;
+      for (uint32_t i = chunk_begin; i < chunk_end; ++i) {
+        lldb::SBValue element = container.GetChildAtIndex(i);
+        lldb::addr_t addr = element.GetLoadAddress();
+        if (addr != LLDB_INVALID_ADDRESS) {
+          min_addr = std::min(min_addr, addr);
+          max_addr = std::max(max_addr, addr + element.GetByteSize());
+        }
+        elements.push_back(std::move(element));
+      }
+
+      // The memory cache is valid for one chunk only, the expressions might
+      // have side effects.
+      eval.SetKeepMemoryCache(true);
+      if (min_addr != LLDB_INVALID_ADDRESS &&
+          max_addr - min_addr <= kMaxPrefetchSize) {
+        eval.PrefetchMemory(min_addr, max_addr - min_addr);
+      }
+
+      for (uint32_t i = chunk_begin; i < chunk_end; ++i) {
+        lldb::SBValue scope = elements[i - chunk_begin];
+        EvaluationResult& result = results[i - begin];
+
+        lldb::SBType scope_type = scope.GetType();
+        if (!cast_type.IsValid() || !(cast_type == scope_type)) {
+          cast_type = scope_type;
+          cast_ok = GetScopeCastPath(scope_type, *expression, &cast_path);
+        }
+        if (!cast_ok) {
+          result.error = CreateIncompatibleScopeError();
+          continue;
+        }
+
+        eval.SetScope(Value(CastScope(scope, cast_path)));
+        result.value = EvaluateExpressionImpl(expression, eval, result.error);
+      }
+    }
+  };
+
+  // Each worker handles at least one chunk.
+  RunWorkers(std::clamp<size_t>(num_threads, 1, num_chunks), worker);
+}
+
+void EvaluateInFrames(const std::vector<lldb::SBFrame>& frames,
+                      const char* expression, Options opts, size_t num_threads,
+                      std::vector<EvaluationResult>& results) {
+  StatsScope stats_scope(opts.stats);
+  TraceScope trace_scope(opts.trace_sink);
+  results.clear();
+  results.resize(frames.size());
+  if (frames.empty()) {
+    return;
+  }
+
+  // Frames stopped in the same lexical block (of the same process) share the
+  // compiled expression. The frames without blocks (e.g. without the debug
+  // info) are compiled one by one.
+  struct Group {
+    std::shared_ptr<CompiledExpr> expression;
+    std::vector<Value> context_vars;
+    lldb::SBError error;
+  };
+  std::vector<Group> groups;
+  std::vector<size_t> frame_groups(frames.size());
+  std::map<std::pair<uint32_t, lldb::addr_t>, size_t> block_groups;
+
+  for (size_t i = 0; i < frames.size(); ++i) {
+    lldb::SBProcess process = frames[i].GetThread().GetProcess();
+    lldb::addr_t block = GetFrameBlock(frames[i], process.GetTarget());
+    if (block != LLDB_INVALID_ADDRESS) {
+      auto [it, inserted] = block_groups.emplace(
+          std::make_pair(process.GetUniqueID(), block), groups.size());
+      if (!inserted) {
+        frame_groups[i] = it->second;
+        continue;
+      }
+    }
+    frame_groups[i] = groups.size();
+    Group& group = groups.emplace_back();
+    group.expression =
+        CompileExpression(frames[i], expression, opts, group.error);
+    if (group.expression) {
+      group.context_vars =
+          BindContextVars(*group.expression, opts.context_vars);
+    }
+  }
+
+  EvaluationBudget budget = GetBudget(opts);
+  std::atomic<size_t> next_frame(0);
+
+  auto worker = [&]() {
+    // The interpreter is re-used for all the frames of the same target
+    // evaluated by the worker.
+    std::unique_ptr<Interpreter> eval;
+    for (size_t i = next_frame++; i < frames.size(); i = next_frame++) {
+      const Group& group = groups[frame_groups[i]];
+      EvaluationResult& result = results[i];
+      if (!group.expression) {
+        result.error = group.error;
+        continue;
+      }
+
+      lldb::SBTarget target = frames[i].GetThread().GetProcess().GetTarget();
+      if (!eval || !(eval->target() == target)) {
+        eval = std::make_unique<Interpreter>(target, group.expression->source);
+        eval->SetBudget(budget);
+        if (opts.memory_provider) {
+          eval->SetMemoryProvider(opts.memory_provider);
+        }
+      } else {
+        eval->SetSourceManager(group.expression->source);
+      }
+      eval->SetFrame(frames[i]);
+      if (opts.use_frame_index) {
+        eval->SetFrameIndex(FrameIndex::Get(frames[i]));
+      }
+      eval->SetContextVars(group.context_vars);
+      result.value = EvaluateExpressionImpl(group.expression, *eval,
+                                            result.error,
+                                            opts.format_error_messages);
+    }
+  };
+
+  // Each worker handles at least one frame.
+  RunWorkers(std::clamp<size_t>(num_threads, 1, frames.size()), worker);
+}
+
+// Identifies the frame the watched expression is evaluated in. The compiled
+// expression can be re-used as long as the PC stays in the same lexical block,
+// the recorded inputs only as long as the frame is the same.
+struct FrameKey {
+  lldb::tid_t thread_id = LLDB_INVALID_THREAD_ID;
+  lldb::addr_t cfa = LLDB_INVALID_ADDRESS;
+  lldb::addr_t block_addr = LLDB_INVALID_ADDRESS;
+
+  bool operator==(const FrameKey& other) const {
+    return thread_id == other.thread_id && cfa == other.cfa &&
+           block_addr == other.block_addr;
+  }
+};
+
+static FrameKey CreateFrameKey(lldb::SBFrame frame, lldb::SBTarget target) {
+  FrameKey key;
+  key.thread_id = frame.GetThread().GetThreadID();
+  key.cfa = frame.GetCFA();
+  key.block_addr = GetFrameBlock(frame, target);
+  return key;
+}
+
+// Context variable bound by the last evaluation of a watched expression. The
+// variables located in memory are identified by their addresses, the reads of
+// their contents are tracked with the other inputs. Other variables (e.g. the
+// results of the previous evaluations) are compared by their contents.
+struct WatchedContextVar {
+  std::string name;
+  lldb::SBType type;
+  lldb::addr_t addr = LLDB_INVALID_ADDRESS;
+  std::vector<uint8_t> contents;
+
+  // Whether the expression compiles the same way with both variables.
+  bool HasSameType(const WatchedContextVar& other) const {
+    lldb::SBType lhs_type = type;
+    lldb::SBType rhs_type = other.type;
+    return name == other.name && lhs_type == rhs_type;
+  }
+
+  bool operator==(const WatchedContextVar& other) const {
+    return HasSameType(other) && addr == other.addr &&
+           contents == other.contents;
+  }
+};
+
+static std::vector<WatchedContextVar> RecordContextVars(
+    ContextVariableList context_vars) {
+  std::vector<WatchedContextVar> vars(context_vars.size);
+  for (size_t i = 0; i < context_vars.size; ++i) {
+    const ContextVariable& context_var = context_vars.data[i];
+    WatchedContextVar& var = vars[i];
+    var.name = context_var.name;
+    lldb::SBValue value = context_var.value;
+    var.type = value.GetType();
+    var.addr = value.GetLoadAddress();
+    if (var.addr != LLDB_INVALID_ADDRESS) {
+      continue;
+    }
+    lldb::SBData data = value.GetData();
+    var.contents.resize(data.GetByteSize());
+    lldb::SBError error;
+    if (data.ReadRawData(error, 0, var.contents.data(),
+                         var.contents.size()) != var.contents.size() ||
+        error.Fail()) {
+      var.contents.clear();
+    }
+  }
+  return vars;
+}
+
+static bool HaveSameTypes(const std::vector<WatchedContextVar>& lhs,
+                          const std::vector<WatchedContextVar>& rhs) {
+  return lhs.size() == rhs.size() &&
+         std::equal(lhs.begin(), lhs.end(), rhs.begin(),
+                    [](const WatchedContextVar& l, const WatchedContextVar& r) {
+                      return l.HasSameType(r);
+                    });
+}
+
+// State of the watched expression behind `EvaluationSnapshot`.
+class WatchState {
+ public:
+  std::shared_ptr<CompiledExpr> expression;
+  // Scope of the evaluation (for the expressions compiled in the value scope).
+  lldb::SBValue scope;
+  // Source and frame of the compilation (for the expressions compiled in the
+  // frame).
+  std::string text;
+  FrameKey frame;
+  // Options the expression compiled in the frame depends on, besides the types
+  // of the context variables.
+  bool allow_side_effects = false;
+
+  std::vector<WatchedContextVar> context_vars;
+  DependencyTracker inputs;
+};
+
+// Scope values are identified by their address and type. Values not located in
+// memory can't be identified, the expression is evaluated every time.
+static bool IsSameScope(lldb::SBValue lhs, lldb::SBValue rhs) {
+  lldb::addr_t addr = lhs.GetLoadAddress();
+  if (addr == LLDB_INVALID_ADDRESS || addr != rhs.GetLoadAddress()) {
+    return false;
+  }
+  lldb::SBType lhs_type = lhs.GetType();
+  lldb::SBType rhs_type = rhs.GetType();
+  return lhs_type == rhs_type;
+}
+
+static void EvaluateWatched(WatchState& state, Interpreter& eval,
+                            lldb::SBProcess process, EvaluationResult& result,
+                            bool format_message = true) {
+  state.inputs.Clear();
+  eval.SetDependencyTracker(&state.inputs);
+  result.error.Clear();
+  result.value = EvaluateExpressionImpl(state.expression, eval, result.error,
+                                        format_message);
+  state.inputs.Snapshot(process);
+}
+
+bool ReevaluateExpression(lldb::SBValue scope,
+                          std::shared_ptr<CompiledExpr> expression,
+                          ContextVariableList context_vars,
+                          EvaluationSnapshot& snapshot) {
+  StatsScope stats_scope(nullptr);
+  lldb::SBProcess process = scope.GetProcess();
+  std::vector<WatchedContextVar> vars = RecordContextVars(context_vars);
+  auto& state = snapshot.state;
+  if (state && state->expression == expression &&
+      IsSameScope(state->scope, scope) && state->context_vars == vars &&
+      !state->inputs.HasChanged(process)) {
+    return false;
+  }
+
+  if (!state) {
+    state = std::make_shared<WatchState>();
+  }
+  state->expression = expression;
+  state->scope = scope;
+  state->context_vars = std::move(vars);
+  snapshot.result = EvaluationResult{};
+
+  std::vector<uint32_t> path;
+  if (!GetScopeCastPath(scope.GetType(), *expression, &path)) {
+    // Depends only on the scope type, there are no other inputs.
+    state->inputs.Clear();
+    snapshot.result.error = CreateIncompatibleScopeError();
+    return true;
+  }
+
+  Interpreter eval(scope.GetTarget(), expression->source,
+                   Value(CastScope(scope, path)));
+  eval.SetContextVars(BindContextVars(*expression, context_vars));
+  EvaluateWatched(*state, eval, process, snapshot.result);
+  return true;
+}
+
+bool ReevaluateExpression(lldb::SBFrame frame, const char* expression,
+                          Options opts, EvaluationSnapshot& snapshot) {
+  StatsScope stats_scope(opts.stats);
+  TraceScope trace_scope(opts.trace_sink);
+  auto target = frame.GetThread().GetProcess().GetTarget();
+  lldb::SBProcess process = target.GetProcess();
+  FrameKey key = CreateFrameKey(frame, target);
+
+  // The compiled expression doesn't depend on the frame, only on the
+  // identifiers visible in it. Compilation errors don't change either.
+  std::vector<WatchedContextVar> vars = RecordContextVars(opts.context_vars);
+  auto& state = snapshot.state;
+  bool same_block = state && state->text == expression &&
+                    state->frame.block_addr == key.block_addr &&
+                    state->allow_side_effects == opts.allow_side_effects &&
+                    HaveSameTypes(state->context_vars, vars);
+  if (same_block &&
+      (!state->expression ||
+       (state->frame == key && state->context_vars == vars &&
+        !state->inputs.HasChanged(process)))) {
+    state->frame = key;
+    return false;
+  }
+
+  if (!state) {
+    state = std::make_shared<WatchState>();
+  }
+  state->frame = key;
+  state->context_vars = std::move(vars);
+  if (!same_block) {
+    state->text = expression;
+    state->allow_side_effects = opts.allow_side_effects;
+    state->inputs.Clear();
+    snapshot.result = EvaluationResult{};
+
+    auto source = SourceManager::Create(expression);
+    auto context = CreateFrameContext(source, frame, opts);
+    state->expression = CompileExpressionImpl(source, context, opts,
+                                              lldb::SBType(),
+                                              snapshot.result.error);
+    if (!state->expression) {
+      return true;
+    }
+  }
+
+  Interpreter eval(target, state->expression->source);
+  eval.SetFrame(frame);
+  if (opts.use_frame_index) {
+    eval.SetFrameIndex(FrameIndex::Get(frame));
+  }
+  eval.SetContextVars(BindContextVars(*state->expression, opts.context_vars));
+  eval.SetBudget(GetBudget(opts));
+  if (opts.memory_provider) {
+    eval.SetMemoryProvider(opts.memory_provider);
+  }
+  EvaluateWatched(*state, eval, process, snapshot.result,
+                  opts.format_error_messages);
+  return true;
+}
+
+// State of the expression being edited behind `CompilationSession`.
+class EditState {
+ public:
+  lldb::SBTarget target;
+  lldb::SBType scope;
+  std::string text;
+  // Context of the previous compilations. Its caches of the resolved
+  // identifiers and types are re-used by the next ones, they are valid until
+  // the caches of the target are invalidated.
+  std::shared_ptr<Context> context;
+  std::shared_ptr<TargetCache> target_cache;
+};
+
+bool RecompileExpression(lldb::SBTarget target, lldb::SBType scope,
+                         const char* expression, Options opts,
+                         CompilationSession& session) {
+  StatsScope stats_scope(opts.stats);
+  TraceScope trace_scope(opts.trace_sink);
+  auto target_cache = TargetCache::Get(target);
+  auto& state = session.state;
+  bool same_context = state && state->target == target &&
+                      state->scope == scope &&
+                      state->target_cache == target_cache;
+  if (same_context && state->text == expression) {
+    return false;
+  }
+
+  if (!same_context) {
+    state = std::make_shared<EditState>();
+    state->target = target;
+    state->scope = scope;
+    state->target_cache = std::move(target_cache);
+  }
+  state->text = expression;
+
+  auto source = SourceManager::Create(state->text);
+  if (state->context) {
+    state->context->SetSourceManager(source);
+  } else {
+    state->context =
+        Context::Create(source, target, LLDBType::CreateSP(scope));
+  }
+  session.expression = CompileExpressionImpl(source, state->context, opts,
+                                             scope, session.error);
+  return true;
+}
+
+// Identifier being completed at the end of the expression and the object it is
+// a member of, see `CompleteExpression()`.
+struct CompletionPoint {
+  // Expression of the object before `.` or `->`, if the identifier is a member.
+  llvm::StringRef object;
+  bool is_member = false;
+  bool is_arrow = false;
+  llvm::StringRef prefix;
+};
+
+static CompletionPoint FindCompletionPoint(llvm::StringRef expr) {
+  size_t begin = expr.size();
+  while (begin > 0 && (llvm::isAlnum(expr[begin - 1]) ||
+                       expr[begin - 1] == '_' || expr[begin - 1] == '$')) {
+    --begin;
+  }
+  CompletionPoint point;
+  point.prefix = expr.drop_front(begin);
+  llvm::StringRef rest = expr.take_front(begin).rtrim();
+  if (rest.consume_back("->")) {
+    point.is_member = true;
+    point.is_arrow = true;
+  } else if (rest.consume_back(".")) {
+    point.is_member = true;
+  }
+  point.object = rest;
+  return point;
+}
+
+static CompletionCandidate::Kind GetCandidateKind(
+    Context::IdentifierInfo::Kind kind) {
+  using Kind = Context::IdentifierInfo::Kind;
+  switch (kind) {
+    case Kind::kContextArg:
+      return CompletionCandidate::Kind::kContextVariable;
+    case Kind::kLocalVariable:
+    case Kind::kFrameVariable:
+      return CompletionCandidate::Kind::kLocalVariable;
+    case Kind::kMemberPath:
+    case Kind::kInstanceVariable:
+      return CompletionCandidate::Kind::kMember;
+    default:
+      return CompletionCandidate::Kind::kGlobalVariable;
+  }
+}
+
+void CompleteExpression(lldb::SBFrame frame, const char* expression,
+                        Options opts,
+                        std::vector<CompletionCandidate>& candidates) {
+  StatsScope stats_scope(opts.stats);
+  TraceScope trace_scope(opts.trace_sink);
+  candidates.clear();
+  CompletionPoint point = FindCompletionPoint(expression);
+  if (!point.prefix.empty() && llvm::isDigit(point.prefix.front())) {
+    // Numeric literal, e.g. "1.5".
+    return;
+  }
+
+  // Only the object is compiled, the buffer has to be null-terminated.
+  auto source = SourceManager::Create(point.object.str());
+  auto context = Context::Create(source, FrameIndex::Get(frame));
+  context->SetContextArgs(
+      ConvertToArgList(opts.context_args, opts.context_vars));
+
+  if (!point.is_member) {
+    for (auto& candidate : context->CompleteIdentifier(point.prefix)) {
+      candidates.push_back({std::move(candidate.name),
+                            ToSBType(candidate.type),
+                            GetCandidateKind(candidate.kind)});
+    }
+    return;
+  }
+
+  context->SetAllowSideEffects(opts.allow_side_effects);
+  Error err;
+  Parser p(context,
+           ParserEngine::GetForTriple(context->GetTargetFacts().triple),
+           opts.use_builtin_lexer ? LexerKind::kBuiltin : LexerKind::kClang);
+  ExprResult tree;
+  {
+    PhaseTimer timer(&EvaluationStats::parse_ns);
+    tree = p.Run(err);
+  }
+  if (err) {
+    return;
+  }
+
+  // Same as `Parser::BuildMemberOf()`, `->` accepts the pointers, the smart
+  // pointers and the arrays of the records.
+  TypeSP type = tree->result_type_deref();
+  if (point.is_arrow) {
+    if (type->IsPointerType()) {
+      type = type->GetPointeeType();
+    } else if (type->IsSmartPtrType()) {
+      type = type->GetSmartPtrPointeeType();
+    } else if (type->IsArrayType()) {
+      type = type->GetArrayElementType();
+    } else {
+      return;
+    }
+  }
+  if (!type->IsRecordType()) {
+    return;
+  }
+  for (auto& [name, member] :
+       context->FindMembersWithPrefix(type, point.prefix)) {
+    candidates.push_back({std::move(name), ToSBType(member.type),
+                          CompletionCandidate::Kind::kMember});
+  }
+}
+
+struct AsyncEvaluationState {
+  explicit AsyncEvaluationState(AsyncEvaluation::Clock::time_point deadline)
+      : interrupt(deadline) {}
+
+  EvaluationInterrupt interrupt;
+  std::mutex mutex;
+  std::condition_variable done_cv;
+  bool done = false;
+  EvaluationResult result;
+};
+
+AsyncEvaluation::AsyncEvaluation(std::shared_ptr<AsyncEvaluationState> state)
+    : state_(std::move(state)) {}
+
+void AsyncEvaluation::Cancel() {
+  assert(state_ && "invalid async evaluation");
+  state_->interrupt.Cancel();
+}
+
+bool AsyncEvaluation::IsDone() const {
+  assert(state_ && "invalid async evaluation");
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->done;
+}
+
+EvaluationResult AsyncEvaluation::Wait() const {
+  assert(state_ && "invalid async evaluation");
+  std::unique_lock<std::mutex> lock(state_->mutex);
+  state_->done_cv.wait(lock, [this] { return state_->done; });
+  return state_->result;
+}
+
+bool AsyncEvaluation::WaitFor(Clock::duration timeout) const {
+  assert(state_ && "invalid async evaluation");
+  std::unique_lock<std::mutex> lock(state_->mutex);
+  return state_->done_cv.wait_for(lock, timeout,
+                                  [this] { return state_->done; });
+}
+
+// Runs `evaluate(interrupt, error)` on a new thread. The thread holds the state
+// until the evaluation is done, so the handles can be dropped earlier.
+template <typename F>
+static AsyncEvaluation StartAsyncEvaluation(
+    AsyncEvaluation::Clock::time_point deadline, F evaluate) {
+  auto state = std::make_shared<AsyncEvaluationState>(deadline);
+  std::thread([state, evaluate = std::move(evaluate)]() mutable {
+    EvaluationResult result;
+    result.value = evaluate(&state->interrupt, result.error);
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->result = std::move(result);
+      state->done = true;
+    }
+    state->done_cv.notify_all();
+  }).detach();
+  return AsyncEvaluation(std::move(state));
+}
+
+AsyncEvaluation EvaluateExpressionAsync(
+    lldb::SBFrame frame, const char* expression, Options opts,
+    AsyncEvaluation::Clock::time_point deadline) {
+  // The caller's arrays may go away before the evaluation is done, copy them
+  // together with the names.
+  struct OwnedOptions {
+    std::string expression;
+    std::vector<std::string> names;
+    std::vector<ContextArgument> args;
+    std::vector<ContextVariable> vars;
+    Options opts;
+  };
+  auto owned = std::make_shared<OwnedOptions>();
+  owned->expression = expression;
+  for (size_t i = 0; i < opts.context_args.size; ++i) {
+    owned->names.emplace_back(opts.context_args.data[i].name);
+  }
+  for (size_t i = 0; i < opts.context_vars.size; ++i) {
+    owned->names.emplace_back(opts.context_vars.data[i].name);
+  }
+  size_t name_index = 0;
+  for (size_t i = 0; i < opts.context_args.size; ++i) {
+    owned->args.push_back({owned->names[name_index++].c_str(),
+                           opts.context_args.data[i].type});
+  }
+  for (size_t i = 0; i < opts.context_vars.size; ++i) {
+    owned->vars.push_back({owned->names[name_index++].c_str(),
+                           opts.context_vars.data[i].value});
+  }
+  owned->opts = opts;
+  owned->opts.context_args = {owned->args.data(), owned->args.size()};
+  owned->opts.context_vars = {owned->vars.data(), owned->vars.size()};
+
+  return StartAsyncEvaluation(
+      deadline, [frame, owned](const EvaluationInterrupt* interrupt,
+                               lldb::SBError& error) {
+        return EvaluateInFrame(frame, owned->expression.c_str(), owned->opts,
+                               interrupt, error);
+      });
+}
+
+AsyncEvaluation EvaluateExpressionAsync(
+    lldb::SBValue scope, std::shared_ptr<CompiledExpr> expression,
+    ContextVariableList context_vars,
+    AsyncEvaluation::Clock::time_point deadline) {
+  // Binding copies the values of the context variables.
+  auto bound_context_vars = BindContextVars(*expression, context_vars);
+  return StartAsyncEvaluation(
+      deadline, [scope, expression, bound_context_vars](
+                    const EvaluationInterrupt* interrupt,
+                    lldb::SBError& error) {
+        return EvaluateInScope(scope, expression, bound_context_vars,
+                               EvaluationBudget{}, interrupt, error);
+      });
+}
+
+std::vector<uint8_t> SerializeCompiledExpr(
+    lldb::SBTarget target, std::shared_ptr<CompiledExpr> expression) {
+  return WriteCompiledExpr(target, *expression);
+}
+
+std::shared_ptr<CompiledExpr> DeserializeCompiledExpr(
+    lldb::SBTarget target, lldb::SBType scope, const std::vector<uint8_t>& data,
+    Options opts, lldb::SBError& error) {
+  StatsScope stats_scope(opts.stats);
+  TraceScope trace_scope(opts.trace_sink);
+  error.Clear();
+  auto context_args = ConvertToArgList(opts.context_args, opts.context_vars);
+  std::optional<std::string> source;
+  if (auto compiled_expr =
+          ReadCompiledExpr(target, scope, data, context_args, opts, &source)) {
+    return compiled_expr;
+  }
+  if (!source) {
+    error = CreateError(ErrorCode::kUnknown, "malformed serialized expression");
+    return nullptr;
+  }
+  return CompileExpression(target, scope, source->c_str(), opts, error);
+}
+
+void SetCompiledExprCacheSize(size_t max_entries) {
+  CompiledExprCache::Instance().SetMaxEntries(max_entries);
+}
+
+void InvalidateCaches(lldb::SBTarget target) {
+  CompiledExprCache::Instance().Invalidate(target);
+  TargetCache::Invalidate(target);
+}
+
+void InvalidateCaches(const lldb::SBEvent& event) {
+  if (lldb::SBProcess::EventIsProcessEvent(event)) {
+    lldb::StateType state = lldb::SBProcess::GetStateFromEvent(event);
+    if (state == lldb::eStateExited || state == lldb::eStateDetached) {
+      TargetCache::InvalidateProcessData(
+          lldb::SBProcess::GetProcessFromEvent(event).GetTarget());
+    }
+    return;
+  }
+  if (!lldb::SBTarget::EventIsTargetEvent(event)) {
+    return;
+  }
+  const uint32_t kModuleEvents = lldb::SBTarget::eBroadcastBitModulesLoaded |
+                                 lldb::SBTarget::eBroadcastBitModulesUnloaded |
+                                 lldb::SBTarget::eBroadcastBitSymbolsLoaded;
+  if (event.GetType() & kModuleEvents) {
+    InvalidateCaches(lldb::SBTarget::GetTargetFromEvent(event));
+  }
+}
+
+void ClearCaches() {
+  CompiledExprCache::Instance().Clear();
+  TargetCache::Clear();
+  FrameIndex::Clear();
+}
+
+CacheMemoryUsage GetCacheMemoryUsage() {
+  CacheMemoryUsage usage;
+  usage.compiled_exprs = CompiledExprCache::Instance().GetMemoryUsage();
+  TargetCache::MemoryUsage target_usage = TargetCache::GetTotalMemoryUsage();
+  usage.types = target_usage.types;
+  usage.globals = target_usage.globals;
+  usage.member_paths = target_usage.member_paths;
+  usage.frame_indexes = FrameIndex::GetTotalMemoryUsage();
+  return usage;
+}
+
+void SetCacheMemoryLimits(const CacheMemoryUsage& limits) {
+  CompiledExprCache::Instance().SetMaxBytes(limits.compiled_exprs);
+  TargetCache::MemoryUsage target_limits;
+  target_limits.types = limits.types;
+  target_limits.globals = limits.globals;
+  target_limits.member_paths = limits.member_paths;
+  TargetCache::SetMemoryLimits(target_limits);
+  FrameIndex::SetMemoryLimit(limits.frame_indexes);
 }
 
 }  // namespace lldb_eval
@@ -17,10 +17,16 @@
 #ifndef LLDB_EVAL_API_H_
 #define LLDB_EVAL_API_H_
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "lldb/API/SBError.h"
+#include "lldb/API/SBEvent.h"
 #include "lldb/API/SBFrame.h"
+#include "lldb/API/SBTarget.h"
 #include "lldb/API/SBValue.h"
 
 #ifdef _MSC_VER
@@ -42,7 +48,14 @@ namespace lldb_eval {
 // Including full definitions of the following classes also includes many
 // unnecessary structures from LLVM. Forward declaration is sufficient.
 class AstNode;
+struct AsyncEvaluationState;
+class Bytecode;
+class EditState;
+class MemoryProvider;
+class ScalarTier;
+class ScopeCastCache;
 class SourceManager;
+class WatchState;
 
 // Context variables (aka. convenience variables) are variables living entirely
 // within LLDB. They are prefixed with '$' and created via expression evaluation
@@ -73,20 +86,286 @@ struct ContextArgumentList {
   size_t size;
 };
 
+// Values of the context variables bound by position: the i-th value is bound to
+// the i-th slot of the compiled expression (see `CompiledExpr::context_slots`).
+// Invalid values leave the slot unbound.
+struct ContextValueList {
+  const lldb::SBValue* data;
+  size_t size;
+};
+
+// List of expressions for the batch evaluation.
+struct ExpressionList {
+  const char* const* data;
+  size_t size;
+};
+
+struct EvaluationResult {
+  lldb::SBValue value;
+  lldb::SBError error;
+};
+
+// Result of the last evaluation of a watched expression and the inputs it has
+// read, see `ReevaluateExpression()`. Initially empty.
+struct EvaluationSnapshot {
+  EvaluationResult result;
+  std::shared_ptr<WatchState> state;
+};
+
+// Handle of an evaluation running on a separate thread, see
+// `EvaluateExpressionAsync()`. Copies of the handle refer to the same
+// evaluation. Dropping the handles doesn't stop the evaluation.
+class LLDB_EVAL_API AsyncEvaluation {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  AsyncEvaluation() = default;
+  explicit AsyncEvaluation(std::shared_ptr<AsyncEvaluationState> state);
+
+  bool IsValid() const { return state_ != nullptr; }
+
+  // Requests the evaluation to stop. The evaluation fails with an "evaluation
+  // cancelled" error at the next node or the next chunk of a buffer scan. Does
+  // nothing if the evaluation is already done.
+  void Cancel();
+
+  bool IsDone() const;
+
+  // Blocks until the evaluation is done and returns its result.
+  EvaluationResult Wait() const;
+
+  // Blocks until the evaluation is done or `timeout` passes. Returns true if
+  // the evaluation is done.
+  bool WaitFor(Clock::duration timeout) const;
+
+ private:
+  std::shared_ptr<AsyncEvaluationState> state_;
+};
+
+// Receives the trace events of the API calls, see `Options::trace_sink`. An
+// event is reported when the traced operation (e.g. the parsing, a type lookup
+// or a memory read) ends, on the thread doing it. The implementations must be
+// thread-safe.
+class LLDB_EVAL_API TraceSink {
+ public:
+  virtual ~TraceSink() = default;
+
+  // `name` identifies the operation, `detail` is its argument (e.g. the name
+  // of the looked up type) or empty. `begin` is the steady clock time the
+  // operation started at. `thread_id` identifies the thread, the ids are
+  // assigned sequentially in the order the threads report their first event.
+  virtual void AddEvent(const char* name, const std::string& detail,
+                        std::chrono::nanoseconds begin,
+                        std::chrono::nanoseconds duration,
+                        uint32_t thread_id) = 0;
+};
+
+// Writes the trace events to a file in the Chrome trace event format, which can
+// be loaded by chrome://tracing or Perfetto. The file is complete once the sink
+// is destroyed.
+class LLDB_EVAL_API ChromeTraceSink : public TraceSink {
+ public:
+  // Returns null if the file can't be opened for writing.
+  static std::unique_ptr<ChromeTraceSink> Create(const std::string& path);
+
+  ~ChromeTraceSink() override;
+
+  void AddEvent(const char* name, const std::string& detail,
+                std::chrono::nanoseconds begin,
+                std::chrono::nanoseconds duration,
+                uint32_t thread_id) override;
+
+ private:
+  class Writer;
+
+  explicit ChromeTraceSink(std::unique_ptr<Writer> writer);
+
+  std::unique_ptr<Writer> writer_;
+};
+
+// Wall times and counters of the evaluations, see `Options::stats`. The phases
+// may nest, e.g. the parsing time includes the lexing and the lookups done by
+// the parser, the evaluation time includes the memory reads.
+struct EvaluationStats {
+  uint64_t num_compilations = 0;
+  uint64_t num_evaluations = 0;
+
+  // Wall times of the phases, in nanoseconds.
+  uint64_t total_ns = 0;
+  uint64_t lex_ns = 0;
+  uint64_t parse_ns = 0;
+  uint64_t type_lookup_ns = 0;
+  uint64_t identifier_lookup_ns = 0;
+  uint64_t eval_ns = 0;
+  uint64_t memory_read_ns = 0;
+
+  // Number of the calls to the LLDB's API doing the lookups and creating the
+  // values.
+  uint64_t find_types_calls = 0;
+  uint64_t find_global_variables_calls = 0;
+  uint64_t create_value_from_data_calls = 0;
+
+  // Memory read by lldb-eval directly (e.g. via the memory cache or the buffer
+  // scans). Memory read by LLDB for the values of the variables isn't counted.
+  uint64_t memory_read_calls = 0;
+  uint64_t memory_bytes_read = 0;
+
+  // Number of AST nodes created by the parser and the AST transformations.
+  uint64_t ast_nodes = 0;
+
+  // Number of the evaluations done by the scalar programs, see
+  // `Options::scalar_tier_threshold`.
+  uint64_t scalar_evaluations = 0;
+
+  EvaluationStats& operator+=(const EvaluationStats& other);
+};
+
 struct Options {
   bool allow_side_effects = false;
   ContextArgumentList context_args = {};
   ContextVariableList context_vars = {};
+
+  // If set, compiled expressions are stored in a process-wide LRU cache and
+  // re-used by subsequent compilations of the same expression (in the same
+  // target, scope and with the same context argument types). Only applies to
+  // expressions compiled in the value scope. The cache must be invalidated by
+  // the user when modules are loaded or unloaded, see `InvalidateCaches()`.
+  bool use_compiled_expr_cache = false;
+
+  // If set, the expression is tokenized by the builtin lexer instead of
+  // clang::Preprocessor. This is faster, but macros, trigraphs and raw string
+  // literals are not supported.
+  bool use_builtin_lexer = false;
+
+  // If set, constant subexpressions (e.g. `sizeof(int) * 4 + 1`) are evaluated
+  // once during the compilation and replaced with literals. Mostly useful for
+  // compiled expressions that are evaluated many times.
+  bool fold_constants = false;
+
+  // If set, compiled expressions are additionally lowered to bytecode, which is
+  // faster to evaluate than walking the AST. Mostly useful for compiled
+  // expressions that are evaluated many times.
+  bool use_bytecode = false;
+
+  // If non-zero, compiled expressions evaluated more than this many times are
+  // lowered to a program operating on the native integers and floats, which
+  // reads the memory directly and doesn't create the intermediate values. Only
+  // the expressions over scalars without side effects are lowered, the others
+  // (and the evaluations with a budget or the dependency tracking) fallback to
+  // the interpreter. Mostly useful for conditions of the breakpoints and
+  // expressions evaluated for every element of a container.
+  uint32_t scalar_tier_threshold = 0;
+
+  // If set, the identifiers of the frame (local variables, members of `this`
+  // and registers) are looked up in an index of the frame instead of querying
+  // the frame for each of them. The index is built on the first use at every
+  // stop of the process and shared by all the expressions evaluated in the
+  // frame until the next stop. The registers are read from the process once
+  // per stop too. Mostly useful for evaluating many expressions in the same
+  // frame (e.g. the watch window).
+  bool use_frame_index = false;
+
+  // Limits of every evaluation done by the call, zero means no limit. The
+  // evaluation fails with an error once it evaluates more than
+  // `max_node_evaluations` nodes, reads more than `max_bytes_read` bytes of the
+  // process memory or runs longer than `max_eval_time`. Only the memory read by
+  // lldb-eval directly is counted (see `EvaluationStats::memory_bytes_read`).
+  // The limits are checked before every node and every chunk of the buffer
+  // scans, so that one expression (e.g. a huge `__findnonnull`) can't stall the
+  // caller.
+  uint64_t max_node_evaluations = 0;
+  uint64_t max_bytes_read = 0;
+  std::chrono::nanoseconds max_eval_time{0};
+
+  // If unset, the messages of the errors contain only their description (e.g.
+  // "use of undeclared identifier 'x'"), without the location and the line of
+  // the expression. Formatting them is the most expensive part of the failed
+  // calls, callers that only check the error code (e.g. probing candidate
+  // expressions for autocompletion) can skip it.
+  bool format_error_messages = true;
+
+  // If set, the memory is read from `memory_provider` instead of the process
+  // (e.g. from a `SnapshotMemoryProvider` when analyzing a dump offline). Only
+  // applies to the evaluations in a frame. The values LLDB reads itself (e.g.
+  // the variables in the registers) still come from the process.
+  std::shared_ptr<MemoryProvider> memory_provider;
+
+  // If set, the trace events of the call are reported to `trace_sink` (instead
+  // of the global sink, see `SetTraceSink()`). The sink must outlive the call,
+  // or the evaluation for the asynchronous calls (see
+  // `EvaluateExpressionAsync()`).
+  TraceSink* trace_sink = nullptr;
+
+  // If set, the stats of the call are added to `*stats`. Collecting the stats
+  // has a small overhead, they are not collected by default.
+  EvaluationStats* stats = nullptr;
 };
 
+// Expression compiled in the context of a type or of a frame (see
+// `CompileExpression()`). It is immutable after the compilation, all the
+// evaluation state is created per `EvaluateExpression()` call. Therefore the
+// same compiled expression can be evaluated concurrently from multiple threads
+// (e.g. against different scope values). The non-const methods of the types
+// (e.g. `lldb::SBType::GetName()`) are called on their copies.
 struct CompiledExpr {
-  std::shared_ptr<SourceManager> source;
-  std::unique_ptr<AstNode> tree;
-  lldb::SBType scope;
-  lldb::SBType result_type;
+  const std::shared_ptr<SourceManager> source;
+  const std::unique_ptr<const AstNode> tree;
+  const lldb::SBType scope;
+  const lldb::SBType result_type;
+  // Optional, see `Options::use_bytecode`.
+  const std::shared_ptr<const Bytecode> bytecode;
+  // Optional, see `Options::scalar_tier_threshold`. Thread-safe.
+  const std::shared_ptr<ScalarTier> scalar_tier;
+  // Names of the context arguments in the order of their slots: the
+  // `Options::context_args` followed by the `Options::context_vars` used for
+  // the compilation.
+  const std::vector<std::string> context_slots;
+  // Paths casting the scope values of the derived types to `scope`, resolved
+  // by the previous evaluations. Thread-safe.
+  const std::shared_ptr<ScopeCastCache> scope_casts;
+  // Load address of the lexical block the expression is compiled in, for the
+  // expressions compiled in a frame. They can be evaluated only in the frames
+  // stopped in the same block. Invalid for the expressions compiled in the
+  // context of a type.
+  const lldb::addr_t frame_block;
 
   CompiledExpr(std::shared_ptr<SourceManager> source,
-               std::unique_ptr<AstNode> tree, lldb::SBType scope);
+               std::unique_ptr<const AstNode> tree, lldb::SBType scope,
+               std::shared_ptr<const Bytecode> bytecode = nullptr,
+               std::vector<std::string> context_slots = {},
+               std::shared_ptr<ScalarTier> scalar_tier = nullptr,
+               lldb::addr_t frame_block = LLDB_INVALID_ADDRESS);
+
+  // Estimated memory held by the compiled expression, in bytes: the source,
+  // the AST, the bytecode, the scalar program and the resolved scope casts.
+  // The types of the AST are shared with the target cache and are counted
+  // there (see `GetCacheMemoryUsage()`). Grows once the expression is lowered
+  // to the scalar program and with the scope casts.
+  size_t GetMemoryUsage() const;
+};
+
+// Result of the last compilation of an expression being edited and the state
+// re-used by the next compilation, see `RecompileExpression()`. Initially
+// empty.
+struct CompilationSession {
+  std::shared_ptr<CompiledExpr> expression;
+  lldb::SBError error;
+  std::shared_ptr<EditState> state;
+};
+
+// Identifier or member completing an expression, see `CompleteExpression()`.
+struct CompletionCandidate {
+  enum class Kind {
+    kContextVariable,
+    kLocalVariable,
+    // Member of the object before `.` or `->`, or of `this`.
+    kMember,
+    kGlobalVariable,
+  };
+
+  std::string name;
+  lldb::SBType type;
+  Kind kind;
 };
 
 LLDB_EVAL_API
@@ -105,6 +384,14 @@ LLDB_EVAL_API
 lldb::SBValue EvaluateExpression(lldb::SBValue scope, const char* expression,
                                  Options opts, lldb::SBError& error);
 
+// Evaluates a batch of expressions in the context of the same frame. The
+// expressions share identifier lookup and type resolution results and are
+// evaluated by the same interpreter. `results` is resized to the number of
+// expressions, the i-th result corresponds to the i-th expression.
+LLDB_EVAL_API
+void EvaluateExpressions(lldb::SBFrame frame, ExpressionList expressions,
+                         Options opts, std::vector<EvaluationResult>& results);
+
 LLDB_EVAL_API
 std::shared_ptr<CompiledExpr> CompileExpression(lldb::SBTarget target,
                                                 lldb::SBType scope,
@@ -118,6 +405,18 @@ std::shared_ptr<CompiledExpr> CompileExpression(lldb::SBTarget target,
                                                 Options opts,
                                                 lldb::SBError& error);
 
+// Compiles the expression in the context of the frame, e.g. for a condition of
+// a breakpoint. The local variables are bound by their declarations, the
+// members of `this` and the registers by their names. The values are looked up
+// on every evaluation, so the compiled expression can be evaluated in any frame
+// stopped in the same function and lexical block (e.g. at every hit of the
+// breakpoint) without being parsed again, see `CompiledExpr::frame_block`.
+LLDB_EVAL_API
+std::shared_ptr<CompiledExpr> CompileExpression(lldb::SBFrame frame,
+                                                const char* expression,
+                                                Options opts,
+                                                lldb::SBError& error);
+
 LLDB_EVAL_API
 lldb::SBValue EvaluateExpression(lldb::SBValue scope,
                                  std::shared_ptr<CompiledExpr> expression,
@@ -129,6 +428,261 @@ lldb::SBValue EvaluateExpression(lldb::SBValue scope,
                                  ContextVariableList context_vars,
                                  lldb::SBError& error);
 
+// Same as above, but the values of the context variables are bound to the slots
+// by position, rather than by name. This avoids looking up the names on every
+// evaluation, e.g. for conditional breakpoints passing the same variables on
+// every hit.
+LLDB_EVAL_API
+lldb::SBValue EvaluateBoundExpression(lldb::SBValue scope,
+                                      std::shared_ptr<CompiledExpr> expression,
+                                      ContextValueList context_values,
+                                      lldb::SBError& error);
+
+// Evaluates the expression compiled in the context of a frame. Fails if the
+// frame is stopped in another lexical block than the expression is compiled
+// in, or if either frame has no lexical block (e.g. it's in a function without
+// debug information).
+LLDB_EVAL_API
+lldb::SBValue EvaluateExpression(lldb::SBFrame frame,
+                                 std::shared_ptr<CompiledExpr> expression,
+                                 ContextVariableList context_vars,
+                                 lldb::SBError& error);
+
+// Evaluates the compiled expression as a condition (e.g. of a breakpoint) in
+// the context of the frame. The result is converted to bool directly rather
+// than creating lldb::SBValue for it, and the hot conditions are evaluated by
+// the scalar programs (see `Options::scalar_tier_threshold`). If the
+// expression is compiled in the context of a type, the scope is `*this` of the
+// frame. Otherwise it must be compiled in the same lexical block the frame is
+// stopped in. `result` is false if the evaluation fails.
+LLDB_EVAL_API
+void EvaluateCondition(lldb::SBFrame frame,
+                       std::shared_ptr<CompiledExpr> expression, bool& result,
+                       lldb::SBError& error);
+
+// Evaluates the compiled expression in the scope of each child of `container`
+// with index in [begin, end), e.g. for expanding the elements of an array or a
+// std::vector. `results` is resized to the number of evaluated elements, the
+// i-th result corresponds to the child `begin + i`. The range is clamped to the
+// number of children.
+//
+// The evaluation state is re-used for all the elements, and the memory of the
+// nearby elements is read at once. If `num_threads` is greater than one, the
+// elements are evaluated concurrently by the calling thread and the threads of
+// a pool shared with `EvaluateInFrames()`. The pool is created on the first use
+// and kept for the lifetime of the process. Expressions with side effects
+// should be evaluated by one thread, since the order of the evaluations is not
+// defined otherwise.
+LLDB_EVAL_API
+void EvaluateOverRange(std::shared_ptr<CompiledExpr> expression,
+                       lldb::SBValue container, uint32_t begin, uint32_t end,
+                       std::vector<EvaluationResult>& results);
+
+LLDB_EVAL_API
+void EvaluateOverRange(std::shared_ptr<CompiledExpr> expression,
+                       lldb::SBValue container, uint32_t begin, uint32_t end,
+                       ContextVariableList context_vars, size_t num_threads,
+                       std::vector<EvaluationResult>& results);
+
+// Evaluates the expression in each of the `frames`, e.g. in the frames of all
+// the threads of the process. The expression is compiled once per lexical
+// block the frames are stopped in (see `CompileExpression()` for the frame) and
+// the local variables are bound in every frame. `results` is resized to the
+// number of frames, the i-th result corresponds to the i-th frame.
+//
+// If `num_threads` is greater than one, the frames are evaluated concurrently
+// by the calling thread and the threads of the pool shared with
+// `EvaluateOverRange()` (the expression is still compiled by the calling
+// thread). Expressions with side effects should be evaluated by one thread,
+// since the order of the evaluations is not defined otherwise.
+LLDB_EVAL_API
+void EvaluateInFrames(const std::vector<lldb::SBFrame>& frames,
+                      const char* expression, Options opts, size_t num_threads,
+                      std::vector<EvaluationResult>& results);
+
+// Incremental re-evaluation, e.g. for the watch windows. Evaluates the compiled
+// expression and records the memory ranges and the values (e.g. registers) read
+// by the evaluation in `snapshot`. The subsequent calls with the same snapshot
+// evaluate the expression again only if the scope or the contents of any of
+// those inputs differ, otherwise `snapshot.result` is kept as is. Returns true
+// if the expression has been evaluated.
+//
+// Expressions with side effects are evaluated every time. The expression is
+// also evaluated again if `context_vars` are bound to other values: the
+// variables located in memory are compared by their addresses and types, the
+// other ones by their contents.
+LLDB_EVAL_API
+bool ReevaluateExpression(lldb::SBValue scope,
+                          std::shared_ptr<CompiledExpr> expression,
+                          ContextVariableList context_vars,
+                          EvaluationSnapshot& snapshot);
+
+// Same as above, but the expression is evaluated in the context of the frame.
+// It is evaluated again if the frame (i.e. the thread or the frame's CFA)
+// differs from the previous call or `opts.context_vars` are bound to other
+// values. It's compiled again only if the lexical block of the frame's PC, the
+// expression, `opts.allow_side_effects` or the names and types of
+// `opts.context_vars` differ. The other options must be the same for all the
+// calls with the same snapshot.
+LLDB_EVAL_API
+bool ReevaluateExpression(lldb::SBFrame frame, const char* expression,
+                          Options opts, EvaluationSnapshot& snapshot);
+
+// Incremental compilation, e.g. for validating the expression in the watch
+// window on every keystroke. Same as `CompileExpression()`, but the context of
+// the compilation is kept in `session` and re-used by the subsequent calls, so
+// the identifiers and the types resolved for the previous versions of the
+// expression are not looked up again. The result is stored in
+// `session.expression` and `session.error`. If the expression hasn't changed,
+// the previous result is kept as is. Returns true if the expression has been
+// compiled.
+//
+// The context is dropped if `target` or `scope` differ from the previous call,
+// or if the caches of the target have been invalidated (see
+// `InvalidateCaches()`). `opts` must be the same for all the calls with the
+// same session.
+LLDB_EVAL_API
+bool RecompileExpression(lldb::SBTarget target, lldb::SBType scope,
+                         const char* expression, Options opts,
+                         CompilationSession& session);
+
+// Completion of the identifier at the end of `expression`, e.g. for the
+// autocompletion in the watch window. If the expression ends with a member
+// access (e.g. "foo->ba" or "foo."), the candidates are the members of the
+// object (`foo`) starting with the typed prefix (`ba`). The object is compiled
+// in the frame, but not evaluated. Otherwise the candidates are the
+// identifiers visible in the frame starting with the prefix: the context
+// variables of `opts`, the local variables, the members of `this` and the
+// global variables. `candidates` is cleared and filled in the lookup order,
+// there are no candidates if the object can't be compiled.
+//
+// The candidates are found via the index of the frame (see
+// `Options::use_frame_index`) and the sorted indexes of the record members and
+// the global variables cached per target, without probing every candidate.
+LLDB_EVAL_API
+void CompleteExpression(lldb::SBFrame frame, const char* expression,
+                        Options opts,
+                        std::vector<CompletionCandidate>& candidates);
+
+// Asynchronous versions of `EvaluateExpression()`, e.g. for the evaluations
+// doing long scans of the remote memory (`__findnonnull` over a large buffer)
+// that shouldn't block the UI thread. The evaluation runs on a separate thread
+// and fails with an "evaluation deadline exceeded" error if it's not done by
+// `deadline`. The process must stay stopped until the evaluation is done.
+//
+// The expression and the context arguments are copied, `opts.stats` and
+// `opts.trace_sink` (if set) must stay valid until the evaluation is done,
+// i.e. until `AsyncEvaluation::Wait()` returns or `IsDone()` returns true.
+LLDB_EVAL_API
+AsyncEvaluation EvaluateExpressionAsync(
+    lldb::SBFrame frame, const char* expression, Options opts,
+    AsyncEvaluation::Clock::time_point deadline =
+        AsyncEvaluation::Clock::time_point::max());
+
+LLDB_EVAL_API
+AsyncEvaluation EvaluateExpressionAsync(
+    lldb::SBValue scope, std::shared_ptr<CompiledExpr> expression,
+    ContextVariableList context_vars,
+    AsyncEvaluation::Clock::time_point deadline =
+        AsyncEvaluation::Clock::time_point::max());
+
+// Serializes the compiled expression, e.g. for persisting the compiled
+// breakpoint conditions across debugging sessions. The data contains the tree
+// of the expression (types are referred to by their names), the source and the
+// fingerprint of the modules loaded in `target`.
+LLDB_EVAL_API
+std::vector<uint8_t> SerializeCompiledExpr(
+    lldb::SBTarget target, std::shared_ptr<CompiledExpr> expression);
+
+// Restores the expression serialized by `SerializeCompiledExpr()`. The tree is
+// rehydrated without parsing if the modules of `target` and the types the
+// expression refers to are the same as when it was serialized. Otherwise the
+// expression is compiled again from the source, the same way
+// `CompileExpression(target, scope, source, opts, error)` would do it.
+// `scope` and the context arguments of `opts` must be the same as used for the
+// compilation, otherwise the expression is compiled again too. Returns null and
+// sets `error` if the data is malformed or the compilation fails.
+LLDB_EVAL_API
+std::shared_ptr<CompiledExpr> DeserializeCompiledExpr(
+    lldb::SBTarget target, lldb::SBType scope, const std::vector<uint8_t>& data,
+    Options opts, lldb::SBError& error);
+
+// Sets the maximum number of entries in the compiled expression cache. Least
+// recently used entries are evicted when the cache is full. Setting the size to
+// zero disables the cache.
+LLDB_EVAL_API
+void SetCompiledExprCacheSize(size_t max_entries);
+
+// Drops all cached data associated with the given target. Should be called
+// when the set of modules loaded in the target changes.
+LLDB_EVAL_API
+void InvalidateCaches(lldb::SBTarget target);
+
+// Convenience hook for the debugger's event loop. Invalidates caches of the
+// event's target if the event is a target event reporting loaded or unloaded
+// modules (or symbols). If the event reports that the process exited or was
+// detached, drops the data cached for the process (e.g. global variables).
+// Other events are ignored. The data of a relaunched process is never mixed
+// with the old one, so forwarding the process events is optional.
+LLDB_EVAL_API
+void InvalidateCaches(const lldb::SBEvent& event);
+
+// Drops all cached data for all targets.
+LLDB_EVAL_API
+void ClearCaches();
+
+// Estimated memory held by the process-wide caches, in bytes. Only the data
+// owned by lldb-eval is counted, not the objects LLDB keeps for the cached
+// handles (e.g. the debug information behind `lldb::SBType`). Also used for the
+// limits, see `SetCacheMemoryLimits()`.
+struct CacheMemoryUsage {
+  // Compiled expressions, see `Options::use_compiled_expr_cache`.
+  size_t compiled_exprs = 0;
+  // Types resolved by name, interned types, enumerators and the layouts of the
+  // smart pointers, of all targets.
+  size_t types = 0;
+  // Global variables resolved by name and the names for the completion, of
+  // all targets.
+  size_t globals = 0;
+  // Paths to the base classes and the offsets of the virtual bases, of all
+  // targets.
+  size_t member_paths = 0;
+  // Identifiers of the frames, see `Options::use_frame_index`.
+  size_t frame_indexes = 0;
+};
+
+LLDB_EVAL_API
+CacheMemoryUsage GetCacheMemoryUsage();
+
+// Sets the limits of the memory held by the caches, in bytes. Zero (the
+// default) means no limit. When a cache exceeds its limit, its least recently
+// used entries are evicted. The limits of `types`, `globals` and
+// `member_paths` apply to each target separately. The compiled expression
+// cache is also limited by the number of entries, see
+// `SetCompiledExprCacheSize()`.
+LLDB_EVAL_API
+void SetCacheMemoryLimits(const CacheMemoryUsage& limits);
+
+// Enables or disables the process-wide aggregate of the stats. If enabled, the
+// stats of all the calls are collected (with or without `Options::stats`) and
+// added to the aggregate.
+LLDB_EVAL_API
+void SetAggregateStatsEnabled(bool enabled);
+
+// Returns the process-wide aggregate of the stats collected since the last
+// `ResetAggregateStats()`.
+LLDB_EVAL_API
+EvaluationStats GetAggregateStats();
+
+LLDB_EVAL_API
+void ResetAggregateStats();
+
+// Sets the process-wide sink of the trace events, used by the calls without
+// `Options::trace_sink`. Null (the default) disables the tracing. The sink must
+// stay alive until it's replaced.
+LLDB_EVAL_API
+void SetTraceSink(TraceSink* sink);
+
 }  // namespace lldb_eval
 
 #endif  // LLDB_EVAL_API_H_
@@ -14,10 +14,56 @@
 
 #include "lldb-eval/ast.h"
 
+#include <cstddef>
+
 #include "lldb-eval/defines.h"
+#include "lldb-eval/stats.h"
 
 namespace lldb_eval {
 
+namespace {
+
+// The pointer to the arena is stored right before the node. The header is
+// padded to keep the node maximally aligned.
+constexpr size_t kNodeHeaderSize = alignof(std::max_align_t);
+static_assert(kNodeHeaderSize >= sizeof(AstArena*),
+              "node header must fit the arena pointer");
+
+// The common part of the nodes: vtable, result type, location, kind and flags.
+static_assert(sizeof(AstNode) <= 3 * sizeof(void*) + 8,
+              "AstNode header is expected to be compact");
+
+AstArena*& NodeHeader(void* ptr) {
+  return *reinterpret_cast<AstArena**>(static_cast<char*>(ptr) -
+                                       kNodeHeaderSize);
+}
+
+}  // namespace
+
+void* AstNode::operator new(size_t size, AstArena& arena) {
+  char* mem = static_cast<char*>(
+      arena.Allocate(kNodeHeaderSize + size, alignof(std::max_align_t)));
+  void* ptr = mem + kNodeHeaderSize;
+  NodeHeader(ptr) = &arena;
+  arena.Retain();
+  CountStat(&EvaluationStats::ast_nodes);
+  return ptr;
+}
+
+void AstNode::operator delete(void* ptr) {
+  // The memory itself is owned by the arena (and is released together with it).
+  // The header is not a part of the node, so it's still valid here.
+  NodeHeader(ptr)->Release();
+}
+
+void AstNode::operator delete(void* ptr, AstArena&) {
+  AstNode::operator delete(ptr);
+}
+
+AstArena& AstNode::arena() const {
+  return *NodeHeader(const_cast<AstNode*>(this));
+}
+
 std::string to_string(BinaryOpKind kind) {
   switch (kind) {
       // clang-format off
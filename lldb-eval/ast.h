@@ -17,8 +17,13 @@
 #ifndef LLDB_EVAL_AST_H_
 #define LLDB_EVAL_AST_H_
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -28,27 +33,98 @@
 #include "lldb-eval/type.h"
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
 
 namespace lldb_eval {
 
+class AstNode;
 class Visitor;
 
+using ExprResult = std::unique_ptr<AstNode>;
+
+// Bump allocator for the AST nodes of one expression. The nodes are allocated
+// one after another and the memory is released in one shot, when the arena and
+// all the nodes allocated in it are destroyed. Each node holds a reference to
+// its arena, so the tree may outlive the parser that created it. The reference
+// count is atomic, since the compiled trees are shared between threads.
+class AstArena : public llvm::ThreadSafeRefCountedBase<AstArena> {
+ public:
+  void* Allocate(size_t size, size_t alignment) {
+    return allocator_.Allocate(size, alignment);
+  }
+
+  // Copies the string to the arena, e.g. for the names of the identifiers.
+  llvm::StringRef CopyString(llvm::StringRef str) {
+    char* data = static_cast<char*>(Allocate(str.size(), 1));
+    std::copy(str.begin(), str.end(), data);
+    return llvm::StringRef(data, str.size());
+  }
+
+  // Memory allocated by the arena (including the unused parts of the slabs).
+  size_t GetMemoryUsage() const {
+    return sizeof(*this) + allocator_.getTotalMemory();
+  }
+
+ private:
+  llvm::BumpPtrAllocator allocator_;
+};
+
+enum class NodeKind : uint8_t {
+  kError,
+  kLiteral,
+  kIdentifier,
+  kSizeOf,
+  kBuiltinFunctionCall,
+  kCStyleCast,
+  kCxxStaticCast,
+  kCxxReinterpretCast,
+  kMemberOf,
+  kArraySubscript,
+  kBinaryOp,
+  kUnaryOp,
+  kTernaryOp,
+  kSmartPtrToPtrDecay,
+};
+
 // TODO(werat): Save original token and the source position, so we can give
 // better diagnostic messages during the evaluation.
+//
+// The properties queried by the semantic analysis (the kind of the node, the
+// value category, the result type, etc) are stored in the common header of the
+// nodes, so they are read without virtual calls. The header also holds the
+// operation of the node (e.g. `BinaryOpNode::kind()`), which keeps the nodes
+// with one or two children within a single cache line.
 class AstNode {
  public:
-  AstNode(clang::SourceLocation location) : location_(location) {}
   virtual ~AstNode() {}
 
+  // AST nodes can be allocated only in an arena, see `MakeNode()`. Deleting a
+  // node runs its destructor and releases the reference to the arena.
+  static void* operator new(size_t size) = delete;
+  static void* operator new(size_t size, AstArena& arena);
+  static void operator delete(void* ptr);
+  static void operator delete(void* ptr, AstArena& arena);
+
+  // The arena the node is allocated in.
+  AstArena& arena() const;
+
   virtual void Accept(Visitor* v) const = 0;
 
-  virtual bool is_error() const { return false; };
-  virtual bool is_rvalue() const = 0;
-  virtual bool is_bitfield() const { return false; };
-  virtual bool is_context_var() const { return false; };
-  virtual bool is_literal_zero() const { return false; }
-  virtual uint32_t bitfield_size() const { return 0; }
-  virtual TypeSP result_type() const = 0;
+  // Calls `f` for each direct child of the node. Allows AST transformations
+  // (e.g. constant folding) to replace the children in place.
+  virtual void TransformChildren(llvm::function_ref<void(ExprResult&)> f) {}
+
+  NodeKind node_kind() const { return node_kind_; }
+  bool is_error() const { return node_kind_ == NodeKind::kError; }
+  bool is_rvalue() const { return flags_ & kRValue; }
+  bool is_bitfield() const { return flags_ & kBitfield; }
+  bool is_context_var() const { return flags_ & kContextVar; }
+  bool is_literal_zero() const { return flags_ & kLiteralZero; }
+  uint32_t bitfield_size() const { return bitfield_size_; }
+  const TypeSP& result_type() const { return result_type_; }
 
   clang::SourceLocation location() const { return location_; }
 
@@ -57,120 +133,147 @@ class AstNode {
   // the dereferenced type matters.
   TypeSP result_type_deref() const;
 
+ protected:
+  enum Flags : uint8_t {
+    kRValue = 1 << 0,
+    kBitfield = 1 << 1,
+    kContextVar = 1 << 2,
+    kLiteralZero = 1 << 3,
+    // Meaning depends on the node, e.g. `MemberOfNode::is_arrow()`.
+    kNodeFlag = 1 << 4,
+  };
+
+  AstNode(NodeKind node_kind, clang::SourceLocation location,
+          TypeSP result_type, uint8_t flags, uint8_t op = 0)
+      : result_type_(std::move(result_type)),
+        location_(location),
+        node_kind_(node_kind),
+        flags_(flags),
+        op_(op) {}
+
+  bool has_flag(Flags flag) const { return flags_ & flag; }
+  void set_flag(Flags flag, bool value) {
+    flags_ = value ? (flags_ | flag) : (flags_ & ~flag);
+  }
+  void set_bitfield_size(uint32_t size) {
+    assert(size <= UINT8_MAX && "bitfield size doesn't fit the node header");
+    bitfield_size_ = static_cast<uint8_t>(size);
+  }
+  uint8_t op() const { return op_; }
+
  private:
+  TypeSP result_type_;
   clang::SourceLocation location_;
+  NodeKind node_kind_;
+  uint8_t flags_;
+  // Operation of the node, e.g. `BinaryOpNode::kind()`.
+  uint8_t op_;
+  uint8_t bitfield_size_ = 0;
 };
 
-using ExprResult = std::unique_ptr<AstNode>;
+// Allocates a new node in the given arena, the counterpart of
+// `std::make_unique()` for the AST nodes.
+template <typename T, typename... Args>
+std::unique_ptr<T> MakeNode(AstArena& arena, Args&&... args) {
+  return std::unique_ptr<T>(new (arena) T(std::forward<Args>(args)...));
+}
 
 class ErrorNode : public AstNode {
  public:
   ErrorNode(TypeSP empty_type)
-      : AstNode(clang::SourceLocation()), empty_type_(std::move(empty_type)) {}
+      : AstNode(NodeKind::kError, clang::SourceLocation(),
+                std::move(empty_type), /*flags*/ 0) {}
   void Accept(Visitor* v) const override;
-  bool is_error() const override { return true; }
-  bool is_rvalue() const override { return false; }
-  TypeSP result_type() const override { return empty_type_; }
-
- private:
-  TypeSP empty_type_;
 };
 
 class LiteralNode : public AstNode {
  public:
+  using ValueType =
+      std::variant<llvm::APInt, llvm::APFloat, bool, std::vector<char>>;
+
   template <typename ValueT>
   LiteralNode(clang::SourceLocation location, TypeSP type, ValueT&& value,
               bool is_literal_zero)
-      : AstNode(location),
-        type_(std::move(type)),
-        value_(std::forward<ValueT>(value)),
-        is_literal_zero_(is_literal_zero) {}
+      : AstNode(NodeKind::kLiteral, location, std::move(type),
+                kRValue | (is_literal_zero ? kLiteralZero : 0)),
+        value_(std::forward<ValueT>(value)) {}
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override { return true; }
-  bool is_literal_zero() const override { return is_literal_zero_; }
-  TypeSP result_type() const override { return type_; }
 
   template <typename ValueT>
-  ValueT value() const {
+  const ValueT& value() const {
     return std::get<ValueT>(value_);
   }
 
-  auto value() const { return value_; }
+  const ValueType& value() const { return value_; }
 
  private:
-  TypeSP type_;
-  std::variant<llvm::APInt, llvm::APFloat, bool, std::vector<char>> value_;
-  bool is_literal_zero_;
+  ValueType value_;
 };
 
 class IdentifierNode : public AstNode {
  public:
-  IdentifierNode(clang::SourceLocation location, std::string name,
+  IdentifierNode(clang::SourceLocation location, llvm::StringRef name,
                  std::unique_ptr<ParserContext::IdentifierInfo> identifier,
                  bool is_rvalue, bool is_context_var)
-      : AstNode(location),
-        is_rvalue_(is_rvalue),
-        is_context_var_(is_context_var),
-        name_(std::move(name)),
+      : AstNode(NodeKind::kIdentifier, location, identifier->GetType(),
+                (is_rvalue ? kRValue : 0) |
+                    (is_context_var ? kContextVar : 0)),
+        name_(arena().CopyString(name)),
         identifier_(std::move(identifier)) {}
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override { return is_rvalue_; }
-  bool is_context_var() const override { return is_context_var_; };
-  TypeSP result_type() const override { return identifier_->GetType(); }
 
-  std::string name() const { return name_; }
+  llvm::StringRef name() const { return name_; }
   const ParserContext::IdentifierInfo& info() const { return *identifier_; }
 
  private:
-  bool is_rvalue_;
-  bool is_context_var_;
-  std::string name_;
+  // Allocated in the arena.
+  llvm::StringRef name_;
   std::unique_ptr<ParserContext::IdentifierInfo> identifier_;
 };
 
 class SizeOfNode : public AstNode {
  public:
   SizeOfNode(clang::SourceLocation location, TypeSP type, TypeSP operand)
-      : AstNode(location),
-        type_(std::move(type)),
+      : AstNode(NodeKind::kSizeOf, location, std::move(type), kRValue),
         operand_(std::move(operand)) {}
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override { return true; }
-  TypeSP result_type() const override { return type_; }
 
   TypeSP operand() const { return operand_; }
 
  private:
-  TypeSP type_;
   TypeSP operand_;
 };
 
 class BuiltinFunctionCallNode : public AstNode {
  public:
   BuiltinFunctionCallNode(clang::SourceLocation location, TypeSP result_type,
-                          std::string name, std::vector<ExprResult> arguments)
-      : AstNode(location),
-        result_type_(std::move(result_type)),
-        name_(std::move(name)),
+                          llvm::StringRef name,
+                          std::vector<ExprResult> arguments)
+      : AstNode(NodeKind::kBuiltinFunctionCall, location,
+                std::move(result_type), kRValue),
+        name_(arena().CopyString(name)),
         arguments_(std::move(arguments)) {}
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override { return true; }
-  TypeSP result_type() const override { return result_type_; }
+  void TransformChildren(llvm::function_ref<void(ExprResult&)> f) override {
+    for (auto& arg : arguments_) {
+      f(arg);
+    }
+  }
 
-  std::string name() const { return name_; }
+  llvm::StringRef name() const { return name_; }
   const std::vector<ExprResult>& arguments() const { return arguments_; };
 
  private:
-  TypeSP result_type_;
-  std::string name_;
+  // Allocated in the arena.
+  llvm::StringRef name_;
   std::vector<ExprResult> arguments_;
 };
 
-enum class CStyleCastKind {
+enum class CStyleCastKind : uint8_t {
   kArithmetic,
   kEnumeration,
   kPointer,
@@ -182,28 +285,25 @@ class CStyleCastNode : public AstNode {
  public:
   CStyleCastNode(clang::SourceLocation location, TypeSP type, ExprResult rhs,
                  CStyleCastKind kind)
-      : AstNode(location),
-        type_(std::move(type)),
-        rhs_(std::move(rhs)),
-        kind_(kind) {}
+      : AstNode(NodeKind::kCStyleCast, location, std::move(type),
+                kind != CStyleCastKind::kReference ? kRValue : 0,
+                static_cast<uint8_t>(kind)),
+        rhs_(std::move(rhs)) {}
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override {
-    return kind_ != CStyleCastKind::kReference;
+  void TransformChildren(llvm::function_ref<void(ExprResult&)> f) override {
+    f(rhs_);
   }
-  TypeSP result_type() const override { return type_; }
 
-  TypeSP type() const { return type_; }
+  const TypeSP& type() const { return result_type(); }
   AstNode* rhs() const { return rhs_.get(); }
-  CStyleCastKind kind() const { return kind_; }
+  CStyleCastKind kind() const { return static_cast<CStyleCastKind>(op()); }
 
  private:
-  TypeSP type_;
   ExprResult rhs_;
-  CStyleCastKind kind_;
 };
 
-enum class CxxStaticCastKind {
+enum class CxxStaticCastKind : uint8_t {
   kNoOp,
   kArithmetic,
   kEnumeration,
@@ -217,11 +317,9 @@ class CxxStaticCastNode : public AstNode {
  public:
   CxxStaticCastNode(clang::SourceLocation location, TypeSP type, ExprResult rhs,
                     CxxStaticCastKind kind, bool is_rvalue)
-      : AstNode(location),
-        type_(std::move(type)),
-        rhs_(std::move(rhs)),
-        kind_(kind),
-        is_rvalue_(is_rvalue) {
+      : AstNode(NodeKind::kCxxStaticCast, location, std::move(type),
+                is_rvalue ? kRValue : 0, static_cast<uint8_t>(kind)),
+        rhs_(std::move(rhs)) {
     assert(kind != CxxStaticCastKind::kBaseToDerived &&
            kind != CxxStaticCastKind::kDerivedToBase &&
            "invalid constructor for base-to-derived and derived-to-base casts");
@@ -229,118 +327,115 @@ class CxxStaticCastNode : public AstNode {
 
   CxxStaticCastNode(clang::SourceLocation location, TypeSP type, ExprResult rhs,
                     std::vector<uint32_t> idx, bool is_rvalue)
-      : AstNode(location),
-        type_(std::move(type)),
+      : AstNode(NodeKind::kCxxStaticCast, location, std::move(type),
+                is_rvalue ? kRValue : 0,
+                static_cast<uint8_t>(CxxStaticCastKind::kDerivedToBase)),
         rhs_(std::move(rhs)),
-        idx_(std::move(idx)),
-        kind_(CxxStaticCastKind::kDerivedToBase),
-        is_rvalue_(is_rvalue) {}
+        idx_(std::move(idx)) {}
 
   CxxStaticCastNode(clang::SourceLocation location, TypeSP type, ExprResult rhs,
                     uint64_t offset, bool is_rvalue)
-      : AstNode(location),
-        type_(std::move(type)),
+      : AstNode(NodeKind::kCxxStaticCast, location, std::move(type),
+                is_rvalue ? kRValue : 0,
+                static_cast<uint8_t>(CxxStaticCastKind::kBaseToDerived)),
         rhs_(std::move(rhs)),
-        offset_(offset),
-        kind_(CxxStaticCastKind::kBaseToDerived),
-        is_rvalue_(is_rvalue) {}
+        offset_(offset) {}
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override { return is_rvalue_; }
-  TypeSP result_type() const override { return type_; }
+  void TransformChildren(llvm::function_ref<void(ExprResult&)> f) override {
+    f(rhs_);
+  }
 
-  TypeSP type() const { return type_; }
+  const TypeSP& type() const { return result_type(); }
   AstNode* rhs() const { return rhs_.get(); }
   const std::vector<uint32_t>& idx() const { return idx_; }
   uint64_t offset() const { return offset_; }
-  CxxStaticCastKind kind() const { return kind_; }
+  CxxStaticCastKind kind() const {
+    return static_cast<CxxStaticCastKind>(op());
+  }
 
  private:
-  TypeSP type_;
   ExprResult rhs_;
   std::vector<uint32_t> idx_;
   uint64_t offset_ = 0;
-  CxxStaticCastKind kind_;
-  bool is_rvalue_;
 };
 
 class CxxReinterpretCastNode : public AstNode {
  public:
   CxxReinterpretCastNode(clang::SourceLocation location, TypeSP type,
                          ExprResult rhs, bool is_rvalue)
-      : AstNode(location),
-        type_(std::move(type)),
-        rhs_(std::move(rhs)),
-        is_rvalue_(is_rvalue) {}
+      : AstNode(NodeKind::kCxxReinterpretCast, location, std::move(type),
+                is_rvalue ? kRValue : 0),
+        rhs_(std::move(rhs)) {}
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override { return is_rvalue_; }
-  TypeSP result_type() const override { return type_; }
+  void TransformChildren(llvm::function_ref<void(ExprResult&)> f) override {
+    f(rhs_);
+  }
 
-  TypeSP type() const { return type_; }
+  const TypeSP& type() const { return result_type(); }
   AstNode* rhs() const { return rhs_.get(); }
 
  private:
-  TypeSP type_;
   ExprResult rhs_;
-  bool is_rvalue_;
 };
 
 class MemberOfNode : public AstNode {
  public:
   MemberOfNode(clang::SourceLocation location, TypeSP result_type,
                ExprResult lhs, bool is_bitfield, uint32_t bitfield_size,
-               std::vector<uint32_t> member_index, bool is_arrow)
-      : AstNode(location),
-        result_type_(std::move(result_type)),
+               std::vector<uint32_t> member_index,
+               std::optional<uint64_t> member_offset, bool is_arrow)
+      : AstNode(NodeKind::kMemberOf, location, std::move(result_type),
+                (is_bitfield ? kBitfield : 0) | (is_arrow ? kNodeFlag : 0)),
         lhs_(std::move(lhs)),
-        is_bitfield_(is_bitfield),
-        bitfield_size_(bitfield_size),
         member_index_(std::move(member_index)),
-        is_arrow_(is_arrow) {}
+        member_offset_(member_offset) {
+    set_bitfield_size(bitfield_size);
+  }
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override { return false; }
-  bool is_bitfield() const override { return is_bitfield_; }
-  uint32_t bitfield_size() const override { return bitfield_size_; }
-  TypeSP result_type() const override { return result_type_; }
+  void TransformChildren(llvm::function_ref<void(ExprResult&)> f) override {
+    f(lhs_);
+  }
 
   AstNode* lhs() const { return lhs_.get(); }
   const std::vector<uint32_t>& member_index() const { return member_index_; }
-  bool is_arrow() const { return is_arrow_; }
+  // Offset of the member from the start of the LHS object, if the member can
+  // be accessed by its address (see `Type::MemberIndex`).
+  std::optional<uint64_t> member_offset() const { return member_offset_; }
+  bool is_arrow() const { return has_flag(kNodeFlag); }
 
  private:
-  TypeSP result_type_;
   ExprResult lhs_;
-  bool is_bitfield_;
-  uint32_t bitfield_size_;
   std::vector<uint32_t> member_index_;
-  bool is_arrow_;
+  std::optional<uint64_t> member_offset_;
 };
 
 class ArraySubscriptNode : public AstNode {
  public:
   ArraySubscriptNode(clang::SourceLocation location, TypeSP result_type,
                      ExprResult base, ExprResult index)
-      : AstNode(location),
-        result_type_(std::move(result_type)),
+      : AstNode(NodeKind::kArraySubscript, location, std::move(result_type),
+                /*flags*/ 0),
         base_(std::move(base)),
         index_(std::move(index)) {}
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override { return false; }
-  TypeSP result_type() const override { return result_type_; }
+  void TransformChildren(llvm::function_ref<void(ExprResult&)> f) override {
+    f(base_);
+    f(index_);
+  }
 
   AstNode* base() const { return base_.get(); }
   AstNode* index() const { return index_.get(); }
 
  private:
-  TypeSP result_type_;
   ExprResult base_;
   ExprResult index_;
 };
 
-enum class BinaryOpKind {
+enum class BinaryOpKind : uint8_t {
   Mul,        // "*"
   Div,        // "/"
   Rem,        // "%"
@@ -382,33 +477,31 @@ class BinaryOpNode : public AstNode {
   BinaryOpNode(clang::SourceLocation location, TypeSP result_type,
                BinaryOpKind kind, ExprResult lhs, ExprResult rhs,
                TypeSP comp_assign_type)
-      : AstNode(location),
-        result_type_(std::move(result_type)),
-        kind_(kind),
+      : AstNode(NodeKind::kBinaryOp, location, std::move(result_type),
+                !binary_op_kind_is_comp_assign(kind) ? kRValue : 0,
+                static_cast<uint8_t>(kind)),
         lhs_(std::move(lhs)),
         rhs_(std::move(rhs)),
-        comp_assign_type_(comp_assign_type) {}
+        comp_assign_type_(std::move(comp_assign_type)) {}
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override {
-    return !binary_op_kind_is_comp_assign(kind_);
+  void TransformChildren(llvm::function_ref<void(ExprResult&)> f) override {
+    f(lhs_);
+    f(rhs_);
   }
-  TypeSP result_type() const override { return result_type_; }
 
-  BinaryOpKind kind() const { return kind_; }
+  BinaryOpKind kind() const { return static_cast<BinaryOpKind>(op()); }
   AstNode* lhs() const { return lhs_.get(); }
   AstNode* rhs() const { return rhs_.get(); }
   TypeSP comp_assign_type() const { return comp_assign_type_; }
 
  private:
-  TypeSP result_type_;
-  BinaryOpKind kind_;
   ExprResult lhs_;
   ExprResult rhs_;
   TypeSP comp_assign_type_;
 };
 
-enum class UnaryOpKind {
+enum class UnaryOpKind : uint8_t {
   PostInc,  // "++"
   PostDec,  // "--"
   PreInc,   // "++"
@@ -427,21 +520,20 @@ class UnaryOpNode : public AstNode {
  public:
   UnaryOpNode(clang::SourceLocation location, TypeSP result_type,
               UnaryOpKind kind, ExprResult rhs)
-      : AstNode(location),
-        result_type_(std::move(result_type)),
-        kind_(kind),
+      : AstNode(NodeKind::kUnaryOp, location, std::move(result_type),
+                kind != UnaryOpKind::Deref ? kRValue : 0,
+                static_cast<uint8_t>(kind)),
         rhs_(std::move(rhs)) {}
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override { return kind_ != UnaryOpKind::Deref; }
-  TypeSP result_type() const override { return result_type_; }
+  void TransformChildren(llvm::function_ref<void(ExprResult&)> f) override {
+    f(rhs_);
+  }
 
-  UnaryOpKind kind() const { return kind_; }
+  UnaryOpKind kind() const { return static_cast<UnaryOpKind>(op()); }
   AstNode* rhs() const { return rhs_.get(); }
 
  private:
-  TypeSP result_type_;
-  UnaryOpKind kind_;
   ExprResult rhs_;
 };
 
@@ -449,27 +541,34 @@ class TernaryOpNode : public AstNode {
  public:
   TernaryOpNode(clang::SourceLocation location, TypeSP result_type,
                 ExprResult cond, ExprResult lhs, ExprResult rhs)
-      : AstNode(location),
-        result_type_(std::move(result_type)),
+      : AstNode(NodeKind::kTernaryOp, location, std::move(result_type),
+                /*flags*/ 0),
         cond_(std::move(cond)),
         lhs_(std::move(lhs)),
-        rhs_(std::move(rhs)) {}
+        rhs_(std::move(rhs)) {
+    UpdateFlags();
+  }
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override {
-    return lhs_->is_rvalue() || rhs_->is_rvalue();
-  }
-  bool is_bitfield() const override {
-    return lhs_->is_bitfield() || rhs_->is_bitfield();
+  void TransformChildren(llvm::function_ref<void(ExprResult&)> f) override {
+    f(cond_);
+    f(lhs_);
+    f(rhs_);
+    UpdateFlags();
   }
-  TypeSP result_type() const override { return result_type_; }
 
   AstNode* cond() const { return cond_.get(); }
   AstNode* lhs() const { return lhs_.get(); }
   AstNode* rhs() const { return rhs_.get(); }
 
  private:
-  TypeSP result_type_;
+  // The value category depends on the branches.
+  void UpdateFlags() {
+    set_flag(kRValue, lhs_->is_rvalue() || rhs_->is_rvalue());
+    set_flag(kBitfield, lhs_->is_bitfield() || rhs_->is_bitfield());
+  }
+
+ private:
   ExprResult cond_;
   ExprResult lhs_;
   ExprResult rhs_;
@@ -479,16 +578,18 @@ class SmartPtrToPtrDecay : public AstNode {
  public:
   SmartPtrToPtrDecay(clang::SourceLocation location, TypeSP result_type,
                      ExprResult ptr)
-      : AstNode(location), result_type_(result_type), ptr_(std::move(ptr)) {}
+      : AstNode(NodeKind::kSmartPtrToPtrDecay, location,
+                std::move(result_type), /*flags*/ 0),
+        ptr_(std::move(ptr)) {}
 
   void Accept(Visitor* v) const override;
-  bool is_rvalue() const override { return false; }
-  TypeSP result_type() const override { return result_type_; }
+  void TransformChildren(llvm::function_ref<void(ExprResult&)> f) override {
+    f(ptr_);
+  }
 
   AstNode* ptr() const { return ptr_.get(); }
 
  private:
-  TypeSP result_type_;
   ExprResult ptr_;
 };
 
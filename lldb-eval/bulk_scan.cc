@@ -0,0 +1,175 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/bulk_scan.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace lldb_eval {
+
+namespace {
+
+// Size of the blocks, which are tested at once.
+constexpr size_t kBlockSize = 64;
+
+// Returns true if all bytes of the block are zero.
+bool IsZeroBlock(const uint8_t* block) {
+  uint64_t acc = 0;
+  for (size_t i = 0; i < kBlockSize; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, block + i, sizeof(word));
+    acc |= word;
+  }
+  return acc == 0;
+}
+
+bool IsZeroElement(const uint8_t* element, size_t element_size) {
+  for (size_t i = 0; i < element_size; ++i) {
+    if (element[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+int64_t FindFirstEqualImpl(const T* data, size_t count, T value) {
+  // Find the first block containing the value, then the value in the block.
+  constexpr size_t kBlockCount = kBlockSize / sizeof(T);
+  size_t begin = 0;
+  for (; begin + kBlockCount <= count; begin += kBlockCount) {
+    bool found = false;
+    for (size_t i = 0; i < kBlockCount; ++i) {
+      found |= data[begin + i] == value;
+    }
+    if (found) {
+      break;
+    }
+  }
+  for (size_t i = begin; i < count; ++i) {
+    if (data[i] == value) {
+      return static_cast<int64_t>(i);
+    }
+  }
+  return -1;
+}
+
+template <typename T>
+size_t CountNonZeroImpl(const T* data, size_t count) {
+  size_t ret = 0;
+  for (size_t i = 0; i < count; ++i) {
+    ret += data[i] != 0;
+  }
+  return ret;
+}
+
+// Reinterprets the buffer as an array of unsigned integers of type `T`. Allows
+// using the typed kernels for the elements of the common sizes.
+template <typename T>
+const T* AsElements(const void* data) {
+  return static_cast<const T*>(data);
+}
+
+}  // namespace
+
+int64_t FindFirstNonZero(const void* data, size_t count, size_t element_size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  size_t size = count * element_size;
+
+  // Skip the leading zero blocks.
+  size_t offset = 0;
+  while (offset + kBlockSize <= size && IsZeroBlock(bytes + offset)) {
+    offset += kBlockSize;
+  }
+
+  // Find the element in the first non-zero block (or in the tail).
+  for (size_t i = offset / element_size; i < count; ++i) {
+    if (!IsZeroElement(bytes + i * element_size, element_size)) {
+      return static_cast<int64_t>(i);
+    }
+  }
+  return -1;
+}
+
+int64_t FindFirstEqual(const void* data, size_t count, size_t element_size,
+                       const void* value) {
+  switch (element_size) {
+    case 1:
+      return FindFirstEqualImpl(AsElements<uint8_t>(data), count,
+                                *AsElements<uint8_t>(value));
+    case 2:
+      return FindFirstEqualImpl(AsElements<uint16_t>(data), count,
+                                *AsElements<uint16_t>(value));
+    case 4:
+      return FindFirstEqualImpl(AsElements<uint32_t>(data), count,
+                                *AsElements<uint32_t>(value));
+    case 8:
+      return FindFirstEqualImpl(AsElements<uint64_t>(data), count,
+                                *AsElements<uint64_t>(value));
+    default:
+      break;
+  }
+
+  // Elements of uncommon sizes.
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < count; ++i) {
+    if (memcmp(bytes + i * element_size, value, element_size) == 0) {
+      return static_cast<int64_t>(i);
+    }
+  }
+  return -1;
+}
+
+int64_t FindFirstEqual(const float* data, size_t count, float value) {
+  return FindFirstEqualImpl(data, count, value);
+}
+
+int64_t FindFirstEqual(const double* data, size_t count, double value) {
+  return FindFirstEqualImpl(data, count, value);
+}
+
+size_t CountNonZero(const void* data, size_t count, size_t element_size) {
+  switch (element_size) {
+    case 1:
+      return CountNonZeroImpl(AsElements<uint8_t>(data), count);
+    case 2:
+      return CountNonZeroImpl(AsElements<uint16_t>(data), count);
+    case 4:
+      return CountNonZeroImpl(AsElements<uint32_t>(data), count);
+    case 8:
+      return CountNonZeroImpl(AsElements<uint64_t>(data), count);
+    default:
+      break;
+  }
+
+  // Elements of uncommon sizes.
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  size_t ret = 0;
+  for (size_t i = 0; i < count; ++i) {
+    ret += !IsZeroElement(bytes + i * element_size, element_size);
+  }
+  return ret;
+}
+
+size_t CountNonZero(const float* data, size_t count) {
+  return CountNonZeroImpl(data, count);
+}
+
+size_t CountNonZero(const double* data, size_t count) {
+  return CountNonZeroImpl(data, count);
+}
+
+}  // namespace lldb_eval
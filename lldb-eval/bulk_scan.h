@@ -0,0 +1,69 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_BULK_SCAN_H_
+#define LLDB_EVAL_BULK_SCAN_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lldb_eval {
+
+// Kernels for scanning large buffers read from the process memory (used by the
+// builtin functions like `__findnonnull()`). The kernels process the data in
+// fixed-size blocks without early exits, so the compiler can vectorize them.
+
+// Returns the index of the first element of `element_size` bytes, which has
+// at least one non-zero byte, or -1 if all `count` elements are zero.
+int64_t FindFirstNonZero(const void* data, size_t count, size_t element_size);
+
+// Returns the index of the first element equal to `value` (compared bytewise),
+// or -1 if there is no such element.
+int64_t FindFirstEqual(const void* data, size_t count, size_t element_size,
+                       const void* value);
+// Same, but the elements are compared as floating point numbers.
+int64_t FindFirstEqual(const float* data, size_t count, float value);
+int64_t FindFirstEqual(const double* data, size_t count, double value);
+
+// Returns the number of elements of `element_size` bytes, which have at least
+// one non-zero byte.
+size_t CountNonZero(const void* data, size_t count, size_t element_size);
+// Same, but the elements are compared as floating point numbers (i.e. negative
+// zero is zero).
+size_t CountNonZero(const float* data, size_t count);
+size_t CountNonZero(const double* data, size_t count);
+
+template <typename T>
+struct MinMax {
+  T min;
+  T max;
+};
+
+// Returns the smallest and the largest of `count` elements, `count` must be
+// positive. NaNs are ignored unless the first element is NaN.
+template <typename T>
+MinMax<T> FindMinMax(const T* data, size_t count) {
+  MinMax<T> ret{data[0], data[0]};
+  for (size_t i = 1; i < count; ++i) {
+    ret.min = data[i] < ret.min ? data[i] : ret.min;
+    ret.max = data[i] > ret.max ? data[i] : ret.max;
+  }
+  return ret;
+}
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_BULK_SCAN_H_
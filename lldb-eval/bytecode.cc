@@ -0,0 +1,161 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/bytecode.h"
+
+#include <cstdint>
+#include <memory>
+
+#include "lldb-eval/ast.h"
+
+namespace lldb_eval {
+
+class BytecodeCompiler : Visitor {
+ public:
+  explicit BytecodeCompiler(Bytecode* bytecode) : bytecode_(bytecode) {}
+
+  // Emits the instructions evaluating `node`. Returns the register holding the
+  // result.
+  uint32_t Compile(const AstNode* node) {
+    node->Accept(this);
+    return result_;
+  }
+
+ private:
+  void Visit(const ErrorNode* node) override { EmitEvalNode(node); }
+  void Visit(const LiteralNode* node) override { EmitEvalNode(node); }
+  void Visit(const IdentifierNode* node) override { EmitEvalNode(node); }
+  void Visit(const SizeOfNode* node) override { EmitEvalNode(node); }
+  void Visit(const BuiltinFunctionCallNode* node) override {
+    // Builtins are evaluated by the tree-walking interpreter on purpose: they
+    // scan buffers, so the dispatch overhead is negligible compared to them.
+    EmitEvalNode(node);
+  }
+  void Visit(const CStyleCastNode* node) override {
+    result_ = Emit(OpCode::kCStyleCast, node, Compile(node->rhs()));
+  }
+  void Visit(const CxxStaticCastNode* node) override {
+    result_ = Emit(OpCode::kCxxStaticCast, node, Compile(node->rhs()));
+  }
+  void Visit(const CxxReinterpretCastNode* node) override {
+    result_ = Emit(OpCode::kCxxReinterpretCast, node, Compile(node->rhs()));
+  }
+  void Visit(const MemberOfNode* node) override {
+    result_ = Emit(OpCode::kMemberOf, node, Compile(node->lhs()));
+  }
+  void Visit(const ArraySubscriptNode* node) override {
+    uint32_t base = Compile(node->base());
+    uint32_t index = Compile(node->index());
+    result_ = Emit(OpCode::kArraySubscript, node, base, index);
+  }
+  void Visit(const BinaryOpNode* node) override {
+    if (node->kind() == BinaryOpKind::LAnd ||
+        node->kind() == BinaryOpKind::LOr) {
+      // For "&&" break if LHS is "false", for "||" if LHS is "true".
+      uint32_t dst = AllocateRegister();
+      uint32_t lhs = Compile(node->lhs());
+      EmitTo(dst, OpCode::kToBool, node, lhs);
+      size_t jump = EmitJumpIf(dst, node->kind() == BinaryOpKind::LOr);
+      uint32_t rhs = Compile(node->rhs());
+      EmitTo(dst, OpCode::kToBool, node, rhs);
+      PatchJump(jump);
+      result_ = dst;
+      return;
+    }
+    uint32_t lhs = Compile(node->lhs());
+    uint32_t rhs = Compile(node->rhs());
+    result_ = Emit(OpCode::kBinaryOp, node, lhs, rhs);
+  }
+  void Visit(const UnaryOpNode* node) override {
+    if (node->kind() == UnaryOpKind::AddrOf) {
+      // The address-of operator relies on the flow analysis (e.g. for eliding
+      // `&*`), which is available only in the tree-walking interpreter.
+      EmitEvalNode(node);
+      return;
+    }
+    result_ = Emit(OpCode::kUnaryOp, node, Compile(node->rhs()));
+  }
+  void Visit(const TernaryOpNode* node) override {
+    uint32_t dst = AllocateRegister();
+    uint32_t cond = Compile(node->cond());
+    size_t jump_to_rhs = EmitJumpIf(cond, false);
+    EmitTo(dst, OpCode::kMove, node, Compile(node->lhs()));
+    size_t jump_to_end = EmitJump();
+    PatchJump(jump_to_rhs);
+    EmitTo(dst, OpCode::kMove, node, Compile(node->rhs()));
+    PatchJump(jump_to_end);
+    result_ = dst;
+  }
+  void Visit(const SmartPtrToPtrDecay* node) override {
+    result_ = Emit(OpCode::kSmartPtrToPtrDecay, node, Compile(node->ptr()));
+  }
+
+  uint32_t AllocateRegister() { return bytecode_->num_registers_++; }
+
+  void EmitTo(uint32_t dst, OpCode op, const AstNode* node, uint32_t a = 0,
+              uint32_t b = 0) {
+    Instruction inst;
+    inst.op = op;
+    inst.dst = dst;
+    inst.a = a;
+    inst.b = b;
+    inst.node = node;
+    bytecode_->instructions_.push_back(inst);
+  }
+
+  uint32_t Emit(OpCode op, const AstNode* node, uint32_t a = 0,
+                uint32_t b = 0) {
+    uint32_t dst = AllocateRegister();
+    EmitTo(dst, op, node, a, b);
+    return dst;
+  }
+
+  void EmitEvalNode(const AstNode* node) {
+    result_ = Emit(OpCode::kEvalNode, node);
+  }
+
+  size_t EmitJumpIf(uint32_t reg, bool flag) {
+    Instruction inst;
+    inst.op = OpCode::kJumpIf;
+    inst.a = reg;
+    inst.flag = flag;
+    bytecode_->instructions_.push_back(inst);
+    return bytecode_->instructions_.size() - 1;
+  }
+
+  size_t EmitJump() {
+    Instruction inst;
+    inst.op = OpCode::kJump;
+    bytecode_->instructions_.push_back(inst);
+    return bytecode_->instructions_.size() - 1;
+  }
+
+  // Makes the given jump point to the next emitted instruction.
+  void PatchJump(size_t jump) {
+    bytecode_->instructions_[jump].target =
+        static_cast<uint32_t>(bytecode_->instructions_.size());
+  }
+
+ private:
+  Bytecode* bytecode_;
+  uint32_t result_ = 0;
+};
+
+std::shared_ptr<Bytecode> Bytecode::Compile(const AstNode* tree) {
+  std::shared_ptr<Bytecode> bytecode(new Bytecode());
+  bytecode->result_register_ = BytecodeCompiler(bytecode.get()).Compile(tree);
+  return bytecode;
+}
+
+}  // namespace lldb_eval
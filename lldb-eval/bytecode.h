@@ -0,0 +1,95 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_BYTECODE_H_
+#define LLDB_EVAL_BYTECODE_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "lldb-eval/ast.h"
+
+namespace lldb_eval {
+
+enum class OpCode : uint8_t {
+  // Evaluates `node` with the tree-walking interpreter. Used for the leaf nodes
+  // (literals, identifiers, etc) and for the subtrees that require the flow
+  // analysis (i.e. operands of the address-of operator).
+  kEvalNode,
+  // Operations on the values in registers `a` and `b`. Semantics is defined by
+  // the corresponding `node`.
+  kCStyleCast,
+  kCxxStaticCast,
+  kCxxReinterpretCast,
+  kMemberOf,
+  kArraySubscript,
+  kBinaryOp,
+  kUnaryOp,
+  kSmartPtrToPtrDecay,
+  // Converts the value in register `a` to bool.
+  kToBool,
+  // Copies the value in register `a`.
+  kMove,
+  // Jumps to `target` if the value in register `a` converted to bool is equal
+  // to `flag`.
+  kJumpIf,
+  // Jumps to `target` unconditionally.
+  kJump,
+};
+
+struct Instruction {
+  OpCode op;
+  bool flag = false;
+  // Destination and operand registers.
+  uint32_t dst = 0;
+  uint32_t a = 0;
+  uint32_t b = 0;
+  // Index of the instruction to jump to.
+  uint32_t target = 0;
+  const AstNode* node = nullptr;
+};
+
+// Linear, register-based representation of an AST. It's evaluated by
+// `Interpreter::Eval(const Bytecode&, Error&)` in a single loop, without
+// recursion and virtual dispatch for the inner nodes. Instructions refer to the
+// original AST nodes, so the tree must outlive the bytecode.
+class Bytecode {
+ public:
+  static std::shared_ptr<Bytecode> Compile(const AstNode* tree);
+
+  const std::vector<Instruction>& instructions() const { return instructions_; }
+  uint32_t num_registers() const { return num_registers_; }
+  uint32_t result_register() const { return result_register_; }
+
+  size_t GetMemoryUsage() const {
+    return sizeof(*this) + instructions_.capacity() * sizeof(Instruction);
+  }
+
+ private:
+  Bytecode() = default;
+
+ private:
+  std::vector<Instruction> instructions_;
+  uint32_t num_registers_ = 0;
+  uint32_t result_register_ = 0;
+
+  friend class BytecodeCompiler;
+};
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_BYTECODE_H_
@@ -0,0 +1,139 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/constant_folding.h"
+
+#include <memory>
+#include <utility>
+
+#include "lldb-eval/ast.h"
+#include "lldb-eval/context.h"
+#include "lldb-eval/eval.h"
+#include "lldb-eval/parser_context.h"
+#include "lldb-eval/value.h"
+#include "lldb/API/SBTarget.h"
+
+namespace lldb_eval {
+
+namespace {
+
+// Checks if the node produces a constant value, provided that all its children
+// are constants. Only the common node header is read for most of the nodes, so
+// the check doesn't need a virtual dispatch.
+bool IsConstantNode(const AstNode* node) {
+  switch (node->node_kind()) {
+    case NodeKind::kLiteral:
+      // String literals are arrays and can't be represented as a scalar
+      // literal.
+      return !node->result_type()->IsArrayType();
+    case NodeKind::kSizeOf:
+      return true;
+    case NodeKind::kCStyleCast:
+      return static_cast<const CStyleCastNode*>(node)->kind() !=
+             CStyleCastKind::kReference;
+    case NodeKind::kCxxStaticCast:
+      switch (static_cast<const CxxStaticCastNode*>(node)->kind()) {
+        case CxxStaticCastKind::kArithmetic:
+        case CxxStaticCastKind::kEnumeration:
+        case CxxStaticCastKind::kPointer:
+        case CxxStaticCastKind::kNullptr:
+          return true;
+        default:
+          return false;
+      }
+    case NodeKind::kBinaryOp: {
+      BinaryOpKind kind = static_cast<const BinaryOpNode*>(node)->kind();
+      return kind != BinaryOpKind::Assign &&
+             !binary_op_kind_is_comp_assign(kind);
+    }
+    case NodeKind::kUnaryOp:
+      switch (static_cast<const UnaryOpNode*>(node)->kind()) {
+        case UnaryOpKind::Plus:
+        case UnaryOpKind::Minus:
+        case UnaryOpKind::Not:
+        case UnaryOpKind::LNot:
+          return true;
+        default:
+          return false;
+      }
+    case NodeKind::kTernaryOp:
+      return node->is_rvalue();
+    default:
+      return false;
+  }
+}
+
+class ConstantFolder {
+ public:
+  ConstantFolder(lldb::SBTarget target, std::shared_ptr<SourceManager> sm)
+      : interpreter_(target, std::move(sm)) {}
+
+  // Folds constant subexpressions of the given node. Returns true if the node
+  // itself is a constant (even if it couldn't be folded).
+  bool Fold(ExprResult& node) {
+    bool children_are_constant = true;
+    node->TransformChildren([this, &children_are_constant](ExprResult& child) {
+      // Fold all children, even if some of them aren't constants.
+      children_are_constant &= Fold(child);
+    });
+
+    if (!children_are_constant || !IsConstantNode(node.get())) {
+      return false;
+    }
+    // Literals are already folded.
+    if (node->node_kind() != NodeKind::kLiteral) {
+      FoldNode(node);
+    }
+    return true;
+  }
+
+ private:
+  void FoldNode(ExprResult& node) {
+    TypeSP type = node->result_type();
+    if (!type->IsScalar() && !type->IsEnum() && !type->IsPointerType() &&
+        !type->IsNullPtrType()) {
+      return;
+    }
+
+    Error error;
+    Value value = interpreter_.Eval(node.get(), error);
+    if (error || error.ub_status() != UbStatus::kOk || !value) {
+      // Keep the original subtree, the evaluation will report the problem.
+      return;
+    }
+
+    clang::SourceLocation location = node->location();
+    AstArena& arena = node->arena();
+    if (type->IsFloat()) {
+      node = MakeNode<LiteralNode>(arena, location, type, value.GetFloat(),
+                                   /*is_literal_zero*/ false);
+    } else {
+      llvm::APInt integer = value.GetInteger();
+      node = MakeNode<LiteralNode>(arena, location, type, std::move(integer),
+                                   /*is_literal_zero*/ false);
+    }
+  }
+
+ private:
+  Interpreter interpreter_;
+};
+
+}  // namespace
+
+void FoldConstants(ExprResult& tree, lldb::SBTarget target,
+                   std::shared_ptr<SourceManager> sm) {
+  ConstantFolder(std::move(target), std::move(sm)).Fold(tree);
+}
+
+}  // namespace lldb_eval
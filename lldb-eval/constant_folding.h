@@ -0,0 +1,40 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_CONSTANT_FOLDING_H_
+#define LLDB_EVAL_CONSTANT_FOLDING_H_
+
+#include <memory>
+
+#include "lldb-eval/ast.h"
+#include "lldb-eval/context.h"
+#include "lldb/API/SBTarget.h"
+
+namespace lldb_eval {
+
+// Replaces constant subexpressions of the given tree with literals. Constant
+// subexpressions consist only of literals, `sizeof` and arithmetic operators
+// and casts applied to them, e.g. `sizeof(Foo) * 4 + 1` or `(char)1.1 + 2`.
+//
+// Subexpressions that trigger undefined behaviour (e.g. division by zero or
+// invalid shifts) are left intact, so their UbStatus is reported during the
+// evaluation as usual.
+void FoldConstants(ExprResult& tree, lldb::SBTarget target,
+                   std::shared_ptr<SourceManager> sm);
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_CONSTANT_FOLDING_H_
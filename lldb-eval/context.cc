@@ -14,15 +14,23 @@
 
 #include "lldb-eval/context.h"
 
+#include <algorithm>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "clang/Basic/Diagnostic.h"
 #include "clang/Basic/FileManager.h"
 #include "clang/Basic/SourceManager.h"
+#include "lldb-eval/frame_index.h"
+#include "lldb-eval/stats.h"
+#include "lldb-eval/target_cache.h"
 #include "lldb-eval/value.h"
 #include "lldb/API/SBExecutionContext.h"
 #include "lldb/API/SBFrame.h"
@@ -33,56 +41,143 @@
 #include "lldb/API/SBTypeEnumMember.h"
 #include "lldb/API/SBValue.h"
 #include "lldb/API/SBValueList.h"
-#include "llvm/ADT/Twine.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/FormatAdapters.h"
 #include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/VirtualFileSystem.h"
 
-#if LLVM_VERSION_MAJOR < 16
-#include "llvm/ADT/Triple.h"
-#else
-#include "llvm/TargetParser/Triple.h"
-#endif
+namespace lldb_eval {
+
+struct SourceManagerEnv {
+  SourceManagerEnv()
+      : file_manager(clang::FileSystemOptions(),
+                     new llvm::vfs::InMemoryFileSystem),
+        diagnostics(new clang::DiagnosticIDs, new clang::DiagnosticOptions,
+                    // Disable default diagnostics reporting.
+                    // TODO(werat): Add custom consumer to keep track of errors.
+                    new clang::IgnoringDiagConsumer) {}
+
+  // The expression is passed as a memory buffer, the file manager is never
+  // used to access any files.
+  clang::FileManager file_manager;
+  clang::DiagnosticsEngine diagnostics;
+};
 
 namespace {
 
-lldb::SBValue CreateSBValue(lldb::SBTarget target, const void* bytes,
-                            lldb::SBType type) {
-  lldb::SBError ignore;
-  lldb::SBData data;
-  data.SetData(ignore, bytes, type.GetByteSize(), target.GetByteOrder(),
-               static_cast<uint8_t>(target.GetAddressByteSize()));
+// Pool of the environments of the destroyed source managers. Creating them
+// for every expression is a noticeable part of evaluating short expressions.
+class SourceManagerEnvPool {
+ public:
+  static SourceManagerEnvPool& Instance() {
+    static SourceManagerEnvPool* pool = new SourceManagerEnvPool();
+    return *pool;
+  }
 
-  // CreateValueFromData copies the data referenced by `bytes` to its own
-  // storage. `value` should be valid up until this point.
-  return target.CreateValueFromData("result", data, type);
-}
+  std::unique_ptr<SourceManagerEnv> Acquire() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!envs_.empty()) {
+        auto env = std::move(envs_.back());
+        envs_.pop_back();
+        return env;
+      }
+    }
+    return std::make_unique<SourceManagerEnv>();
+  }
 
-}  // namespace
+  void Release(std::unique_ptr<SourceManagerEnv> env) {
+    // Diagnostics may have been reported while parsing the expression.
+    env->diagnostics.Reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (envs_.size() < kMaxPooledEnvs) {
+      envs_.push_back(std::move(env));
+    }
+  }
 
-namespace lldb_eval {
+ private:
+  // More environments are only needed if more expressions are alive at once,
+  // e.g. for the compiled expressions held by the user.
+  static constexpr size_t kMaxPooledEnvs = 16;
 
-SourceManager::SourceManager(std::string expr) : expr_(std::move(expr)) {
-  // This holds a SourceManager and all of its dependencies.
-  smff_ = std::make_unique<clang::SourceManagerForFile>("<expr>", expr_);
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<SourceManagerEnv>> envs_;
+};
+
+}  // namespace
 
-  // Disable default diagnostics reporting.
-  // TODO(werat): Add custom consumer to keep track of errors.
-  clang::DiagnosticsEngine& de = smff_->get().getDiagnostics();
-  de.setClient(new clang::IgnoringDiagConsumer);
+SourceManager::SourceManager(std::string owned_expr,
+                             std::optional<llvm::StringRef> borrowed_expr)
+    : owned_expr_(std::move(owned_expr)),
+      expr_(borrowed_expr ? *borrowed_expr : llvm::StringRef(owned_expr_)),
+      env_(SourceManagerEnvPool::Instance().Acquire()) {
+  // The lexer relies on the buffer being null-terminated.
+  assert(expr_.data()[expr_.size()] == '\0' &&
+         "expression must be null-terminated");
+  sm_ = std::make_unique<clang::SourceManager>(env_->diagnostics,
+                                               env_->file_manager);
+  // The buffer refers to the expression, it isn't copied.
+  clang::FileID id = sm_->createFileID(llvm::MemoryBuffer::getMemBuffer(
+      expr_, "<expr>", /*RequiresNullTerminator*/ false));
+  sm_->setMainFileID(id);
+}
+
+SourceManager::~SourceManager() {
+  // The source manager refers to the environment, destroy it first.
+  sm_.reset();
+  SourceManagerEnvPool::Instance().Release(std::move(env_));
 }
 
 std::shared_ptr<SourceManager> SourceManager::Create(std::string expr) {
-  return std::shared_ptr<SourceManager>(new SourceManager(std::move(expr)));
-};
+  return std::shared_ptr<SourceManager>(
+      new SourceManager(std::move(expr), std::nullopt));
+}
+
+std::shared_ptr<SourceManager> SourceManager::CreateBorrowed(
+    llvm::StringRef expr) {
+  return std::shared_ptr<SourceManager>(new SourceManager(std::string(), expr));
+}
+
+size_t SourceManager::GetMemoryUsage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sizeof(*this) + owned_expr_.capacity() + sizeof(clang::SourceManager) +
+         sm_->getDataStructureSizes();
+}
+
+std::string SourceManager::FormatDiagnostics(const std::string& message,
+                                             clang::SourceLocation loc) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return lldb_eval::FormatDiagnostics(*sm_, message, loc);
+}
 
 void Context::SetContextArgs(
-    std::unordered_map<std::string, TypeSP> context_args) {
-  context_args_ = std::move(context_args);
+    std::vector<std::pair<std::string, TypeSP>> context_args) {
+  context_args_.clear();
+  for (uint32_t slot = 0; slot < context_args.size(); ++slot) {
+    auto& [name, type] = context_args[slot];
+    context_args_.try_emplace(name, ContextArg{std::move(type), slot});
+  }
+}
+
+void Context::SetBindVariablesByDeclaration(bool bind_by_declaration) {
+  bind_by_declaration_ = bind_by_declaration;
+}
+
+void Context::SetSourceManager(std::shared_ptr<SourceManager> sm) {
+  sm_ = std::move(sm);
 }
 
 Context::Context(std::shared_ptr<SourceManager> sm,
                  lldb::SBExecutionContext ctx, TypeSP scope)
-    : sm_(std::move(sm)), ctx_(std::move(ctx)), scope_(std::move(scope)) {
+    : sm_(std::move(sm)),
+      ctx_(std::move(ctx)),
+      scope_(std::move(scope)),
+      target_cache_(TargetCache::Get(ctx_.GetTarget())) {
+  // Intern the scope type, so that the types derived from it are interned too.
+  if (scope_->IsValid()) {
+    scope_ = target_cache_->InternType(ToSBType(scope_));
+  }
   // If `scope_` is a reference, dereference it. This makes identifier lookup
   // in the reference value context more convenient (e.g. avoids constructing
   // qualified name "ScopeType &::IDENTIFIER" for static members).
@@ -98,55 +193,50 @@ TypeSP Context::GetBasicType(lldb::BasicType basic_type) {
   }
 
   // Get the basic type from the target and cache it for future calls.
-  TypeSP ret = LLDBType::CreateSP(ctx_.GetTarget().GetBasicType(basic_type));
+  TypeSP ret =
+      target_cache_->InternType(ctx_.GetTarget().GetBasicType(basic_type));
   basic_types_.insert({basic_type, ret});
   return ret;
 }
 
 lldb::BasicType Context::GetSizeType() {
-  // Determine "size_t" based on OS and architecture. It is "unsigned int" on
-  // most 32-bit architectures and "unsigned long" on most 64-bit architectures.
-  // On 64-bit Windows, it is "unsigned long long". To see a complete definition
-  // for all architectures, refer to
-  // https://github.com/llvm/llvm-project/blob/main/clang/lib/Basic/Targets.
-
-  llvm::Triple triple(llvm::Twine(ctx_.GetTarget().GetTriple()));
-  if (triple.isOSWindows()) {
-    return triple.isArch64Bit() ? lldb::eBasicTypeUnsignedLongLong
-                                : lldb::eBasicTypeUnsignedInt;
-  } else {
-    return triple.isArch64Bit() ? lldb::eBasicTypeUnsignedLong
-                                : lldb::eBasicTypeUnsignedInt;
-  }
+  return target_cache_->facts().size_type;
 }
 
 lldb::BasicType Context::GetPtrDiffType() {
-  // Determine "ptrdiff_t" based on OS and architecture. It is "int" on most
-  // 32-bit architectures and "long" on most 64-bit architectures. On 64-bit
-  // Windows, it is "long long". To see a complete definition for all
-  // architectures, refer to
-  // https://github.com/llvm/llvm-project/blob/main/clang/lib/Basic/Targets.
-
-  llvm::Triple triple(llvm::Twine(ctx_.GetTarget().GetTriple()));
-  if (triple.isOSWindows()) {
-    return triple.isArch64Bit() ? lldb::eBasicTypeLongLong
-                                : lldb::eBasicTypeInt;
-  } else {
-    return triple.isArch64Bit() ? lldb::eBasicTypeLong : lldb::eBasicTypeInt;
-  }
+  return target_cache_->facts().ptrdiff_type;
 }
 
 TypeSP Context::GetEmptyType() const {
   return LLDBType::CreateSP(lldb::SBType());
 }
 
-TypeSP Context::ResolveTypeByName(const std::string& name) const {
+TypeSP Context::ResolveTypeByName(llvm::StringRef name) const {
+  PhaseTimer timer(&EvaluationStats::type_lookup_ns);
+  TraceEvent trace("ResolveTypeByName", name);
+  auto cached = types_.find(name);
+  if (cached != types_.end()) {
+    return cached->second;
+  }
+  // Type lookup doesn't depend on the scope (yet), so the results can be
+  // shared with other contexts via the target cache.
+  std::optional<lldb::SBType> sb_type = target_cache_->LookupType(name);
+  if (!sb_type) {
+    sb_type = ResolveTypeByNameImpl(name);
+    target_cache_->InsertType(name, *sb_type);
+  }
+  TypeSP type = target_cache_->InternType(*sb_type);
+  types_.try_emplace(name, type);
+  return type;
+}
+
+lldb::SBType Context::ResolveTypeByNameImpl(llvm::StringRef name) const {
   // TODO(b/163308825): Do scope-aware type lookup. Look for the types defined
   // in the current scope (function, class, namespace) and prioritize them.
 
   // Internally types don't have global scope qualifier in their names and
   // LLDB doesn't support queries with it too.
-  llvm::StringRef name_ref(name);
+  llvm::StringRef name_ref = name;
   bool global_scope = false;
 
   if (name_ref.startswith("::")) {
@@ -157,27 +247,33 @@ TypeSP Context::ResolveTypeByName(const std::string& name) const {
   // SBTarget::FindTypes will return all matched types, including the ones one
   // in different scopes. I.e. if seaching for "myint", this will also return
   // "ns::myint" and "Foo::myint".
-  lldb::SBTypeList types = ctx_.GetTarget().FindTypes(name_ref.data());
+  CountStat(&EvaluationStats::find_types_calls);
+  TraceEvent trace("FindTypes", name_ref);
+  lldb::SBTypeList types = ctx_.GetTarget().FindTypes(name_ref.str().c_str());
 
-  // We've found multiple types, try finding the "correct" one.
+  // We've found multiple types, try finding the "correct" one. Only the last
+  // partial match is used, so there's no need to collect all of them.
   lldb::SBType full_match;
-  std::vector<lldb::SBType> partial_matches;
+  lldb::SBType partial_match;
 
   for (uint32_t i = 0; i < types.GetSize(); ++i) {
     lldb::SBType type = types.GetTypeAtIndex(i);
     llvm::StringRef type_name = type.GetName();
 
-    if (type_name == name_ref) {
+    if (!type_name.endswith(name_ref)) {
+      continue;
+    }
+    if (type_name.size() == name_ref.size()) {
       full_match = type;
-    } else if (type_name.endswith(name_ref)) {
-      partial_matches.push_back(type);
+    } else {
+      partial_match = type;
     }
   }
 
   if (global_scope) {
     // Look only for full matches when looking for a globally qualified type.
     if (full_match.IsValid()) {
-      return LLDBType::CreateSP(full_match);
+      return full_match;
     }
   } else {
     // TODO(b/163308825): We're looking for type, but there may be multiple
@@ -186,25 +282,44 @@ TypeSP Context::ResolveTypeByName(const std::string& name) const {
 
     // Full match is always correct if we're currently in the global scope.
     if (full_match.IsValid()) {
-      return LLDBType::CreateSP(full_match);
+      return full_match;
     }
 
     // If we have partial matches, pick a "random" one.
-    if (partial_matches.size() > 0) {
-      return LLDBType::CreateSP(partial_matches.back());
+    if (partial_match.IsValid()) {
+      return partial_match;
     }
   }
 
-  return LLDBType::CreateSP(lldb::SBType());
+  return lldb::SBType();
 }
 
-static lldb::SBValue LookupStaticIdentifier(lldb::SBTarget target,
-                                            const llvm::StringRef& name_ref) {
+// Returns true if `val_name` names the variable `name`, i.e. it's either
+// `name` itself, "::<name>" or ends with `name` preceded by ' ', '*' or '&'.
+// The tail of `val_name` is compared in place, so no strings are built for
+// the candidates.
+static bool IsVariableNameMatch(llvm::StringRef val_name,
+                                llvm::StringRef name) {
+  if (!val_name.endswith(name)) {
+    return false;
+  }
+  llvm::StringRef prefix = val_name.drop_back(name.size());
+  if (prefix.empty() || prefix == "::") {
+    return true;
+  }
+  char separator = prefix.back();
+  return separator == ' ' || separator == '*' || separator == '&';
+}
+
+static lldb::SBValue FindStaticIdentifier(lldb::SBTarget target,
+                                          const llvm::StringRef& name_ref) {
   // List global variable with the same "basename". There can be many matches
   // from other scopes (namespaces, classes), so we do additional filtering
   // later.
+  CountStat(&EvaluationStats::find_global_variables_calls);
   lldb::SBValueList values = target.FindGlobalVariables(
-      name_ref.data(), /*max_matches=*/std::numeric_limits<uint32_t>::max());
+      name_ref.str().c_str(),
+      /*max_matches=*/std::numeric_limits<uint32_t>::max());
 
   // Find the corrent variable by matching the name. lldb::SBValue::GetName()
   // can return strings like "::globarVar", "ns::i" or "int const ns::foo"
@@ -213,33 +328,86 @@ static lldb::SBValue LookupStaticIdentifier(lldb::SBTarget target,
     lldb::SBValue val = values.GetValueAtIndex(i);
     llvm::StringRef val_name = val.GetName();
 
-    if (val_name == name_ref ||
-        val_name == llvm::formatv("::{0}", name_ref).str() ||
-        val_name.endswith(llvm::formatv(" {0}", name_ref).str()) ||
-        val_name.endswith(llvm::formatv("*{0}", name_ref).str()) ||
-        val_name.endswith(llvm::formatv("&{0}", name_ref).str())) {
+    if (IsVariableNameMatch(val_name, name_ref)) {
       return val;
     }
   }
   return lldb::SBValue();
 }
 
+lldb::SBValue Context::LookupStaticIdentifier(llvm::StringRef name) const {
+  lldb::SBProcess process = ctx_.GetTarget().GetProcess();
+  std::optional<lldb::SBValue> value =
+      target_cache_->LookupGlobal(process, name);
+  if (!value) {
+    value = FindStaticIdentifier(ctx_.GetTarget(), name);
+    target_cache_->InsertGlobal(process, name, *value);
+  }
+  return *value;
+}
+
+lldb::SBValue Context::FindRegister(llvm::StringRef name) const {
+  if (frame_index_) {
+    return frame_index_->FindRegister(name).value;
+  }
+  return ctx_.GetFrame().FindRegister(name.str().c_str());
+}
+
+std::unique_ptr<ParserContext::IdentifierInfo> Context::IdentifierFromValue(
+    lldb::SBValue value) const {
+  auto type = target_cache_->InternType(value.GetType());
+  return IdentifierInfo::FromValue(std::move(value), std::move(type));
+}
+
+std::unique_ptr<ParserContext::IdentifierInfo>
+Context::IdentifierFromFrameValue(IdentifierInfo::Kind kind,
+                                  llvm::StringRef name,
+                                  lldb::SBValue value) const {
+  if (!value) {
+    // Invalid identifier.
+    return IdentifierFromValue(value);
+  }
+  TypeSP type = target_cache_->InternType(value.GetType());
+  if (kind == IdentifierInfo::Kind::kFrameVariable) {
+    return IdentifierInfo::FromFrameVariable(name.str(), value.GetDeclaration(),
+                                             std::move(type));
+  }
+  return IdentifierInfo::FromFrameValue(kind, name.str(), std::move(type));
+}
+
 std::unique_ptr<ParserContext::IdentifierInfo> Context::LookupIdentifier(
-    const std::string& name) const {
+    llvm::StringRef name) const {
+  PhaseTimer timer(&EvaluationStats::identifier_lookup_ns);
+  TraceEvent trace("LookupIdentifier", name);
+
   // Context arguments take precedence over other identifiers (local/global
   // variables, enum values, registers).
   auto context_arg = context_args_.find(name);
   if (context_arg != context_args_.end()) {
-    return IdentifierInfo::FromContextArg(context_arg->second);
+    return IdentifierInfo::FromContextArg(context_arg->second.type,
+                                          context_arg->second.slot);
   }
 
-  llvm::StringRef name_ref(name);
+  auto cached = identifiers_.find(name);
+  if (cached == identifiers_.end()) {
+    auto info = LookupIdentifierImpl(name);
+    cached =
+        identifiers_
+            .try_emplace(name, static_cast<const IdentifierInfo&>(*info))
+            .first;
+  }
+  return std::unique_ptr<ParserContext::IdentifierInfo>(
+      new IdentifierInfo(cached->second));
+}
 
+std::unique_ptr<ParserContext::IdentifierInfo> Context::LookupIdentifierImpl(
+    llvm::StringRef name_ref) const {
   // Support $rax as a special syntax for accessing registers.
   // Will return an invalid value in case the requested register doesn't exist.
   if (name_ref.startswith("$")) {
-    const char* reg_name = name_ref.drop_front(1).data();
-    return IdentifierInfo::FromValue(ctx_.GetFrame().FindRegister(reg_name));
+    llvm::StringRef reg_name = name_ref.drop_front(1);
+    return IdentifierFromFrameValue(IdentifierInfo::Kind::kRegister, reg_name,
+                                    FindRegister(reg_name).GetStaticValue());
   }
 
   // Internally values don't have global scope qualifier in their names and
@@ -253,32 +421,8 @@ std::unique_ptr<ParserContext::IdentifierInfo> Context::LookupIdentifier(
   // If the identifier doesn't refer to the global scope and doesn't have any
   // other scope qualifiers, try looking among the local and instance variables.
   if (!global_scope && !name_ref.contains("::")) {
-    if (!scope_->IsValid()) {
-      // Lookup in the current frame.
-      lldb::SBFrame frame = ctx_.GetFrame();
-      // Try looking for a local variable in current scope.
-      lldb::SBValue value = frame.FindVariable(name_ref.data());
-      if (value) {
-        // Force static value, otherwise we can end up with the "real" type.
-        return IdentifierInfo::FromValue(value.GetStaticValue());
-      }
-      // Try looking for an instance variable (class member).
-      value =
-          frame.FindVariable("this").GetChildMemberWithName(name_ref.data());
-      if (value) {
-        // Force static value, otherwise we can end up with the "real" type.
-        return IdentifierInfo::FromValue(value.GetStaticValue());
-      }
-    } else {
-      // In a "value" scope `this` refers to the scope object itself.
-      if (name_ref == "this") {
-        return IdentifierInfo::FromThisKeyword(scope_->GetPointerType());
-      }
-      // Lookup the variable as a member of the current scope value.
-      auto [member, path] = GetMemberInfo(scope_, name_ref.data());
-      if (member) {
-        return IdentifierInfo::FromMemberPath(member.type, std::move(path));
-      }
+    if (auto local = LookupLocalIdentifier(name_ref)) {
+      return local;
     }
   }
 
@@ -289,49 +433,226 @@ std::unique_ptr<ParserContext::IdentifierInfo> Context::LookupIdentifier(
   // "ns1::ns2::Foo()", then "ns2::x" should resolve to "ns1::ns2::x".
 
   lldb::SBValue value;
-  if (scope_ && !global_scope) {
+  if (scope_->IsValid() && !global_scope) {
     // Try looking for static member of the current scope value, e.g.
     // `ScopeType::NAME`. NAME can include nested struct (`Nested::SUBNAME`),
     // but it cannot be part of the global scope (start with "::").
     const char* type_name = scope_->GetCanonicalType()->GetName().data();
     std::string name_with_type_prefix =
         llvm::formatv("{0}::{1}", type_name, name_ref).str();
-    value = LookupStaticIdentifier(ctx_.GetTarget(), name_with_type_prefix);
+    value = LookupStaticIdentifier(name_with_type_prefix);
   }
 
   // Lookup a regular global variable.
   if (!value) {
-    value = LookupStaticIdentifier(ctx_.GetTarget(), name_ref);
+    value = LookupStaticIdentifier(name_ref);
   }
 
-  // Try looking up enum value.
+  // Try looking up enum value. The enumerators are constants, they are stored
+  // inline instead of creating lldb::SBValue for them.
   if (!value && name_ref.contains("::")) {
     auto [enum_typename, enumerator_name] = name_ref.rsplit("::");
 
-    auto type = ResolveTypeByName(enum_typename.str());
-    lldb::SBTypeEnumMemberList members = ToSBType(type).GetEnumMembers();
-
-    for (size_t i = 0; i < members.GetSize(); i++) {
-      lldb::SBTypeEnumMember member = members.GetTypeEnumMemberAtIndex(i);
-      if (member.GetName() == enumerator_name) {
-        uint64_t bytes = member.GetValueAsUnsigned();
-        value = CreateSBValue(ctx_.GetTarget(), &bytes, ToSBType(type));
-        break;
+    TypeSP type = ResolveTypeByName(enum_typename);
+    if (type->IsValid() && type->IsEnum()) {
+      auto table = target_cache_->GetEnumTable(ToSBType(type));
+      if (auto enumerator = table->Find(enumerator_name)) {
+        llvm::APInt bytes(64, *enumerator);
+        Value constant = Value::CreateScalar(
+            ctx_.GetTarget(), ToSBType(type),
+            bytes.zextOrTrunc(static_cast<unsigned>(type->GetByteSize() * 8)));
+        return IdentifierInfo::FromValue(std::move(constant), type);
       }
     }
   }
 
   // Last resort, lookup as a register (e.g. `rax` or `rip`).
   if (!value) {
-    value = ctx_.GetFrame().FindRegister(name_ref.data());
+    return IdentifierFromFrameValue(IdentifierInfo::Kind::kRegister, name_ref,
+                                    FindRegister(name_ref).GetStaticValue());
   }
 
   // Force static value, otherwise we can end up with the "real" type.
-  return IdentifierInfo::FromValue(value.GetStaticValue());
+  return IdentifierFromValue(value.GetStaticValue());
 }
 
-bool Context::IsContextVar(const std::string& name) const {
-  return context_args_.find(name) != context_args_.end();
+// Looks up the local and instance variables. Returns null if there are none.
+std::unique_ptr<ParserContext::IdentifierInfo> Context::LookupLocalIdentifier(
+    llvm::StringRef name_ref) const {
+  auto local_kind = bind_by_declaration_
+                        ? IdentifierInfo::Kind::kFrameVariable
+                        : IdentifierInfo::Kind::kLocalVariable;
+  if (frame_index_) {
+    // Same as below, but via the index of the frame.
+    lldb::SBValue value = frame_index_->FindVariable(name_ref);
+    if (value) {
+      return IdentifierFromFrameValue(local_kind, name_ref,
+                                      value.GetStaticValue());
+    }
+    value = frame_index_->FindMember(name_ref);
+    if (value) {
+      return IdentifierFromFrameValue(IdentifierInfo::Kind::kInstanceVariable,
+                                      name_ref, value.GetStaticValue());
+    }
+  } else if (!scope_->IsValid()) {
+    // Lookup in the current frame. LLDB needs a null-terminated name.
+    lldb::SBFrame frame = ctx_.GetFrame();
+    std::string name = name_ref.str();
+    // Try looking for a local variable in current scope.
+    lldb::SBValue value = frame.FindVariable(name.c_str());
+    if (value) {
+      // Force static value, otherwise we can end up with the "real" type.
+      return IdentifierFromFrameValue(local_kind, name_ref,
+                                      value.GetStaticValue());
+    }
+    // Try looking for an instance variable (class member).
+    value = frame.FindVariable("this").GetChildMemberWithName(name.c_str());
+    if (value) {
+      return IdentifierFromFrameValue(IdentifierInfo::Kind::kInstanceVariable,
+                                      name_ref, value.GetStaticValue());
+    }
+  } else {
+    // In a "value" scope `this` refers to the scope object itself.
+    if (name_ref == "this") {
+      return IdentifierInfo::FromThisKeyword(scope_->GetPointerType());
+    }
+    // Lookup the variable as a member of the current scope value.
+    auto [member, path, offset] = GetMemberInfo(scope_, name_ref);
+    if (member) {
+      return IdentifierInfo::FromMemberPath(member.type, std::move(path));
+    }
+  }
+  return nullptr;
+}
+
+bool Context::IsLocalIdentifier(llvm::StringRef name) const {
+  if (IsContextVar(name)) {
+    return true;
+  }
+  auto cached = identifiers_.find(name);
+  if (cached != identifiers_.end()) {
+    using Kind = IdentifierInfo::Kind;
+    Kind kind = cached->second.kind();
+    return cached->second.IsValid() && kind != Kind::kValue &&
+           kind != Kind::kRegister;
+  }
+  if (name.startswith("$") || name.contains("::")) {
+    return false;
+  }
+  return LookupLocalIdentifier(name) != nullptr;
+}
+
+bool Context::IsContextVar(llvm::StringRef name) const {
+  return context_args_.count(name) > 0;
+}
+
+std::shared_ptr<const BaseClassPath> Context::GetBaseClassPath(
+    TypeSP type, TypeSP base) const {
+  return target_cache_->GetBaseClassPath(std::move(type), std::move(base));
+}
+
+static std::shared_ptr<const TargetCache::GlobalNames> FindGlobalNames(
+    lldb::SBTarget target, llvm::StringRef prefix) {
+  CountStat(&EvaluationStats::find_global_variables_calls);
+  lldb::SBValueList values = target.FindGlobalVariables(
+      prefix.str().c_str(),
+      /*max_matches=*/std::numeric_limits<uint32_t>::max(),
+      lldb::eMatchTypeStartsWith);
+
+  auto names = std::make_shared<TargetCache::GlobalNames>();
+  for (uint32_t i = 0; i < values.GetSize(); ++i) {
+    lldb::SBValue value = values.GetValueAtIndex(i);
+    const char* value_name = value.GetName();
+    if (!value_name) {
+      continue;
+    }
+    // See `FindStaticIdentifier()`, only the plain (possibly qualified) names
+    // can be completed.
+    llvm::StringRef name(value_name);
+    name.consume_front("::");
+    if (name.startswith(prefix) && !name.contains(' ')) {
+      names->globals.try_emplace(name, std::move(value));
+    }
+  }
+  names->sorted_names.reserve(names->globals.size());
+  for (const auto& global : names->globals) {
+    names->sorted_names.push_back(global.getKey());
+  }
+  std::sort(names->sorted_names.begin(), names->sorted_names.end());
+  return names;
+}
+
+std::vector<Context::IdentifierCandidate> Context::CompleteIdentifier(
+    llvm::StringRef prefix) const {
+  using Kind = IdentifierInfo::Kind;
+  std::vector<IdentifierCandidate> ret;
+  std::unordered_set<std::string> seen;
+  auto add = [&](llvm::StringRef name, TypeSP type, Kind kind) {
+    if (seen.insert(name.str()).second) {
+      ret.push_back({name.str(), std::move(type), kind});
+    }
+  };
+
+  // Prefixes can't be looked up in the map, every context argument is checked.
+  // Their number is fixed by the caller of the compilation and is small next
+  // to the local variables and the globals matched below.
+  for (const auto& context_arg : context_args_) {
+    if (context_arg.getKey().startswith(prefix)) {
+      add(context_arg.getKey(), context_arg.getValue().type, Kind::kContextArg);
+    }
+  }
+  std::sort(ret.begin(), ret.end(),
+            [](const IdentifierCandidate& lhs, const IdentifierCandidate& rhs) {
+              return lhs.name < rhs.name;
+            });
+
+  // Only the context variables are prefixed with '$' (registers are not
+  // completed).
+  if (prefix.startswith("$")) {
+    return ret;
+  }
+
+  if (scope_->IsValid()) {
+    for (auto& [name, member] : FindMembersWithPrefix(scope_, prefix)) {
+      add(name, member.type, Kind::kMemberPath);
+    }
+  } else {
+    auto frame_index =
+        frame_index_ ? frame_index_ : FrameIndex::Get(ctx_.GetFrame());
+    for (llvm::StringRef name : frame_index->FindVariableNames(prefix)) {
+      lldb::SBValue value = frame_index->FindVariable(name).GetStaticValue();
+      add(name, target_cache_->InternType(value.GetType()),
+          Kind::kLocalVariable);
+    }
+    lldb::SBValue this_value = frame_index->this_value();
+    if (this_value) {
+      TypeSP this_type =
+          target_cache_->InternType(this_value.GetStaticValue().GetType());
+      TypeSP record_type = this_type->GetPointeeType();
+      if (this_type->IsPointerType() && record_type->IsRecordType()) {
+        for (auto& [name, member] :
+             FindMembersWithPrefix(record_type, prefix)) {
+          add(name, member.type, Kind::kInstanceVariable);
+        }
+      }
+    }
+  }
+
+  if (prefix.empty()) {
+    return ret;
+  }
+  lldb::SBProcess process = ctx_.GetTarget().GetProcess();
+  auto globals = target_cache_->LookupGlobalNames(process, prefix);
+  if (!globals) {
+    globals = FindGlobalNames(ctx_.GetTarget(), prefix);
+    target_cache_->InsertGlobalNames(process, prefix, globals);
+  }
+  for (llvm::StringRef name :
+       FindNamesWithPrefix(globals->sorted_names, prefix)) {
+    lldb::SBValue value = globals->globals.lookup(name).GetStaticValue();
+    add(name, target_cache_->InternType(value.GetType()), Kind::kValue);
+  }
+  return ret;
 }
 
 std::shared_ptr<Context> Context::Create(std::shared_ptr<SourceManager> sm,
@@ -341,6 +662,14 @@ std::shared_ptr<Context> Context::Create(std::shared_ptr<SourceManager> sm,
                   LLDBType::CreateSP(lldb::SBType())));
 }
 
+std::shared_ptr<Context> Context::Create(
+    std::shared_ptr<SourceManager> sm,
+    std::shared_ptr<FrameIndex> frame_index) {
+  auto context = Create(std::move(sm), frame_index->frame());
+  context->frame_index_ = std::move(frame_index);
+  return context;
+}
+
 std::shared_ptr<Context> Context::Create(std::shared_ptr<SourceManager> sm,
                                          lldb::SBTarget target, TypeSP scope) {
   // SBValues created via SBTarget::CreateValueFromData don't have SBFrame
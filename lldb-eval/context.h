@@ -18,40 +18,81 @@
 #define LLDB_EVAL_EXPRESSION_CONTEXT_H_
 
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "clang/Basic/SourceManager.h"
+#include "lldb-eval/frame_index.h"
+#include "lldb-eval/target_cache.h"
+#include "lldb/API/SBDeclaration.h"
 #include "lldb/API/SBExecutionContext.h"
 #include "lldb/API/SBFrame.h"
 #include "lldb/API/SBType.h"
 #include "lldb/API/SBValue.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
 #include "parser_context.h"
 #include "value.h"
 
 namespace lldb_eval {
 
-// clang::SourceManager wrapper which takes ownership of the expression string.
-class SourceManager {
+// Objects clang::SourceManager depends on (the file manager and the
+// diagnostics engine). They are pooled and re-used by the subsequent source
+// managers, see `SourceManager`.
+struct SourceManagerEnv;
+
+// clang::SourceManager wrapper for the expression string.
+class SourceManager : public DiagnosticsSource {
  public:
+  // Creates a source manager which takes the ownership of the expression.
   static std::shared_ptr<SourceManager> Create(std::string expr);
+  // Same as above, but borrows the caller-owned expression instead of copying
+  // it. `expr` must be null-terminated (e.g. a C string) and outlive the source
+  // manager and everything holding it (contexts, interpreters, compiled
+  // expressions).
+  static std::shared_ptr<SourceManager> CreateBorrowed(llvm::StringRef expr);
+
+  ~SourceManager() override;
 
   // This class cannot be safely moved because of the dependency between `expr_`
-  // and `smff_`. Users are supposed to pass around the shared pointer.
+  // and `sm_`. Users are supposed to pass around the shared pointer.
   SourceManager(SourceManager&&) = delete;
   SourceManager(const SourceManager&) = delete;
   SourceManager& operator=(SourceManager const&) = delete;
 
-  clang::SourceManager& GetSourceManager() const { return smff_->get(); }
+  clang::SourceManager& GetSourceManager() const { return *sm_; }
+  llvm::StringRef expr() const { return expr_; }
+
+  // Estimated memory held by the source manager: the owned expression and the
+  // data structures of clang::SourceManager (e.g. the line tables). The
+  // environment is pooled and isn't counted.
+  size_t GetMemoryUsage() const;
+
+  // Same as `FormatDiagnostics(GetSourceManager(), message, loc)`, but can be
+  // called concurrently. clang::SourceManager computes the line tables lazily,
+  // so even the "read-only" queries are not thread-safe. Used by the
+  // interpreter, since compiled expressions (sharing the source) can be
+  // evaluated by multiple threads at once.
+  std::string FormatDiagnostics(const std::string& message,
+                                clang::SourceLocation loc) const override;
 
  private:
-  explicit SourceManager(std::string expr);
+  // Borrows `borrowed_expr` if it's set, otherwise uses `owned_expr`.
+  SourceManager(std::string owned_expr,
+                std::optional<llvm::StringRef> borrowed_expr);
 
  private:
-  // Store the expression, since SourceManagerForFile doesn't take the
-  // ownership.
-  std::string expr_;
-  std::unique_ptr<clang::SourceManagerForFile> smff_;
+  // Storage of the expression if it's owned, clang::SourceManager doesn't take
+  // the ownership.
+  std::string owned_expr_;
+  llvm::StringRef expr_;
+  std::unique_ptr<SourceManagerEnv> env_;
+  std::unique_ptr<clang::SourceManager> sm_;
+  mutable std::mutex mutex_;
 };
 
 class Context : public ParserContext {
@@ -67,16 +108,51 @@ class Context : public ParserContext {
       kContextArg,
       kMemberPath,
       kThisKeyword,
+      // Identifiers of the frame. Only their types are bound during the
+      // parsing, the values are looked up by the name in the frame of the
+      // evaluation (see `Interpreter::SetFrame()`).
+      kLocalVariable,
+      kInstanceVariable,
+      kRegister,
+      // Local variable (or an argument) of the frame identified by its
+      // declaration rather than by just the name. It's looked up by the name
+      // first, and among all the variables of the frame if that one has a
+      // different declaration (e.g. it's shadowed by a variable of a nested
+      // block). See `Context::SetBindVariablesByDeclaration()`.
+      kFrameVariable,
     };
 
-    static IdentifierInfoPtr FromValue(lldb::SBValue value) {
-      TypeSP type = LLDBType::CreateSP(value.GetType());
+    static IdentifierInfoPtr FromValue(lldb::SBValue value,
+                                       std::shared_ptr<LLDBType> type) {
+      Value val(std::move(value), type);
       return IdentifierInfoPtr(new IdentifierInfo(Kind::kValue, std::move(type),
-                                                  Value(std::move(value)), {}));
+                                                  std::move(val), {}));
     }
-    static IdentifierInfoPtr FromContextArg(TypeSP type) {
-      return IdentifierInfoPtr(
-          new IdentifierInfo(Kind::kContextArg, std::move(type), Value(), {}));
+    // Same as above, but for the values created by lldb-eval (e.g. inline
+    // scalars for the enumerators).
+    static IdentifierInfoPtr FromValue(Value value, TypeSP type) {
+      return IdentifierInfoPtr(new IdentifierInfo(Kind::kValue, std::move(type),
+                                                  std::move(value), {}));
+    }
+    static IdentifierInfoPtr FromFrameValue(Kind kind, std::string name,
+                                            TypeSP type) {
+      auto info = new IdentifierInfo(kind, std::move(type), Value(), {});
+      info->name_ = std::move(name);
+      return IdentifierInfoPtr(info);
+    }
+    static IdentifierInfoPtr FromFrameVariable(
+        std::string name, lldb::SBDeclaration declaration, TypeSP type) {
+      auto info = new IdentifierInfo(Kind::kFrameVariable, std::move(type),
+                                     Value(), {});
+      info->name_ = std::move(name);
+      info->declaration_ = std::move(declaration);
+      return IdentifierInfoPtr(info);
+    }
+    static IdentifierInfoPtr FromContextArg(TypeSP type, uint32_t slot) {
+      auto info = new IdentifierInfo(Kind::kContextArg, std::move(type),
+                                     Value(), {});
+      info->context_slot_ = slot;
+      return IdentifierInfoPtr(info);
     }
     static IdentifierInfoPtr FromMemberPath(TypeSP type, MemberPath path) {
       return IdentifierInfoPtr(new IdentifierInfo(
@@ -90,6 +166,15 @@ class Context : public ParserContext {
     Kind kind() const { return kind_; }
     Value value() const { return value_; }
     const MemberPath& path() const { return path_; }
+    // Position of the context argument in the list of the context arguments
+    // (see `Context::SetContextArgs()`). The values of the context variables
+    // are bound to the slots during the evaluation.
+    uint32_t context_slot() const { return context_slot_; }
+    // Name of the local variable, the member of `this` or the register (without
+    // the `$` prefix) the frame identifier refers to.
+    const std::string& name() const { return name_; }
+    // Declaration of the frame variable.
+    const lldb::SBDeclaration& declaration() const { return declaration_; }
 
     // from ParserContext::IdentifierInfo:
     TypeSP GetType() override { return type_; }
@@ -107,34 +192,92 @@ class Context : public ParserContext {
     TypeSP type_;
     Value value_;
     MemberPath path_;
+    uint32_t context_slot_ = 0;
+    std::string name_;
+    lldb::SBDeclaration declaration_;
   };
 
   static std::shared_ptr<Context> Create(std::shared_ptr<SourceManager> sm,
                                          lldb::SBFrame frame);
+  // Same as above, but the identifiers are looked up in the given index of the
+  // frame rather than in the frame itself.
+  static std::shared_ptr<Context> Create(
+      std::shared_ptr<SourceManager> sm,
+      std::shared_ptr<FrameIndex> frame_index);
   static std::shared_ptr<Context> Create(std::shared_ptr<SourceManager> sm,
                                          lldb::SBTarget target, TypeSP scope);
 
   clang::SourceManager& GetSourceManager() const override {
     return sm_->GetSourceManager();
   }
+  std::shared_ptr<const DiagnosticsSource> GetDiagnosticsSource()
+      const override {
+    return sm_;
+  }
   lldb::SBExecutionContext GetExecutionContext() const { return ctx_; }
+  const TargetFacts& GetTargetFacts() const { return target_cache_->facts(); }
 
-  void SetContextArgs(std::unordered_map<std::string, TypeSP> context_args);
+  // Sets the context arguments. The position of the argument in the list is
+  // its slot, if there are multiple arguments with the same name, the first one
+  // is used.
+  void SetContextArgs(
+      std::vector<std::pair<std::string, TypeSP>> context_args);
+
+  // If set, the local variables are bound by their declarations (see
+  // `IdentifierInfo::Kind::kFrameVariable`), so the expressions parsed in the
+  // context can be evaluated in any frame stopped in the same lexical block.
+  // Must be set before parsing the expressions.
+  void SetBindVariablesByDeclaration(bool bind_by_declaration);
+
+  // Replaces the expression source. Allows re-using the context (and its
+  // caches) for parsing multiple expressions in the same scope.
+  void SetSourceManager(std::shared_ptr<SourceManager> sm);
 
  public:
   TypeSP GetBasicType(lldb::BasicType basic_type) override;
   TypeSP GetEmptyType() const override;
   lldb::BasicType GetSizeType() override;
   lldb::BasicType GetPtrDiffType() override;
-  TypeSP ResolveTypeByName(const std::string& name) const override;
+  TypeSP ResolveTypeByName(llvm::StringRef name) const override;
   std::unique_ptr<ParserContext::IdentifierInfo> LookupIdentifier(
-      const std::string& name) const override;
-  bool IsContextVar(const std::string& name) const override;
+      llvm::StringRef name) const override;
+  bool IsLocalIdentifier(llvm::StringRef name) const override;
+  bool IsContextVar(llvm::StringRef name) const override;
+  std::shared_ptr<const BaseClassPath> GetBaseClassPath(
+      TypeSP type, TypeSP base) const override;
+
+  // Identifier visible in the context, see `CompleteIdentifier()`.
+  struct IdentifierCandidate {
+    std::string name;
+    TypeSP type;
+    IdentifierInfo::Kind kind;
+  };
+  // Returns the identifiers starting with `prefix`, in the order of the lookup:
+  // the context arguments, the local variables, the members of `this` (or of
+  // the scope value) and the global variables. Each group is sorted by the
+  // names, the identifiers shadowed by the preceding ones are skipped. Local
+  // variables are enumerated via the index of the frame. Global variables are
+  // looked up only for non-empty prefixes, there are too many of them.
+  std::vector<IdentifierCandidate> CompleteIdentifier(
+      llvm::StringRef prefix) const;
 
  private:
   Context(std::shared_ptr<SourceManager> sm, lldb::SBExecutionContext ctx,
           TypeSP scope);
 
+  lldb::SBType ResolveTypeByNameImpl(llvm::StringRef name) const;
+  std::unique_ptr<ParserContext::IdentifierInfo> LookupIdentifierImpl(
+      llvm::StringRef name_ref) const;
+  std::unique_ptr<ParserContext::IdentifierInfo> LookupLocalIdentifier(
+      llvm::StringRef name_ref) const;
+  lldb::SBValue LookupStaticIdentifier(llvm::StringRef name) const;
+  lldb::SBValue FindRegister(llvm::StringRef name) const;
+  std::unique_ptr<ParserContext::IdentifierInfo> IdentifierFromValue(
+      lldb::SBValue value) const;
+  std::unique_ptr<ParserContext::IdentifierInfo> IdentifierFromFrameValue(
+      IdentifierInfo::Kind kind, llvm::StringRef name,
+      lldb::SBValue value) const;
+
  private:
   std::shared_ptr<SourceManager> sm_;
 
@@ -148,11 +291,31 @@ class Context : public ParserContext {
   // available.
   TypeSP scope_;
 
+  // Optional, identifiers of the frame are looked up in the index if set.
+  std::shared_ptr<FrameIndex> frame_index_;
+
   // Context arguments used for identifier lookup.
-  std::unordered_map<std::string, TypeSP> context_args_;
+  struct ContextArg {
+    TypeSP type;
+    uint32_t slot;
+  };
+  llvm::StringMap<ContextArg> context_args_;
+
+  // See `SetBindVariablesByDeclaration()`.
+  bool bind_by_declaration_ = false;
 
   // Cache of the basic types for the current target.
   std::unordered_map<lldb::BasicType, TypeSP> basic_types_;
+
+  // Caches of resolved types and identifiers (except for context arguments).
+  // The scope doesn't change during the lifetime of the context, so the
+  // results can be re-used by all expressions parsed with it. Looked up by
+  // `llvm::StringRef`, so the lookups don't copy the names.
+  mutable llvm::StringMap<TypeSP> types_;
+  mutable llvm::StringMap<IdentifierInfo> identifiers_;
+
+  // Types and global variables of the target, shared by all contexts.
+  std::shared_ptr<TargetCache> target_cache_;
 };
 
 }  // namespace lldb_eval
@@ -0,0 +1,142 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/dependency_tracker.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "lldb-eval/stats.h"
+#include "lldb/API/SBData.h"
+#include "lldb/API/SBError.h"
+#include "lldb/API/SBProcess.h"
+#include "lldb/API/SBValue.h"
+#include "lldb/lldb-defines.h"
+
+namespace lldb_eval {
+
+static std::vector<uint8_t> ReadMemory(lldb::SBProcess process,
+                                       lldb::addr_t addr, uint64_t size) {
+  std::vector<uint8_t> ret(size);
+  lldb::SBError error;
+  size_t read = ReadProcessMemory(process, addr, ret.data(), size, error);
+  ret.resize(read);
+  return ret;
+}
+
+static std::vector<uint8_t> ReadValueData(lldb::SBValue value) {
+  std::vector<uint8_t> ret;
+  lldb::SBData data = value.GetData();
+  if (!data.IsValid()) {
+    return ret;
+  }
+  ret.resize(data.GetByteSize());
+  lldb::SBError error;
+  size_t read = data.ReadRawData(error, 0, ret.data(), ret.size());
+  ret.resize(error.Fail() ? 0 : read);
+  return ret;
+}
+
+void DependencyTracker::AddValue(lldb::SBValue value) {
+  if (!is_trackable_ || !value.IsValid()) {
+    return;
+  }
+  lldb::addr_t addr = value.GetLoadAddress();
+  if (addr != LLDB_INVALID_ADDRESS) {
+    AddMemory(addr, value.GetByteSize());
+    return;
+  }
+  values_.push_back({value, {}});
+}
+
+void DependencyTracker::AddMemory(lldb::addr_t addr, uint64_t size) {
+  if (!is_trackable_ || size == 0) {
+    return;
+  }
+  tracked_bytes_ += size;
+  if (tracked_bytes_ > kMaxTrackedBytes) {
+    SetUntrackable();
+    return;
+  }
+  memory_.push_back({addr, size, {}});
+}
+
+void DependencyTracker::SetUntrackable() {
+  Clear();
+  is_trackable_ = false;
+}
+
+void DependencyTracker::Snapshot(lldb::SBProcess process) {
+  if (!is_trackable_) {
+    return;
+  }
+  MergeMemoryRanges();
+  for (auto& input : memory_) {
+    input.contents = ReadMemory(process, input.addr, input.size);
+  }
+  for (auto& input : values_) {
+    input.contents = ReadValueData(input.value);
+  }
+}
+
+bool DependencyTracker::HasChanged(lldb::SBProcess process) {
+  if (!is_trackable_) {
+    return true;
+  }
+  // Memory ranges are merged, so every range is read by one call.
+  for (const auto& input : memory_) {
+    if (ReadMemory(process, input.addr, input.size) != input.contents) {
+      return true;
+    }
+  }
+  for (const auto& input : values_) {
+    if (ReadValueData(input.value) != input.contents) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void DependencyTracker::Clear() {
+  memory_.clear();
+  values_.clear();
+  tracked_bytes_ = 0;
+  is_trackable_ = true;
+}
+
+void DependencyTracker::MergeMemoryRanges() {
+  if (memory_.empty()) {
+    return;
+  }
+  std::sort(memory_.begin(), memory_.end(),
+            [](const MemoryInput& lhs, const MemoryInput& rhs) {
+              return lhs.addr < rhs.addr;
+            });
+
+  size_t last = 0;
+  for (size_t i = 1; i < memory_.size(); ++i) {
+    lldb::addr_t last_end = memory_[last].addr + memory_[last].size;
+    if (memory_[i].addr <= last_end) {
+      lldb::addr_t end = memory_[i].addr + memory_[i].size;
+      memory_[last].size = std::max(last_end, end) - memory_[last].addr;
+    } else {
+      memory_[++last] = std::move(memory_[i]);
+    }
+  }
+  memory_.resize(last + 1);
+}
+
+}  // namespace lldb_eval
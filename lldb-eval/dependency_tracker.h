@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_DEPENDENCY_TRACKER_H_
+#define LLDB_EVAL_DEPENDENCY_TRACKER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "lldb/API/SBProcess.h"
+#include "lldb/API/SBValue.h"
+#include "lldb/lldb-types.h"
+
+namespace lldb_eval {
+
+// Records the inputs of an evaluation, i.e. the process memory and the values
+// not located in memory (e.g. variables in registers) read by the interpreter,
+// and detects whether they have changed since. Used for re-evaluating the
+// expressions only when necessary (see `ReevaluateExpression()` in api.h).
+//
+// The tracking is conservative: the recorded inputs cover everything the
+// evaluation has read, but may include unrelated bytes (e.g. the whole object
+// when only one of its members is used).
+class DependencyTracker {
+ public:
+  // Inputs larger than this are not tracked, the evaluation is considered
+  // changed every time instead.
+  static constexpr uint64_t kMaxTrackedBytes = 1 << 20;
+
+  // Records the contents of `value` as an input. Values located in the process
+  // memory are tracked by their memory range, the other values by their data.
+  void AddValue(lldb::SBValue value);
+
+  // Records `size` bytes at `addr` as an input.
+  void AddMemory(lldb::addr_t addr, uint64_t size);
+
+  // Marks the evaluation as untrackable (e.g. it has side effects), such
+  // evaluations are always considered changed.
+  void SetUntrackable();
+
+  // Reads the current contents of the recorded inputs. Called once the
+  // evaluation is done.
+  void Snapshot(lldb::SBProcess process);
+
+  // Returns true if the contents of any input differ from the snapshot.
+  bool HasChanged(lldb::SBProcess process);
+
+  void Clear();
+
+  bool is_trackable() const { return is_trackable_; }
+  size_t num_memory_ranges() const { return memory_.size(); }
+  size_t num_values() const { return values_.size(); }
+
+ private:
+  struct MemoryInput {
+    lldb::addr_t addr;
+    uint64_t size;
+    // Readable part of the range at the time of the snapshot.
+    std::vector<uint8_t> contents;
+  };
+
+  struct ValueInput {
+    lldb::SBValue value;
+    std::vector<uint8_t> contents;
+  };
+
+  // Merges the overlapping and adjacent memory ranges.
+  void MergeMemoryRanges();
+
+ private:
+  std::vector<MemoryInput> memory_;
+  std::vector<ValueInput> values_;
+  uint64_t tracked_bytes_ = 0;
+  bool is_trackable_ = true;
+};
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_DEPENDENCY_TRACKER_H_
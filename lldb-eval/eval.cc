@@ -14,21 +14,140 @@
 
 #include "lldb-eval/eval.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
 #include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "clang/Basic/TokenKinds.h"
 #include "lldb-eval/ast.h"
+#include "lldb-eval/bulk_scan.h"
+#include "lldb-eval/bytecode.h"
 #include "lldb-eval/context.h"
+#include "lldb-eval/dependency_tracker.h"
+#include "lldb-eval/memory_cache.h"
+#include "lldb-eval/memory_provider.h"
+#include "lldb-eval/scalar_program.h"
+#include "lldb-eval/stats.h"
+#include "lldb-eval/target_cache.h"
+#include "lldb-eval/trace.h"
 #include "lldb-eval/value.h"
+#include "lldb/API/SBDeclaration.h"
+#include "lldb/API/SBFrame.h"
 #include "lldb/API/SBTarget.h"
 #include "lldb/API/SBType.h"
 #include "lldb/API/SBValue.h"
+#include "lldb/API/SBValueList.h"
+#include "lldb/lldb-defines.h"
 #include "lldb/lldb-enumerations.h"
 #include "llvm/ADT/APSInt.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/FormatVariadic.h"
 
 namespace lldb_eval {
 
+// Size of the memory reads done by the builtin functions scanning the buffers.
+static constexpr size_t kBulkReadSize = 64 * 1024;
+
+// Returns the element type "T" of the buffer "T*" (a pointer or an array).
+static TypeSP GetBufferElementType(TypeSP type) {
+  TypeSP element_type = type->IsPointerType() ? type->GetPointeeType()
+                                              : type->GetArrayElementType();
+  return element_type->GetUnqualifiedType();
+}
+
+// Reads `count` elements of `element_size` bytes at `addr` in large chunks
+// (every read can be a round trip to the remote debug server) and passes them
+// to `scan(data, begin, num)` until it returns false. The chunks stored
+// contiguously by the `provider` (e.g. a mapped snapshot) are scanned in place,
+// if they are aligned for the elements. If the buffer spans the unreadable
+// memory, the readable prefix is still scanned. `can_read(size)` is called
+// before reading every chunk, the scan stops if it returns false. Returns false
+// if the scan didn't stop before the unreadable memory or has been stopped by
+// `can_read`.
+static bool ScanBuffer(
+    MemoryProvider& provider, uint64_t addr, int64_t count,
+    size_t element_size,
+    llvm::function_ref<bool(const void* data, int64_t begin, size_t num)> scan,
+    llvm::function_ref<bool(size_t size)> can_read, lldb::SBError& error) {
+  size_t chunk_size = std::max<size_t>(kBulkReadSize / element_size, 1);
+  std::vector<uint8_t> chunk;
+
+  for (int64_t begin = 0; begin < count; begin += chunk_size) {
+    size_t num = std::min<size_t>(chunk_size, count - begin);
+    if (!can_read(num * element_size)) {
+      return false;
+    }
+    uint64_t chunk_addr = addr + begin * element_size;
+    const uint8_t* data =
+        provider.GetContiguous(chunk_addr, num * element_size);
+    if (data && reinterpret_cast<uintptr_t>(data) % element_size == 0) {
+      if (!scan(data, begin, num)) {
+        return true;
+      }
+      continue;
+    }
+
+    chunk.resize(chunk_size * element_size);
+    size_t read = provider.ReadMemory(chunk_addr, chunk.data(),
+                                      num * element_size, error);
+
+    size_t num_read = error.Fail() ? 0 : read / element_size;
+    // The chunk may span the unreadable memory. Read the rest of it element
+    // by element, the result may precede the unreadable part.
+    while (num_read < num) {
+      read = provider.ReadMemory(chunk_addr + num_read * element_size,
+                                 chunk.data() + num_read * element_size,
+                                 element_size, error);
+      if (error.Fail() || read != element_size) {
+        break;
+      }
+      ++num_read;
+    }
+
+    if (!scan(chunk.data(), begin, num_read)) {
+      return true;
+    }
+    if (num_read != num) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+static bool FindMinMaxInBuffer(MemoryProvider& provider, uint64_t addr,
+                               int64_t count, MinMax<T>* ret,
+                               llvm::function_ref<bool(size_t size)> can_read,
+                               lldb::SBError& error) {
+  bool has_value = false;
+  auto scan = [&](const void* data, int64_t, size_t num) {
+    if (num == 0) {
+      return true;
+    }
+    // The chunks are stored in the buffers allocated by `new` or scanned in
+    // place if they are aligned, so the data is suitably aligned for `T`.
+    MinMax<T> chunk = FindMinMax(static_cast<const T*>(data), num);
+    if (!has_value) {
+      *ret = chunk;
+      has_value = true;
+    } else {
+      ret->min = chunk.min < ret->min ? chunk.min : ret->min;
+      ret->max = chunk.max > ret->max ? chunk.max : ret->max;
+    }
+    return true;
+  };
+  return ScanBuffer(provider, addr, count, sizeof(T), scan, can_read, error);
+}
+
 template <typename T>
 bool Compare(BinaryOpKind kind, const T& l, const T& r) {
   switch (kind) {
@@ -164,7 +283,18 @@ static bool IsInvalidDivisionByMinusOne(Value lhs, Value rhs) {
   return lhs.GetValueAsSigned() + (1LLU << (bit_size - 1)) == 0;
 }
 
-static Value EvaluateMemberOf(Value value, const std::vector<uint32_t>& path) {
+// Returns the member of `value` at the given `path`. If `cache` is provided,
+// scalar members are read via the memory cache (it must not be used for the
+// bitfields).
+static Value GetMember(lldb::SBTarget target, Value value,
+                       const std::vector<uint32_t>& path, MemoryCache* cache) {
+  if (cache && value.IsPointer()) {
+    // Make sure the pointer is stored inline. Otherwise LLDB reads it from the
+    // process memory again when accessing the children.
+    value = CreateValueFromPointer(target, value.GetUInt64(),
+                                   ToSBType(value.type()));
+  }
+
   // The given `value` can be a pointer, but GetChildAtIndex works for pointers
   // too, so we don't need to dereference it explicitely. This also avoid having
   // an "ephemeral" parent Value, representing the dereferenced value.
@@ -187,6 +317,9 @@ static Value EvaluateMemberOf(Value value, const std::vector<uint32_t>& path) {
     member_val = member_val.Dereference();
   }
 
+  if (cache) {
+    return Value::CreateFromMemory(member_val, *cache);
+  }
   return Value(member_val);
 }
 
@@ -233,7 +366,7 @@ static Value CastBaseToDerivedType(lldb::SBTarget target, Value value,
                           : type->GetDereferencedType()->GetPointerType();
 
   uintptr_t addr = type->IsPointerType() ? value.GetUInt64()
-                                         : value.inner_value().GetLoadAddress();
+                                         : value.GetLoadAddress();
 
   value = CreateValueFromPointer(target, addr - offset, ToSBType(pointer_type));
 
@@ -248,11 +381,33 @@ static Value CastBaseToDerivedType(lldb::SBTarget target, Value value,
 
 Interpreter::Interpreter(lldb::SBTarget target,
                          std::shared_ptr<SourceManager> sm)
-    : target_(std::move(target)), sm_(std::move(sm)) {}
+    : target_(std::move(target)),
+      address_byte_size_(target_.GetAddressByteSize()),
+      sm_(std::move(sm)),
+      memory_cache_(target_.GetProcess()) {}
 
 Interpreter::Interpreter(lldb::SBTarget target,
                          std::shared_ptr<SourceManager> sm, Value scope)
-    : target_(std::move(target)), sm_(std::move(sm)), scope_(std::move(scope)) {
+    : target_(std::move(target)),
+      address_byte_size_(target_.GetAddressByteSize()),
+      sm_(std::move(sm)),
+      memory_cache_(target_.GetProcess()) {
+  SetScope(std::move(scope));
+}
+
+void Interpreter::SetFrame(lldb::SBFrame frame) {
+  frame_ = std::move(frame);
+  frame_index_.reset();
+  frame_values_.clear();
+}
+
+void Interpreter::SetFrameIndex(std::shared_ptr<FrameIndex> frame_index) {
+  frame_index_ = std::move(frame_index);
+  frame_values_.clear();
+}
+
+void Interpreter::SetScope(Value scope) {
+  scope_ = std::move(scope);
   // If `scope_` is a reference, dereference it. All operations on a reference
   // should be operations on the referent.
   if (scope_.IsValid() && scope_.type()->IsReferenceType()) {
@@ -260,13 +415,112 @@ Interpreter::Interpreter(lldb::SBTarget target,
   }
 }
 
-void Interpreter::SetContextVars(
-    std::unordered_map<std::string, Value> context_vars) {
+void Interpreter::SetKeepMemoryCache(bool keep_memory_cache) {
+  keep_memory_cache_ = keep_memory_cache;
+  memory_cache_.Clear();
+}
+
+void Interpreter::SetMemoryProvider(std::shared_ptr<MemoryProvider> provider) {
+  if (!provider) {
+    provider = std::make_shared<ProcessMemoryProvider>(target_.GetProcess());
+  }
+  memory_cache_.SetProvider(std::move(provider));
+}
+
+void Interpreter::PrefetchMemory(lldb::addr_t addr, size_t size) {
+  memory_cache_.Prefetch(addr, size);
+}
+
+void Interpreter::SetContextVars(std::vector<Value> context_vars) {
   context_vars_ = std::move(context_vars);
 }
 
+void Interpreter::SetSourceManager(std::shared_ptr<SourceManager> sm) {
+  sm_ = std::move(sm);
+}
+
+void Interpreter::SetDependencyTracker(DependencyTracker* tracker) {
+  tracker_ = tracker;
+}
+
+void Interpreter::SetInterrupt(const EvaluationInterrupt* interrupt) {
+  interrupt_ = interrupt;
+  has_limits_ = interrupt_ || budget_.max_node_evaluations ||
+                budget_.max_bytes_read || budget_.max_eval_time.count();
+}
+
+void Interpreter::SetBudget(EvaluationBudget budget) {
+  budget_ = budget;
+  // Updates `has_limits_`.
+  SetInterrupt(interrupt_);
+}
+
+void Interpreter::TrackInput(const Value& value) {
+  if (!tracker_ || value.is_inline()) {
+    return;
+  }
+  // Values located in the memory are tracked without creating lldb::SBValue.
+  lldb::addr_t addr = value.GetLoadAddress();
+  if (addr != LLDB_INVALID_ADDRESS) {
+    tracker_->AddMemory(addr, value.type()->GetByteSize());
+    return;
+  }
+  tracker_->AddValue(value.inner_value());
+}
+
+void Interpreter::StartBudget() {
+  nodes_evaluated_ = 0;
+  scan_bytes_read_ = 0;
+  cache_bytes_read_start_ = memory_cache_.bytes_read();
+  if (budget_.max_eval_time.count()) {
+    deadline_ = std::chrono::steady_clock::now() + budget_.max_eval_time;
+  }
+}
+
+bool Interpreter::CheckLimits(uint64_t num_nodes, uint64_t num_bytes,
+                              clang::SourceLocation loc) {
+  nodes_evaluated_ += num_nodes;
+  scan_bytes_read_ += num_bytes;
+
+  ErrorCode code = ErrorCode::kBudgetExceeded;
+  std::string reason;
+  uint64_t bytes_read = scan_bytes_read_ + memory_cache_.bytes_read() -
+                        cache_bytes_read_start_;
+  if (budget_.max_node_evaluations &&
+      nodes_evaluated_ > budget_.max_node_evaluations) {
+    reason = llvm::formatv("evaluation exceeded the limit of {0} nodes",
+                           budget_.max_node_evaluations);
+  } else if (budget_.max_bytes_read && bytes_read > budget_.max_bytes_read) {
+    reason = llvm::formatv("evaluation exceeded the limit of {0} bytes read",
+                           budget_.max_bytes_read);
+  } else if (budget_.max_eval_time.count() &&
+             std::chrono::steady_clock::now() >= deadline_) {
+    reason = "evaluation exceeded the time limit";
+  } else if (const char* interrupted = interrupt_ ? interrupt_->Check()
+                                                  : nullptr) {
+    code = ErrorCode::kCancelled;
+    reason = interrupted;
+  } else {
+    return true;
+  }
+
+  if (!error_) {
+    SetError(code, std::move(reason), loc);
+  }
+  return false;
+}
+
 Value Interpreter::Eval(const AstNode* tree, Error& error) {
+  TraceEvent trace("Eval");
   error_.Clear();
+  result_ = Value();
+  // The process memory may have changed since the last evaluation.
+  if (!keep_memory_cache_) {
+    memory_cache_.Clear();
+  }
+  if (has_limits_) {
+    StartBudget();
+  }
   // Evaluate an AST.
   EvalNode(tree);
   // Set the error.
@@ -275,7 +529,469 @@ Value Interpreter::Eval(const AstNode* tree, Error& error) {
   return result_;
 }
 
+Value Interpreter::Eval(const Bytecode& bytecode, Error& error) {
+  TraceEvent trace("EvalBytecode");
+  error_.Clear();
+  result_ = Value();
+  if (!keep_memory_cache_) {
+    memory_cache_.Clear();
+  }
+  if (has_limits_) {
+    StartBudget();
+  }
+
+  std::vector<Value> registers(bytecode.num_registers());
+  // The bytecode doesn't contain the constructs that require flow analysis
+  // (they're evaluated via `kEvalNode`), so the chain is always empty.
+  flow_analysis_chain_.push_back(nullptr);
+
+  const std::vector<Instruction>& instructions = bytecode.instructions();
+  bool failed = false;
+  size_t pc = 0;
+  while (pc < instructions.size()) {
+    const Instruction& inst = instructions[pc++];
+    const AstNode* node = inst.node;
+    result_ = Value();
+    // Nodes evaluated via `kEvalNode` are counted by `EvalNode()`.
+    if (has_limits_ && node && inst.op != OpCode::kEvalNode &&
+        !CheckLimits(1, 0, node->location())) {
+      failed = true;
+      break;
+    }
+
+    switch (inst.op) {
+      case OpCode::kEvalNode:
+        EvalNode(node);
+        break;
+      case OpCode::kCStyleCast:
+        EvaluateCStyleCast(static_cast<const CStyleCastNode*>(node),
+                           registers[inst.a]);
+        break;
+      case OpCode::kCxxStaticCast:
+        EvaluateCxxStaticCast(static_cast<const CxxStaticCastNode*>(node),
+                              registers[inst.a]);
+        break;
+      case OpCode::kCxxReinterpretCast:
+        EvaluateCxxReinterpretCast(
+            static_cast<const CxxReinterpretCastNode*>(node),
+            registers[inst.a]);
+        break;
+      case OpCode::kMemberOf:
+        EvaluateMemberOf(static_cast<const MemberOfNode*>(node),
+                         registers[inst.a]);
+        break;
+      case OpCode::kArraySubscript:
+        EvaluateArraySubscript(registers[inst.a], registers[inst.b]);
+        break;
+      case OpCode::kBinaryOp:
+        EvaluateBinaryOp(static_cast<const BinaryOpNode*>(node),
+                         registers[inst.a], registers[inst.b]);
+        break;
+      case OpCode::kUnaryOp:
+        EvaluateUnaryOp(static_cast<const UnaryOpNode*>(node),
+                        registers[inst.a]);
+        break;
+      case OpCode::kSmartPtrToPtrDecay:
+        EvaluateSmartPtrToPtrDecay(registers[inst.a]);
+        break;
+      case OpCode::kToBool:
+        result_ = CreateValueFromBool(target_, registers[inst.a].GetBool());
+        break;
+      case OpCode::kMove:
+        result_ = registers[inst.a];
+        break;
+      case OpCode::kJumpIf:
+        if (registers[inst.a].GetBool() == inst.flag) {
+          pc = inst.target;
+        }
+        continue;
+      case OpCode::kJump:
+        pc = inst.target;
+        continue;
+    }
+
+    if (!result_) {
+      // The error (if any) is already set.
+      failed = true;
+      break;
+    }
+    registers[inst.dst] = std::move(result_);
+  }
+
+  flow_analysis_chain_.pop_back();
+
+  error = error_;
+  if (failed) {
+    return Value();
+  }
+  result_ = registers[bytecode.result_register()];
+  return result_;
+}
+
+// Helpers of the scalar programs, the floating point values are held in the
+// registers by their bits.
+static float BitsToFloat(uint64_t bits) {
+  uint32_t v = static_cast<uint32_t>(bits);
+  float f;
+  memcpy(&f, &v, sizeof(f));
+  return f;
+}
+
+static double BitsToDouble(uint64_t bits) {
+  double d;
+  memcpy(&d, &bits, sizeof(d));
+  return d;
+}
+
+static uint64_t FloatToBits(float f) {
+  uint32_t v;
+  memcpy(&v, &f, sizeof(v));
+  return v;
+}
+
+static uint64_t DoubleToBits(double d) {
+  uint64_t v;
+  memcpy(&v, &d, sizeof(v));
+  return v;
+}
+
+// Reads the register holding a floating point value of `width` bytes. Floats
+// are promoted to doubles exactly.
+static double ReadFloat(uint64_t bits, uint8_t width) {
+  return width == 4 ? BitsToFloat(bits) : BitsToDouble(bits);
+}
+
+static uint64_t WriteFloat(double v, uint8_t width) {
+  return width == 4 ? FloatToBits(static_cast<float>(v)) : DoubleToBits(v);
+}
+
+template <typename T>
+static T EvaluateFloatBinary(BinaryOpKind kind, T l, T r) {
+  switch (kind) {
+    case BinaryOpKind::Add:
+      return l + r;
+    case BinaryOpKind::Sub:
+      return l - r;
+    case BinaryOpKind::Mul:
+      return l * r;
+    case BinaryOpKind::Div:
+      return l / r;
+    default:
+      assert(false && "invalid scalar program: invalid float operation");
+      return 0;
+  }
+}
+
+// Evaluates the integer operation on the operands extended to 64 bits. Returns
+// false if the operation is undefined behaviour (the interpreter reports it).
+static bool EvaluateIntBinary(const ScalarInstruction& inst, uint64_t l,
+                              uint64_t r, uint64_t& ret) {
+  int64_t sl = static_cast<int64_t>(l);
+  int64_t sr = static_cast<int64_t>(r);
+  switch (inst.binary_op) {
+    case BinaryOpKind::Add:
+      ret = l + r;
+      return true;
+    case BinaryOpKind::Sub:
+      ret = l - r;
+      return true;
+    case BinaryOpKind::Mul:
+      ret = l * r;
+      return true;
+    case BinaryOpKind::Div:
+    case BinaryOpKind::Rem:
+      if (r == 0) {
+        return false;
+      }
+      if (inst.is_signed) {
+        // The minimal value divided by -1 overflows.
+        if (sr == -1 && ExtendScalar(l, inst.width, false) ==
+                            uint64_t{1} << (inst.width * 8 - 1)) {
+          return false;
+        }
+        ret = static_cast<uint64_t>(inst.binary_op == BinaryOpKind::Div
+                                        ? sl / sr
+                                        : sl % sr);
+      } else {
+        ret = inst.binary_op == BinaryOpKind::Div ? l / r : l % r;
+      }
+      return true;
+    case BinaryOpKind::And:
+      ret = l & r;
+      return true;
+    case BinaryOpKind::Or:
+      ret = l | r;
+      return true;
+    case BinaryOpKind::Xor:
+      ret = l ^ r;
+      return true;
+    case BinaryOpKind::Shl:
+    case BinaryOpKind::Shr:
+      if ((inst.operand_signed && sr < 0) || r >= inst.width * 8u) {
+        return false;
+      }
+      if (inst.binary_op == BinaryOpKind::Shl) {
+        ret = l << r;
+      } else {
+        ret = inst.is_signed ? static_cast<uint64_t>(sl >> r) : l >> r;
+      }
+      return true;
+    default:
+      assert(false && "invalid scalar program: invalid integer operation");
+      return false;
+  }
+}
+
+// Converts the floating point value to an integer of `width` bytes, rounding
+// toward zero. Returns false if the value is out of the range of the integer
+// (or is NaN), such conversion is undefined behaviour.
+static bool FloatToInt(double v, uint8_t width, bool is_signed,
+                       uint64_t& ret) {
+  double bound = std::ldexp(1.0, width * 8 - (is_signed ? 1 : 0));
+  if (is_signed ? !(v >= -bound && v < bound) : !(v >= 0 && v < bound)) {
+    return false;
+  }
+  ret = is_signed ? static_cast<uint64_t>(static_cast<int64_t>(v))
+                  : static_cast<uint64_t>(v);
+  return true;
+}
+
+bool Interpreter::TryEval(const ScalarProgram& program, Value& result) {
+  uint64_t bits;
+  if (!EvalScalarProgram(program, bits)) {
+    return false;
+  }
+  if (program.result_is_address()) {
+    result_ = Value::CreateFromAddress(target_, bits, program.result_type(),
+                                       memory_cache_);
+  } else {
+    result_ = CreateValueFromAPInt(target_, llvm::APInt(64, bits),
+                                   ToSBType(program.result_type()));
+  }
+  result = result_;
+  return true;
+}
+
+bool Interpreter::TryEvalCondition(const ScalarProgram& program,
+                                   bool& result) {
+  uint64_t bits;
+  if (!EvalScalarProgram(program, bits)) {
+    return false;
+  }
+  TypeSP type = program.result_type();
+  if (program.result_is_address()) {
+    // The scalars are read via the memory cache.
+    result = Value::CreateFromAddress(target_, bits, type, memory_cache_)
+                 .GetBool();
+  } else if (type->IsFloat()) {
+    result = ReadFloat(bits, static_cast<uint8_t>(type->GetByteSize())) != 0;
+  } else {
+    result = bits != 0;
+  }
+  return true;
+}
+
+bool Interpreter::EvalScalarProgram(const ScalarProgram& program,
+                                    uint64_t& result) {
+  // The budget and the dependencies are accounted per node, only the
+  // interpreter does that.
+  if (has_limits_ || tracker_) {
+    return false;
+  }
+  error_.Clear();
+  result_ = Value();
+  if (!keep_memory_cache_) {
+    memory_cache_.Clear();
+  }
+
+  llvm::SmallVector<uint64_t, 16> registers(program.num_registers(), 0);
+  flow_analysis_chain_.push_back(nullptr);
+  bool ok = RunScalarProgram(program, registers);
+  flow_analysis_chain_.pop_back();
+  // The errors and the undefined behaviour are reported by the interpreter.
+  if (!ok || error_ || error_.ub_status() != UbStatus::kOk) {
+    error_.Clear();
+    result_ = Value();
+    return false;
+  }
+  result = registers[program.result_register()];
+  return true;
+}
+
+bool Interpreter::RunScalarProgram(const ScalarProgram& program,
+                                   llvm::MutableArrayRef<uint64_t> registers) {
+  const std::vector<ScalarInstruction>& instructions = program.instructions();
+  size_t pc = 0;
+  while (pc < instructions.size()) {
+    const ScalarInstruction& inst = instructions[pc++];
+    uint64_t a = registers[inst.a];
+    uint64_t b = registers[inst.b];
+    uint64_t& dst = registers[inst.dst];
+
+    switch (inst.op) {
+      case ScalarOp::kEvalValue: {
+        Value value = EvalNode(inst.node);
+        if (!value || error_ || error_.ub_status() != UbStatus::kOk) {
+          return false;
+        }
+        if (value.IsFloat()) {
+          dst = value.GetFloat().bitcastToAPInt().getZExtValue();
+        } else if (value.type()->IsBool()) {
+          dst = value.GetBool() ? 1 : 0;
+        } else {
+          llvm::APSInt v = value.GetInteger();
+          dst = (v.isSigned() ? v.sextOrTrunc(64) : v.zextOrTrunc(64))
+                    .getZExtValue();
+        }
+        break;
+      }
+      case ScalarOp::kEvalAddress: {
+        Value value = EvalNode(inst.node);
+        if (!value || error_ || error_.ub_status() != UbStatus::kOk) {
+          return false;
+        }
+        dst = value.GetLoadAddress();
+        if (dst == LLDB_INVALID_ADDRESS) {
+          return false;
+        }
+        break;
+      }
+      case ScalarOp::kConst:
+        dst = inst.imm;
+        break;
+      case ScalarOp::kLoad: {
+        uint64_t v = 0;
+        if (!memory_cache_.Read(a + inst.imm, &v, inst.width)) {
+          return false;
+        }
+        // Same as `Value::CreateFromAddress()`, bools are normalized.
+        dst = inst.flag ? (v != 0)
+                        : ExtendScalar(v, inst.width, inst.is_signed);
+        break;
+      }
+      case ScalarOp::kAddOffset:
+        dst = a + inst.imm;
+        break;
+      case ScalarOp::kPointerAdd:
+        // Same as the interpreter, the offset of the null pointer is reported.
+        if (a == 0 && b != 0) {
+          return false;
+        }
+        dst = ExtendScalar(a + b * inst.imm, inst.width, false);
+        break;
+      case ScalarOp::kIndex:
+        dst = ExtendScalar(a + b * inst.imm, inst.width, false);
+        break;
+      case ScalarOp::kPointerDiff: {
+        int64_t diff = static_cast<int64_t>(a - b);
+        if (static_cast<uint64_t>(diff) % inst.imm != 0 && diff < 0) {
+          return false;
+        }
+        diff /= static_cast<int64_t>(inst.imm);
+        dst = ExtendScalar(static_cast<uint64_t>(diff), inst.width, true);
+        break;
+      }
+      case ScalarOp::kIntBinary: {
+        uint64_t v;
+        if (!EvaluateIntBinary(inst, a, b, v)) {
+          return false;
+        }
+        dst = ExtendScalar(v, inst.width, inst.is_signed);
+        break;
+      }
+      case ScalarOp::kFloatBinary:
+        if (inst.width == 4) {
+          dst = FloatToBits(EvaluateFloatBinary(inst.binary_op, BitsToFloat(a),
+                                                BitsToFloat(b)));
+        } else {
+          dst = DoubleToBits(EvaluateFloatBinary(
+              inst.binary_op, BitsToDouble(a), BitsToDouble(b)));
+        }
+        break;
+      case ScalarOp::kIntCompare:
+        dst = inst.operand_signed
+                  ? Compare(inst.binary_op, static_cast<int64_t>(a),
+                            static_cast<int64_t>(b))
+                  : Compare(inst.binary_op, a, b);
+        break;
+      case ScalarOp::kFloatCompare:
+        dst = Compare(inst.binary_op, ReadFloat(a, inst.operand_width),
+                      ReadFloat(b, inst.operand_width));
+        break;
+      case ScalarOp::kPointerCompare: {
+        // Both operands are sign-extended (or truncated) to the pointer size,
+        // same as the interpreter does it.
+        uint32_t ptr_size = static_cast<uint32_t>(inst.imm);
+        auto to_ptr = [ptr_size](uint64_t v, uint8_t width) {
+          v = ExtendScalar(v, width, true);
+          return static_cast<int64_t>(ExtendScalar(v, ptr_size, true));
+        };
+        dst = Compare(inst.binary_op, to_ptr(a, inst.width),
+                      to_ptr(b, inst.operand_width));
+        break;
+      }
+      case ScalarOp::kIntNeg:
+        dst = ExtendScalar(0 - a, inst.width, inst.is_signed);
+        break;
+      case ScalarOp::kIntNot:
+        dst = ExtendScalar(~a, inst.width, inst.is_signed);
+        break;
+      case ScalarOp::kFloatNeg:
+        dst = a ^ (uint64_t{1} << (inst.width * 8 - 1));
+        break;
+      case ScalarOp::kIntToBool:
+        dst = (a != 0) != inst.flag;
+        break;
+      case ScalarOp::kFloatToBool:
+        dst = (ReadFloat(a, inst.operand_width) != 0) != inst.flag;
+        break;
+      case ScalarOp::kIntToInt:
+        dst = ExtendScalar(a, inst.width, inst.is_signed);
+        break;
+      case ScalarOp::kIntToFloat:
+        if (inst.width == 4) {
+          dst = FloatToBits(inst.operand_signed
+                                ? static_cast<float>(static_cast<int64_t>(a))
+                                : static_cast<float>(a));
+        } else {
+          dst = DoubleToBits(inst.operand_signed
+                                 ? static_cast<double>(static_cast<int64_t>(a))
+                                 : static_cast<double>(a));
+        }
+        break;
+      case ScalarOp::kFloatToInt: {
+        uint64_t v;
+        if (!FloatToInt(ReadFloat(a, inst.operand_width), inst.width,
+                        inst.is_signed, v)) {
+          return false;
+        }
+        dst = ExtendScalar(v, inst.width, inst.is_signed);
+        break;
+      }
+      case ScalarOp::kFloatToFloat:
+        dst = WriteFloat(ReadFloat(a, inst.operand_width), inst.width);
+        break;
+      case ScalarOp::kMove:
+        dst = a;
+        break;
+      case ScalarOp::kJumpIf:
+        if ((a != 0) == inst.flag) {
+          pc = inst.imm;
+        }
+        break;
+      case ScalarOp::kJump:
+        pc = inst.imm;
+        break;
+    }
+  }
+  return true;
+}
+
 Value Interpreter::EvalNode(const AstNode* node, FlowAnalysis* flow) {
+  if (has_limits_ && !CheckLimits(1, 0, node->location())) {
+    result_ = Value();
+    return result_;
+  }
   // Set up the evaluation context for the current node.
   flow_analysis_chain_.push_back(flow);
   // Traverse an AST pointed by the `node`.
@@ -290,7 +1006,7 @@ Value Interpreter::EvalNode(const AstNode* node, FlowAnalysis* flow) {
 void Interpreter::SetError(ErrorCode code, std::string error,
                            clang::SourceLocation loc) {
   assert(!error_ && "interpreter can error only once");
-  error_.Set(code, FormatDiagnostics(sm_->GetSourceManager(), error, loc));
+  error_.SetDiagnostic(code, std::move(error), loc, sm_);
 }
 
 void Interpreter::Visit(const ErrorNode*) {
@@ -331,7 +1047,7 @@ void Interpreter::Visit(const IdentifierNode* node) {
 
     case Kind::kContextArg:
       assert(node->is_context_var() && "invalid ast: context var expected");
-      val = ResolveContextVar(node->name());
+      val = ResolveContextVar(identifier.context_slot());
       if (!val.IsValid()) {
         SetError(
             ErrorCode::kUndeclaredIdentifier,
@@ -353,6 +1069,32 @@ void Interpreter::Visit(const IdentifierNode* node) {
       }
       break;
 
+    case Kind::kLocalVariable:
+    case Kind::kInstanceVariable:
+    case Kind::kRegister:
+    case Kind::kFrameVariable:
+      val = ResolveFrameValue(identifier);
+      if (!val.IsValid()) {
+        SetError(
+            ErrorCode::kUndeclaredIdentifier,
+            llvm::formatv("use of undeclared identifier '{0}'", node->name()),
+            node->location());
+        result_ = Value();
+        return;
+      }
+      if (!CompareTypes(identifier.GetType(), val.type())) {
+        SetError(ErrorCode::kInvalidOperandType,
+                 llvm::formatv("unexpected type of identifier '{0}' (expected "
+                               "{1}, got {2})",
+                               node->name(),
+                               TypeDescription(identifier.GetType()),
+                               TypeDescription(val.type())),
+                 node->location());
+        result_ = Value();
+        return;
+      }
+      break;
+
     case Kind::kMemberPath:
       if (!scope_.IsValid()) {
         SetError(
@@ -364,7 +1106,9 @@ void Interpreter::Visit(const IdentifierNode* node) {
         result_ = Value();
         return;
       }
-      val = EvaluateMemberOf(scope_, identifier.path());
+      // The type of the member isn't known here (it can be a bitfield), so
+      // the memory cache can't be used.
+      val = GetMember(target_, scope_, identifier.path(), /*cache*/ nullptr);
       break;
 
     case Kind::kThisKeyword:
@@ -385,6 +1129,7 @@ void Interpreter::Visit(const IdentifierNode* node) {
 
   assert(val.IsValid() && "identifier doesn't resolve to a valid value");
   // TODO: Check that `val` type is matching the node's result type.
+  TrackInput(val);
 
   // If value is a reference, dereference it to get to the underlying type. All
   // operations on a reference should be actually operations on the referent.
@@ -400,6 +1145,7 @@ void Interpreter::Visit(const IdentifierNode* node) {
     if (val_type != deref_type) {
       val = Value(val.inner_value().Cast(deref_type));
     }
+    TrackInput(val);
   }
 
   result_ = val;
@@ -435,90 +1181,235 @@ void Interpreter::Visit(const BuiltinFunctionCallNode* node) {
     return;
   }
 
-  if (node->name() == "__findnonnull") {
-    assert(node->arguments().size() == 2 &&
-           "invalid ast: expected exactly two arguments to `__findnonnull`");
+  if (node->name() == "__findnonnull" || node->name() == "__findvalue" ||
+      node->name() == "__count" || node->name() == "__min" ||
+      node->name() == "__max") {
+    EvaluateBufferFunction(node);
+    return;
+  }
 
-    auto& arg1 = node->arguments()[0];
-    Value val1 = EvalNode(arg1.get());
-    if (!val1) {
-      return;
-    }
+  assert(false && "invalid ast: unknown builtin function");
+  result_ = Value();
+}
 
-    // Resolve data address for the first argument.
-    uint64_t addr;
+void Interpreter::EvaluateBufferFunction(const BuiltinFunctionCallNode* node) {
+  llvm::StringRef name = node->name();
+  size_t num_args = name == "__findvalue" ? 3 : 2;
+  assert(node->arguments().size() == num_args &&
+         "invalid ast: wrong number of arguments to the buffer function");
 
-    if (val1.IsPointer()) {
-      addr = val1.inner_value().GetValueAsUnsigned();
-    } else if (val1.type()->IsArrayType()) {
-      addr = val1.inner_value().GetLoadAddress();
-    } else {
-      SetError(ErrorCode::kInvalidOperandType,
-               llvm::formatv("no known conversion from '{0}' to 'T*' for 1st "
-                             "argument of __findnonnull()",
-                             val1.type()->GetName()),
-               arg1->location());
-      return;
-    }
+  auto& arg1 = node->arguments()[0];
+  Value val1 = EvalNode(arg1.get());
+  if (!val1) {
+    return;
+  }
 
-    auto& arg2 = node->arguments()[1];
-    Value val2 = EvalNode(arg2.get());
-    if (!val2) {
-      return;
-    }
-    int64_t size = val2.inner_value().GetValueAsSigned();
-
-    if (size < 0 || size > 100000000) {
-      SetError(ErrorCode::kInvalidOperandType,
-               llvm::formatv(
-                   "passing in a buffer size ('{0}') that is negative or in "
-                   "excess of 100 million to __findnonnull() is not allowed.",
-                   size),
-               arg2->location());
-      return;
+  // Resolve data address for the first argument.
+  uint64_t addr;
+
+  if (val1.IsPointer()) {
+    addr = val1.GetUInt64();
+  } else if (val1.type()->IsArrayType()) {
+    addr = val1.GetLoadAddress();
+  } else {
+    SetError(ErrorCode::kInvalidOperandType,
+             llvm::formatv("no known conversion from '{0}' to 'T*' for 1st "
+                           "argument of {1}()",
+                           val1.type()->GetName(), name),
+             arg1->location());
+    return;
+  }
+
+  auto& arg2 = node->arguments()[1];
+  Value val2 = EvalNode(arg2.get());
+  if (!val2) {
+    return;
+  }
+  int64_t size = val2.GetValueAsSigned();
+
+  if (size < 0 || size > 100000000) {
+    SetError(ErrorCode::kInvalidOperandType,
+             llvm::formatv(
+                 "passing in a buffer size ('{0}') that is negative or in "
+                 "excess of 100 million to {1}() is not allowed.",
+                 size, name),
+             arg2->location());
+    return;
+  }
+
+  MemoryProvider& provider = *memory_cache_.provider();
+  lldb::SBError error;
+  bool ok = true;
+
+  auto can_read = [this, node](size_t size) {
+    return !has_limits_ || CheckLimits(0, size, node->location());
+  };
+
+  auto create_int = [this](int64_t value) {
+    int ret = static_cast<int>(value);
+    return CreateValueFromBytes(target_, &ret, lldb::eBasicTypeInt);
+  };
+
+  if (name == "__findnonnull") {
+    // The elements are always pointers, regardless of the buffer type.
+    size_t ptr_size = address_byte_size_;
+    if (tracker_) {
+      tracker_->AddMemory(addr, size * ptr_size);
     }
+    int64_t ret = -1;
+    ok = ScanBuffer(
+        provider, addr, size, ptr_size,
+        [&](const void* data, int64_t begin, size_t num) {
+          int64_t found = FindFirstNonZero(data, num, ptr_size);
+          ret = found >= 0 ? begin + found : -1;
+          return found < 0;
+        },
+        can_read, error);
+    result_ = create_int(ret);
 
-    lldb::SBProcess process = target_.GetProcess();
-    size_t ptr_size = target_.GetAddressByteSize();
+  } else {
+    TypeSP element_type = GetBufferElementType(val1.type());
+    TypeSP canonical = element_type->GetCanonicalType();
+    lldb::BasicType basic_type = canonical->GetBasicType();
+    bool is_float = basic_type == lldb::eBasicTypeFloat;
+    bool is_double = basic_type == lldb::eBasicTypeDouble;
+    size_t element_size = canonical->GetByteSize();
+    if (tracker_) {
+      tracker_->AddMemory(addr, size * element_size);
+    }
 
-    uint64_t memory = 0;
-    lldb::SBError error;
+    if (name == "__findvalue") {
+      Value val3 = EvalNode(node->arguments()[2].get());
+      if (!val3) {
+        return;
+      }
+      // The value is converted to `T` by the parser. Store it the same way it
+      // is stored in memory (the target is assumed to have the same byte order
+      // as the host).
+      float float_value = 0;
+      double double_value = 0;
+      uint64_t int_value = 0;
+      if (is_float) {
+        float_value = val3.GetFloat().convertToFloat();
+      } else if (is_double) {
+        double_value = val3.GetFloat().convertToDouble();
+      } else {
+        int_value = val3.GetUInt64();
+      }
 
-    for (int i = 0; i < size; ++i) {
-      size_t read =
-          process.ReadMemory(addr + i * ptr_size, &memory, ptr_size, error);
+      int64_t ret = -1;
+      ok = ScanBuffer(
+          provider, addr, size, element_size,
+          [&](const void* data, int64_t begin, size_t num) {
+            int64_t found;
+            if (is_float) {
+              found = FindFirstEqual(static_cast<const float*>(data), num,
+                                     float_value);
+            } else if (is_double) {
+              found = FindFirstEqual(static_cast<const double*>(data), num,
+                                     double_value);
+            } else {
+              found = FindFirstEqual(data, num, element_size, &int_value);
+            }
+            ret = found >= 0 ? begin + found : -1;
+            return found < 0;
+          },
+          can_read, error);
+      result_ = create_int(ret);
+
+    } else if (name == "__count") {
+      int64_t ret = 0;
+      ok = ScanBuffer(
+          provider, addr, size, element_size,
+          [&](const void* data, int64_t, size_t num) {
+            if (is_float) {
+              ret += CountNonZero(static_cast<const float*>(data), num);
+            } else if (is_double) {
+              ret += CountNonZero(static_cast<const double*>(data), num);
+            } else {
+              ret += CountNonZero(data, num, element_size);
+            }
+            return true;
+          },
+          can_read, error);
+      result_ = create_int(ret);
 
-      if (error.Fail() || read != ptr_size) {
-        SetError(ErrorCode::kUnknown,
-                 llvm::formatv("error calling __findnonnull(): {0}",
-                               error.GetCString() ? error.GetCString()
-                                                  : "cannot read memory"),
-                 node->location());
+    } else {
+      if (size == 0) {
+        SetError(ErrorCode::kInvalidOperandType,
+                 llvm::formatv("passing in an empty buffer to {0}() is not "
+                               "allowed.",
+                               name),
+                 arg2->location());
         return;
       }
 
-      if (memory != 0) {
-        result_ = CreateValueFromBytes(target_, &i, lldb::eBasicTypeInt);
+      bool is_min = name == "__min";
+      lldb::SBType result_type = ToSBType(element_type);
+      auto find_min_max = [&](auto* tag) {
+        using T = std::remove_pointer_t<decltype(tag)>;
+        MinMax<T> ret{};
+        if (!FindMinMaxInBuffer(provider, addr, size, &ret, can_read, error)) {
+          return false;
+        }
+        T value = is_min ? ret.min : ret.max;
+        result_ = CreateValueFromBytes(target_, &value, result_type);
+        return true;
+      };
+
+      bool is_signed = canonical->IsSigned();
+      if (is_float) {
+        ok = find_min_max(static_cast<float*>(nullptr));
+      } else if (is_double) {
+        ok = find_min_max(static_cast<double*>(nullptr));
+      } else if (element_size == 1) {
+        ok = is_signed ? find_min_max(static_cast<int8_t*>(nullptr))
+                       : find_min_max(static_cast<uint8_t*>(nullptr));
+      } else if (element_size == 2) {
+        ok = is_signed ? find_min_max(static_cast<int16_t*>(nullptr))
+                       : find_min_max(static_cast<uint16_t*>(nullptr));
+      } else if (element_size == 4) {
+        ok = is_signed ? find_min_max(static_cast<int32_t*>(nullptr))
+                       : find_min_max(static_cast<uint32_t*>(nullptr));
+      } else if (element_size == 8) {
+        ok = is_signed ? find_min_max(static_cast<int64_t*>(nullptr))
+                       : find_min_max(static_cast<uint64_t*>(nullptr));
+      } else {
+        SetError(ErrorCode::kInvalidOperandType,
+                 llvm::formatv("{0}() is not supported for the elements of "
+                               "type '{1}'",
+                               name, element_type->GetName()),
+                 arg1->location());
         return;
       }
     }
-
-    int ret = -1;
-    result_ = CreateValueFromBytes(target_, &ret, lldb::eBasicTypeInt);
-    return;
   }
 
-  assert(false && "invalid ast: unknown builtin function");
-  result_ = Value();
+  if (!ok) {
+    result_ = Value();
+    // The scan has been stopped by the budget or the interrupt.
+    if (error_) {
+      return;
+    }
+    SetError(ErrorCode::kUnknown,
+             llvm::formatv("error calling {0}(): {1}", name,
+                           error.GetCString() ? error.GetCString()
+                                              : "cannot read memory"),
+             node->location());
+  }
 }
 
 void Interpreter::Visit(const CStyleCastNode* node) {
-  // Get the type and the value we need to cast.
-  auto type = node->type();
+  // Get the value we need to cast.
   auto rhs = EvalNode(node->rhs());
   if (!rhs) {
     return;
   }
+  EvaluateCStyleCast(node, rhs);
+}
+
+void Interpreter::EvaluateCStyleCast(const CStyleCastNode* node, Value rhs) {
+  auto type = node->type();
 
   switch (node->kind()) {
     case CStyleCastKind::kArithmetic: {
@@ -555,7 +1446,7 @@ void Interpreter::Visit(const CStyleCastNode* node) {
       assert(type->IsPointerType() &&
              "invalid ast: target type should be a pointer.");
       uint64_t addr = rhs.type()->IsArrayType()
-                          ? rhs.inner_value().GetLoadAddress()
+                          ? rhs.GetLoadAddress()
                           : rhs.GetUInt64();
       result_ = CreateValueFromPointer(target_, addr, ToSBType(type));
       return;
@@ -578,12 +1469,17 @@ void Interpreter::Visit(const CStyleCastNode* node) {
 }
 
 void Interpreter::Visit(const CxxStaticCastNode* node) {
-  // Get the type and the value we need to cast.
-  auto type = node->type();
+  // Get the value we need to cast.
   auto rhs = EvalNode(node->rhs());
   if (!rhs) {
     return;
   }
+  EvaluateCxxStaticCast(node, rhs);
+}
+
+void Interpreter::EvaluateCxxStaticCast(const CxxStaticCastNode* node,
+                                        Value rhs) {
+  auto type = node->type();
 
   switch (node->kind()) {
     case CxxStaticCastKind::kNoOp: {
@@ -626,7 +1522,7 @@ void Interpreter::Visit(const CxxStaticCastNode* node) {
              "invalid ast: target type should be a pointer.");
 
       uint64_t addr = rhs.type()->IsArrayType()
-                          ? rhs.inner_value().GetLoadAddress()
+                          ? rhs.GetLoadAddress()
                           : rhs.GetUInt64();
       result_ = CreateValueFromPointer(target_, addr, ToSBType(type));
       return;
@@ -638,7 +1534,7 @@ void Interpreter::Visit(const CxxStaticCastNode* node) {
     }
 
     case CxxStaticCastKind::kDerivedToBase: {
-      result_ = CastDerivedToBaseType(target_, rhs, type, node->idx());
+      result_ = CastDerivedToBase(rhs, type, node->idx());
       return;
     }
 
@@ -650,12 +1546,17 @@ void Interpreter::Visit(const CxxStaticCastNode* node) {
 }
 
 void Interpreter::Visit(const CxxReinterpretCastNode* node) {
-  // Get the type and the value we need to cast.
-  auto type = node->type();
+  // Get the value we need to cast.
   auto rhs = EvalNode(node->rhs());
   if (!rhs) {
     return;
   }
+  EvaluateCxxReinterpretCast(node, rhs);
+}
+
+void Interpreter::EvaluateCxxReinterpretCast(
+    const CxxReinterpretCastNode* node, Value rhs) {
+  auto type = node->type();
 
   if (type->IsInteger()) {
     if (rhs.IsPointer() || rhs.IsNullPtrType()) {
@@ -676,7 +1577,7 @@ void Interpreter::Visit(const CxxReinterpretCastNode* node) {
             rhs.type()->IsArrayType()) &&
            "invalid ast: unexpected operand to reinterpret_cast");
     uint64_t addr = rhs.type()->IsArrayType()
-                        ? rhs.inner_value().GetLoadAddress()
+                        ? rhs.GetLoadAddress()
                         : rhs.GetUInt64();
     result_ = CreateValueFromPointer(target_, addr, ToSBType(type));
   } else if (type->IsReferenceType()) {
@@ -704,7 +1605,30 @@ void Interpreter::Visit(const MemberOfNode* node) {
     return;
   }
 
-  result_ = EvaluateMemberOf(lhs, node->member_index());
+  EvaluateMemberOf(node, lhs);
+}
+
+void Interpreter::EvaluateMemberOf(const MemberOfNode* node, Value lhs) {
+  // If the offset of the member is known, compute its address directly rather
+  // than creating lldb::SBValue for every element of the path.
+  if (node->member_offset()) {
+    lldb::addr_t base_addr =
+        node->is_arrow() ? lhs.GetUInt64() : lhs.GetLoadAddress();
+    // If the object isn't in the process memory (e.g. it's in a register),
+    // fallback to lldb::SBValue.
+    if (base_addr != LLDB_INVALID_ADDRESS) {
+      result_ = Value::CreateFromAddress(
+          target_, base_addr + *node->member_offset(), node->result_type(),
+          memory_cache_);
+      TrackInput(result_);
+      return;
+    }
+  }
+
+  // Bitfields are read via lldb::SBValue, it takes care of the bit offsets.
+  MemoryCache* cache = node->is_bitfield() ? nullptr : &memory_cache_;
+  result_ = GetMember(target_, lhs, node->member_index(), cache);
+  TrackInput(result_);
 }
 
 void Interpreter::Visit(const ArraySubscriptNode* node) {
@@ -716,7 +1640,10 @@ void Interpreter::Visit(const ArraySubscriptNode* node) {
   if (!index) {
     return;
   }
+  EvaluateArraySubscript(base, index);
+}
 
+void Interpreter::EvaluateArraySubscript(Value base, Value index) {
   assert(base.type()->IsPointerType() &&
          "array subscript: base must be a pointer");
   assert(index.type()->IsIntegerOrUnscopedEnum() &&
@@ -737,7 +1664,7 @@ void Interpreter::Visit(const ArraySubscriptNode* node) {
     flow_analysis()->DiscardAddressOf();
     result_ = value;
   } else {
-    result_ = value.Dereference();
+    result_ = DereferencePointer(value);
   }
 }
 
@@ -782,6 +1709,30 @@ void Interpreter::Visit(const BinaryOpNode* node) {
   if (!rhs) {
     return;
   }
+  EvaluateBinaryOp(node, lhs, rhs);
+}
+
+void Interpreter::PrepareWrite() {
+  // The write goes to the process memory or to a register, the cached contents
+  // can't be used anymore. Nothing is read via the caches until the write is
+  // done.
+  memory_cache_.Clear();
+  frame_values_.clear();
+  if (frame_index_) {
+    frame_index_->DropRegisterContents();
+  }
+  // Evaluations with side effects can't be skipped.
+  if (tracker_) {
+    tracker_->SetUntrackable();
+  }
+}
+
+void Interpreter::EvaluateBinaryOp(const BinaryOpNode* node, Value lhs,
+                                   Value rhs) {
+  if (node->kind() == BinaryOpKind::Assign ||
+      binary_op_kind_is_comp_assign(node->kind())) {
+    PrepareWrite();
+  }
 
   switch (node->kind()) {
     case BinaryOpKind::Add:
@@ -870,20 +1821,32 @@ void Interpreter::Visit(const UnaryOpNode* node) {
     return;
   }
 
+  if (node->kind() == UnaryOpKind::AddrOf) {
+    // If the address-of operation wasn't cancelled during the evaluation of
+    // RHS (e.g. because of the address-of-a-dereference elision), apply it
+    // here.
+    if (rhs_flow.AddressOfIsPending()) {
+      result_ = rhs.AddressOf();
+    } else {
+      result_ = rhs;
+    }
+    return;
+  }
+  EvaluateUnaryOp(node, rhs);
+}
+
+void Interpreter::EvaluateUnaryOp(const UnaryOpNode* node, Value rhs) {
+  if (node->kind() == UnaryOpKind::PreInc ||
+      node->kind() == UnaryOpKind::PreDec ||
+      node->kind() == UnaryOpKind::PostInc ||
+      node->kind() == UnaryOpKind::PostDec) {
+    PrepareWrite();
+  }
+
   switch (node->kind()) {
     case UnaryOpKind::Deref:
       result_ = EvaluateDereference(rhs);
       return;
-    case UnaryOpKind::AddrOf:
-      // If the address-of operation wasn't cancelled during the evaluation of
-      // RHS (e.g. because of the address-of-a-dereference elision), apply it
-      // here.
-      if (rhs_flow.AddressOfIsPending()) {
-        result_ = rhs.AddressOf();
-      } else {
-        result_ = rhs;
-      }
-      return;
     case UnaryOpKind::Plus:
       result_ = rhs;
       return;
@@ -945,16 +1908,42 @@ void Interpreter::Visit(const SmartPtrToPtrDecay* node) {
   if (!ptr) {
     return;
   }
+  EvaluateSmartPtrToPtrDecay(ptr);
+}
 
+void Interpreter::EvaluateSmartPtrToPtrDecay(Value ptr) {
   assert(ptr.type()->IsSmartPtrType() &&
          "invalid ast: must be a smart pointer");
 
+  // Fast path, read the raw pointer at its offset in the smart pointer. The
+  // offset is known for the layouts of libc++ and libstdc++, see
+  // `TargetCache::GetSmartPtrOffset()`.
+  lldb::addr_t addr = ptr.GetLoadAddress();
+  if (addr != LLDB_INVALID_ADDRESS && !ptr.type()->IsReferenceType()) {
+    if (!target_cache_) {
+      target_cache_ = TargetCache::Get(target_);
+    }
+    if (auto offset = target_cache_->GetSmartPtrOffset(ToSBType(ptr.type()))) {
+      TypeSP pointer_type =
+          ptr.type()->GetSmartPtrPointeeType()->GetPointerType();
+      Value raw_ptr = Value::CreateFromAddress(target_, addr + *offset,
+                                               pointer_type, memory_cache_);
+      TrackInput(raw_ptr);
+      result_ = CreateValueFromPointer(target_, raw_ptr.GetUInt64(),
+                                       ToSBType(pointer_type));
+      return;
+    }
+  }
+
   // Prefer synthetic value because we need LLDB machinery to "dereference" the
   // pointer for us. This is usually the default, but if the value was obtained
   // as a field of some other object, it will inherit the value from parent.
   lldb::SBValue ptr_value = ptr.inner_value();
   ptr_value.SetPreferSyntheticValue(true);
   ptr_value = ptr_value.GetChildAtIndex(0);
+  if (tracker_) {
+    tracker_->AddValue(ptr_value);
+  }
 
   lldb::addr_t base_addr = ptr_value.GetValueAsUnsigned();
   lldb::SBType pointer_type = ptr_value.GetType();
@@ -982,7 +1971,7 @@ Value Interpreter::EvaluateComparison(BinaryOpKind kind, Value lhs, Value rhs) {
   }
 
   // Must be pointer/integer and/or nullptr comparison.
-  size_t ptr_size = target_.GetAddressByteSize() * 8;
+  size_t ptr_size = address_byte_size_ * 8;
 
   bool ret =
       Compare(kind, llvm::APSInt(lhs.GetInteger().sextOrTrunc(ptr_size), true),
@@ -1005,7 +1994,15 @@ Value Interpreter::EvaluateDereference(Value rhs) {
     return value;
   }
 
-  return value.Dereference();
+  return DereferencePointer(value);
+}
+
+Value Interpreter::DereferencePointer(Value ptr) {
+  Value ret = Value::CreateFromAddress(target_, ptr.GetUInt64(),
+                                       ptr.type()->GetPointeeType(),
+                                       memory_cache_);
+  TrackInput(ret);
+  return ret;
 }
 
 Value Interpreter::EvaluateUnaryMinus(Value rhs) {
@@ -1394,9 +2391,149 @@ Value Interpreter::PointerAdd(Value lhs, int64_t offset) {
   return CreateValueFromPointer(target_, addr, ToSBType(lhs.type()));
 }
 
-Value Interpreter::ResolveContextVar(const std::string& name) const {
-  auto it = context_vars_.find(name);
-  return it != context_vars_.end() ? it->second : Value();
+Value Interpreter::CastDerivedToBase(Value value, TypeSP type,
+                                     const std::vector<uint32_t>& idx) {
+  // Fast path, the address of the base is computed from the path cached per
+  // target (see `TargetCache::GetBaseClassPath()`) instead of walking the
+  // children of the value in LLDB.
+  bool is_pointer = type->IsPointerType();
+  TypeSP base =
+      is_pointer ? type->GetPointeeType() : type->GetDereferencedType();
+  TypeSP derived = is_pointer
+                       ? value.type()->GetCanonicalType()->GetPointeeType()
+                       : value.type();
+  lldb::addr_t addr = is_pointer ? value.GetUInt64() : value.GetLoadAddress();
+  if (addr == LLDB_INVALID_ADDRESS || value.type()->IsReferenceType()) {
+    return CastDerivedToBaseType(target_, value, type, idx);
+  }
+
+  if (!target_cache_) {
+    target_cache_ = TargetCache::Get(target_);
+  }
+  auto path = target_cache_->GetBaseClassPath(derived, base);
+  if (!path) {
+    return CastDerivedToBaseType(target_, value, type, idx);
+  }
+  auto base_value = [&](lldb::addr_t base_addr) {
+    if (is_pointer) {
+      return CreateValueFromPointer(target_, base_addr, ToSBType(type));
+    }
+    return Value::CreateFromAddress(target_, base_addr, base, memory_cache_);
+  };
+  lldb::addr_t owner_addr = addr + path->offset;
+  if (!path->virtual_base) {
+    return base_value(owner_addr);
+  }
+
+  // The offset of the virtual base depends on the most derived type of the
+  // object, which is identified by the vtable of the subobject inheriting the
+  // base. The offset is found by LLDB once per vtable.
+  const TargetFacts& facts = target_cache_->facts();
+  uint64_t vtable_addr = 0;
+  if (!facts.itanium_cxx_abi || facts.byte_order != lldb::eByteOrderLittle ||
+      !memory_cache_.Read(owner_addr, &vtable_addr, address_byte_size_) ||
+      vtable_addr == 0) {
+    return CastDerivedToBaseType(target_, value, type, idx);
+  }
+  if (tracker_) {
+    tracker_->AddMemory(owner_addr, address_byte_size_);
+  }
+  lldb::SBProcess process = target_.GetProcess();
+  if (auto offset =
+          target_cache_->LookupVirtualBaseOffset(process, vtable_addr, base)) {
+    return base_value(owner_addr + *offset);
+  }
+
+  Value ret = CastDerivedToBaseType(target_, value, type, idx);
+  lldb::addr_t base_addr = is_pointer ? ret.GetUInt64() : ret.GetLoadAddress();
+  if (base_addr != LLDB_INVALID_ADDRESS) {
+    auto offset = static_cast<int64_t>(base_addr - owner_addr);
+    target_cache_->InsertVirtualBaseOffset(process, vtable_addr, base, offset);
+  }
+  return ret;
+}
+
+Value Interpreter::ResolveContextVar(uint32_t slot) const {
+  return slot < context_vars_.size() ? context_vars_[slot] : Value();
+}
+
+// Looks for the variable of the frame with the given name and declaration.
+static lldb::SBValue FindDeclaredVariable(
+    lldb::SBFrame frame, const std::string& name,
+    const lldb::SBDeclaration& declaration) {
+  // Usually the name isn't shadowed, the innermost variable is the one.
+  lldb::SBValue value = frame.FindVariable(name.c_str());
+  if (!value || value.GetDeclaration() == declaration) {
+    return value;
+  }
+  lldb::SBValueList variables =
+      frame.GetVariables(/*arguments*/ true, /*locals*/ true,
+                         /*statics*/ true, /*in_scope_only*/ true);
+  for (uint32_t i = 0; i < variables.GetSize(); ++i) {
+    lldb::SBValue variable = variables.GetValueAtIndex(i);
+    const char* variable_name = variable.GetName();
+    if (variable_name && name == variable_name &&
+        variable.GetDeclaration() == declaration) {
+      return variable;
+    }
+  }
+  return lldb::SBValue();
+}
+
+Value Interpreter::ResolveFrameValue(
+    const Context::IdentifierInfo& identifier) {
+  auto key = std::make_pair(identifier.kind(), identifier.name());
+  auto it = frame_values_.find(key);
+  if (it != frame_values_.end()) {
+    return it->second;
+  }
+
+  PhaseTimer timer(&EvaluationStats::identifier_lookup_ns);
+  const char* name = identifier.name().c_str();
+  lldb::SBValue value;
+  std::optional<llvm::APInt> register_contents;
+  switch (identifier.kind()) {
+    using Kind = Context::IdentifierInfo::Kind;
+    case Kind::kLocalVariable:
+      value = frame_index_ ? frame_index_->FindVariable(name)
+                           : frame_.FindVariable(name);
+      break;
+    case Kind::kInstanceVariable:
+      value = frame_index_
+                  ? frame_index_->FindMember(name)
+                  : frame_.FindVariable("this").GetChildMemberWithName(name);
+      break;
+    case Kind::kRegister:
+      if (frame_index_) {
+        FrameIndex::Register reg = frame_index_->FindRegister(name);
+        value = std::move(reg.value);
+        register_contents = std::move(reg.contents);
+      } else {
+        value = frame_.FindRegister(name).GetStaticValue();
+        if (value) {
+          register_contents = ReadRegisterContents(value);
+        }
+      }
+      break;
+    case Kind::kFrameVariable:
+      value = FindDeclaredVariable(frame_, identifier.name(),
+                                   identifier.declaration());
+      break;
+    default:
+      assert(false && "invalid ast: not a frame identifier");
+  }
+
+  // Force static value, the same as the parser does. The contents of the
+  // scalar registers are known, so the arithmetic on them doesn't call into
+  // lldb::SBValue.
+  Value ret;
+  if (register_contents) {
+    ret = Value::CreateFromRegister(value, std::move(*register_contents));
+  } else if (value) {
+    ret = Value(value.GetStaticValue());
+  }
+  frame_values_.emplace(std::move(key), ret);
+  return ret;
 }
 
 }  // namespace lldb_eval
@@ -17,19 +17,32 @@
 #ifndef LLDB_EVAL_EVAL_H_
 #define LLDB_EVAL_EVAL_H_
 
+#include <atomic>
+#include <chrono>
+#include <map>
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "clang/Basic/TokenKinds.h"
 #include "lldb-eval/ast.h"
+#include "lldb-eval/bytecode.h"
 #include "lldb-eval/context.h"
 #include "lldb-eval/defines.h"
+#include "lldb-eval/dependency_tracker.h"
+#include "lldb-eval/frame_index.h"
+#include "lldb-eval/memory_cache.h"
+#include "lldb-eval/memory_provider.h"
+#include "lldb-eval/scalar_program.h"
+#include "lldb-eval/target_cache.h"
 #include "lldb-eval/value.h"
 #include "lldb/API/SBFrame.h"
 #include "lldb/API/SBProcess.h"
 #include "lldb/API/SBTarget.h"
 #include "lldb/API/SBThread.h"
 #include "lldb/API/SBValue.h"
+#include "llvm/ADT/ArrayRef.h"
 
 namespace lldb_eval {
 
@@ -45,6 +58,46 @@ class FlowAnalysis {
   bool address_of_is_pending_;
 };
 
+// Stops the evaluation when it's cancelled from another thread or when its
+// deadline passes, see `Interpreter::SetInterrupt()`. Thread-safe.
+class EvaluationInterrupt {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit EvaluationInterrupt(
+      Clock::time_point deadline = Clock::time_point::max())
+      : deadline_(deadline) {}
+
+  void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+  // Returns the reason the evaluation must stop, or null if it can continue.
+  const char* Check() const {
+    if (cancelled_.load(std::memory_order_relaxed)) {
+      return "evaluation cancelled";
+    }
+    if (deadline_ != Clock::time_point::max() && Clock::now() >= deadline_) {
+      return "evaluation deadline exceeded";
+    }
+    return nullptr;
+  }
+
+ private:
+  std::atomic<bool> cancelled_{false};
+  Clock::time_point deadline_;
+};
+
+// Limits of a single evaluation, zero means no limit. See `Options` for the
+// details.
+struct EvaluationBudget {
+  uint64_t max_node_evaluations = 0;
+  uint64_t max_bytes_read = 0;
+  std::chrono::nanoseconds max_eval_time{0};
+};
+
+// Evaluates the AST (or its bytecode). The interpreter holds all the mutable
+// state of the evaluation (the result, the error, the memory cache, etc), while
+// the evaluated tree is never modified. Interpreter isn't thread-safe, but the
+// same tree can be evaluated concurrently by multiple interpreters.
 class Interpreter : Visitor {
  public:
   Interpreter(lldb::SBTarget target, std::shared_ptr<SourceManager> sm);
@@ -54,7 +107,75 @@ class Interpreter : Visitor {
  public:
   Value Eval(const AstNode* tree, Error& error);
 
-  void SetContextVars(std::unordered_map<std::string, Value> context_vars);
+  // Evaluates the expression compiled to bytecode. The result is the same as
+  // evaluating the original tree.
+  Value Eval(const Bytecode& bytecode, Error& error);
+
+  // Evaluates the expression lowered to a scalar program. Returns false if the
+  // program bails out or can't be used by this interpreter (e.g. the budget is
+  // set), the expression must be evaluated by `Eval()` then. Otherwise the
+  // result is the same as evaluating the original tree.
+  bool TryEval(const ScalarProgram& program, Value& result);
+
+  // Same as above, but the result is converted to bool (i.e. the expression is
+  // a condition) without creating the result value.
+  bool TryEvalCondition(const ScalarProgram& program, bool& result);
+
+  lldb::SBTarget target() const { return target_; }
+
+  // Sets the values of the context variables, the i-th value is bound to the
+  // context argument in slot i (see `Context::SetContextArgs()`). Invalid
+  // values denote unbound slots.
+  void SetContextVars(std::vector<Value> context_vars);
+
+  // Sets the frame the identifiers of the frame (local variables, members of
+  // `this` and registers) are resolved in. Expressions compiled in a frame can
+  // be evaluated in any frame where these identifiers have the same types (e.g.
+  // in the same function at a later stop).
+  void SetFrame(lldb::SBFrame frame);
+
+  // Sets the index of the frame passed to `SetFrame()`. The registers are then
+  // looked up in the index and their contents are read once per stop (see
+  // `FrameIndex::FindRegister()`). Reset by `SetFrame()`.
+  void SetFrameIndex(std::shared_ptr<FrameIndex> frame_index);
+
+  // Replaces the scope of the evaluated expressions. Allows re-using the
+  // interpreter for evaluating the same expression against multiple values.
+  void SetScope(Value scope);
+
+  // If set, the memory cache is shared by the subsequent evaluations instead of
+  // being cleared at the start of each one. The caller guarantees the process
+  // memory doesn't change between the evaluations (writes done by the
+  // expressions themselves are accounted for).
+  void SetKeepMemoryCache(bool keep_memory_cache);
+
+  // Replaces the source of the memory read by the interpreter (the process of
+  // the target by default, also if `provider` is null) and clears the memory
+  // cache. The values LLDB reads itself (e.g. the variables in the registers)
+  // and the writes done by the expressions still go through the process.
+  void SetMemoryProvider(std::shared_ptr<MemoryProvider> provider);
+
+  // Reads the given memory range into the memory cache in advance. Only useful
+  // if the memory cache is kept between the evaluations.
+  void PrefetchMemory(lldb::addr_t addr, size_t size);
+
+  // Replaces the source of the evaluated expressions (used for formatting the
+  // diagnostics). Allows re-using the interpreter for multiple expressions.
+  void SetSourceManager(std::shared_ptr<SourceManager> sm);
+
+  // If set, the inputs read by the subsequent evaluations (memory ranges and
+  // values) are recorded in `tracker`. The tracker isn't cleared between the
+  // evaluations.
+  void SetDependencyTracker(DependencyTracker* tracker);
+
+  // If set, the subsequent evaluations fail with `ErrorCode::kCancelled` once
+  // `interrupt` is triggered. It is checked before evaluating every node and
+  // between the chunks of the buffer scans. Must outlive the evaluations.
+  void SetInterrupt(const EvaluationInterrupt* interrupt);
+
+  // Sets the limits of the subsequent evaluations. Every evaluation exceeding
+  // them fails with `ErrorCode::kBudgetExceeded`.
+  void SetBudget(EvaluationBudget budget);
 
  private:
   void SetError(ErrorCode error_code, std::string error,
@@ -77,9 +198,34 @@ class Interpreter : Visitor {
 
   Value EvalNode(const AstNode* node, FlowAnalysis* flow = nullptr);
 
+  // Runs `program` and returns the bits of the result (see
+  // `ScalarProgram::result_is_address()`). Returns false if it bails out.
+  bool EvalScalarProgram(const ScalarProgram& program, uint64_t& result);
+  // Runs the instructions of `program`. Returns false if it bails out.
+  bool RunScalarProgram(const ScalarProgram& program,
+                        llvm::MutableArrayRef<uint64_t> registers);
+
+  // Evaluate the node given the values of its operands. These set `result_`
+  // and are shared by the tree-walking and the bytecode interpreters.
+  void EvaluateCStyleCast(const CStyleCastNode* node, Value rhs);
+  void EvaluateCxxStaticCast(const CxxStaticCastNode* node, Value rhs);
+  void EvaluateCxxReinterpretCast(const CxxReinterpretCastNode* node,
+                                  Value rhs);
+  void EvaluateMemberOf(const MemberOfNode* node, Value lhs);
+  void EvaluateArraySubscript(Value base, Value index);
+  void EvaluateBinaryOp(const BinaryOpNode* node, Value lhs, Value rhs);
+  void EvaluateUnaryOp(const UnaryOpNode* node, Value rhs);
+  void EvaluateSmartPtrToPtrDecay(Value ptr);
+
+  // Evaluates the builtin functions, which scan the buffer given by the first
+  // two arguments `(T* ptr, long long buffer_size)`.
+  void EvaluateBufferFunction(const BuiltinFunctionCallNode* node);
+
   Value EvaluateComparison(BinaryOpKind kind, Value lhs, Value rhs);
 
   Value EvaluateDereference(Value rhs);
+  // Dereferences the pointer, reading the result via the memory cache.
+  Value DereferencePointer(Value ptr);
 
   Value EvaluateUnaryMinus(Value rhs);
   Value EvaluateUnaryNegation(Value rhs);
@@ -105,14 +251,38 @@ class Interpreter : Visitor {
   Value EvaluateBinaryShiftAssign(BinaryOpKind kind, Value lhs, Value rhs,
                                   TypeSP comp_assign_type);
 
+  // Records the value as an input of the evaluation, if the dependencies are
+  // tracked. Values computed by the interpreter (e.g. literals) are ignored.
+  void TrackInput(const Value& value);
+
+  // Resets the usage of the budget at the start of an evaluation.
+  void StartBudget();
+
+  // Adds `num_nodes` evaluated nodes and `num_bytes` read by a buffer scan to
+  // the usage of the budget, and checks the budget and the interrupt. Returns
+  // false (and sets the error) if the evaluation must stop. Only called if
+  // `has_limits_` is set.
+  bool CheckLimits(uint64_t num_nodes, uint64_t num_bytes,
+                   clang::SourceLocation loc);
+
   Value PointerAdd(Value lhs, int64_t offset);
-  Value ResolveContextVar(const std::string& name) const;
+  // Casts the pointer to (or the lvalue of) a derived class to its base `type`
+  // via the base classes `idx`.
+  Value CastDerivedToBase(Value value, TypeSP type,
+                          const std::vector<uint32_t>& idx);
+  Value ResolveContextVar(uint32_t slot) const;
+  Value ResolveFrameValue(const Context::IdentifierInfo& identifier);
+  // Drops the cached contents of the memory and the registers before the
+  // expression writes to them (assignments, increments and decrements).
+  void PrepareWrite();
 
   FlowAnalysis* flow_analysis() { return flow_analysis_chain_.back(); }
 
  private:
   // Used by the interpreter to create objects, perform casts, etc.
   lldb::SBTarget target_;
+  // Size of the pointers of the target, queried once per interpreter.
+  uint32_t address_byte_size_;
 
   std::shared_ptr<SourceManager> sm_;
 
@@ -126,12 +296,44 @@ class Interpreter : Visitor {
   // available, the caller/user is supposed to check.
   std::vector<FlowAnalysis*> flow_analysis_chain_;
 
-  std::unordered_map<std::string, Value> context_vars_;
+  std::vector<Value> context_vars_;
+
+  lldb::SBFrame frame_;
+  // Optional, see `SetFrameIndex()`.
+  std::shared_ptr<FrameIndex> frame_index_;
+  // Identifiers of the frame resolved in `frame_`, by their kind and name.
+  std::map<std::pair<Context::IdentifierInfo::Kind, std::string>, Value>
+      frame_values_;
 
   Value result_;
 
   Value scope_;
 
+  // Cache of the target, used for the layouts of the smart pointers and the
+  // class hierarchies. Fetched on the first use.
+  std::shared_ptr<TargetCache> target_cache_;
+
+  // Cache of the process memory, valid during one evaluation (or multiple, see
+  // `SetKeepMemoryCache()`).
+  MemoryCache memory_cache_;
+  bool keep_memory_cache_ = false;
+
+  // Optional, see `SetDependencyTracker()`.
+  DependencyTracker* tracker_ = nullptr;
+
+  // Optional, see `SetInterrupt()`.
+  const EvaluationInterrupt* interrupt_ = nullptr;
+
+  // See `SetBudget()`. `has_limits_` is set if the budget or the interrupt is
+  // set, so that the unlimited evaluations skip the checks.
+  EvaluationBudget budget_;
+  bool has_limits_ = false;
+  // Usage of the budget by the current evaluation.
+  uint64_t nodes_evaluated_ = 0;
+  uint64_t scan_bytes_read_ = 0;
+  uint64_t cache_bytes_read_start_ = 0;
+  std::chrono::steady_clock::time_point deadline_;
+
   Error error_;
 };
 
@@ -18,23 +18,52 @@
 #include <errno.h>  // for `program_invocation_name`
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <new>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "benchmark/benchmark.h"
 #include "lldb-eval/api.h"
 #include "lldb-eval/context.h"
+#include "lldb-eval/eval.h"
 #include "lldb-eval/parser.h"
 #include "lldb-eval/runner.h"
+#include "lldb-eval/type.h"
 #include "lldb/API/SBDebugger.h"
 #include "lldb/API/SBFrame.h"
 #include "lldb/API/SBProcess.h"
 #include "lldb/API/SBTarget.h"
 #include "lldb/API/SBThread.h"
+#include "lldb/API/SBValue.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/FormatVariadic.h"
 #include "tools/cpp/runfiles/runfiles.h"
 
 using bazel::tools::cpp::runfiles::Runfiles;
 
+// Number of the heap allocations made by the whole program, for the benchmarks
+// reporting the allocations per iteration.
+static std::atomic<uint64_t> num_allocations{0};
+
+void* operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size > 0 ? size : 1);
+  if (!ptr) {
+    std::abort();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
 class BM : public benchmark::Fixture {
  public:
   void SetUp(::benchmark::State&) override {
@@ -132,9 +161,322 @@ BENCHMARK_F(BM, ParseInteger)(benchmark::State& state) {
   }
 }
 
+// Evaluates one compiled expression from multiple threads at once, each thread
+// uses its own scope value.
+BENCHMARK_DEFINE_F(BM, CompiledExprConcurrent)(benchmark::State& state) {
+  constexpr size_t kEvaluationsPerThread = 100;
+  size_t num_threads = static_cast<size_t>(state.range(0));
+
+  lldb::SBValue points = frame.FindVariable("points");
+  std::vector<lldb::SBValue> scopes;
+  for (size_t t = 0; t < num_threads; ++t) {
+    scopes.push_back(points.GetChildAtIndex(t % points.GetNumChildren()));
+  }
+
+  lldb::SBError error;
+  auto expr = lldb_eval::CompileExpression(
+      points.GetTarget(), scopes[0].GetType(), "x * y + 1", error);
+  if (error.Fail()) {
+    state.SkipWithError("Failed to compile the expression!");
+    return;
+  }
+
+  for (auto _ : state) {
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t] {
+        for (size_t i = 0; i < kEvaluationsPerThread; ++i) {
+          lldb::SBError error;
+          lldb_eval::EvaluateExpression(scopes[t], expr, error);
+          if (error.Fail()) {
+            failed = true;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    if (failed) {
+      state.SkipWithError("Failed to evaluate the expression!");
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * num_threads *
+                          kEvaluationsPerThread);
+}
+BENCHMARK_REGISTER_F(BM, CompiledExprConcurrent)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->UseRealTime();
+
+// Expressions measured separately by the phase of the evaluation. The benchmark
+// binary defines thousands of types and global variables (see
+// testdata/benchmark_types.cc), so the lookups search through the debug
+// information of a realistic size.
+struct BenchmarkExpression {
+  const char* label;
+  const char* expr;
+};
+
+constexpr BenchmarkExpression kExpressions[] = {
+    {"local", "points[1].x + arr[2]"},
+    {"member_chain", "head->next->next->next->next->next->next->value"},
+    {"global", "global_counter + ns2999::global.value"},
+    {"static_member", "ns::inner::Config::instances"},
+    {"qualified_type", "sizeof(ns1999::Type) + (int)(ns2500::Kind)1"},
+    {"hierarchy_cast", "static_cast<Derived*>(base_ptr)->d"},
+    {"smart_ptr", "point_ptr->x + (*point_ptr).y"},
+};
+
+constexpr int kNumExpressions =
+    static_cast<int>(sizeof(kExpressions) / sizeof(kExpressions[0]));
+
+// Parsing only, including the identifier and type lookups.
+BENCHMARK_DEFINE_F(BM, Parse)(benchmark::State& state) {
+  const BenchmarkExpression& expr = kExpressions[state.range(0)];
+  state.SetLabel(expr.label);
+
+  for (auto _ : state) {
+    auto context = lldb_eval::Context::Create(
+        lldb_eval::SourceManager::Create(expr.expr), frame);
+    lldb_eval::Error err;
+    lldb_eval::Parser(context).Run(err);
+
+    if (err) {
+      state.SkipWithError("Failed to parse the expression!");
+    }
+  }
+}
+BENCHMARK_REGISTER_F(BM, Parse)->DenseRange(0, kNumExpressions - 1);
+
+// Evaluation only, the expression is parsed once.
+BENCHMARK_DEFINE_F(BM, Eval)(benchmark::State& state) {
+  const BenchmarkExpression& expr = kExpressions[state.range(0)];
+  state.SetLabel(expr.label);
+
+  auto source = lldb_eval::SourceManager::Create(expr.expr);
+  lldb_eval::Error err;
+  auto tree =
+      lldb_eval::Parser(lldb_eval::Context::Create(source, frame)).Run(err);
+  if (err) {
+    state.SkipWithError("Failed to parse the expression!");
+    return;
+  }
+
+  for (auto _ : state) {
+    lldb_eval::Interpreter eval(process.GetTarget(), source);
+    eval.SetFrame(frame);
+    eval.Eval(tree.get(), err);
+
+    if (err) {
+      state.SkipWithError("Failed to evaluate the expression!");
+    }
+  }
+}
+BENCHMARK_REGISTER_F(BM, Eval)->DenseRange(0, kNumExpressions - 1);
+
+// Parsing and evaluation via the public API.
+BENCHMARK_DEFINE_F(BM, Total)(benchmark::State& state) {
+  const BenchmarkExpression& expr = kExpressions[state.range(0)];
+  state.SetLabel(expr.label);
+
+  for (auto _ : state) {
+    lldb::SBError error;
+    lldb_eval::EvaluateExpression(frame, expr.expr, error);
+
+    if (error.Fail()) {
+      state.SkipWithError("Failed to evaluate the expression!");
+    }
+  }
+}
+BENCHMARK_REGISTER_F(BM, Total)->DenseRange(0, kNumExpressions - 1);
+
+// Compiles the expression once and evaluates it against every element of an
+// array, e.g. for the columns of an array view.
+BENCHMARK_F(BM, CompiledExprReuse)(benchmark::State& state) {
+  lldb::SBValue points = frame.FindVariable("points");
+  uint32_t num_points = points.GetNumChildren();
+
+  lldb::SBError error;
+  auto expr = lldb_eval::CompileExpression(
+      points.GetTarget(), points.GetChildAtIndex(0).GetType(), "x * x + y * y",
+      error);
+  if (error.Fail()) {
+    state.SkipWithError("Failed to compile the expression!");
+    return;
+  }
+
+  for (auto _ : state) {
+    for (uint32_t i = 0; i < num_points; ++i) {
+      lldb_eval::EvaluateExpression(points.GetChildAtIndex(i), expr, error);
+
+      if (error.Fail()) {
+        state.SkipWithError("Failed to evaluate the expression!");
+      }
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * num_points);
+}
+
+// Compiled expression using a context variable, which is bound by name (arg 0)
+// or by the slot index (arg 1).
+BENCHMARK_DEFINE_F(BM, ContextVariableBinding)(benchmark::State& state) {
+  bool bind_by_slot = state.range(0) != 0;
+  state.SetLabel(bind_by_slot ? "slot" : "name");
+
+  lldb::SBValue scope = frame.FindVariable("points").GetChildAtIndex(0);
+  lldb::SBValue counter = frame.FindVariable("global_counter");
+
+  std::vector<lldb_eval::ContextArgument> args = {
+      {"$counter", counter.GetType()}};
+  lldb_eval::Options opts;
+  opts.context_args = {args.data(), args.size()};
+
+  lldb::SBError error;
+  auto expr = lldb_eval::CompileExpression(
+      scope.GetTarget(), scope.GetType(), "x + y * $counter", opts, error);
+  if (error.Fail()) {
+    state.SkipWithError("Failed to compile the expression!");
+    return;
+  }
+
+  std::vector<lldb_eval::ContextVariable> vars = {{"$counter", counter}};
+  std::vector<lldb::SBValue> values = {counter};
+
+  for (auto _ : state) {
+    if (bind_by_slot) {
+      lldb_eval::EvaluateBoundExpression(scope, expr,
+                                         {values.data(), values.size()}, error);
+    } else {
+      lldb_eval::EvaluateExpression(scope, expr, {vars.data(), vars.size()},
+                                    error);
+    }
+
+    if (error.Fail()) {
+      state.SkipWithError("Failed to evaluate the expression!");
+    }
+  }
+}
+BENCHMARK_REGISTER_F(BM, ContextVariableBinding)->Arg(0)->Arg(1);
+
+// Lookup of the already resolved identifiers (local variable, global variable
+// and context variable). Reports the heap allocations per lookup.
+BENCHMARK_F(BM, IdentifierLookupAllocations)(benchmark::State& state) {
+  lldb::SBValue counter = frame.FindVariable("global_counter");
+  auto context = lldb_eval::Context::Create(
+      lldb_eval::SourceManager::Create("points"), frame);
+  context->SetContextArgs(
+      {{"$counter", lldb_eval::LLDBType::CreateSP(counter.GetType())}});
+
+  const std::string names[] = {"points", "global_counter", "$counter"};
+  for (const auto& name : names) {
+    if (!context->LookupIdentifier(name)) {
+      state.SkipWithError("Failed to look up the identifier!");
+      return;
+    }
+  }
+
+  uint64_t allocations = 0;
+  for (auto _ : state) {
+    uint64_t before = num_allocations.load(std::memory_order_relaxed);
+    for (const auto& name : names) {
+      benchmark::DoNotOptimize(context->LookupIdentifier(name));
+    }
+    allocations += num_allocations.load(std::memory_order_relaxed) - before;
+  }
+  state.counters["allocs_per_lookup"] = benchmark::Counter(
+      static_cast<double>(allocations) / std::size(names),
+      benchmark::Counter::kAvgIterations);
+}
+
+// Expressions found slow by the fuzzer (see `--perf` in tools/fuzzer/main.cc).
+// Lines starting with '#' are comments.
+static std::vector<std::string> ReadPerfCorpus(const std::string& path) {
+  std::vector<std::string> exprs;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!line.empty() && line[0] != '#') {
+      exprs.push_back(line);
+    }
+  }
+  return exprs;
+}
+
+// The corpus is evaluated in fuzzer_binary. The process is launched on the
+// first use and shared by all the corpus benchmarks.
+class PerfCorpusProcess {
+ public:
+  explicit PerfCorpusProcess(Runfiles* runfiles) : runfiles_(runfiles) {}
+
+  ~PerfCorpusProcess() {
+    if (process_) {
+      process_.Destroy();
+      lldb::SBDebugger::Destroy(debugger_);
+    }
+  }
+
+  lldb::SBFrame GetFrame() {
+    if (!process_) {
+      auto binary_path =
+          runfiles_->Rlocation("lldb_eval/testdata/fuzzer_binary");
+      auto source_path =
+          runfiles_->Rlocation("lldb_eval/testdata/fuzzer_binary.cc");
+      debugger_ = lldb::SBDebugger::Create(false);
+      process_ = lldb_eval::LaunchTestProgram(debugger_, source_path,
+                                              binary_path, "// BREAK HERE");
+    }
+    return process_.GetSelectedThread().GetSelectedFrame();
+  }
+
+ private:
+  Runfiles* runfiles_;
+  lldb::SBDebugger debugger_;
+  lldb::SBProcess process_;
+};
+
 int main(int argc, char** argv) {
   lldb::SBDebugger::Initialize();
 
+  std::unique_ptr<Runfiles> runfiles(Runfiles::Create(argv[0]));
+  lldb_eval::SetupLLDBServerEnv(*runfiles);
+
+  // The default corpus can be replaced by `--perf_corpus=<path>`.
+  std::string corpus_path =
+      runfiles->Rlocation("lldb_eval/testdata/fuzzer_perf_corpus.txt");
+  for (int i = 1; i < argc; ++i) {
+    llvm::StringRef arg = argv[i];
+    if (arg.consume_front("--perf_corpus=")) {
+      corpus_path = arg.str();
+      std::copy(argv + i + 1, argv + argc, argv + i);
+      --argc;
+      break;
+    }
+  }
+
+  std::vector<std::string> corpus = ReadPerfCorpus(corpus_path);
+  PerfCorpusProcess corpus_process(runfiles.get());
+  for (size_t i = 0; i < corpus.size(); ++i) {
+    const std::string& expr = corpus[i];
+    // Slow error paths are interesting too, the errors are not fatal.
+    ::benchmark::RegisterBenchmark(
+        ("PerfCorpus/" + std::to_string(i)).c_str(),
+        [&corpus_process, &expr](benchmark::State& state) {
+          state.SetLabel(expr);
+          lldb::SBFrame frame = corpus_process.GetFrame();
+          for (auto _ : state) {
+            lldb::SBError error;
+            lldb_eval::EvaluateExpression(frame, expr.c_str(), error);
+          }
+        });
+  }
+
   // Same as BENCHMARK_MAIN()
   // clang-format off
   ::benchmark::Initialize(&argc, argv);
@@ -13,17 +13,27 @@
 // limitations under the License.
 
 #ifndef __EMSCRIPTEN__
+#include <chrono>
+#include <cstdio>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 #include "lldb-eval/api.h"
 #include "lldb-eval/ast.h"
 #include "lldb-eval/context.h"
+#include "lldb-eval/eval.h"
+#include "lldb-eval/memory_provider.h"
+#include "lldb-eval/parser.h"
 #include "lldb-eval/runner.h"
+#include "lldb-eval/target_cache.h"
 #include "lldb-eval/traits.h"
 #include "lldb/API/SBDebugger.h"
 #include "lldb/API/SBFrame.h"
@@ -381,13 +391,23 @@ Matcher<EvalResult> IsError(std::string value) {
 #ifndef __EMSCRIPTEN__
 class EvalTest : public ::testing::Test {
  protected:
+  // The debugger and the target are shared by the test cases, so the debug
+  // information of the test binary is loaded only once. Each test case stops
+  // at its own breakpoint and may modify the debuggee, so the program is
+  // re-launched for every one of them.
   static void SetUpTestSuite() {
     runfiles_ = Runfiles::CreateForTest();
     lldb_eval::SetupLLDBServerEnv(*runfiles_);
     lldb::SBDebugger::Initialize();
+
+    auto binary_path = runfiles_->Rlocation("lldb_eval/testdata/test_binary");
+    debugger_ = lldb::SBDebugger::Create(false);
+    target_ = debugger_.CreateTarget(binary_path.c_str());
   }
 
   static void TearDownTestSuite() {
+    target_ = lldb::SBTarget();
+    lldb::SBDebugger::Destroy(debugger_);
     lldb::SBDebugger::Terminate();
     delete runfiles_;
     runfiles_ = nullptr;
@@ -398,26 +418,32 @@ class EvalTest : public ::testing::Test {
         ::testing::UnitTest::GetInstance()->current_test_info()->name();
     std::string break_line = "// BREAK(" + test_name + ")";
 
-    auto binary_path = runfiles_->Rlocation("lldb_eval/testdata/test_binary");
     auto source_path =
         runfiles_->Rlocation("lldb_eval/testdata/test_binary.cc");
 
-    debugger_ = lldb::SBDebugger::Create(false);
-    process_ = lldb_eval::LaunchTestProgram(debugger_, source_path, binary_path,
-                                            break_line);
+    process_ = lldb_eval::LaunchTestProgram(target_, source_path, break_line);
     frame_ = process_.GetSelectedThread().GetSelectedFrame();
   }
 
-  void TearDown() {
-    process_.Destroy();
-    lldb::SBDebugger::Destroy(debugger_);
-  }
+  void TearDown() { process_.Destroy(); }
 
   EvalResult Eval(const std::string& expr) {
     return EvaluatorHelper(frame_, compare_with_lldb_, allow_side_effects_)
         .Eval(expr);
   }
 
+  // Evaluates `expr` in the frame with the given options (e.g. with one of the
+  // optional passes enabled).
+  EvalResult Eval(const std::string& expr, const lldb_eval::Options& opts) {
+    EvalResult ret;
+    ret.lldb_eval_value = lldb_eval::EvaluateExpression(
+        frame_, expr.c_str(), opts, ret.lldb_eval_error);
+    if (compare_with_lldb_) {
+      ret.lldb_value = frame_.EvaluateExpression(expr.c_str());
+    }
+    return ret;
+  }
+
   EvalResult EvalWithContext(
       const std::string& expr,
       const std::unordered_map<std::string, lldb::SBValue>& vars) {
@@ -460,7 +486,6 @@ class EvalTest : public ::testing::Test {
   }
 
  protected:
-  lldb::SBDebugger debugger_;
   lldb::SBProcess process_;
   lldb::SBFrame frame_;
 
@@ -474,9 +499,13 @@ class EvalTest : public ::testing::Test {
   std::unordered_map<std::string, lldb::SBValue> vars_;
 
   static Runfiles* runfiles_;
+  static lldb::SBDebugger debugger_;
+  static lldb::SBTarget target_;
 };
 
 Runfiles* EvalTest::runfiles_ = nullptr;
+lldb::SBDebugger EvalTest::debugger_;
+lldb::SBTarget EvalTest::target_;
 
 TEST_F(EvalTest, TestSymbols) {
   EXPECT_GT(frame_.GetModule().GetNumSymbols(), 0)
@@ -612,6 +641,58 @@ TEST_F(EvalTest, TestZeroDivision) {
   EXPECT_THAT(Eval("1 % uint_zero + 1"), IsEqual("1"));
 }
 
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestBuiltinLexer) {
+  lldb_eval::Options opts;
+  opts.use_builtin_lexer = true;
+
+  EXPECT_THAT(Eval("1 + 2*3", opts), IsEqual("7"));
+  EXPECT_THAT(Eval("x + 1 /* comment */", opts), IsEqual("3"));
+  EXPECT_THAT(Eval("c << 1 >= uc", opts), IsEqual("true"));
+  EXPECT_THAT(Eval("*p != 0 and a", opts), IsEqual("true"));
+  EXPECT_THAT(Eval("(long long)1.5e+1 + 1'000", opts), IsEqual("1015"));
+  EXPECT_THAT(Eval("0x10 + 010 + 0b10", opts), IsEqual("26"));
+  EXPECT_THAT(Eval("'A' + u'B' + U'C' + L'D'", opts), IsEqual("266"));
+  EXPECT_THAT(Eval("static_cast<unsigned char>(x)", opts), IsOk());
+
+  EXPECT_THAT(Eval("1 @ 2", opts),
+              IsError("expected 'eof', got: <'@' (unknown)>"));
+}
+#endif
+
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestConstantFolding) {
+  lldb_eval::Options opts;
+  opts.fold_constants = true;
+
+  EXPECT_THAT(Eval("sizeof(int) * 4 + 1", opts), IsEqual("17"));
+  EXPECT_THAT(Eval("(long long)1.1 + (double)(char)2", opts), IsEqual("3"));
+  EXPECT_THAT(Eval("1 < 2 ? 1.5f : 2.5f", opts), IsEqual("1.5"));
+  EXPECT_THAT(Eval("!(1 == 2) && ~0", opts), IsEqual("true"));
+  EXPECT_THAT(Eval("(unsigned char)-1 + x", opts), IsEqual("257"));
+  EXPECT_THAT(Eval("x * (2 + 3)", opts), IsEqual("10"));
+}
+#endif
+
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestBatchEvaluation) {
+  const char* exprs[] = {"x + 1", "x * x", "(long)x", "foo", "(long)x + r"};
+  std::vector<lldb_eval::EvaluationResult> results;
+  lldb_eval::EvaluateExpressions(frame_, {exprs, std::size(exprs)},
+                                 lldb_eval::Options{}, results);
+
+  ASSERT_EQ(results.size(), std::size(exprs));
+  auto result = [&](size_t i) {
+    return EvalResult{results[i].error, results[i].value};
+  };
+  EXPECT_THAT(result(0), IsEqual("3"));
+  EXPECT_THAT(result(1), IsEqual("4"));
+  EXPECT_THAT(result(2), IsEqual("2"));
+  EXPECT_THAT(result(3), IsError("use of undeclared identifier 'foo'"));
+  EXPECT_THAT(result(4), IsEqual("4"));
+}
+#endif
+
 TEST_F(EvalTest, TestBitwiseOperators) {
   EXPECT_THAT(Eval("~(-1)"), IsEqual("0"));
   EXPECT_THAT(Eval("~~0"), IsEqual("0"));
@@ -1062,6 +1143,670 @@ TEST_F(EvalTest, TestMemberOf) {
   // EXPECT_THAT(Eval("&(*(Sx*)0).y"), IsEqual("0x0000000000000010"));
 }
 
+TEST_F(EvalTest, TestMemoryCache) {
+  // Members and array elements are read via the memory cache.
+  EXPECT_THAT(Eval("sp->x + sarr[1].x + sarr[0].y"), IsEqual("4"));
+  EXPECT_THAT(Eval("sarr[0].x * sarr[1].y + (sarr + 1)->x"), IsEqual("16"));
+
+  // Writes invalidate the cache.
+  this->compare_with_lldb_ = false;
+  this->allow_side_effects_ = true;
+  EXPECT_THAT(Eval("sp->x = 7"), IsEqual("7"));
+  EXPECT_THAT(Eval("s.x + sp->x"), IsEqual("14"));
+  EXPECT_THAT(Eval("sarr[0].x += sarr[0].x"), IsEqual("10"));
+  EXPECT_THAT(Eval("++sarr[1].x + sarr[1].x"), IsEqual("4"));
+  EXPECT_THAT(Eval("sarr[0].x + sarr[1].x"), IsEqual("12"));
+
+  EXPECT_THAT(Eval("sp->x = 1"), IsEqual("1"));
+  EXPECT_THAT(Eval("sarr[0].x = 5"), IsEqual("5"));
+  EXPECT_THAT(Eval("sarr[1].x = 1"), IsEqual("1"));
+}
+
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestBytecode) {
+  lldb_eval::Options opts;
+  opts.use_bytecode = true;
+
+  EXPECT_THAT(Eval("s.x + sp->r * 2", opts), IsEqual("5"));
+  EXPECT_THAT(Eval("(sarr + 1)->x + sarr[0].x", opts), IsEqual("6"));
+  EXPECT_THAT(Eval("(long)sr.y + (char)sa.x", opts), IsEqual("5"));
+  EXPECT_THAT(Eval("-sp->x", opts), IsEqual("-1"));
+  EXPECT_THAT(Eval("&sarr[1] - &sarr[0]", opts), IsEqual("1"));
+  EXPECT_THAT(Eval("*&s.x", opts), IsEqual("1"));
+
+  // Control flow.
+  EXPECT_THAT(Eval("s.x > 0 && sp->r == 2", opts), IsEqual("true"));
+  EXPECT_THAT(Eval("s.x == 0 && sp->r == 2", opts), IsEqual("false"));
+  EXPECT_THAT(Eval("s.x == 0 || sa.y", opts), IsEqual("true"));
+  EXPECT_THAT(Eval("s.x == 1 || sa.y", opts), IsEqual("true"));
+  EXPECT_THAT(Eval("s.x ? sr.r : sa.x", opts), IsEqual("2"));
+  EXPECT_THAT(Eval("!s.x ? sr.r : sa.x", opts), IsEqual("3"));
+  EXPECT_THAT(Eval("(s.x ? sarr[0] : sarr[1]).y", opts), IsEqual("'\\x02'"));
+
+  // Compiled expressions.
+  lldb::SBError error;
+  lldb::SBValue sarr = frame_.FindVariable("sarr");
+  auto expr = lldb_eval::CompileExpression(
+      sarr.GetTarget(), frame_.FindVariable("s").GetType(), "x + r", opts,
+      error);
+  ASSERT_TRUE(error.Success());
+  ASSERT_NE(expr->bytecode.get(), nullptr);
+  for (lldb::SBValue scope :
+       {frame_.FindVariable("s"), sarr.GetChildAtIndex(1)}) {
+    EXPECT_EQ(lldb_eval::EvaluateExpression(scope, expr, error)
+                  .GetValueAsSigned(),
+              scope.GetChildMemberWithName("x").GetValueAsSigned() + 2);
+    EXPECT_TRUE(error.Success());
+  }
+}
+
+TEST_F(EvalTest, TestScalarTier) {
+  lldb_eval::Options opts;
+  opts.scalar_tier_threshold = 1;
+
+  lldb::SBValue sarr = frame_.FindVariable("sarr");
+  lldb::SBTarget target = sarr.GetTarget();
+  lldb::SBType scope_type = sarr.GetChildAtIndex(0).GetType();
+  auto str = [](const char* s) { return std::string(s ? s : ""); };
+
+  lldb_eval::SetAggregateStatsEnabled(true);
+  lldb_eval::ResetAggregateStats();
+  // The results are the same as evaluating the tree, including the errors
+  // and the undefined behaviour detected in the lowered operations.
+  for (const char* expr :
+       {"x * 3 + y", "x > 2 ? y : -x", "(&x)[0] + *&y", "this->x - this->y",
+        "x / 2 + (double)y / 4", "(unsigned char)(y - 10) >> 1", "x && !r",
+        "x / (y - 2)", "(int)(x * 1e10)", "&this->y - (char*)this"}) {
+    lldb::SBError error;
+    auto tree = lldb_eval::CompileExpression(target, scope_type, expr, error);
+    ASSERT_TRUE(error.Success()) << expr;
+    auto tiered =
+        lldb_eval::CompileExpression(target, scope_type, expr, opts, error);
+    ASSERT_TRUE(error.Success()) << expr;
+    for (int i = 0; i < 3; ++i) {
+      for (uint32_t idx : {0u, 1u}) {
+        lldb::SBValue scope = sarr.GetChildAtIndex(idx);
+        lldb::SBError expected_error;
+        lldb::SBValue expected =
+            lldb_eval::EvaluateExpression(scope, tree, expected_error);
+        lldb::SBValue value =
+            lldb_eval::EvaluateExpression(scope, tiered, error);
+        EXPECT_EQ(error.Success(), expected_error.Success()) << expr;
+        EXPECT_EQ(str(value.GetValue()), str(expected.GetValue())) << expr;
+        EXPECT_EQ(str(value.GetTypeName()), str(expected.GetTypeName()))
+            << expr;
+      }
+    }
+  }
+  lldb_eval::SetAggregateStatsEnabled(false);
+
+  lldb_eval::EvaluationStats aggregate = lldb_eval::GetAggregateStats();
+  EXPECT_EQ(aggregate.num_evaluations, 10u * 3 * 2 * 2);
+  EXPECT_GT(aggregate.scalar_evaluations, 0u);
+}
+
+TEST_F(EvalTest, TestCompiledExprConcurrentEvaluation) {
+  lldb::SBValue s = frame_.FindVariable("s");
+  lldb::SBValue sarr = frame_.FindVariable("sarr");
+  std::vector<lldb::SBValue> scopes = {s, sarr.GetChildAtIndex(0),
+                                       sarr.GetChildAtIndex(1)};
+  std::vector<int64_t> expected;
+  for (lldb::SBValue scope : scopes) {
+    expected.push_back(
+        scope.GetChildMemberWithName("x").GetValueAsSigned() * 10 +
+        scope.GetChildMemberWithName("y").GetValueAsSigned() +
+        scope.GetChildMemberWithName("r").GetValueAsSigned());
+  }
+
+  std::vector<lldb_eval::ContextArgument> args = {{"$var", s.GetType()}};
+
+  for (bool use_bytecode : {false, true}) {
+    lldb_eval::Options opts;
+    opts.use_bytecode = use_bytecode;
+    opts.context_args = {args.data(), args.size()};
+
+    lldb::SBError error;
+    auto expr = lldb_eval::CompileExpression(
+        s.GetTarget(), s.GetType(), "x * 10 + y + r", opts, error);
+    ASSERT_TRUE(error.Success());
+    // Fails during the evaluation (the context variable is not passed), so the
+    // diagnostics are formatted concurrently too.
+    auto failing_expr = lldb_eval::CompileExpression(
+        s.GetTarget(), s.GetType(), "$var.x + x", opts, error);
+    ASSERT_TRUE(error.Success());
+
+    constexpr size_t kNumThreads = 8;
+    constexpr size_t kNumIterations = 100;
+    std::vector<size_t> failures(kNumThreads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kNumThreads; ++t) {
+      threads.emplace_back([&, t] {
+        for (size_t i = 0; i < kNumIterations; ++i) {
+          size_t idx = (t + i) % scopes.size();
+          lldb::SBError error;
+          lldb::SBValue ret =
+              lldb_eval::EvaluateExpression(scopes[idx], expr, error);
+          if (error.Fail() || ret.GetValueAsSigned() != expected[idx]) {
+            ++failures[t];
+          }
+          lldb_eval::EvaluateExpression(scopes[idx], failing_expr, error);
+          if (!error.Fail() ||
+              std::string_view(error.GetCString()).find("$var") ==
+                  std::string_view::npos) {
+            ++failures[t];
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    for (size_t t = 0; t < kNumThreads; ++t) {
+      EXPECT_EQ(failures[t], 0u) << "thread " << t;
+    }
+  }
+}
+
+TEST_F(EvalTest, TestEvaluateOverRange) {
+  lldb::SBValue items = frame_.FindVariable("items");
+  lldb::SBType item_type = items.GetChildAtIndex(0).GetType();
+  lldb::SBType base_type = item_type.GetDirectBaseClassAtIndex(0).GetType();
+
+  lldb::SBError error;
+  auto expr = lldb_eval::CompileExpression(items.GetTarget(), item_type,
+                                           "b + x * y", error);
+  ASSERT_TRUE(error.Success());
+
+  for (size_t num_threads : {1, 4}) {
+    std::vector<lldb_eval::EvaluationResult> results;
+    lldb_eval::EvaluateOverRange(expr, items, 10, 290,
+                                 lldb_eval::ContextVariableList{}, num_threads,
+                                 results);
+    ASSERT_EQ(results.size(), 280u);
+    for (size_t i = 0; i < results.size(); ++i) {
+      int64_t idx = static_cast<int64_t>(i) + 10;
+      EXPECT_TRUE(results[i].error.Success()) << "element " << idx;
+      EXPECT_EQ(results[i].value.GetValueAsSigned(), idx + idx * 2 * (idx % 7))
+          << "element " << idx;
+    }
+  }
+
+  // The elements are casted to the base class the expression is compiled for.
+  // The range is clamped to the number of elements.
+  auto base_expr = lldb_eval::CompileExpression(items.GetTarget(), base_type,
+                                                "b * 2", error);
+  ASSERT_TRUE(error.Success());
+  std::vector<lldb_eval::EvaluationResult> results;
+  lldb_eval::EvaluateOverRange(base_expr, items, 0, 1000, results);
+  ASSERT_EQ(results.size(), 300u);
+  EXPECT_EQ(results[0].value.GetValueAsSigned(), 0);
+  EXPECT_EQ(results[299].value.GetValueAsSigned(), 598);
+
+  lldb_eval::EvaluateOverRange(expr, items, 5, 5, results);
+  EXPECT_TRUE(results.empty());
+
+  lldb_eval::EvaluateOverRange(expr, frame_.FindVariable("ints"), 0, 3,
+                               results);
+  ASSERT_EQ(results.size(), 3u);
+  for (const auto& result : results) {
+    EXPECT_STREQ(result.error.GetCString(),
+                 "expression isn't parsed in the context of compatible type");
+  }
+}
+
+TEST_F(EvalTest, TestCompiledExprScopeCast) {
+  lldb::SBValue items = frame_.FindVariable("items");
+  lldb::SBValue ints = frame_.FindVariable("ints");
+  lldb::SBType item_type = items.GetChildAtIndex(0).GetType();
+  lldb::SBType base_type = item_type.GetDirectBaseClassAtIndex(0).GetType();
+
+  lldb::SBError error;
+  auto expr = lldb_eval::CompileExpression(items.GetTarget(), base_type,
+                                           "b + 1", error);
+  ASSERT_TRUE(error.Success());
+
+  // The cast paths (and the failures) are cached per scope type, repeated
+  // evaluations must give the same results.
+  for (int i = 0; i < 3; ++i) {
+    lldb::SBValue derived = items.GetChildAtIndex(i + 5);
+    EXPECT_EQ(lldb_eval::EvaluateExpression(derived, expr, error)
+                  .GetValueAsSigned(),
+              i + 6);
+    EXPECT_TRUE(error.Success());
+
+    lldb::SBValue base = derived.GetChildAtIndex(0);
+    EXPECT_EQ(
+        lldb_eval::EvaluateExpression(base, expr, error).GetValueAsSigned(),
+        i + 6);
+    EXPECT_TRUE(error.Success());
+
+    lldb_eval::EvaluateExpression(ints, expr, error);
+    EXPECT_STREQ(error.GetCString(),
+                 "expression isn't parsed in the context of compatible type");
+  }
+}
+#endif
+
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestReevaluateExpression) {
+  lldb::SBValue items = frame_.FindVariable("items");
+  lldb::SBType item_type = items.GetChildAtIndex(0).GetType();
+
+  lldb::SBError error;
+  auto expr = lldb_eval::CompileExpression(items.GetTarget(), item_type,
+                                           "x + y", error);
+  ASSERT_TRUE(error.Success());
+
+  lldb_eval::EvaluationSnapshot snapshot;
+  lldb::SBValue item = items.GetChildAtIndex(10);
+  EXPECT_TRUE(lldb_eval::ReevaluateExpression(item, expr, {}, snapshot));
+  EXPECT_EQ(snapshot.result.value.GetValueAsSigned(), 23);
+
+  // Nothing has changed, the cached result is kept.
+  EXPECT_FALSE(lldb_eval::ReevaluateExpression(item, expr, {}, snapshot));
+  EXPECT_EQ(snapshot.result.value.GetValueAsSigned(), 23);
+
+  // Writes to the unrelated memory don't cause the re-evaluation.
+  items.GetChildAtIndex(11).GetChildMemberWithName("x").SetValueFromCString(
+      "100", error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_FALSE(lldb_eval::ReevaluateExpression(item, expr, {}, snapshot));
+
+  item.GetChildMemberWithName("y").SetValueFromCString("10", error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_TRUE(lldb_eval::ReevaluateExpression(item, expr, {}, snapshot));
+  EXPECT_EQ(snapshot.result.value.GetValueAsSigned(), 30);
+
+  // Different scope.
+  EXPECT_TRUE(lldb_eval::ReevaluateExpression(items.GetChildAtIndex(11), expr,
+                                              {}, snapshot));
+  EXPECT_EQ(snapshot.result.value.GetValueAsSigned(), 104);
+
+  // Expressions compiled in the frame.
+  lldb_eval::EvaluationSnapshot frame_snapshot;
+  EXPECT_TRUE(lldb_eval::ReevaluateExpression(frame_, "ints[1] * 10", {},
+                                              frame_snapshot));
+  EXPECT_EQ(frame_snapshot.result.value.GetValueAsSigned(), 20);
+  EXPECT_FALSE(lldb_eval::ReevaluateExpression(frame_, "ints[1] * 10", {},
+                                               frame_snapshot));
+  frame_.FindVariable("ints").GetChildAtIndex(1).SetValueFromCString("5",
+                                                                     error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_TRUE(lldb_eval::ReevaluateExpression(frame_, "ints[1] * 10", {},
+                                              frame_snapshot));
+  EXPECT_EQ(frame_snapshot.result.value.GetValueAsSigned(), 50);
+
+  // Compilation errors are kept too, other expressions are compiled again.
+  EXPECT_TRUE(
+      lldb_eval::ReevaluateExpression(frame_, "nope", {}, frame_snapshot));
+  EXPECT_TRUE(frame_snapshot.result.error.Fail());
+  EXPECT_FALSE(
+      lldb_eval::ReevaluateExpression(frame_, "nope", {}, frame_snapshot));
+
+  // Expressions with side effects are evaluated every time.
+  lldb_eval::Options opts;
+  opts.allow_side_effects = true;
+  lldb_eval::EvaluationSnapshot side_effects_snapshot;
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_TRUE(lldb_eval::ReevaluateExpression(frame_, "ints[2] += 1", opts,
+                                                side_effects_snapshot));
+    EXPECT_EQ(side_effects_snapshot.result.value.GetValueAsSigned(), 4 + i);
+  }
+
+  // Context variables bound to other values, in memory (`$a`) and not (`$b`).
+  lldb::SBValue one = lldb_eval::EvaluateExpression(frame_, "1", error);
+  lldb::SBValue two = lldb_eval::EvaluateExpression(frame_, "2", error);
+  std::vector<lldb_eval::ContextVariable> vars = {
+      {"$a", items.GetChildAtIndex(3)}, {"$b", one}};
+  lldb_eval::Options vars_opts;
+  vars_opts.context_vars = {vars.data(), vars.size()};
+  lldb_eval::EvaluationSnapshot vars_snapshot;
+  EXPECT_TRUE(lldb_eval::ReevaluateExpression(frame_, "$a.x + $b", vars_opts,
+                                              vars_snapshot));
+  EXPECT_EQ(vars_snapshot.result.value.GetValueAsSigned(), 7);
+  EXPECT_FALSE(lldb_eval::ReevaluateExpression(frame_, "$a.x + $b", vars_opts,
+                                               vars_snapshot));
+  vars[0].value = items.GetChildAtIndex(4);
+  EXPECT_TRUE(lldb_eval::ReevaluateExpression(frame_, "$a.x + $b", vars_opts,
+                                              vars_snapshot));
+  EXPECT_EQ(vars_snapshot.result.value.GetValueAsSigned(), 9);
+  vars[1].value = two;
+  EXPECT_TRUE(lldb_eval::ReevaluateExpression(frame_, "$a.x + $b", vars_opts,
+                                              vars_snapshot));
+  EXPECT_EQ(vars_snapshot.result.value.GetValueAsSigned(), 10);
+
+  // The same in the value scope.
+  std::vector<lldb_eval::ContextArgument> args = {{"$b", one.GetType()}};
+  lldb_eval::Options args_opts;
+  args_opts.context_args = {args.data(), args.size()};
+  auto args_expr = lldb_eval::CompileExpression(items.GetTarget(), item_type,
+                                                "y + $b", args_opts, error);
+  ASSERT_TRUE(error.Success());
+  lldb_eval::EvaluationSnapshot args_snapshot;
+  EXPECT_TRUE(lldb_eval::ReevaluateExpression(item, args_expr, {&vars[1], 1},
+                                              args_snapshot));
+  EXPECT_EQ(args_snapshot.result.value.GetValueAsSigned(), 12);
+  EXPECT_FALSE(lldb_eval::ReevaluateExpression(item, args_expr, {&vars[1], 1},
+                                               args_snapshot));
+  vars[1].value = one;
+  EXPECT_TRUE(lldb_eval::ReevaluateExpression(item, args_expr, {&vars[1], 1},
+                                              args_snapshot));
+  EXPECT_EQ(args_snapshot.result.value.GetValueAsSigned(), 11);
+}
+#endif
+
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestEvaluationStats) {
+  lldb_eval::EvaluationStats stats;
+  lldb_eval::Options opts;
+  opts.stats = &stats;
+
+  lldb::SBError error;
+  lldb::SBValue ret = lldb_eval::EvaluateExpression(
+      frame_, "items[1].x + ints[2] + ns::globalVar + sizeof(ns::Foo)", opts,
+      error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_EQ(ret.GetValueAsSigned(), 2 + 3 + 13 + 1);
+  EXPECT_EQ(stats.num_compilations, 1u);
+  EXPECT_EQ(stats.num_evaluations, 1u);
+  EXPECT_GE(stats.find_types_calls, 1u);
+  EXPECT_GE(stats.find_global_variables_calls, 1u);
+  EXPECT_GT(stats.ast_nodes, 0u);
+  EXPECT_GT(stats.total_ns, 0u);
+  EXPECT_GE(stats.total_ns, stats.parse_ns + stats.eval_ns);
+
+  // The stats of the subsequent calls are added up.
+  lldb_eval::EvaluateExpression(frame_, "ints[0]", opts, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_EQ(stats.num_compilations, 2u);
+  EXPECT_EQ(stats.num_evaluations, 2u);
+
+  // The aggregate collects the stats of all the calls, including the ones
+  // evaluated on the worker threads.
+  lldb_eval::SetAggregateStatsEnabled(true);
+  lldb_eval::ResetAggregateStats();
+  lldb::SBValue items = frame_.FindVariable("items");
+  auto expr = lldb_eval::CompileExpression(
+      items.GetTarget(), items.GetChildAtIndex(0).GetType(), "x * y", error);
+  ASSERT_TRUE(error.Success());
+  std::vector<lldb_eval::EvaluationResult> results;
+  lldb_eval::EvaluateOverRange(expr, items, 0, 300,
+                               lldb_eval::ContextVariableList{},
+                               /*num_threads*/ 4, results);
+  lldb_eval::SetAggregateStatsEnabled(false);
+  lldb_eval::EvaluateExpression(frame_, "ints[0]", error);
+
+  lldb_eval::EvaluationStats aggregate = lldb_eval::GetAggregateStats();
+  EXPECT_EQ(aggregate.num_compilations, 1u);
+  EXPECT_EQ(aggregate.num_evaluations, 300u);
+}
+
+// Collects the names of the trace events.
+class RecordingTraceSink : public lldb_eval::TraceSink {
+ public:
+  void AddEvent(const char* name, const std::string& detail,
+                std::chrono::nanoseconds, std::chrono::nanoseconds,
+                uint32_t) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events.push_back(std::string(name) + "(" + detail + ")");
+  }
+
+  std::vector<std::string> events;
+
+ private:
+  std::mutex mutex_;
+};
+
+TEST_F(EvalTest, TestTraceEvents) {
+  RecordingTraceSink sink;
+  lldb_eval::Options opts;
+  opts.trace_sink = &sink;
+
+  lldb::SBError error;
+  lldb::SBValue ret =
+      lldb_eval::EvaluateExpression(frame_, "(ns::Foo*)0 == 0", opts, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_THAT(sink.events, testing::Contains("Parse()"));
+  EXPECT_THAT(sink.events, testing::Contains("CompileExpression()"));
+  EXPECT_THAT(sink.events, testing::Contains("ResolveTypeByName(ns::Foo)"));
+  EXPECT_THAT(sink.events, testing::Contains("Eval()"));
+
+  // The global sink is used by the calls without a sink of their own.
+  sink.events.clear();
+  lldb_eval::SetTraceSink(&sink);
+  lldb_eval::EvaluateExpression(frame_, "ints[0]", error);
+  lldb_eval::SetTraceSink(nullptr);
+  ASSERT_TRUE(error.Success());
+  EXPECT_THAT(sink.events, testing::Contains("LookupIdentifier(ints)"));
+
+  sink.events.clear();
+  lldb_eval::EvaluateExpression(frame_, "ints[0]", error);
+  EXPECT_TRUE(sink.events.empty());
+}
+
+TEST_F(EvalTest, TestTargetFacts) {
+  // "size_t" and "ptrdiff_t" are derived from the triple of the target.
+  uint32_t address_size = frame_.GetThread().GetProcess().GetAddressByteSize();
+  lldb::SBError error;
+  lldb::SBValue size =
+      lldb_eval::EvaluateExpression(frame_, "sizeof(int)", error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_EQ(size.GetValueAsUnsigned(), 4u);
+  EXPECT_EQ(size.GetByteSize(), address_size);
+
+  lldb::SBValue diff =
+      lldb_eval::EvaluateExpression(frame_, "&ints[2] - &ints[0]", error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_EQ(diff.GetValueAsSigned(), 2);
+  EXPECT_EQ(diff.GetByteSize(), address_size);
+}
+
+TEST_F(EvalTest, TestBorrowedSourceManager) {
+  // The source manager can refer to the caller's buffer. The objects it
+  // depends on are re-used by the subsequent source managers.
+  std::string expr = "ints[1] + 1";
+  for (int i = 0; i < 2; ++i) {
+    auto sm = lldb_eval::SourceManager::CreateBorrowed(expr);
+    EXPECT_EQ(sm->expr().data(), expr.data());
+    auto ctx = lldb_eval::Context::Create(sm, frame_);
+    lldb_eval::Error err;
+    lldb_eval::ExprResult tree = lldb_eval::Parser(ctx).Run(err);
+    ASSERT_FALSE(err);
+
+    lldb_eval::Interpreter eval(process_.GetTarget(), sm);
+    eval.SetFrame(frame_);
+    EXPECT_EQ(eval.Eval(tree.get(), err).GetUInt64(), 3u);
+    ASSERT_FALSE(err);
+  }
+
+  // Diagnostics are formatted from the borrowed buffer too.
+  std::string invalid = "ints[1] +";
+  auto sm = lldb_eval::SourceManager::CreateBorrowed(invalid);
+  auto ctx = lldb_eval::Context::Create(sm, frame_);
+  lldb_eval::Error err;
+  lldb_eval::Parser(ctx).Run(err);
+  ASSERT_TRUE(err);
+  EXPECT_THAT(err.message(), testing::HasSubstr("<expr>:1:10:"));
+}
+
+TEST_F(EvalTest, TestRecompileExpression) {
+  lldb::SBValue items = frame_.FindVariable("items");
+  lldb::SBTarget target = items.GetTarget();
+  lldb::SBType item_type = items.GetChildAtIndex(0).GetType();
+  lldb_eval::EvaluationStats stats;
+  lldb_eval::Options opts;
+  opts.stats = &stats;
+
+  // Every keystroke compiles the expression in the same context.
+  lldb_eval::CompilationSession session;
+  for (const char* expr : {"x", "x +", "x + y"}) {
+    EXPECT_TRUE(lldb_eval::RecompileExpression(target, item_type, expr, opts,
+                                               session));
+  }
+  ASSERT_TRUE(session.error.Success());
+  ASSERT_NE(session.expression, nullptr);
+  lldb::SBError error;
+  EXPECT_EQ(lldb_eval::EvaluateExpression(items.GetChildAtIndex(10),
+                                          session.expression, error)
+                .GetValueAsSigned(),
+            23);
+  EXPECT_EQ(stats.num_compilations, 3u);
+
+  // The expression hasn't changed, the previous result is kept.
+  auto compiled = session.expression;
+  EXPECT_FALSE(lldb_eval::RecompileExpression(target, item_type, "x + y",
+                                              opts, session));
+  EXPECT_EQ(session.expression, compiled);
+  EXPECT_EQ(stats.num_compilations, 3u);
+
+  // Errors are reported the same way as by `CompileExpression()`.
+  EXPECT_TRUE(lldb_eval::RecompileExpression(target, item_type, "x + z", opts,
+                                             session));
+  EXPECT_TRUE(session.error.Fail());
+  EXPECT_EQ(session.expression, nullptr);
+
+  // The context is dropped when the caches of the target are invalidated.
+  EXPECT_FALSE(lldb_eval::RecompileExpression(target, item_type, "x + z",
+                                              opts, session));
+  lldb_eval::InvalidateCaches(target);
+  EXPECT_TRUE(lldb_eval::RecompileExpression(target, item_type, "x + z", opts,
+                                             session));
+  EXPECT_TRUE(session.error.Fail());
+}
+
+TEST_F(EvalTest, TestLazyErrorMessages) {
+  // The location of the error is formatted only when the message is queried.
+  auto sm = lldb_eval::SourceManager::Create("ints[1] + foo");
+  auto ctx = lldb_eval::Context::Create(sm, frame_);
+  lldb_eval::Error err;
+  lldb_eval::Parser(ctx).Run(err);
+  ASSERT_TRUE(err);
+  EXPECT_EQ(err.code(), lldb_eval::ErrorCode::kUndeclaredIdentifier);
+  EXPECT_EQ(err.description(), "use of undeclared identifier 'foo'");
+  EXPECT_EQ(err.message(),
+            "<expr>:1:11: use of undeclared identifier 'foo'\n"
+            "ints[1] + foo\n"
+            "          ^");
+
+  lldb_eval::Options opts;
+  opts.format_error_messages = false;
+  lldb::SBError error;
+  lldb_eval::EvaluateExpression(frame_, "ints[1] + foo", opts, error);
+  ASSERT_TRUE(error.Fail());
+  EXPECT_EQ(error.GetError(), static_cast<uint32_t>(
+                                  lldb_eval::ErrorCode::kUndeclaredIdentifier));
+  EXPECT_STREQ(error.GetCString(), "use of undeclared identifier 'foo'");
+
+  // Same for the evaluation errors.
+  opts.max_node_evaluations = 2;
+  lldb_eval::EvaluateExpression(frame_, "1 + 2 + 3", opts, error);
+  ASSERT_TRUE(error.Fail());
+  EXPECT_STREQ(error.GetCString(), "evaluation exceeded the limit of 2 nodes");
+}
+
+TEST_F(EvalTest, TestDereferenceByAddress) {
+  lldb_eval::EvaluationStats stats;
+  lldb_eval::Options opts;
+  opts.stats = &stats;
+
+  // Dereferenced values are read via the memory cache without creating
+  // lldb::SBValue, it's created only for the final result.
+  lldb::SBError error;
+  lldb::SBValue ret = lldb_eval::EvaluateExpression(
+      frame_, "items[1].x + items[2].b + ints[2] + *(ints + 1)", opts, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_EQ(ret.GetValueAsSigned(), 2 + 2 + 3 + 2);
+  EXPECT_LE(stats.create_value_from_data_calls, 1u);
+
+  EXPECT_THAT(Eval("&items[1] == items + 1"), IsEqual("true"));
+  EXPECT_THAT(Eval("&*(ints + 2) == &ints[2]"), IsEqual("true"));
+  EXPECT_THAT(Eval("items[299]"), IsOk());
+  EXPECT_THAT(Eval("items[299].y"), IsEqual("5"));
+}
+#endif
+
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestTentativeParsing) {
+  lldb_eval::EvaluationStats stats;
+  lldb_eval::Options opts;
+  opts.stats = &stats;
+
+  // Parenthesized local variables are not looked up as types.
+  lldb::SBError error;
+  lldb::SBValue ret = lldb_eval::EvaluateExpression(
+      frame_, "(ints[0]) + ((ints[1])) * (((ints[2])))", opts, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_EQ(ret.GetValueAsSigned(), 7);
+  EXPECT_EQ(stats.find_types_calls, 0u);
+
+  // Nested template argument lists are tried at every level, which is
+  // exponential without memoizing the results.
+  std::string expr = "(";
+  for (int i = 0; i < 24; ++i) {
+    expr += "a<";
+  }
+  expr += "int" + std::string(24, '>') + "*)0";
+  lldb_eval::EvaluateExpression(frame_, expr.c_str(), error);
+  EXPECT_TRUE(error.Fail());
+}
+#endif
+
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestSerializeCompiledExpr) {
+  lldb::SBValue items = frame_.FindVariable("items");
+  lldb::SBTarget target = items.GetTarget();
+  lldb::SBType item_type = items.GetChildAtIndex(0).GetType();
+
+  lldb::SBError error;
+  auto expr = lldb_eval::CompileExpression(
+      target, item_type,
+      "x * 2 + y + ns::globalVar + (int)sizeof(int) + (b > 10 ? 1 : 2)",
+      error);
+  ASSERT_TRUE(error.Success());
+  std::vector<uint8_t> data = lldb_eval::SerializeCompiledExpr(target, expr);
+
+  // The same modules, the tree is rehydrated without parsing.
+  lldb_eval::EvaluationStats stats;
+  lldb_eval::Options opts;
+  opts.stats = &stats;
+  auto restored = lldb_eval::DeserializeCompiledExpr(target, item_type, data,
+                                                     opts, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_EQ(stats.num_compilations, 0u);
+  EXPECT_EQ(stats.find_global_variables_calls, 0u);
+  lldb::SBType restored_type = restored->result_type;
+  lldb::SBType expected_type = expr->result_type;
+  EXPECT_STREQ(restored_type.GetName(), expected_type.GetName());
+  for (uint32_t i : {10, 11}) {
+    lldb::SBValue item = items.GetChildAtIndex(i);
+    EXPECT_EQ(
+        lldb_eval::EvaluateExpression(item, restored, error).GetValueAsSigned(),
+        lldb_eval::EvaluateExpression(item, expr, error).GetValueAsSigned());
+    EXPECT_TRUE(error.Success());
+  }
+  EXPECT_EQ(lldb_eval::EvaluateExpression(items.GetChildAtIndex(10), restored,
+                                          error)
+                .GetValueAsSigned(),
+            62);
+
+  // Incomplete trees are compiled again from the source.
+  std::vector<uint8_t> truncated(data.begin(), data.end() - 1);
+  restored = lldb_eval::DeserializeCompiledExpr(target, item_type, truncated,
+                                                opts, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_EQ(stats.num_compilations, 1u);
+  EXPECT_EQ(lldb_eval::EvaluateExpression(items.GetChildAtIndex(11), restored,
+                                          error)
+                .GetValueAsSigned(),
+            66);
+
+  lldb_eval::DeserializeCompiledExpr(target, item_type, {1, 2, 3}, opts,
+                                     error);
+  EXPECT_STREQ(error.GetCString(), "malformed serialized expression");
+}
+#endif
+
 TEST_F(EvalTest, TestMemberOfInheritance) {
   EXPECT_THAT(Eval("a.a_"), IsEqual("1"));
   EXPECT_THAT(Eval("b.b_"), IsEqual("2"));
@@ -1090,6 +1835,36 @@ TEST_F(EvalTest, TestMemberOfInheritance) {
   EXPECT_THAT(Eval("parent->z"), IsEqual("3"));
 }
 
+TEST_F(EvalTest, TestMemberIndex) {
+  // Member indexes are built once per type and re-used by the following
+  // lookups, including the ones via the qualified types and the pointers.
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_THAT(Eval("d.a_"), IsEqual("1"));
+    EXPECT_THAT(Eval("d.fa_.a_"), IsEqual("5"));
+    EXPECT_THAT(Eval("((const D&)d).c_"), IsEqual("3"));
+    EXPECT_THAT(Eval("parent->x"), IsEqual("1"));
+    EXPECT_THAT(Eval("((const Parent*)parent)->z"), IsEqual("3"));
+    EXPECT_THAT(Eval("d.__doesnt_exist"),
+                IsError("no member named '__doesnt_exist' in 'D'"));
+  }
+}
+
+TEST_F(EvalTest, TestMemberOfOffsets) {
+  // Members of the non-virtual bases are accessed by their addresses.
+  EXPECT_THAT(Eval("c.b_"), IsEqual("2"));
+  EXPECT_THAT(Eval("d.c_"), IsEqual("3"));
+  EXPECT_THAT(Eval("d.fa_.a_"), IsEqual("5"));
+  EXPECT_THAT(Eval("(&d)->d_"), IsEqual("4"));
+  EXPECT_THAT(Eval("parent->z"), IsEqual("3"));
+  EXPECT_THAT(Eval("&d.fa_.a_ == (int*)((char*)&d + 16)"),
+              IsEqual("true"));
+  EXPECT_THAT(Eval("&parent_base->y == &parent->y"), IsEqual("true"));
+
+  // Members of the virtual bases are accessed via lldb::SBValue.
+  EXPECT_THAT(Eval("bat.weight_"), IsEqual("10"));
+  EXPECT_THAT(Eval("(&bat)->weight_"), IsEqual("10"));
+}
+
 TEST_F(EvalTest, TestMemberOfAnonymousMember) {
   EXPECT_THAT(Eval("a.x"), IsEqual("1"));
   EXPECT_THAT(Eval("a.y"), IsEqual("2"));
@@ -1143,6 +1918,36 @@ TEST_F(EvalTest, TestGlobalVariableLookup) {
   EXPECT_THAT(Eval("::ns::globalPtr"), IsOk());
 }
 
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestTargetCache) {
+  // Lookups are cached per target, repeated ones must give the same results.
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_THAT(Eval("globalVar"), IsEqual("-559038737"));
+    EXPECT_THAT(Eval("ns::globalVar"), IsEqual("13"));
+    EXPECT_THAT(Eval("sizeof(ns::myint)"), IsEqual("4"));
+    // Negative results are cached too.
+    EXPECT_THAT(Eval("ns::__doesnt_exist"),
+                IsError("use of undeclared identifier 'ns::__doesnt_exist'"));
+    EXPECT_THAT(Eval("sizeof(ns::__doesnt_exist_t)"),
+                IsError("use of undeclared identifier 'ns::__doesnt_exist_t'"));
+  }
+
+  // Global variables are read from the memory again, even if cached.
+  this->compare_with_lldb_ = false;
+  this->allow_side_effects_ = true;
+  EXPECT_THAT(Eval("ns::globalVar = 14"), IsEqual("14"));
+  EXPECT_THAT(Eval("ns::globalVar"), IsEqual("14"));
+  EXPECT_THAT(Eval("ns::globalVar = 13"), IsEqual("13"));
+
+  lldb_eval::InvalidateCaches(frame_.GetThread().GetProcess().GetTarget());
+  EXPECT_THAT(Eval("ns::globalVar"), IsEqual("13"));
+  EXPECT_THAT(Eval("sizeof(ns::myint)"), IsEqual("4"));
+
+  lldb_eval::ClearCaches();
+  EXPECT_THAT(Eval("globalVar"), IsEqual("-559038737"));
+}
+#endif
+
 TEST_F(EvalTest, TestInstanceVariables) {
   EXPECT_THAT(Eval("this->field_"), IsEqual("1"));
   EXPECT_THAT(Eval("this.field_"),
@@ -1156,6 +1961,312 @@ TEST_F(EvalTest, TestInstanceVariables) {
                                          "pointer; did you mean to use '.'?"));
 }
 
+TEST_F(EvalTest, TestEvaluateCondition) {
+  lldb_eval::Options opts;
+  opts.scalar_tier_threshold = 1;
+
+  lldb::SBTarget target = process_.GetTarget();
+  lldb::SBType scope_type = frame_.FindVariable("this").Dereference().GetType();
+  auto condition = [&](const char* expr, bool& result) {
+    lldb::SBError error;
+    auto compiled =
+        lldb_eval::CompileExpression(target, scope_type, expr, opts, error);
+    EXPECT_TRUE(error.Success()) << expr;
+    if (!compiled) {
+      return error;
+    }
+    // The first evaluation is done by the interpreter, the next ones by the
+    // scalar program.
+    for (int i = 0; i < 3; ++i) {
+      lldb_eval::EvaluateCondition(frame_, compiled, result, error);
+    }
+    return error;
+  };
+
+  bool result = false;
+  EXPECT_TRUE(condition("field_ == 1", result).Success());
+  EXPECT_TRUE(result);
+  EXPECT_TRUE(condition("field_ * 2.5 > 3", result).Success());
+  EXPECT_FALSE(result);
+  EXPECT_TRUE(condition("this->field_ - 1", result).Success());
+  EXPECT_FALSE(result);
+  EXPECT_TRUE(condition("this", result).Success());
+  EXPECT_TRUE(result);
+
+  result = true;
+  lldb::SBError error = condition("*this", result);
+  EXPECT_FALSE(result);
+  EXPECT_STREQ(error.GetCString(),
+               "value of type 'TestMethods' is not contextually convertible "
+               "to 'bool'");
+
+  // The scope of the condition must match `*this` of the frame.
+  lldb::SBType other_type = frame_.FindVariable("c").GetType();
+  auto compiled = lldb_eval::CompileExpression(target, other_type,
+                                               "field_ == -1", opts, error);
+  ASSERT_TRUE(error.Success());
+  lldb_eval::EvaluateCondition(frame_, compiled, result, error);
+  EXPECT_TRUE(error.Fail());
+  EXPECT_FALSE(result);
+}
+
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestFrameIdentifiers) {
+  // Expressions parsed in one frame can be evaluated in the other frames of the
+  // same function, the values of the identifiers are resolved by the
+  // interpreter.
+  auto sm = lldb_eval::SourceManager::Create("depth * 10");
+  auto ctx = lldb_eval::Context::Create(sm, frame_);
+  lldb_eval::Error err;
+  lldb_eval::ExprResult tree = lldb_eval::Parser(ctx).Run(err);
+  ASSERT_FALSE(err);
+
+  lldb::SBThread thread = process_.GetSelectedThread();
+  lldb_eval::Interpreter eval(process_.GetTarget(), sm);
+  for (uint32_t i = 0; i <= 2; ++i) {
+    eval.SetFrame(thread.GetFrameAtIndex(i));
+    lldb_eval::Value ret = eval.Eval(tree.get(), err);
+    ASSERT_FALSE(err);
+    EXPECT_EQ(ret.GetUInt64(), i * 10);
+  }
+
+  // The types of the identifiers are bound during the parsing.
+  sm = lldb_eval::SourceManager::Create("local");
+  ctx = lldb_eval::Context::Create(sm, frame_);
+  tree = lldb_eval::Parser(ctx).Run(err);
+  ASSERT_FALSE(err);
+  eval.SetSourceManager(sm);
+  eval.SetFrame(thread.GetFrameAtIndex(0));
+  EXPECT_EQ(eval.Eval(tree.get(), err).GetUInt64(), 10);
+  // There is no `local` in `main()`.
+  eval.SetFrame(thread.GetFrameAtIndex(3));
+  EXPECT_FALSE(eval.Eval(tree.get(), err).IsValid());
+  EXPECT_EQ(err.code(), lldb_eval::ErrorCode::kUndeclaredIdentifier);
+}
+
+TEST_F(EvalTest, TestFrameCompiledExpr) {
+  lldb::SBThread thread = process_.GetSelectedThread();
+  lldb::SBFrame outer = thread.GetFrameAtIndex(1);
+  lldb_eval::ContextVariableList no_vars{};
+  lldb::SBError error;
+
+  // Compiled once, evaluated in every frame stopped in the same block.
+  auto expr = lldb_eval::CompileExpression(outer, "x * 10 + depth",
+                                           lldb_eval::Options{}, error);
+  ASSERT_TRUE(error.Success());
+  for (uint32_t i = 1; i <= 2; ++i) {
+    lldb::SBValue value = lldb_eval::EvaluateExpression(
+        thread.GetFrameAtIndex(i), expr, no_vars, error);
+    ASSERT_TRUE(error.Success());
+    EXPECT_EQ(value.GetValueAsSigned(), static_cast<int64_t>(i * 11));
+  }
+
+  // The innermost block declares another `x`.
+  EXPECT_FALSE(
+      lldb_eval::EvaluateExpression(frame_, expr, no_vars, error).IsValid());
+  EXPECT_STREQ(error.GetCString(),
+               "expression isn't parsed in the lexical block of the frame");
+  auto inner = lldb_eval::CompileExpression(frame_, "x * 10 + depth",
+                                            lldb_eval::Options{}, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_EQ(lldb_eval::EvaluateExpression(frame_, inner, no_vars, error)
+                .GetValueAsSigned(),
+            420);
+
+  // Compiled conditions are lowered to the scalar programs the same way as
+  // the expressions compiled in the context of a type.
+  lldb_eval::Options opts;
+  opts.scalar_tier_threshold = 1;
+  auto condition =
+      lldb_eval::CompileExpression(outer, "x == depth && x > 1", opts, error);
+  ASSERT_TRUE(error.Success());
+  for (int hit = 0; hit < 3; ++hit) {
+    for (uint32_t i = 1; i <= 2; ++i) {
+      bool result = !(i > 1);
+      lldb_eval::EvaluateCondition(thread.GetFrameAtIndex(i), condition,
+                                   result, error);
+      EXPECT_TRUE(error.Success());
+      EXPECT_EQ(result, i > 1);
+    }
+  }
+  bool result = true;
+  lldb_eval::EvaluateCondition(frame_, condition, result, error);
+  EXPECT_TRUE(error.Fail());
+  EXPECT_FALSE(result);
+}
+
+TEST_F(EvalTest, TestEvaluateInFrames) {
+  lldb::SBThread thread = process_.GetSelectedThread();
+  std::vector<lldb::SBFrame> frames = {
+      thread.GetFrameAtIndex(1), frame_, thread.GetFrameAtIndex(2),
+      thread.GetFrameAtIndex(1)};
+
+  for (size_t num_threads : {1, 4}) {
+    lldb_eval::EvaluationStats stats;
+    lldb_eval::Options opts;
+    opts.stats = &stats;
+    std::vector<lldb_eval::EvaluationResult> results;
+    lldb_eval::EvaluateInFrames(frames, "x * 10 + depth", opts, num_threads,
+                                results);
+    ASSERT_EQ(results.size(), frames.size());
+    std::vector<int64_t> expected = {11, 420, 22, 11};
+    for (size_t i = 0; i < results.size(); ++i) {
+      EXPECT_TRUE(results[i].error.Success());
+      EXPECT_EQ(results[i].value.GetValueAsSigned(), expected[i]);
+    }
+    // Once for the innermost block and once for the recursive calls.
+    EXPECT_EQ(stats.num_compilations, 2u);
+  }
+
+  std::vector<lldb_eval::EvaluationResult> results;
+  lldb_eval::EvaluateInFrames(frames, "depth + 1", lldb_eval::Options{},
+                              /*num_threads*/ 2, results);
+  ASSERT_EQ(results.size(), frames.size());
+  EXPECT_EQ(results[0].value.GetValueAsSigned(), 2);
+  EXPECT_EQ(results[1].value.GetValueAsSigned(), 1);
+  EXPECT_EQ(results[2].value.GetValueAsSigned(), 3);
+
+  // Errors are reported per frame.
+  lldb_eval::EvaluateInFrames({thread.GetFrameAtIndex(1), frame_}, "y",
+                              lldb_eval::Options{}, /*num_threads*/ 1,
+                              results);
+  ASSERT_EQ(results.size(), 2u);
+  EXPECT_THAT(results[0].error.GetCString(),
+              testing::HasSubstr("use of undeclared identifier 'y'"));
+  EXPECT_TRUE(results[1].error.Fail());
+}
+
+TEST_F(EvalTest, TestFrameCompiledExprWithoutBlock) {
+  // Frames of the functions without debug information (e.g. the ones of libc
+  // calling `main()`) have no lexical blocks.
+  lldb::SBThread thread = process_.GetSelectedThread();
+  std::vector<lldb::SBFrame> frames;
+  for (uint32_t i = 0; i < thread.GetNumFrames(); ++i) {
+    lldb::SBFrame frame = thread.GetFrameAtIndex(i);
+    if (!frame.GetBlock().IsValid()) {
+      frames.push_back(frame);
+    }
+  }
+  if (frames.size() < 2) {
+    GTEST_SKIP() << "needs two frames without debug information";
+  }
+
+  // Not even the frame of the compilation is known to be in the same block.
+  lldb_eval::ContextVariableList no_vars{};
+  lldb::SBError error;
+  auto expr = lldb_eval::CompileExpression(frames[0], "1 + 2",
+                                           lldb_eval::Options{}, error);
+  ASSERT_TRUE(error.Success());
+  auto condition = lldb_eval::CompileExpression(frames[0], "1 == 1",
+                                                lldb_eval::Options{}, error);
+  ASSERT_TRUE(error.Success());
+  for (lldb::SBFrame frame : frames) {
+    EXPECT_FALSE(
+        lldb_eval::EvaluateExpression(frame, expr, no_vars, error).IsValid());
+    EXPECT_STREQ(error.GetCString(),
+                 "expression isn't parsed in the lexical block of the frame");
+
+    bool result = true;
+    lldb_eval::EvaluateCondition(frame, condition, result, error);
+    EXPECT_TRUE(error.Fail());
+    EXPECT_FALSE(result);
+  }
+}
+
+TEST_F(EvalTest, TestFrameIndex) {
+  // The index is shared by all the lookups in the frame at the same stop.
+  auto index = lldb_eval::FrameIndex::Get(frame_);
+  EXPECT_EQ(lldb_eval::FrameIndex::Get(frame_), index);
+  EXPECT_TRUE(index->IsValidFor(frame_));
+  EXPECT_TRUE(index->FindVariable("c_ref").IsValid());
+  EXPECT_FALSE(index->FindVariable("field_").IsValid());
+  EXPECT_TRUE(index->FindMember("field_").IsValid());
+  // The innermost variable wins, the same as with `SBFrame::FindVariable()`.
+  EXPECT_EQ(index->FindVariable("shadowed").GetValueAsSigned(), 2);
+  // The globals of the compile unit aren't local variables.
+  EXPECT_FALSE(index->FindVariable("shadowed_by_member").IsValid());
+  EXPECT_FALSE(index->FindVariable("globalVar").IsValid());
+
+  const char* exprs[] = {
+      "field_",
+      "this->field_",
+      "c.field_ + field_",
+      "c_ptr->field_",
+      "(uint64_t)$rsp == (uint64_t)rsp",
+      "foo",
+      "shadowed",
+      "shadowed_by_member",
+  };
+  lldb_eval::Options opts;
+  opts.use_frame_index = true;
+  std::vector<lldb_eval::EvaluationResult> results;
+  lldb_eval::EvaluateExpressions(frame_, {exprs, std::size(exprs)}, opts,
+                                 results);
+
+  ASSERT_EQ(results.size(), std::size(exprs));
+  auto result = [&](size_t i) {
+    return EvalResult{results[i].error, results[i].value};
+  };
+  EXPECT_THAT(result(0), IsEqual("1"));
+  EXPECT_THAT(result(1), IsEqual("1"));
+  EXPECT_THAT(result(2), IsEqual("0"));
+  EXPECT_THAT(result(3), IsEqual("-1"));
+  EXPECT_THAT(result(4), IsEqual("true"));
+  EXPECT_THAT(result(5), IsError("use of undeclared identifier 'foo'"));
+  EXPECT_THAT(result(6), IsEqual("2"));
+  EXPECT_THAT(result(7), IsEqual("4"));
+
+  // The index is re-built after the process is resumed.
+  process_.GetSelectedThread().StepInstruction(/*step_over*/ true);
+  lldb::SBFrame frame = process_.GetSelectedThread().GetSelectedFrame();
+  EXPECT_FALSE(index->IsValidFor(frame));
+  EXPECT_NE(lldb_eval::FrameIndex::Get(frame), index);
+}
+
+TEST_F(EvalTest, TestCompleteExpression) {
+  using Kind = lldb_eval::CompletionCandidate::Kind;
+  std::vector<lldb_eval::CompletionCandidate> candidates;
+  auto names = [&candidates] {
+    std::vector<std::string> ret;
+    for (const auto& candidate : candidates) {
+      ret.push_back(candidate.name);
+    }
+    return ret;
+  };
+  lldb_eval::Options opts;
+
+  // Local variables and members of `this`.
+  lldb_eval::CompleteExpression(frame_, "c_", opts, candidates);
+  EXPECT_THAT(names(), testing::ElementsAre("c_ptr", "c_ref"));
+  EXPECT_EQ(candidates[0].kind, Kind::kLocalVariable);
+  EXPECT_STREQ(candidates[0].type.GetName(), "C *");
+
+  lldb_eval::CompleteExpression(frame_, "1 + fie", opts, candidates);
+  EXPECT_THAT(names(), testing::ElementsAre("field_"));
+  EXPECT_EQ(candidates[0].kind, Kind::kMember);
+
+  // Global variables.
+  lldb_eval::CompleteExpression(frame_, "globalP", opts, candidates);
+  EXPECT_THAT(names(), testing::Contains("globalPtr"));
+  EXPECT_EQ(candidates[0].kind, Kind::kGlobalVariable);
+
+  // Members of the object before the member access.
+  lldb_eval::CompleteExpression(frame_, "c_ptr->", opts, candidates);
+  EXPECT_THAT(names(), testing::ElementsAre("field_"));
+  EXPECT_STREQ(candidates[0].type.GetName(), "int");
+  lldb_eval::CompleteExpression(frame_, "c_ref . f", opts, candidates);
+  EXPECT_THAT(names(), testing::ElementsAre("field_"));
+  lldb_eval::CompleteExpression(frame_, "c.x", opts, candidates);
+  EXPECT_TRUE(candidates.empty());
+
+  // The object must be compiled with the requested operator.
+  lldb_eval::CompleteExpression(frame_, "c_ptr.", opts, candidates);
+  EXPECT_TRUE(candidates.empty());
+  lldb_eval::CompleteExpression(frame_, "foo->", opts, candidates);
+  EXPECT_TRUE(candidates.empty());
+}
+#endif
+
 TEST_F(EvalTest, TestIndirection) {
   EXPECT_THAT(Eval("*p"), IsEqual("1"));
   EXPECT_THAT(Eval("p"), IsOk());
@@ -1281,6 +2392,19 @@ TEST_F(EvalTest, TestSubscript) {
   EXPECT_THAT(Eval("(&c_arr[1])->field_"), IsEqual("1"));
 }
 
+TEST_F(EvalTest, TestTypeInterning) {
+  // Types are interned per target. Typedefs must be distinct from the types
+  // they refer to, but still compare equal to them.
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_THAT(Eval("td_int_idx_1 + td_td_int_idx_2"), IsEqual("3"));
+    EXPECT_THAT(Eval("td_int_idx_1 + idx_1"), IsEqual("2"));
+    EXPECT_THAT(Eval("*td_int_ptr"), IsEqual("1"));
+    EXPECT_THAT(Eval("td_int_ptr == &td_int_arr[0]"), IsEqual("true"));
+    EXPECT_THAT(Eval("td_int_ptr - &td_int_arr[0]"), IsEqual("0"));
+    EXPECT_THAT(Eval("&td_int_idx_1 == &idx_1"), IsEqual("false"));
+  }
+}
+
 TEST_F(EvalTest, TestCStyleCastBuiltins) {
   EXPECT_THAT(Eval("(int)1"), IsOk());
   EXPECT_THAT(Eval("(long long)1"), IsOk());
@@ -1709,6 +2833,39 @@ TEST_F(EvalTest, TestCastDerivedToBase) {
                       "related by inheritance, is not allowed"));
 }
 
+TEST_F(EvalTest, TestBaseClassPathCache) {
+  // The paths to the base classes are found once per target.
+  auto cache = lldb_eval::TargetCache::Get(process_.GetTarget());
+  auto type_of = [&](const char* name) {
+    return cache->InternType(frame_.FindVariable(name).GetType());
+  };
+  auto e_to_b = cache->GetBaseClassPath(type_of("e"), type_of("b"));
+  ASSERT_NE(e_to_b, nullptr);
+  EXPECT_EQ(cache->GetBaseClassPath(type_of("e"), type_of("b")), e_to_b);
+  EXPECT_EQ(e_to_b->virtual_base, nullptr);
+  lldb::SBValue e = frame_.FindVariable("e");
+  lldb::SBValue e_as_b = frame_.FindVariable("e_as_b");
+  EXPECT_EQ(e.GetLoadAddress() + e_to_b->offset, e_as_b.GetValueAsUnsigned());
+  EXPECT_EQ(cache->GetBaseClassPath(type_of("d"), type_of("b")), nullptr);
+
+  auto ve_to_b = cache->GetBaseClassPath(type_of("ve"), type_of("b"));
+  ASSERT_NE(ve_to_b, nullptr);
+  ASSERT_NE(ve_to_b->virtual_base, nullptr);
+  EXPECT_TRUE(lldb_eval::CompareTypes(ve_to_b->virtual_base, type_of("b")));
+
+  // The offsets of the virtual bases are found by LLDB once per vtable.
+  EXPECT_THAT(Eval("static_cast<CxxB*>(&ve)->b"), IsEqual("16"));
+  lldb::SBError error;
+  lldb::addr_t vtable_addr = process_.ReadPointerFromMemory(
+      frame_.FindVariable("ve").GetLoadAddress() + ve_to_b->offset, error);
+  ASSERT_TRUE(error.Success());
+  auto offset =
+      cache->LookupVirtualBaseOffset(process_, vtable_addr, type_of("b"));
+  ASSERT_TRUE(offset.has_value());
+  EXPECT_THAT(Eval("static_cast<CxxB&>(ve).b"), IsEqual("16"));
+  EXPECT_THAT(Eval("&static_cast<CxxB&>(ve) == ve_as_b"), IsEqual("true"));
+}
+
 TEST_F(EvalTest, TestCastBaseToDerived) {
   EXPECT_THAT(Eval("static_cast<CxxE*>(e_as_b)->a"), IsEqual("7"));
   EXPECT_THAT(Eval("static_cast<CxxE*>(e_as_b)->b"), IsEqual("8"));
@@ -2518,6 +3675,26 @@ TEST_F(EvalTest, TestScopedEnumWithUnderlyingType) {
   EXPECT_THAT(Eval("(ScopedEnumUInt8)257"), IsEqual("kBar"));
 }
 
+TEST_F(EvalTest, TestEnumeratorLookup) {
+  lldb_eval::EvaluationStats stats;
+  lldb_eval::Options opts;
+  opts.stats = &stats;
+  lldb::SBError error;
+
+  lldb::SBValue value = lldb_eval::EvaluateExpression(
+      frame_, "ScopedEnumUInt8::kBar", opts, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_STREQ(value.GetValue(), "kBar");
+  EXPECT_EQ(value.GetByteSize(), 1u);
+  // Enumerators are found in the enum table, without looking for a global
+  // variable with the same name.
+  EXPECT_EQ(stats.find_global_variables_calls, 0u);
+
+  EXPECT_THAT(Eval("ScopedEnum::kBar == enum_bar"), IsEqual("true"));
+  EXPECT_THAT(Eval("ScopedEnum::kBaz"),
+              IsError("use of undeclared identifier 'ScopedEnum::kBaz'"));
+}
+
 TEST_F(EvalTest, TestUnscopedEnum) {
   EXPECT_THAT(Eval("enum_one"), IsEqual("kOne"));
   EXPECT_THAT(Eval("enum_two"), IsEqual("kTwo"));
@@ -3249,6 +4426,15 @@ TEST_F(EvalTest, TestBuiltinFunction_findnonnull) {
   EXPECT_THAT(Eval("__findnonnull(pointer_to_pointers+2, 3)"), IsEqual("2"));
   EXPECT_THAT(Eval("__findnonnull(pointer_to_pointers+3, 2)"), IsEqual("1"));
 
+  EXPECT_THAT(Eval("__findnonnull(large_array_of_pointers, 20000)"),
+              IsEqual("17000"));
+  EXPECT_THAT(Eval("__findnonnull(large_array_of_pointers, 17000)"),
+              IsEqual("-1"));
+  EXPECT_THAT(Eval("__findnonnull(large_array_of_pointers+16999, 2)"),
+              IsEqual("1"));
+  EXPECT_THAT(Eval("__findnonnull(large_array_of_pointers+17001, 2999)"),
+              IsEqual("-1"));
+
   EXPECT_THAT(Eval("__findnonnull(0, 0)"),
               IsError("no known conversion from 'int' to 'T*' for 1st argument "
                       "of __findnonnull()\n"
@@ -3286,6 +4472,185 @@ TEST_F(EvalTest, TestBuiltinFunction_findnonnull) {
   }
 }
 
+TEST_F(EvalTest, TestBuiltinFunction_bufferScans) {
+  // LLDB doesn't support the buffer scanning intrinsic functions.
+  this->compare_with_lldb_ = false;
+
+  EXPECT_THAT(Eval("__findvalue(array_of_int, 7, -1)"), IsEqual("1"));
+  EXPECT_THAT(Eval("__findvalue(array_of_int+2, 5, -1)"), IsEqual("3"));
+  EXPECT_THAT(Eval("__findvalue(pointer_to_int, 7, 5)"), IsEqual("6"));
+  EXPECT_THAT(Eval("__findvalue(array_of_int, 7, 42)"), IsEqual("-1"));
+  EXPECT_THAT(Eval("__findvalue(array_of_int, 0, 3)"), IsEqual("-1"));
+  EXPECT_THAT(Eval("__findvalue(array_of_uint16, 5, 65535)"), IsEqual("3"));
+  EXPECT_THAT(Eval("__findvalue(array_of_double, 5, 0)"), IsEqual("1"));
+  EXPECT_THAT(Eval("__findvalue(large_array_of_int, 20000, 42)"),
+              IsEqual("17000"));
+  EXPECT_THAT(Eval("__findvalue(large_array_of_int+17001, 2999, 42)"),
+              IsEqual("-1"));
+
+  EXPECT_THAT(Eval("__count(array_of_int, 7)"), IsEqual("5"));
+  EXPECT_THAT(Eval("__count(pointer_to_int+4, 3)"), IsEqual("2"));
+  EXPECT_THAT(Eval("__count(array_of_uint16, 5)"), IsEqual("3"));
+  EXPECT_THAT(Eval("__count(array_of_double, 5)"), IsEqual("3"));
+  EXPECT_THAT(Eval("__count(large_array_of_int, 20000)"), IsEqual("2"));
+
+  EXPECT_THAT(Eval("__min(array_of_int, 7)"), IsEqual("-1"));
+  EXPECT_THAT(Eval("__max(array_of_int, 7)"), IsEqual("7"));
+  EXPECT_THAT(Eval("__max(pointer_to_int+4, 3)"), IsEqual("5"));
+  EXPECT_THAT(Eval("__min(array_of_uint16, 5)"), IsEqual("0"));
+  EXPECT_THAT(Eval("__max(array_of_uint16, 5)"), IsEqual("65535"));
+  EXPECT_THAT(Eval("__min(array_of_double, 5)"), IsEqual("-3.5"));
+  EXPECT_THAT(Eval("__max(array_of_double, 5)"), IsEqual("2.5"));
+  EXPECT_THAT(Eval("__min(large_array_of_int, 20000)"), IsEqual("-5"));
+  EXPECT_THAT(Eval("__max(large_array_of_int, 20000)"), IsEqual("42"));
+  EXPECT_THAT(Eval("__max(array_of_int, 7) + 1"), IsEqual("8"));
+
+  EXPECT_THAT(Eval("__count(1, 1)"),
+              IsError("no known conversion from 'int' to 'T*' for 1st argument "
+                      "of __count()\n"
+                      "__count(1, 1)\n"
+                      "^"));
+  EXPECT_THAT(Eval("__min(array_of_s, 2)"),
+              IsError("__min() is not supported for the elements of type 'S'\n"
+                      "__min(array_of_s, 2)\n"
+                      "^"));
+  EXPECT_THAT(
+      Eval("__min(array_of_int, 0)"),
+      IsError("passing in an empty buffer to __min() is not allowed.\n"
+              "__min(array_of_int, 0)\n"
+              "                    ^"));
+  EXPECT_THAT(
+      Eval("__count(array_of_int, -1)"),
+      IsError("passing in a buffer size ('-1') that is negative or in excess "
+              "of 100 million to __count() is not allowed.\n"
+              "__count(array_of_int, -1)\n"
+              "                      ^"));
+}
+
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestSnapshotMemoryProvider) {
+  lldb::SBValue small = frame_.FindVariable("array_of_int");
+  lldb::SBValue large = frame_.FindVariable("large_array_of_int");
+  std::string path = ::testing::TempDir() + "/memory_snapshot";
+  lldb::SBError error;
+  ASSERT_TRUE(lldb_eval::SnapshotMemoryProvider::Write(
+      process_,
+      {{large.GetLoadAddress(), large.GetByteSize()},
+       {small.GetLoadAddress(), small.GetByteSize()},
+       // Overlaps the previous range.
+       {small.GetLoadAddress() + 8, 8}},
+      path, error));
+  auto snapshot = lldb_eval::SnapshotMemoryProvider::Open(path, error);
+  ASSERT_NE(snapshot, nullptr);
+
+  int value = 0;
+  EXPECT_EQ(snapshot->ReadMemory(small.GetLoadAddress() + 12, &value,
+                                 sizeof(value), error),
+            sizeof(value));
+  EXPECT_EQ(value, 7);
+  EXPECT_NE(snapshot->GetContiguous(large.GetLoadAddress(),
+                                    large.GetByteSize()),
+            nullptr);
+
+  // The memory is read from the snapshot only.
+  lldb_eval::Options opts;
+  opts.memory_provider = snapshot;
+  auto eval = [&](const char* expr) {
+    lldb::SBValue ret =
+        lldb_eval::EvaluateExpression(frame_, expr, opts, error);
+    EXPECT_TRUE(error.Success()) << expr;
+    return ret.GetValueAsSigned();
+  };
+  EXPECT_EQ(eval("__findvalue(large_array_of_int, 20000, 42)"), 17000);
+  EXPECT_EQ(eval("__max(large_array_of_int, 20000)"), 42);
+  EXPECT_EQ(eval("__count(array_of_int, 7)"), 5);
+  EXPECT_EQ(eval("pointer_to_int[3] + large_array_of_int[19999]"), 2);
+
+  // The memory past the array isn't in the snapshot.
+  lldb_eval::EvaluateExpression(frame_, "__count(array_of_int + 7, 16)", opts,
+                                error);
+  EXPECT_TRUE(error.Fail());
+
+  std::remove(path.c_str());
+}
+#endif  // __EMSCRIPTEN__
+
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestAsyncEvaluation) {
+  lldb_eval::Options opts;
+  auto eval = lldb_eval::EvaluateExpressionAsync(
+      frame_, "__count(large_array_of_int, 20000)", opts);
+  lldb_eval::EvaluationResult result = eval.Wait();
+  EXPECT_TRUE(eval.IsDone());
+  ASSERT_TRUE(result.error.Success());
+  EXPECT_EQ(result.value.GetValueAsSigned(), 2);
+
+  // The expression compiled in a type scope.
+  lldb::SBValue array_of_s = frame_.FindVariable("array_of_s");
+  lldb::SBError error;
+  auto expr = lldb_eval::CompileExpression(
+      array_of_s.GetTarget(), array_of_s.GetChildAtIndex(0).GetType(),
+      "x * 2", error);
+  ASSERT_TRUE(error.Success());
+  eval = lldb_eval::EvaluateExpressionAsync(array_of_s.GetChildAtIndex(1),
+                                            expr, {});
+  ASSERT_TRUE(eval.WaitFor(std::chrono::seconds(60)));
+  result = eval.Wait();
+  ASSERT_TRUE(result.error.Success());
+  EXPECT_EQ(result.value.GetValueAsSigned(), 4);
+
+  // The deadline has already passed, nothing is evaluated.
+  eval = lldb_eval::EvaluateExpressionAsync(
+      frame_, "__count(large_array_of_int, 20000)", opts,
+      std::chrono::steady_clock::now());
+  result = eval.Wait();
+  EXPECT_FALSE(result.value.IsValid());
+  EXPECT_THAT(result.error.GetCString(),
+              testing::HasSubstr("evaluation deadline exceeded"));
+
+  // The evaluation may finish before it's cancelled.
+  eval = lldb_eval::EvaluateExpressionAsync(
+      frame_, "__count(large_array_of_int, 20000)", opts);
+  eval.Cancel();
+  result = eval.Wait();
+  if (result.error.Fail()) {
+    EXPECT_THAT(result.error.GetCString(),
+                testing::HasSubstr("evaluation cancelled"));
+  } else {
+    EXPECT_EQ(result.value.GetValueAsSigned(), 2);
+  }
+}
+#endif
+
+TEST_F(EvalTest, TestEvaluationBudget) {
+  lldb_eval::Options opts;
+  lldb::SBError error;
+
+  opts.max_node_evaluations = 2;
+  lldb_eval::EvaluateExpression(frame_, "1 + 2 + 3", opts, error);
+  EXPECT_THAT(error.GetCString(),
+              testing::HasSubstr("evaluation exceeded the limit of 2 nodes"));
+  opts.max_node_evaluations = 5;
+  EXPECT_EQ(lldb_eval::EvaluateExpression(frame_, "1 + 2 + 3", opts, error)
+                .GetValueAsSigned(),
+            6);
+  EXPECT_TRUE(error.Success());
+
+  // The buffer scan stops before reading the chunk exceeding the limit.
+  opts.max_bytes_read = 1024;
+  lldb_eval::EvaluateExpression(frame_, "__count(large_array_of_int, 20000)",
+                                opts, error);
+  EXPECT_THAT(
+      error.GetCString(),
+      testing::HasSubstr("evaluation exceeded the limit of 1024 bytes read"));
+  opts.max_bytes_read = 1024 * 1024;
+  EXPECT_EQ(lldb_eval::EvaluateExpression(
+                frame_, "__count(large_array_of_int, 20000)", opts, error)
+                .GetValueAsSigned(),
+            2);
+  EXPECT_TRUE(error.Success());
+}
+
 TEST_F(EvalTest, TestUniquePtr) {
 #ifdef _WIN32
   // On Windows we're not using `libc++` and therefore the layout of
@@ -3449,6 +4814,35 @@ TEST_F(EvalTest, TestSharedPtrCompare) {
 #endif
 }
 
+TEST_F(EvalTest, TestSmartPtrOffset) {
+#ifdef _WIN32
+  // On Windows we're not using `libc++` and therefore the layout of
+  // `std::shared_ptr` is different.
+  GTEST_SKIP() << "not supported on Windows";
+#else
+  // The raw pointer is found in the layout of the specialization once per
+  // target, and read without the synthetic children.
+  auto cache = lldb_eval::TargetCache::Get(process_.GetTarget());
+  lldb::SBValue ptr_node = frame_.FindVariable("ptr_node");
+  std::optional<uint64_t> offset =
+      cache->GetSmartPtrOffset(ptr_node.GetType());
+  ASSERT_TRUE(offset.has_value());
+  EXPECT_EQ(ptr_node.GetLoadAddress() + *offset,
+            ptr_node.GetNonSyntheticValue()
+                .GetChildMemberWithName("__ptr_")
+                .GetLoadAddress());
+  EXPECT_TRUE(
+      cache->GetSmartPtrOffset(frame_.FindVariable("ptr_void").GetType()));
+  lldb::SBValue ptr_int_weak = frame_.FindVariable("ptr_int_weak");
+  EXPECT_TRUE(cache->GetSmartPtrOffset(ptr_int_weak.GetType()));
+
+  this->compare_with_lldb_ = false;
+  EXPECT_THAT(Eval("ptr_node->next->value"), IsEqual("2"));
+  EXPECT_THAT(Eval("ptr_null == nullptr"), IsEqual("true"));
+  EXPECT_THAT(Eval("*ptr_int + 1"), IsEqual("2"));
+#endif
+}
+
 TEST_F(EvalTest, TestTypeComparison) {
   // This test is for border-case situations in the CompareTypes function.
 
@@ -3580,6 +4974,186 @@ TEST_F(EvalTest, TestSeparateParsingWithContextVars) {
               IsError("use of undeclared identifier '$y'"));
 }
 
+#ifndef __EMSCRIPTEN__
+TEST_F(EvalTest, TestBoundContextVars) {
+  ASSERT_TRUE(CreateContextVariable("$x", "1"));
+  ASSERT_TRUE(CreateContextVariable("$y", "2.5"));
+  lldb::SBValue x = vars_["$x"];
+  lldb::SBValue y = vars_["$y"];
+  lldb::SBValue scope = frame_.FindVariable("c");
+
+  std::vector<lldb_eval::ContextArgument> args = {{"$x", x.GetType()},
+                                                  {"$y", y.GetType()}};
+  lldb_eval::Options opts;
+  opts.context_args = {args.data(), args.size()};
+
+  lldb::SBError error;
+  auto expr = lldb_eval::CompileExpression(
+      scope.GetTarget(), scope.GetType(), "c_ + $x + $y", opts, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_EQ(expr->context_slots, (std::vector<std::string>{"$x", "$y"}));
+
+  // The values are bound by the slot index.
+  std::vector<lldb::SBValue> values = {x, y};
+  lldb::SBValue ret = lldb_eval::EvaluateBoundExpression(
+      scope, expr, {values.data(), values.size()}, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_STREQ(ret.GetValue(), "8.5");
+
+  // Same result as binding by name.
+  std::vector<lldb_eval::ContextVariable> vars = {{"$y", y}, {"$x", x}};
+  ret = lldb_eval::EvaluateExpression(scope, expr, {vars.data(), vars.size()},
+                                      error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_STREQ(ret.GetValue(), "8.5");
+
+  std::vector<lldb::SBValue> swapped = {y, x};
+  lldb_eval::EvaluateBoundExpression(scope, expr,
+                                     {swapped.data(), swapped.size()}, error);
+  EXPECT_THAT(error.GetCString(),
+              testing::HasSubstr("unexpected type of context variable '$x' "
+                                 "(expected 'int', got 'double')"));
+
+  // Unbound slots.
+  std::vector<lldb::SBValue> incomplete = {x};
+  lldb_eval::EvaluateBoundExpression(
+      scope, expr, {incomplete.data(), incomplete.size()}, error);
+  EXPECT_THAT(error.GetCString(),
+              testing::HasSubstr("use of undeclared identifier '$y'"));
+  incomplete = {lldb::SBValue(), y};
+  lldb_eval::EvaluateBoundExpression(
+      scope, expr, {incomplete.data(), incomplete.size()}, error);
+  EXPECT_THAT(error.GetCString(),
+              testing::HasSubstr("use of undeclared identifier '$x'"));
+}
+#endif
+
+TEST_F(EvalTest, TestCompiledExprCache) {
+  lldb::SBValue scope = frame_.FindVariable("c");
+  lldb::SBTarget target = scope.GetTarget();
+
+  lldb_eval::Options opts;
+  opts.use_compiled_expr_cache = true;
+
+  lldb::SBError error;
+  auto expr = lldb_eval::CompileExpression(target, scope.GetType(), "a_ * b_",
+                                           opts, error);
+  ASSERT_TRUE(error.Success());
+
+  // The same expression in the same scope is served from the cache.
+  EXPECT_EQ(lldb_eval::CompileExpression(target, scope.GetType(), "a_ * b_",
+                                         opts, error),
+            expr);
+  // Different expression or scope produce different compiled expressions.
+  EXPECT_NE(lldb_eval::CompileExpression(target, scope.GetType(), "a_ + b_",
+                                         opts, error),
+            expr);
+  EXPECT_NE(lldb_eval::CompileExpression(
+                target, frame_.FindVariable("d").GetType(), "a_ * b_", opts,
+                error),
+            expr);
+
+  // The options changing the compiled expression are a part of the key.
+  lldb_eval::Options bytecode_opts = opts;
+  bytecode_opts.use_bytecode = true;
+  auto bytecode_expr = lldb_eval::CompileExpression(
+      target, scope.GetType(), "a_ * b_", bytecode_opts, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_NE(bytecode_expr, expr);
+  EXPECT_NE(bytecode_expr->bytecode, nullptr);
+  EXPECT_EQ(lldb_eval::CompileExpression(target, scope.GetType(), "a_ * b_",
+                                         opts, error)
+                ->bytecode,
+            nullptr);
+  lldb_eval::Options folding_opts = opts;
+  folding_opts.fold_constants = true;
+  EXPECT_NE(lldb_eval::CompileExpression(target, scope.GetType(), "a_ * b_",
+                                         folding_opts, error),
+            expr);
+  lldb_eval::Options scalar_opts = opts;
+  scalar_opts.scalar_tier_threshold = 1;
+  auto scalar_expr = lldb_eval::CompileExpression(
+      target, scope.GetType(), "a_ * b_", scalar_opts, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_NE(scalar_expr, expr);
+  EXPECT_NE(scalar_expr->scalar_tier, nullptr);
+  EXPECT_EQ(lldb_eval::CompileExpression(target, scope.GetType(), "a_ * b_",
+                                         opts, error)
+                ->scalar_tier,
+            nullptr);
+
+  // Failed compilations are not cached.
+  EXPECT_EQ(lldb_eval::CompileExpression(target, scope.GetType(), "a_ * x_",
+                                         opts, error),
+            nullptr);
+  EXPECT_TRUE(error.Fail());
+
+  // The cache isn't used unless requested.
+  opts.use_compiled_expr_cache = false;
+  EXPECT_NE(lldb_eval::CompileExpression(target, scope.GetType(), "a_ * b_",
+                                         opts, error),
+            expr);
+
+  // Invalidation drops the cached entries.
+  opts.use_compiled_expr_cache = true;
+  lldb_eval::InvalidateCaches(target);
+  auto new_expr = lldb_eval::CompileExpression(target, scope.GetType(),
+                                               "a_ * b_", opts, error);
+  ASSERT_TRUE(error.Success());
+  EXPECT_NE(new_expr, expr);
+  EXPECT_THAT(Scope("c").Eval(new_expr), IsEqual("12"));
+
+  lldb_eval::ClearCaches();
+}
+
+TEST_F(EvalTest, TestCacheMemoryLimits) {
+  lldb::SBValue scope = frame_.FindVariable("c");
+  lldb::SBTarget target = scope.GetTarget();
+  lldb_eval::ClearCaches();
+
+  lldb_eval::Options opts;
+  opts.use_compiled_expr_cache = true;
+  lldb::SBError error;
+  auto compile = [&](const char* expr) {
+    auto compiled =
+        lldb_eval::CompileExpression(target, scope.GetType(), expr, opts, error);
+    EXPECT_TRUE(error.Success()) << expr;
+    return compiled;
+  };
+
+  auto first = compile("a_ * b_");
+  size_t expr_bytes = first->GetMemoryUsage();
+  EXPECT_GT(expr_bytes, strlen("a_ * b_"));
+  lldb_eval::CacheMemoryUsage usage = lldb_eval::GetCacheMemoryUsage();
+  EXPECT_GT(usage.compiled_exprs, expr_bytes);
+  EXPECT_GT(usage.types, 0u);
+
+  // Room for about two expressions, the least recently used one is evicted.
+  lldb_eval::CacheMemoryUsage limits;
+  limits.compiled_exprs = usage.compiled_exprs * 2 + usage.compiled_exprs / 2;
+  lldb_eval::SetCacheMemoryLimits(limits);
+  auto second = compile("a_ + b_");
+  EXPECT_EQ(compile("a_ * b_"), first);
+  auto third = compile("a_ - b_");
+  EXPECT_LE(lldb_eval::GetCacheMemoryUsage().compiled_exprs,
+            limits.compiled_exprs);
+  EXPECT_EQ(compile("a_ * b_"), first);
+  EXPECT_NE(compile("a_ + b_"), second);
+
+  // The limits of the target caches evict the entries too.
+  limits = lldb_eval::CacheMemoryUsage();
+  limits.types = 1;
+  lldb_eval::SetCacheMemoryLimits(limits);
+  EXPECT_LT(lldb_eval::GetCacheMemoryUsage().types, usage.types);
+  EXPECT_THAT(Scope("c").Eval(compile("(long long) a_ * b_")), IsEqual("12"));
+
+  lldb_eval::SetCacheMemoryLimits(lldb_eval::CacheMemoryUsage());
+  lldb_eval::ClearCaches();
+  usage = lldb_eval::GetCacheMemoryUsage();
+  EXPECT_EQ(usage.compiled_exprs, 0u);
+  EXPECT_EQ(usage.types, 0u);
+}
+
 TEST_F(EvalTest, TestRegisters) {
   // LLDB loses the value formatter when evaluating registers and prints their
   // value "as is". In lldb-eval the value formatter is preserved and the
@@ -3616,6 +5190,90 @@ TEST_F(EvalTest, TestRegistersNoDollar) {
     EXPECT_THAT(Eval(reg_name), IsEqual(reg.GetValue()));
   }
 }
+
+TEST_F(EvalTest, TestRegistersFrameIndex) {
+  // The scalar registers are read when the registers are indexed.
+  auto index = lldb_eval::FrameIndex::Get(frame_);
+  auto rsp = index->FindRegister("rsp");
+  ASSERT_TRUE(rsp.value.IsValid());
+  ASSERT_TRUE(rsp.contents.has_value());
+  uint64_t rsp_value = frame_.FindRegister("rsp").GetValueAsUnsigned();
+  EXPECT_EQ(rsp.contents->getZExtValue(), rsp_value);
+  // Alternative names are looked up in the frame.
+  EXPECT_TRUE(index->FindRegister("flags").value.IsValid());
+  EXPECT_FALSE(index->FindRegister("foo").value.IsValid());
+
+  std::string rsp_plus_8 = std::to_string(rsp_value + 8);
+  const char* exprs[] = {
+      "(uint64_t)$rsp + 8",
+      "(uint64_t)rsp + 8",
+      "(uint64_t)$rsp == (uint64_t)$sp",
+  };
+  lldb_eval::Options opts;
+  opts.use_frame_index = true;
+  std::vector<lldb_eval::EvaluationResult> results;
+  lldb_eval::EvaluateExpressions(frame_, {exprs, std::size(exprs)}, opts,
+                                 results);
+
+  ASSERT_EQ(results.size(), std::size(exprs));
+  auto result = [&](size_t i) {
+    return EvalResult{results[i].error, results[i].value};
+  };
+  EXPECT_THAT(result(0), IsEqual(rsp_plus_8));
+  EXPECT_THAT(result(1), IsEqual(rsp_plus_8));
+  EXPECT_THAT(result(2), IsEqual("true"));
+
+  // The contents are dropped, the registers are read via LLDB then.
+  index->DropRegisterContents();
+  EXPECT_FALSE(index->FindRegister("rsp").contents.has_value());
+  lldb::SBError error;
+  lldb::SBValue value = lldb_eval::EvaluateExpression(
+      frame_, "(uint64_t)$rsp + 8", opts, error);
+  EXPECT_THAT((EvalResult{error, value}), IsEqual(rsp_plus_8));
+}
+
+TEST_F(EvalTest, TestRegisterWrites) {
+  uint64_t rax = frame_.FindRegister("rax").GetValueAsUnsigned();
+  auto rax_plus = [rax](uint64_t n) { return std::to_string(rax + n); };
+
+  // The writes are seen by the following reads, both in the same batch and
+  // in the later evaluations at the same stop.
+  for (bool use_frame_index : {false, true}) {
+    const char* exprs[] = {
+        "(uint64_t)$rax",
+        "(uint64_t)$rax++",
+        "(uint64_t)$rax",
+        "(uint64_t)++$rax",
+        "(uint64_t)$rax",
+        "(uint64_t)--$rax",
+    };
+    lldb_eval::Options opts;
+    opts.allow_side_effects = true;
+    opts.use_frame_index = use_frame_index;
+    std::vector<lldb_eval::EvaluationResult> results;
+    lldb_eval::EvaluateExpressions(frame_, {exprs, std::size(exprs)}, opts,
+                                   results);
+
+    ASSERT_EQ(results.size(), std::size(exprs));
+    auto result = [&](size_t i) {
+      return EvalResult{results[i].error, results[i].value};
+    };
+    EXPECT_THAT(result(0), IsEqual(rax_plus(0)));
+    EXPECT_THAT(result(1), IsEqual(rax_plus(0)));
+    EXPECT_THAT(result(2), IsEqual(rax_plus(1)));
+    EXPECT_THAT(result(3), IsEqual(rax_plus(2)));
+    EXPECT_THAT(result(4), IsEqual(rax_plus(2)));
+    EXPECT_THAT(result(5), IsEqual(rax_plus(1)));
+
+    lldb::SBError error;
+    lldb::SBValue value =
+        lldb_eval::EvaluateExpression(frame_, "(uint64_t)$rax--", opts, error);
+    EXPECT_THAT((EvalResult{error, value}), IsEqual(rax_plus(1)));
+    value =
+        lldb_eval::EvaluateExpression(frame_, "(uint64_t)$rax", opts, error);
+    EXPECT_THAT((EvalResult{error, value}), IsEqual(rax_plus(0)));
+  }
+}
 #endif
 
 TEST_F(EvalTest, TestCharParsing) {
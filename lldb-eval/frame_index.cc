@@ -0,0 +1,291 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/frame_index.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lldb-eval/type.h"
+#include "lldb-eval/value.h"
+#include "lldb/API/SBBlock.h"
+#include "lldb/API/SBFrame.h"
+#include "lldb/API/SBProcess.h"
+#include "lldb/API/SBThread.h"
+#include "lldb/API/SBValue.h"
+#include "lldb/API/SBValueList.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace lldb_eval {
+
+namespace {
+
+uint32_t GetStopID(lldb::SBFrame frame) {
+  return frame.GetThread().GetProcess().GetStopID();
+}
+
+// Estimated overhead of a node of the maps (the links and the hash), on top of
+// the key and the value stored in it.
+constexpr size_t kNodeOverhead = 2 * sizeof(void*);
+
+// Estimated size of a memoized value of `map` named `name`.
+template <typename T>
+size_t GetEntryBytes(const llvm::StringMap<T>& map, llvm::StringRef name) {
+  return sizeof(*map.begin()) + kNodeOverhead + name.size();
+}
+
+// Registry of the frame indexes. The indexes of the previous stops are dropped
+// on the first miss after the process resumes, and at most `kMaxEntries` of the
+// current stop are kept, e.g. the selected frame and the frames shown in the
+// call stack window. The frames have no hashable identity, they are only
+// comparable via `IsValidFor()`, so a lookup checks up to `kMaxEntries` of
+// them.
+class FrameIndexRegistry {
+ public:
+  static constexpr size_t kMaxEntries = 16;
+
+  static FrameIndexRegistry& Instance() {
+    static FrameIndexRegistry* registry = new FrameIndexRegistry();
+    return *registry;
+  }
+
+  template <typename Factory>
+  std::shared_ptr<FrameIndex> Get(lldb::SBFrame frame, Factory factory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = indexes_.begin(); it != indexes_.end(); ++it) {
+      if ((*it)->IsValidFor(frame)) {
+        // Move the index to the back, it's the most recently used now.
+        std::rotate(it, it + 1, indexes_.end());
+        // The index may have grown since it was used last.
+        EvictIfNeeded();
+        return indexes_.back();
+      }
+    }
+
+    // Indexes of the previous stops are never used again.
+    llvm::erase_if(indexes_, [](const std::shared_ptr<FrameIndex>& index) {
+      return !index->IsValidFor(index->frame());
+    });
+    if (indexes_.size() == kMaxEntries) {
+      indexes_.erase(indexes_.begin());
+    }
+    indexes_.push_back(factory());
+    EvictIfNeeded();
+    return indexes_.back();
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    indexes_.clear();
+  }
+
+  size_t GetMemoryUsage() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t bytes = 0;
+    for (const auto& index : indexes_) {
+      bytes += index->GetMemoryUsage();
+    }
+    return bytes;
+  }
+
+  void SetMemoryLimit(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memory_limit_ = bytes;
+    EvictIfNeeded();
+  }
+
+ private:
+  // Evicts the least recently used indexes (at the front) while the indexes
+  // exceed the memory limit, except for the last one. Requires `mutex_`.
+  void EvictIfNeeded() {
+    if (memory_limit_ == 0) {
+      return;
+    }
+    size_t bytes = 0;
+    for (const auto& index : indexes_) {
+      bytes += index->GetMemoryUsage();
+    }
+    size_t num_evicted = 0;
+    while (bytes > memory_limit_ && num_evicted + 1 < indexes_.size()) {
+      bytes -= indexes_[num_evicted++]->GetMemoryUsage();
+    }
+    indexes_.erase(indexes_.begin(), indexes_.begin() + num_evicted);
+  }
+
+  std::mutex mutex_;
+  // The least recently used indexes are at the front.
+  std::vector<std::shared_ptr<FrameIndex>> indexes_;
+  size_t memory_limit_ = 0;
+};
+
+}  // namespace
+
+std::shared_ptr<FrameIndex> FrameIndex::Get(lldb::SBFrame frame) {
+  return FrameIndexRegistry::Instance().Get(frame, [&frame] {
+    return std::shared_ptr<FrameIndex>(new FrameIndex(frame));
+  });
+}
+
+void FrameIndex::Clear() { FrameIndexRegistry::Instance().Clear(); }
+
+size_t FrameIndex::GetTotalMemoryUsage() {
+  return FrameIndexRegistry::Instance().GetMemoryUsage();
+}
+
+void FrameIndex::SetMemoryLimit(size_t bytes) {
+  FrameIndexRegistry::Instance().SetMemoryLimit(bytes);
+}
+
+FrameIndex::FrameIndex(lldb::SBFrame frame)
+    : frame_(std::move(frame)), stop_id_(GetStopID(frame_)) {
+  // Index the same variables `SBFrame::FindVariable()` finds: the variables
+  // of the block the frame is stopped in and of its parent blocks up to the
+  // function (or the inlined function), but not the globals of the compile
+  // unit. The blocks are walked from the innermost one and the first variable
+  // with the given name wins, so shadowed variables resolve the same way.
+  for (lldb::SBBlock block = frame_.GetBlock(); block.IsValid();
+       block = block.GetParent()) {
+    lldb::SBValueList variables =
+        block.GetVariables(frame_, /*arguments*/ true, /*locals*/ true,
+                           /*statics*/ true, lldb::eNoDynamicValues);
+    for (uint32_t i = 0; i < variables.GetSize(); ++i) {
+      lldb::SBValue value = variables.GetValueAtIndex(i);
+      const char* name = value.GetName();
+      if (name && value.IsInScope()) {
+        variables_.try_emplace(name, std::move(value));
+      }
+    }
+    if (block.IsInlined()) {
+      break;
+    }
+  }
+  sorted_variables_.reserve(variables_.size());
+  for (const auto& variable : variables_) {
+    sorted_variables_.push_back(variable.getKey());
+  }
+  std::sort(sorted_variables_.begin(), sorted_variables_.end());
+  this_ = FindVariable("this");
+
+  size_t bytes = sizeof(*this) +
+                 sorted_variables_.capacity() * sizeof(llvm::StringRef);
+  for (const auto& variable : variables_) {
+    bytes += GetEntryBytes(variables_, variable.getKey());
+  }
+  bytes_.store(bytes, std::memory_order_relaxed);
+}
+
+bool FrameIndex::IsValidFor(lldb::SBFrame frame) const {
+  return frame_.IsEqual(frame) && stop_id_ == GetStopID(frame);
+}
+
+lldb::SBValue FrameIndex::FindVariable(llvm::StringRef name) const {
+  auto it = variables_.find(name);
+  return it != variables_.end() ? it->second : lldb::SBValue();
+}
+
+llvm::ArrayRef<llvm::StringRef> FrameIndex::FindVariableNames(
+    llvm::StringRef prefix) const {
+  return FindNamesWithPrefix(sorted_variables_, prefix);
+}
+
+lldb::SBValue FrameIndex::FindMember(llvm::StringRef name) {
+  if (!this_) {
+    return lldb::SBValue();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = members_.find(name);
+    if (it != members_.end()) {
+      return it->second;
+    }
+  }
+  // LLDB needs a null-terminated name.
+  lldb::SBValue value = this_.GetChildMemberWithName(name.str().c_str());
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = members_.try_emplace(name, std::move(value));
+  if (inserted) {
+    bytes_.fetch_add(GetEntryBytes(members_, name), std::memory_order_relaxed);
+  }
+  return it->second;
+}
+
+void FrameIndex::IndexRegisters() {
+  // The registers are read in bulk, all of them at the same stop. LLDB reads
+  // the whole register set from the process at once, so reading the rest of
+  // the registers of a set is cheap.
+  lldb::SBValueList register_sets = frame_.GetRegisters();
+  for (uint32_t i = 0; i < register_sets.GetSize(); ++i) {
+    lldb::SBValue register_set = register_sets.GetValueAtIndex(i);
+    for (uint32_t j = 0; j < register_set.GetNumChildren(); ++j) {
+      lldb::SBValue value = register_set.GetChildAtIndex(j).GetStaticValue();
+      const char* name = value.GetName();
+      if (!name) {
+        continue;
+      }
+      std::optional<llvm::APInt> contents = ReadRegisterContents(value);
+      auto [it, inserted] = registers_.try_emplace(
+          name, Register{std::move(value), std::move(contents)});
+      if (inserted) {
+        bytes_.fetch_add(GetEntryBytes(registers_, it->getKey()),
+                         std::memory_order_relaxed);
+      }
+    }
+  }
+  registers_indexed_ = true;
+}
+
+FrameIndex::Register FrameIndex::FindRegister(llvm::StringRef name) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!registers_indexed_) {
+      IndexRegisters();
+    }
+    auto it = registers_.find(name);
+    if (it != registers_.end()) {
+      return it->second;
+    }
+  }
+  // Not a name of the register sets, but LLDB also knows the registers by
+  // their alternative names. LLDB needs a null-terminated name.
+  lldb::SBValue value = frame_.FindRegister(name.str().c_str());
+  if (value) {
+    value = value.GetStaticValue();
+  }
+  std::optional<llvm::APInt> contents =
+      value ? ReadRegisterContents(value) : std::nullopt;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = registers_.try_emplace(
+      name, Register{std::move(value), std::move(contents)});
+  if (inserted) {
+    bytes_.fetch_add(GetEntryBytes(registers_, name),
+                     std::memory_order_relaxed);
+  }
+  return it->second;
+}
+
+void FrameIndex::DropRegisterContents() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& entry : registers_) {
+    entry.second.contents.reset();
+  }
+}
+
+}  // namespace lldb_eval
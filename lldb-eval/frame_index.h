@@ -0,0 +1,142 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_FRAME_INDEX_H_
+#define LLDB_EVAL_FRAME_INDEX_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "lldb/API/SBFrame.h"
+#include "lldb/API/SBValue.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace lldb_eval {
+
+// Index of the identifiers available in a frame: local variables, members of
+// `this` and registers. The index describes the frame at one stop of the
+// process and is shared by all the contexts created for the frame (see
+// `Options::use_frame_index` in api.h), so the identifiers of many expressions
+// are resolved without scanning the frame's variables for each of them.
+//
+// Local variables (the ones `SBFrame::FindVariable()` finds, i.e. without the
+// globals of the compile unit) are indexed when the index is created. Members
+// are looked up on the first use and memoized, negative results included.
+// Registers are indexed on the first register lookup, reading the contents of
+// all the scalar registers at once. Global variables are cached per target (see
+// `TargetCache`). All methods are thread-safe.
+//
+// The indexes are kept in a registry with the least recently used ones evicted
+// first, when there are too many of them or when they exceed the memory limit
+// (see `SetMemoryLimit()`).
+class FrameIndex {
+ public:
+  // Returns the index of `frame` at the current stop, creating it if necessary.
+  static std::shared_ptr<FrameIndex> Get(lldb::SBFrame frame);
+
+  // Drops all the indexes.
+  static void Clear();
+
+  // Returns the estimated memory held by all the indexes, in bytes.
+  static size_t GetTotalMemoryUsage();
+
+  // Sets the limit of the memory held by all the indexes, zero means no limit.
+  // The index used last is kept even if it exceeds the limit alone.
+  static void SetMemoryLimit(size_t bytes);
+
+  FrameIndex(const FrameIndex&) = delete;
+  FrameIndex& operator=(const FrameIndex&) = delete;
+
+  // Whether the index describes `frame` at the current stop of the process.
+  bool IsValidFor(lldb::SBFrame frame) const;
+
+  lldb::SBFrame frame() const { return frame_; }
+
+  // Returns the local variable (or an argument) visible in the frame, the
+  // innermost one if the name is shadowed.
+  lldb::SBValue FindVariable(llvm::StringRef name) const;
+
+  // Returns the names of the local variables starting with `prefix`, in the
+  // lexicographical order.
+  llvm::ArrayRef<llvm::StringRef> FindVariableNames(
+      llvm::StringRef prefix) const;
+
+  // The `this` variable of the frame, invalid if there is none.
+  lldb::SBValue this_value() const { return this_; }
+
+  // Returns the member of `this`.
+  lldb::SBValue FindMember(llvm::StringRef name);
+
+  struct Register {
+    // Static value of the register, invalid if there's no such register.
+    lldb::SBValue value;
+    // Contents of the register read when it was indexed, nullopt if it isn't
+    // a scalar (e.g. a vector register) or the contents aren't known anymore
+    // (see `DropRegisterContents()`).
+    std::optional<llvm::APInt> contents;
+  };
+
+  // Returns the register of the frame. The registers of all the register sets
+  // are indexed by their names on the first call, other names (e.g. the
+  // aliases like "pc" or "flags") are looked up in the frame and memoized.
+  Register FindRegister(llvm::StringRef name);
+
+  // Forgets the contents of the registers, e.g. after one of them is written
+  // to. The registers are read via lldb::SBValue from then on.
+  void DropRegisterContents();
+
+  // Estimated memory held by the index, in bytes. Only the data owned by the
+  // index is counted, not the objects LLDB keeps for the values.
+  size_t GetMemoryUsage() const {
+    return bytes_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  explicit FrameIndex(lldb::SBFrame frame);
+
+  // Indexes the registers of all the register sets. Requires `mutex_`.
+  void IndexRegisters();
+
+ private:
+  lldb::SBFrame frame_;
+  uint32_t stop_id_;
+
+  // Immutable after the construction.
+  llvm::StringMap<lldb::SBValue> variables_;
+  // Keys of `variables_` in the lexicographical order.
+  std::vector<llvm::StringRef> sorted_variables_;
+  lldb::SBValue this_;
+
+  std::mutex mutex_;
+  llvm::StringMap<lldb::SBValue> members_;
+  bool registers_indexed_ = false;
+  llvm::StringMap<Register> registers_;
+  // See `GetMemoryUsage()`, grows with the memoized lookups.
+  std::atomic<size_t> bytes_{0};
+};
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_FRAME_INDEX_H_
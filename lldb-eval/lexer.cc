@@ -0,0 +1,320 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/lexer.h"
+
+#include <vector>
+
+#include "clang/Basic/IdentifierTable.h"
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Basic/TokenKinds.h"
+#include "clang/Lex/Token.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace {
+
+bool IsIdentifierStart(char c) {
+  return llvm::isAlpha(c) || c == '_' || c == '$';
+}
+
+bool IsIdentifierContinue(char c) {
+  return llvm::isAlnum(c) || c == '_' || c == '$';
+}
+
+bool IsWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' ||
+         c == '\r';
+}
+
+clang::tok::TokenKind CharConstantKind(llvm::StringRef prefix) {
+  if (prefix == "L") return clang::tok::wide_char_constant;
+  if (prefix == "u8") return clang::tok::utf8_char_constant;
+  if (prefix == "u") return clang::tok::utf16_char_constant;
+  if (prefix == "U") return clang::tok::utf32_char_constant;
+  return clang::tok::char_constant;
+}
+
+clang::tok::TokenKind StringLiteralKind(llvm::StringRef prefix) {
+  if (prefix == "L") return clang::tok::wide_string_literal;
+  if (prefix == "u8") return clang::tok::utf8_string_literal;
+  if (prefix == "u") return clang::tok::utf16_string_literal;
+  if (prefix == "U") return clang::tok::utf32_string_literal;
+  return clang::tok::string_literal;
+}
+
+}  // namespace
+
+namespace lldb_eval {
+
+BuiltinLexer::BuiltinLexer(const clang::SourceManager& sm,
+                           const clang::IdentifierTable& keywords)
+    : keywords_(keywords) {
+  clang::FileID fid = sm.getMainFileID();
+  llvm::StringRef buffer = sm.getBufferData(fid);
+  begin_ = buffer.begin();
+  end_ = buffer.end();
+  cur_ = begin_;
+  start_loc_ = sm.getLocForStartOfFile(fid);
+}
+
+std::vector<clang::Token> BuiltinLexer::LexAll() {
+  std::vector<clang::Token> tokens;
+  do {
+    tokens.push_back(Lex());
+  } while (tokens.back().isNot(clang::tok::eof));
+  return tokens;
+}
+
+char BuiltinLexer::Peek(size_t n) const {
+  return static_cast<size_t>(end_ - cur_) > n ? cur_[n] : '\0';
+}
+
+void BuiltinLexer::SkipWhitespaceAndComments() {
+  while (cur_ != end_) {
+    if (IsWhitespace(*cur_)) {
+      ++cur_;
+    } else if (Peek() == '/' && Peek(1) == '/') {
+      while (cur_ != end_ && *cur_ != '\n') {
+        ++cur_;
+      }
+    } else if (Peek() == '/' && Peek(1) == '*') {
+      cur_ += 2;
+      while (cur_ != end_ && !(Peek() == '*' && Peek(1) == '/')) {
+        ++cur_;
+      }
+      // Unterminated comment extends to the end of the buffer.
+      cur_ = cur_ == end_ ? end_ : cur_ + 2;
+    } else {
+      return;
+    }
+  }
+}
+
+clang::Token BuiltinLexer::Lex() {
+  SkipWhitespaceAndComments();
+
+  const char* start = cur_;
+  if (cur_ == end_) {
+    return FormToken(clang::tok::eof, start);
+  }
+
+  char c = Peek();
+
+  // Character and string literals with an optional encoding prefix.
+  size_t prefix_size = 0;
+  if (c == 'u' && Peek(1) == '8') {
+    prefix_size = 2;
+  } else if (c == 'u' || c == 'U' || c == 'L') {
+    prefix_size = 1;
+  }
+  char quote = Peek(prefix_size);
+  if (quote == '\'' || quote == '"') {
+    return LexQuoted(start, prefix_size);
+  }
+
+  if (IsIdentifierStart(c)) {
+    return LexIdentifier(start);
+  }
+  if (llvm::isDigit(c) || (c == '.' && llvm::isDigit(Peek(1)))) {
+    return LexNumericConstant(start);
+  }
+  return LexPunctuator(start);
+}
+
+clang::Token BuiltinLexer::LexIdentifier(const char* start) {
+  while (cur_ != end_ && IsIdentifierContinue(*cur_)) {
+    ++cur_;
+  }
+
+  clang::tok::TokenKind kind = clang::tok::identifier;
+  auto keyword = keywords_.find(llvm::StringRef(start, cur_ - start));
+  if (keyword != keywords_.end()) {
+    // Keywords and alternative operator representations (e.g. `and`) have
+    // their own token kinds, regular identifiers are `identifier`.
+    kind = keyword->getValue()->getTokenID();
+  }
+  return FormToken(kind, start);
+}
+
+clang::Token BuiltinLexer::LexNumericConstant(const char* start) {
+  // Lex a "preprocessing number", the same way clang does. The validity of the
+  // literal is checked later by clang::NumericLiteralParser.
+  char prev = *cur_++;
+  while (cur_ != end_) {
+    char c = *cur_;
+    if (IsIdentifierContinue(c) || c == '.') {
+      // Fall through.
+    } else if ((c == '+' || c == '-') &&
+               (prev == 'e' || prev == 'E' || prev == 'p' || prev == 'P')) {
+      // Exponent sign.
+    } else if (c == '\'' && IsIdentifierContinue(Peek(1))) {
+      // C++14 digit separator.
+    } else {
+      break;
+    }
+    prev = c;
+    ++cur_;
+  }
+  return FormToken(clang::tok::numeric_constant, start);
+}
+
+clang::Token BuiltinLexer::LexQuoted(const char* start, size_t prefix_size) {
+  llvm::StringRef prefix(start, prefix_size);
+  cur_ += prefix_size;
+  char quote = *cur_++;
+
+  const char* content_begin = cur_;
+  while (cur_ != end_ && *cur_ != quote && *cur_ != '\n') {
+    if (*cur_ == '\\' && cur_ + 1 != end_) {
+      ++cur_;
+    }
+    ++cur_;
+  }
+
+  // Unterminated literals and empty character constants are `unknown`,
+  // matching the behaviour of clang::Lexer.
+  if (cur_ == end_ || *cur_ != quote) {
+    return FormToken(clang::tok::unknown, start);
+  }
+  bool is_empty = cur_ == content_begin;
+  ++cur_;
+
+  if (quote == '\'') {
+    if (is_empty) {
+      return FormToken(clang::tok::unknown, start);
+    }
+    return FormToken(CharConstantKind(prefix), start);
+  }
+  return FormToken(StringLiteralKind(prefix), start);
+}
+
+clang::Token BuiltinLexer::LexPunctuator(const char* start) {
+  using namespace clang::tok;
+
+  // Lexes a punctuator of `size` characters.
+  auto form = [this, start](TokenKind kind, size_t size) {
+    cur_ = start + size;
+    return FormToken(kind, start);
+  };
+
+  char c = Peek();
+  char c1 = Peek(1);
+  char c2 = Peek(2);
+
+  switch (c) {
+    case '[':
+      return form(l_square, 1);
+    case ']':
+      return form(r_square, 1);
+    case '(':
+      return form(l_paren, 1);
+    case ')':
+      return form(r_paren, 1);
+    case '{':
+      return form(l_brace, 1);
+    case '}':
+      return form(r_brace, 1);
+    case '~':
+      return form(tilde, 1);
+    case '?':
+      return form(question, 1);
+    case ';':
+      return form(semi, 1);
+    case ',':
+      return form(comma, 1);
+    case '.':
+      if (c1 == '.' && c2 == '.') return form(ellipsis, 3);
+      if (c1 == '*') return form(periodstar, 2);
+      return form(period, 1);
+    case '-':
+      if (c1 == '>' && c2 == '*') return form(arrowstar, 3);
+      if (c1 == '>') return form(arrow, 2);
+      if (c1 == '-') return form(minusminus, 2);
+      if (c1 == '=') return form(minusequal, 2);
+      return form(minus, 1);
+    case '+':
+      if (c1 == '+') return form(plusplus, 2);
+      if (c1 == '=') return form(plusequal, 2);
+      return form(plus, 1);
+    case '&':
+      if (c1 == '&') return form(ampamp, 2);
+      if (c1 == '=') return form(ampequal, 2);
+      return form(amp, 1);
+    case '|':
+      if (c1 == '|') return form(pipepipe, 2);
+      if (c1 == '=') return form(pipeequal, 2);
+      return form(pipe, 1);
+    case '*':
+      if (c1 == '=') return form(starequal, 2);
+      return form(star, 1);
+    case '/':
+      if (c1 == '=') return form(slashequal, 2);
+      return form(slash, 1);
+    case '%':
+      if (c1 == '=') return form(percentequal, 2);
+      return form(percent, 1);
+    case '^':
+      if (c1 == '=') return form(caretequal, 2);
+      return form(caret, 1);
+    case '!':
+      if (c1 == '=') return form(exclaimequal, 2);
+      return form(exclaim, 1);
+    case '=':
+      if (c1 == '=') return form(equalequal, 2);
+      return form(equal, 1);
+    case ':':
+      if (c1 == ':') return form(coloncolon, 2);
+      return form(colon, 1);
+    case '#':
+      if (c1 == '#') return form(hashhash, 2);
+      return form(hash, 1);
+    case '<':
+      if (c1 == '<' && c2 == '=') return form(lesslessequal, 3);
+      if (c1 == '<') return form(lessless, 2);
+      if (c1 == '=') return form(lessequal, 2);
+      return form(less, 1);
+    case '>':
+      if (c1 == '>' && c2 == '=') return form(greatergreaterequal, 3);
+      if (c1 == '>') return form(greatergreater, 2);
+      if (c1 == '=') return form(greaterequal, 2);
+      return form(greater, 1);
+    default:
+      break;
+  }
+
+  // Everything else is an unknown token. Consume the whole UTF-8 sequence to
+  // avoid splitting multi-byte characters.
+  ++cur_;
+  while (cur_ != end_ && (static_cast<unsigned char>(*cur_) & 0xC0) == 0x80) {
+    ++cur_;
+  }
+  return FormToken(unknown, start);
+}
+
+clang::Token BuiltinLexer::FormToken(clang::tok::TokenKind kind,
+                                     const char* start) const {
+  clang::Token token;
+  token.startToken();
+  token.setKind(kind);
+  token.setLocation(start_loc_.getLocWithOffset(start - begin_));
+  token.setLength(cur_ - start);
+  if (clang::tok::isLiteral(kind)) {
+    token.setLiteralData(start);
+  }
+  return token;
+}
+
+}  // namespace lldb_eval
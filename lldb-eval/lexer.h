@@ -0,0 +1,77 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_LEXER_H_
+#define LLDB_EVAL_LEXER_H_
+
+#include <vector>
+
+#include "clang/Basic/IdentifierTable.h"
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Basic/TokenKinds.h"
+#include "clang/Lex/Token.h"
+
+namespace lldb_eval {
+
+// Lightweight lexer for the expression language (see docs/expr-lang.ebnf). It
+// reads the main file of the given source manager and produces the same tokens
+// as clang::Preprocessor would, but without the preprocessor machinery.
+//
+// Not supported (compared to clang::Preprocessor):
+//   * macro expansion (including builtin macros like __LINE__) and directives;
+//   * trigraphs and escaped newlines;
+//   * raw string literals and user-defined literal suffixes;
+//   * non-ASCII identifiers (lexed as `unknown` tokens).
+//
+// Produced tokens don't have IdentifierInfo attached, their spelling can be
+// obtained via clang::Lexer::getSpelling().
+class BuiltinLexer {
+ public:
+  // `keywords` is used for resolving keywords and alternative operator
+  // representations (e.g. `and`) to their token kinds.
+  BuiltinLexer(const clang::SourceManager& sm,
+               const clang::IdentifierTable& keywords);
+
+  // Lexes the whole buffer. The last token is always `eof`.
+  std::vector<clang::Token> LexAll();
+
+  // Lexes the next token. Returns `eof` at the end of the buffer.
+  clang::Token Lex();
+
+ private:
+  char Peek(size_t n = 0) const;
+  void SkipWhitespaceAndComments();
+
+  clang::Token LexIdentifier(const char* start);
+  clang::Token LexNumericConstant(const char* start);
+  clang::Token LexQuoted(const char* start, size_t prefix_size);
+  clang::Token LexPunctuator(const char* start);
+
+  clang::Token FormToken(clang::tok::TokenKind kind, const char* start) const;
+
+ private:
+  const clang::IdentifierTable& keywords_;
+
+  const char* begin_;
+  const char* end_;
+  const char* cur_;
+  clang::SourceLocation start_loc_;
+};
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_LEXER_H_
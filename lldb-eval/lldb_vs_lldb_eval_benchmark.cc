@@ -0,0 +1,173 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares the latency of lldb-eval with the LLDB's own expression evaluator
+// (`SBFrame::EvaluateExpression()`) on the same stopped process. Every
+// expression class is evaluated by both of them in each iteration, the
+// benchmark reports the times of both and their ratio ("speedup" is how many
+// times lldb-eval is faster).
+
+#ifdef _WIN32
+#include <filesystem>
+#else
+#include <errno.h>  // for `program_invocation_name`
+#endif
+
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "lldb-eval/api.h"
+#include "lldb-eval/runner.h"
+#include "lldb/API/SBDebugger.h"
+#include "lldb/API/SBError.h"
+#include "lldb/API/SBExpressionOptions.h"
+#include "lldb/API/SBFrame.h"
+#include "lldb/API/SBProcess.h"
+#include "lldb/API/SBThread.h"
+#include "lldb/API/SBValue.h"
+#include "tools/cpp/runfiles/runfiles.h"
+
+using bazel::tools::cpp::runfiles::Runfiles;
+
+namespace {
+
+struct ExpressionClass {
+  const char* label;
+  const char* expr;
+};
+
+// Expressions supported by both evaluators, see testdata/benchmark_binary.cc.
+constexpr ExpressionClass kExpressionClasses[] = {
+    {"literals", "1 + 2 * 3 - (4 << 1)"},
+    {"local", "arr[1] + points[2].x"},
+    {"member_chain", "head->next->next->next->next->value"},
+    {"global", "global_counter + ns2999::global.value"},
+    {"static_member", "ns::inner::Config::instances"},
+    {"casts", "(long long)points[0].x + (char)1 + (double)arr[2]"},
+    {"hierarchy_cast", "static_cast<Derived*>(base_ptr)->d"},
+    {"qualified_type", "sizeof(ns1999::Type)"},
+};
+
+constexpr int kNumExpressionClasses =
+    static_cast<int>(std::size(kExpressionClasses));
+
+using Clock = std::chrono::steady_clock;
+
+double ElapsedSeconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}  // namespace
+
+class BM : public benchmark::Fixture {
+ public:
+  void SetUp(::benchmark::State&) override {
+#ifdef _WIN32
+    auto cwd = std::filesystem::current_path();
+    std::string argv0 =
+        cwd.parent_path().append("lldb_vs_lldb_eval_benchmark.exe").string();
+#else
+    std::string argv0 = program_invocation_name;
+#endif
+
+    runfiles.reset(Runfiles::Create(argv0));
+
+    lldb_eval::SetupLLDBServerEnv(*runfiles);
+
+    auto binary_path =
+        runfiles->Rlocation("lldb_eval/testdata/benchmark_binary");
+    auto source_path =
+        runfiles->Rlocation("lldb_eval/testdata/benchmark_binary.cc");
+
+    debugger = lldb::SBDebugger::Create(false);
+    process = lldb_eval::LaunchTestProgram(debugger, source_path, binary_path,
+                                           "// BREAK HERE");
+    frame = process.GetSelectedThread().GetSelectedFrame();
+  }
+
+  void TearDown(::benchmark::State&) override {
+    process.Destroy();
+    lldb::SBDebugger::Destroy(debugger);
+  }
+
+  lldb::SBDebugger debugger;
+  lldb::SBProcess process;
+  lldb::SBFrame frame;
+
+  std::unique_ptr<Runfiles> runfiles;
+};
+
+// The iteration time is the time of lldb-eval, the time of LLDB is reported as
+// a counter.
+BENCHMARK_DEFINE_F(BM, LLDBvsLLDBEval)(benchmark::State& state) {
+  const ExpressionClass& expr = kExpressionClasses[state.range(0)];
+  state.SetLabel(expr.label);
+
+  // Disable auto fix-its in LLDB evaluations, lldb-eval doesn't have them.
+  lldb::SBExpressionOptions options;
+  options.SetAutoApplyFixIts(false);
+
+  double lldb_seconds = 0;
+  double lldb_eval_seconds = 0;
+
+  for (auto _ : state) {
+    auto start = Clock::now();
+    lldb::SBValue lldb_value = frame.EvaluateExpression(expr.expr, options);
+    lldb_seconds += ElapsedSeconds(start);
+
+    start = Clock::now();
+    lldb::SBError error;
+    lldb::SBValue lldb_eval_value =
+        lldb_eval::EvaluateExpression(frame, expr.expr, error);
+    double elapsed = ElapsedSeconds(start);
+    lldb_eval_seconds += elapsed;
+    state.SetIterationTime(elapsed);
+
+    if (lldb_value.GetError().Fail()) {
+      state.SkipWithError("LLDB failed to evaluate the expression!");
+      break;
+    }
+    if (error.Fail()) {
+      state.SkipWithError("lldb-eval failed to evaluate the expression!");
+      break;
+    }
+  }
+
+  state.counters["lldb_us"] = benchmark::Counter(
+      lldb_seconds * 1e6, benchmark::Counter::kAvgIterations);
+  state.counters["lldb_eval_us"] = benchmark::Counter(
+      lldb_eval_seconds * 1e6, benchmark::Counter::kAvgIterations);
+  if (lldb_eval_seconds > 0) {
+    state.counters["speedup"] = lldb_seconds / lldb_eval_seconds;
+  }
+}
+BENCHMARK_REGISTER_F(BM, LLDBvsLLDBEval)
+    ->DenseRange(0, kNumExpressionClasses - 1)
+    ->UseManualTime();
+
+int main(int argc, char** argv) {
+  lldb::SBDebugger::Initialize();
+
+  // Same as BENCHMARK_MAIN()
+  // clang-format off
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  ::benchmark::RunSpecifiedBenchmarks();
+  // clang-format on
+
+  lldb::SBDebugger::Terminate();
+}
@@ -0,0 +1,120 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/memory_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "lldb/API/SBError.h"
+#include "lldb/API/SBProcess.h"
+
+namespace lldb_eval {
+
+MemoryCache::MemoryCache(lldb::SBProcess process)
+    : provider_(std::make_shared<ProcessMemoryProvider>(std::move(process))) {}
+
+bool MemoryCache::Read(lldb::addr_t addr, void* buf, size_t size) {
+  if (!provider_) {
+    return false;
+  }
+  if (const uint8_t* data = provider_->GetContiguous(addr, size)) {
+    memcpy(buf, data, size);
+    bytes_read_ += size;
+    return true;
+  }
+
+  uint8_t* out = static_cast<uint8_t*>(buf);
+  while (size > 0) {
+    lldb::addr_t page_addr = addr - addr % kPageSize;
+    size_t offset = static_cast<size_t>(addr - page_addr);
+    size_t chunk = std::min(size, kPageSize - offset);
+
+    const std::vector<uint8_t>& page = GetPage(page_addr);
+    if (page.size() < offset + chunk) {
+      return false;
+    }
+    memcpy(out, page.data() + offset, chunk);
+
+    out += chunk;
+    addr += chunk;
+    size -= chunk;
+  }
+  return true;
+}
+
+void MemoryCache::Prefetch(lldb::addr_t addr, size_t size) {
+  if (!provider_ || size == 0 || provider_->GetContiguous(addr, size)) {
+    return;
+  }
+
+  lldb::addr_t begin = addr - addr % kPageSize;
+  lldb::addr_t end = addr + size;
+  lldb::addr_t page_addr = begin;
+  while (page_addr < end) {
+    if (pages_.count(page_addr)) {
+      page_addr += kPageSize;
+      continue;
+    }
+
+    // Find the run of the missing pages and read it at once.
+    lldb::addr_t run_end = page_addr + kPageSize;
+    while (run_end < end && !pages_.count(run_end)) {
+      run_end += kPageSize;
+    }
+    std::vector<uint8_t> buffer(run_end - page_addr);
+    lldb::SBError error;
+    size_t read =
+        provider_->ReadMemory(page_addr, buffer.data(), buffer.size(), error);
+    bytes_read_ += read;
+
+    // Cache the fully read pages and the partially read one. The pages past the
+    // readable part are left to `GetPage()`, the memory may be readable again
+    // after a gap.
+    for (size_t offset = 0; offset < read; offset += kPageSize) {
+      size_t page_size = std::min(kPageSize, read - offset);
+      pages_.emplace(page_addr + offset,
+                     std::vector<uint8_t>(buffer.data() + offset,
+                                          buffer.data() + offset + page_size));
+    }
+    page_addr = run_end;
+  }
+}
+
+void MemoryCache::SetProvider(std::shared_ptr<MemoryProvider> provider) {
+  provider_ = std::move(provider);
+  Clear();
+}
+
+void MemoryCache::Clear() { pages_.clear(); }
+
+const std::vector<uint8_t>& MemoryCache::GetPage(lldb::addr_t page_addr) {
+  auto it = pages_.find(page_addr);
+  if (it != pages_.end()) {
+    return it->second;
+  }
+
+  std::vector<uint8_t> page(kPageSize);
+  lldb::SBError error;
+  size_t read = provider_->ReadMemory(page_addr, page.data(), kPageSize, error);
+  bytes_read_ += read;
+  // Partially readable pages are cached as is, the reads past the readable
+  // part fail.
+  page.resize(read);
+
+  return pages_.emplace(page_addr, std::move(page)).first->second;
+}
+
+}  // namespace lldb_eval
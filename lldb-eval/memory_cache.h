@@ -0,0 +1,86 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_MEMORY_CACHE_H_
+#define LLDB_EVAL_MEMORY_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "lldb-eval/memory_provider.h"
+#include "lldb/API/SBProcess.h"
+#include "lldb/lldb-types.h"
+
+namespace lldb_eval {
+
+// Cache of the process memory used during the evaluation of an expression.
+// The memory is read in pages, so that the accesses to the nearby addresses
+// (e.g. members of the same object or elements of the same array) are served
+// by one `SBProcess::ReadMemory()` call. This matters for the remote targets,
+// where every read is a round trip to the debug server.
+//
+// The memory is read from a `MemoryProvider`. The reads of the memory the
+// provider stores contiguously (e.g. a mapped snapshot) bypass the pages and
+// are copied from the provider directly.
+//
+// The cache doesn't track the changes of the process memory. It must be
+// cleared when the process is resumed or when the memory is written to.
+class MemoryCache {
+ public:
+  static constexpr size_t kPageSize = 4096;
+
+  MemoryCache() = default;
+  // Reads the memory of `process`.
+  explicit MemoryCache(lldb::SBProcess process);
+
+  // Reads `size` bytes at `addr` into `buf`. Returns false if (some of) the
+  // memory can't be read.
+  bool Read(lldb::addr_t addr, void* buf, size_t size);
+
+  // Reads the pages covering `size` bytes at `addr`, which are not cached yet.
+  // Consecutive missing pages are read by one `SBProcess::ReadMemory()` call.
+  // Used when the range is known to be accessed (e.g. elements of an array
+  // evaluated one by one).
+  void Prefetch(lldb::addr_t addr, size_t size);
+
+  // Replaces the provider to read from and clears the cache.
+  void SetProvider(std::shared_ptr<MemoryProvider> provider);
+  MemoryProvider* provider() const { return provider_.get(); }
+
+  void Clear();
+
+  // Number of bytes read from the provider since the cache was created. Isn't
+  // reset by `Clear()`.
+  uint64_t bytes_read() const { return bytes_read_; }
+
+ private:
+  // Returns the readable contents of the page starting at `page_addr`. The
+  // contents may be shorter than a page (or empty) if the page is not fully
+  // readable.
+  const std::vector<uint8_t>& GetPage(lldb::addr_t page_addr);
+
+ private:
+  std::shared_ptr<MemoryProvider> provider_;
+  std::unordered_map<lldb::addr_t, std::vector<uint8_t>> pages_;
+  uint64_t bytes_read_ = 0;
+};
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_MEMORY_CACHE_H_
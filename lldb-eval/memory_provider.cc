@@ -0,0 +1,305 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/memory_provider.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+#include "lldb-eval/memory_cache.h"
+#include "lldb-eval/stats.h"
+#include "lldb/API/SBError.h"
+#include "lldb/API/SBProcess.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+
+namespace lldb_eval {
+
+namespace {
+
+constexpr char kSnapshotMagic[8] = {'L', 'L', 'E', 'V', 'S', 'N', 'A', 'P'};
+constexpr size_t kHeaderSize = sizeof(kSnapshotMagic) + sizeof(uint64_t);
+constexpr size_t kRegionEntrySize = 3 * sizeof(uint64_t);
+constexpr size_t kPageSize = MemoryCache::kPageSize;
+
+struct CapturedRegion {
+  lldb::addr_t addr;
+  std::vector<uint8_t> data;
+};
+
+// Appends `size` bytes of `data` read at `addr` to the captured regions,
+// extending the last region if it ends at `addr`.
+void AppendCaptured(std::vector<CapturedRegion>& regions, lldb::addr_t addr,
+                    const uint8_t* data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (regions.empty() ||
+      regions.back().addr + regions.back().data.size() != addr) {
+    regions.push_back({addr, {}});
+  }
+  regions.back().data.insert(regions.back().data.end(), data, data + size);
+}
+
+// Reads the range [begin, end) of the process memory, leaving out its
+// unreadable parts.
+void CaptureRange(lldb::SBProcess process, lldb::addr_t begin,
+                  lldb::addr_t end, std::vector<CapturedRegion>& regions) {
+  // Most of the ranges are fully readable, try reading the range at once.
+  std::vector<uint8_t> buffer(end - begin);
+  lldb::SBError error;
+  size_t read =
+      ReadProcessMemory(process, begin, buffer.data(), buffer.size(), error);
+  if (error.Fail()) {
+    read = 0;
+  }
+  AppendCaptured(regions, begin, buffer.data(), read);
+
+  // Read the rest page by page, the memory may be readable again after a gap.
+  lldb::addr_t addr = begin + read;
+  while (addr < end) {
+    lldb::addr_t page_end = std::min(end, addr - addr % kPageSize + kPageSize);
+    size_t size = static_cast<size_t>(page_end - addr);
+    read = ReadProcessMemory(process, addr, buffer.data(), size, error);
+    if (error.Fail()) {
+      read = 0;
+    }
+    // The region is split at the unreadable part, the next readable page
+    // doesn't extend it.
+    AppendCaptured(regions, addr, buffer.data(), read);
+    addr = page_end;
+  }
+}
+
+void WriteUInt64(std::ofstream& out, uint64_t value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+uint64_t ReadUInt64(const uint8_t* data) {
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+const uint8_t* MemoryProvider::GetContiguous(lldb::addr_t, size_t) {
+  return nullptr;
+}
+
+ProcessMemoryProvider::ProcessMemoryProvider(lldb::SBProcess process)
+    : process_(std::move(process)) {}
+
+size_t ProcessMemoryProvider::ReadMemory(lldb::addr_t addr, void* buf,
+                                         size_t size, lldb::SBError& error) {
+  if (!process_.IsValid()) {
+    error.SetErrorString("invalid process");
+    return 0;
+  }
+  return ReadProcessMemory(process_, addr, buf, size, error);
+}
+
+class SnapshotMemoryProvider::Mapping {
+ public:
+  Mapping(llvm::sys::fs::file_t file, size_t size, std::error_code& ec)
+      : region_(file, llvm::sys::fs::mapped_file_region::readonly, size,
+                /*offset*/ 0, ec) {}
+
+  const uint8_t* data() const {
+    return reinterpret_cast<const uint8_t*>(region_.const_data());
+  }
+  size_t size() const { return region_.size(); }
+
+ private:
+  llvm::sys::fs::mapped_file_region region_;
+};
+
+bool SnapshotMemoryProvider::Write(lldb::SBProcess process,
+                                   std::vector<Range> ranges,
+                                   const std::string& path,
+                                   lldb::SBError& error) {
+  std::sort(ranges.begin(), ranges.end(),
+            [](const Range& l, const Range& r) { return l.addr < r.addr; });
+
+  // Merge the overlapping and the adjacent ranges and capture them.
+  std::vector<CapturedRegion> regions;
+  for (size_t i = 0; i < ranges.size();) {
+    lldb::addr_t begin = ranges[i].addr;
+    lldb::addr_t end = begin + ranges[i].size;
+    for (++i; i < ranges.size() && ranges[i].addr <= end; ++i) {
+      end = std::max(end, ranges[i].addr + ranges[i].size);
+    }
+    if (end > begin) {
+      CaptureRange(process, begin, end, regions);
+    }
+  }
+
+  // Place the contents of every region at the same offset within the page as
+  // the region's address.
+  std::vector<uint64_t> offsets;
+  uint64_t offset = kHeaderSize + regions.size() * kRegionEntrySize;
+  for (const CapturedRegion& region : regions) {
+    offset += (region.addr - offset) % kPageSize;
+    offsets.push_back(offset);
+    offset += region.data.size();
+  }
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    error.SetErrorString(
+        llvm::formatv("cannot open '{0}' for writing", path).str().c_str());
+    return false;
+  }
+  out.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+  WriteUInt64(out, regions.size());
+  for (size_t i = 0; i < regions.size(); ++i) {
+    WriteUInt64(out, regions[i].addr);
+    WriteUInt64(out, regions[i].data.size());
+    WriteUInt64(out, offsets[i]);
+  }
+  uint64_t written = kHeaderSize + regions.size() * kRegionEntrySize;
+  for (size_t i = 0; i < regions.size(); ++i) {
+    // Pad up to the offset of the region.
+    std::vector<char> padding(offsets[i] - written, 0);
+    out.write(padding.data(), padding.size());
+    out.write(reinterpret_cast<const char*>(regions[i].data.data()),
+              regions[i].data.size());
+    written = offsets[i] + regions[i].data.size();
+  }
+  out.close();
+  if (!out) {
+    error.SetErrorString(
+        llvm::formatv("cannot write '{0}'", path).str().c_str());
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<SnapshotMemoryProvider> SnapshotMemoryProvider::Open(
+    const std::string& path, lldb::SBError& error) {
+  auto fail = [&](const std::string& message) {
+    error.SetErrorString(
+        llvm::formatv("cannot open snapshot '{0}': {1}", path, message)
+            .str()
+            .c_str());
+    return nullptr;
+  };
+
+  uint64_t file_size = 0;
+  if (std::error_code ec = llvm::sys::fs::file_size(path, file_size)) {
+    return fail(ec.message());
+  }
+  if (file_size < kHeaderSize) {
+    return fail("not a memory snapshot");
+  }
+
+  llvm::Expected<llvm::sys::fs::file_t> file =
+      llvm::sys::fs::openNativeFileForRead(path);
+  if (!file) {
+    return fail(llvm::toString(file.takeError()));
+  }
+  std::error_code ec;
+  auto mapping =
+      std::make_unique<Mapping>(*file, static_cast<size_t>(file_size), ec);
+  // The mapping stays valid after the file is closed.
+  llvm::sys::fs::closeFile(*file);
+  if (ec) {
+    return fail(ec.message());
+  }
+
+  const uint8_t* data = mapping->data();
+  uint64_t num_regions = ReadUInt64(data + sizeof(kSnapshotMagic));
+  if (memcmp(data, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+      num_regions > (file_size - kHeaderSize) / kRegionEntrySize) {
+    return fail("not a memory snapshot");
+  }
+
+  std::shared_ptr<SnapshotMemoryProvider> ret(
+      new SnapshotMemoryProvider(std::move(mapping)));
+  const uint8_t* entry = data + kHeaderSize;
+  for (uint64_t i = 0; i < num_regions; ++i, entry += kRegionEntrySize) {
+    lldb::addr_t addr = ReadUInt64(entry);
+    uint64_t size = ReadUInt64(entry + sizeof(uint64_t));
+    uint64_t offset = ReadUInt64(entry + 2 * sizeof(uint64_t));
+    const std::vector<Region>& regions = ret->regions_;
+    bool overlaps = !regions.empty() &&
+                    regions.back().addr + regions.back().size > addr;
+    if (offset > file_size || size > file_size - offset ||
+        addr + size < addr || overlaps) {
+      return fail("malformed region table");
+    }
+    ret->regions_.push_back({addr, size, data + offset});
+  }
+  return ret;
+}
+
+SnapshotMemoryProvider::SnapshotMemoryProvider(std::unique_ptr<Mapping> mapping)
+    : mapping_(std::move(mapping)) {}
+
+SnapshotMemoryProvider::~SnapshotMemoryProvider() = default;
+
+const SnapshotMemoryProvider::Region* SnapshotMemoryProvider::FindRegion(
+    lldb::addr_t addr) const {
+  // Find the last region starting at or before `addr`.
+  auto it = std::upper_bound(
+      regions_.begin(), regions_.end(), addr,
+      [](lldb::addr_t value, const Region& region) {
+        return value < region.addr;
+      });
+  if (it == regions_.begin()) {
+    return nullptr;
+  }
+  --it;
+  return addr - it->addr < it->size ? &*it : nullptr;
+}
+
+size_t SnapshotMemoryProvider::ReadMemory(lldb::addr_t addr, void* buf,
+                                          size_t size, lldb::SBError& error) {
+  uint8_t* out = static_cast<uint8_t*>(buf);
+  size_t read = 0;
+  while (read < size) {
+    const Region* region = FindRegion(addr + read);
+    if (!region) {
+      break;
+    }
+    uint64_t offset = addr + read - region->addr;
+    size_t chunk =
+        static_cast<size_t>(std::min<uint64_t>(size - read,
+                                               region->size - offset));
+    memcpy(out + read, region->data + offset, chunk);
+    read += chunk;
+  }
+  if (read == 0 && size > 0) {
+    error.SetErrorString(
+        llvm::formatv("memory at {0:x} isn't in the snapshot", addr)
+            .str()
+            .c_str());
+  }
+  return read;
+}
+
+const uint8_t* SnapshotMemoryProvider::GetContiguous(lldb::addr_t addr,
+                                                     size_t size) {
+  const Region* region = FindRegion(addr);
+  if (!region || size > region->size - (addr - region->addr)) {
+    return nullptr;
+  }
+  return region->data + (addr - region->addr);
+}
+
+}  // namespace lldb_eval
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_MEMORY_PROVIDER_H_
+#define LLDB_EVAL_MEMORY_PROVIDER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lldb/API/SBError.h"
+#include "lldb/API/SBProcess.h"
+#include "lldb/lldb-types.h"
+
+namespace lldb_eval {
+
+// Source of the memory read by the interpreter (via the memory cache and the
+// buffer scans). By default it's the process of the target, but the memory can
+// also come from elsewhere, e.g. from a snapshot of the process memory. The
+// implementations must be thread-safe, a provider can be shared by concurrent
+// evaluations.
+class MemoryProvider {
+ public:
+  virtual ~MemoryProvider() = default;
+
+  // Reads `size` bytes at `addr` into `buf`. Returns the number of bytes read,
+  // which is less than `size` if the memory isn't (fully) readable. `error` is
+  // set if nothing can be read.
+  virtual size_t ReadMemory(lldb::addr_t addr, void* buf, size_t size,
+                            lldb::SBError& error) = 0;
+
+  // Returns the contents of `size` bytes at `addr` if they are stored
+  // contiguously by the provider, which allows reading them without copying.
+  // The data is valid for the lifetime of the provider. Returns null otherwise
+  // (and by default), the memory must be read by `ReadMemory()` then.
+  virtual const uint8_t* GetContiguous(lldb::addr_t addr, size_t size);
+};
+
+// Reads the memory of the process via `SBProcess::ReadMemory()`. The reads are
+// counted in the current stats.
+class ProcessMemoryProvider : public MemoryProvider {
+ public:
+  explicit ProcessMemoryProvider(lldb::SBProcess process);
+
+  size_t ReadMemory(lldb::addr_t addr, void* buf, size_t size,
+                    lldb::SBError& error) override;
+
+ private:
+  lldb::SBProcess process_;
+};
+
+// Memory ranges of a process captured to a file, mapped to the memory when the
+// snapshot is opened. Reads are served from the mapping, without going through
+// LLDB (e.g. the core file plugins for the minidumps), and the buffer scans
+// read the mapped memory in place.
+//
+// The file consists of a header (the magic and the number of regions), the
+// table of the regions (their address, size and the file offset of their
+// contents, as 64-bit integers in the host byte order) and the contents. The
+// contents of every region are placed at the same offset within the page as
+// the region's address, so the mapped data has the same alignment as the data
+// in the process.
+class SnapshotMemoryProvider : public MemoryProvider {
+ public:
+  struct Range {
+    lldb::addr_t addr;
+    uint64_t size;
+  };
+
+  // Captures `ranges` of the process memory to the snapshot file at `path`.
+  // Overlapping ranges are merged, the unreadable parts of the ranges are left
+  // out. Returns false (and sets `error`) if the file can't be written.
+  static bool Write(lldb::SBProcess process, std::vector<Range> ranges,
+                    const std::string& path, lldb::SBError& error);
+
+  // Maps the snapshot file at `path`. Returns null (and sets `error`) if the
+  // file can't be mapped or isn't a snapshot.
+  static std::shared_ptr<SnapshotMemoryProvider> Open(const std::string& path,
+                                                      lldb::SBError& error);
+
+  ~SnapshotMemoryProvider() override;
+
+  SnapshotMemoryProvider(const SnapshotMemoryProvider&) = delete;
+  SnapshotMemoryProvider& operator=(const SnapshotMemoryProvider&) = delete;
+
+  size_t ReadMemory(lldb::addr_t addr, void* buf, size_t size,
+                    lldb::SBError& error) override;
+  const uint8_t* GetContiguous(lldb::addr_t addr, size_t size) override;
+
+ private:
+  struct Region {
+    lldb::addr_t addr;
+    uint64_t size;
+    const uint8_t* data;
+  };
+
+  class Mapping;
+
+  explicit SnapshotMemoryProvider(std::unique_ptr<Mapping> mapping);
+
+  // Returns the region containing `addr`, or null.
+  const Region* FindRegion(lldb::addr_t addr) const;
+
+ private:
+  std::unique_ptr<Mapping> mapping_;
+  // Sorted by the address, not overlapping.
+  std::vector<Region> regions_;
+};
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_MEMORY_PROVIDER_H_
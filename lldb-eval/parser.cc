@@ -16,12 +16,15 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include "clang/Basic/Diagnostic.h"
@@ -33,6 +36,7 @@
 #include "clang/Basic/TokenKinds.h"
 #include "clang/Lex/HeaderSearch.h"
 #include "clang/Lex/HeaderSearchOptions.h"
+#include "clang/Lex/Lexer.h"
 #include "clang/Lex/LiteralSupport.h"
 #include "clang/Lex/ModuleLoader.h"
 #include "clang/Lex/Preprocessor.h"
@@ -40,7 +44,11 @@
 #include "clang/Lex/Token.h"
 #include "lldb-eval/ast.h"
 #include "lldb-eval/defines.h"
+#include "lldb-eval/lexer.h"
+#include "lldb-eval/stats.h"
+#include "lldb-eval/trace.h"
 #include "lldb/lldb-enumerations.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Support/FormatAdapters.h"
@@ -195,9 +203,9 @@ static ExprResult InsertSmartPtrToPointerConversion(ExprResult expr) {
       expr_type->IsSmartPtrType() &&
       "an argument to smart-ptr-to-pointer conversion must be a smart pointer");
 
-  return std::make_unique<SmartPtrToPtrDecay>(
-      expr->location(), expr_type->GetSmartPtrPointeeType()->GetPointerType(),
-      std::move(expr));
+  return MakeNode<SmartPtrToPtrDecay>(
+      expr->arena(), expr->location(),
+      expr_type->GetSmartPtrPointeeType()->GetPointerType(), std::move(expr));
 }
 
 static ExprResult InsertArrayToPointerConversion(ExprResult expr) {
@@ -206,8 +214,8 @@ static ExprResult InsertArrayToPointerConversion(ExprResult expr) {
 
   // TODO(werat): Make this an explicit array-to-pointer conversion instead of
   // using a "generic" CStyleCastNode.
-  return std::make_unique<CStyleCastNode>(
-      expr->location(),
+  return MakeNode<CStyleCastNode>(
+      expr->arena(), expr->location(),
       expr->result_type_deref()->GetArrayElementType()->GetPointerType(),
       std::move(expr), CStyleCastKind::kPointer);
 }
@@ -294,13 +302,13 @@ static ExprResult UsualUnaryConversions(ParserContext& ctx, ExprResult expr) {
       uint32_t int_bit_size = int_type->GetByteSize() * CHAR_BIT;
       if (bitfield_size < int_bit_size ||
           (result_type->IsSigned() && bitfield_size == int_bit_size)) {
-        expr = std::make_unique<CStyleCastNode>(expr->location(), int_type,
-                                                std::move(expr),
-                                                CStyleCastKind::kArithmetic);
+        expr = MakeNode<CStyleCastNode>(expr->arena(), expr->location(),
+                                        int_type, std::move(expr),
+                                        CStyleCastKind::kArithmetic);
       } else if (bitfield_size <= uint_type->GetByteSize() * CHAR_BIT) {
-        expr = std::make_unique<CStyleCastNode>(expr->location(), uint_type,
-                                                std::move(expr),
-                                                CStyleCastKind::kArithmetic);
+        expr = MakeNode<CStyleCastNode>(expr->arena(), expr->location(),
+                                        uint_type, std::move(expr),
+                                        CStyleCastKind::kArithmetic);
       }
     }
   }
@@ -315,9 +323,9 @@ static ExprResult UsualUnaryConversions(ParserContext& ctx, ExprResult expr) {
     // Insert a cast if the type promotion is happening.
     // TODO(werat): Make this an implicit static_cast.
     if (!CompareTypes(promoted_type, result_type)) {
-      expr = std::make_unique<CStyleCastNode>(expr->location(), promoted_type,
-                                              std::move(expr),
-                                              CStyleCastKind::kArithmetic);
+      expr = MakeNode<CStyleCastNode>(expr->arena(), expr->location(),
+                                      promoted_type, std::move(expr),
+                                      CStyleCastKind::kArithmetic);
     }
   }
 
@@ -397,17 +405,15 @@ static void PerformIntegerConversions(ParserContext& ctx, ExprResult& l,
       auto r_type_unsigned = ctx.GetBasicType(
           BasicTypeToUnsigned(r_type->GetCanonicalType()->GetBasicType()));
       if (convert_rhs) {
-        r = std::make_unique<CStyleCastNode>(r->location(), r_type_unsigned,
-                                             std::move(r),
-                                             CStyleCastKind::kArithmetic);
+        r = MakeNode<CStyleCastNode>(r->arena(), r->location(), r_type_unsigned,
+                                     std::move(r), CStyleCastKind::kArithmetic);
       }
     }
   }
 
   if (convert_lhs) {
-    l = std::make_unique<CStyleCastNode>(l->location(), r->result_type(),
-                                         std::move(l),
-                                         CStyleCastKind::kArithmetic);
+    l = MakeNode<CStyleCastNode>(l->arena(), l->location(), r->result_type(),
+                                 std::move(l), CStyleCastKind::kArithmetic);
   }
 }
 
@@ -439,32 +445,32 @@ static TypeSP UsualArithmeticConversions(ParserContext& ctx, ExprResult& lhs,
     if (lhs_type->IsFloat() && rhs_type->IsFloat()) {
       int order = lhs_type->GetBasicType() - rhs_type->GetBasicType();
       if (order > 0) {
-        rhs = std::make_unique<CStyleCastNode>(rhs->location(), lhs_type,
-                                               std::move(rhs),
-                                               CStyleCastKind::kArithmetic);
+        rhs = MakeNode<CStyleCastNode>(rhs->arena(), rhs->location(), lhs_type,
+                                       std::move(rhs),
+                                       CStyleCastKind::kArithmetic);
         return lhs_type;
       }
       assert(order < 0 && "illegal operands: must not be of the same type");
       if (!is_comp_assign) {
-        lhs = std::make_unique<CStyleCastNode>(lhs->location(), rhs_type,
-                                               std::move(lhs),
-                                               CStyleCastKind::kArithmetic);
+        lhs = MakeNode<CStyleCastNode>(lhs->arena(), lhs->location(), rhs_type,
+                                       std::move(lhs),
+                                       CStyleCastKind::kArithmetic);
       }
       return rhs_type;
     }
 
     if (lhs_type->IsFloat()) {
       assert(rhs_type->IsInteger() && "illegal operand: must be an integer");
-      rhs = std::make_unique<CStyleCastNode>(rhs->location(), lhs_type,
-                                             std::move(rhs),
-                                             CStyleCastKind::kArithmetic);
+      rhs = MakeNode<CStyleCastNode>(rhs->arena(), rhs->location(), lhs_type,
+                                     std::move(rhs),
+                                     CStyleCastKind::kArithmetic);
       return lhs_type;
     }
     assert(rhs_type->IsFloat() && "illegal operand: must be a float");
     if (!is_comp_assign) {
-      lhs = std::make_unique<CStyleCastNode>(lhs->location(), rhs_type,
-                                             std::move(lhs),
-                                             CStyleCastKind::kArithmetic);
+      lhs = MakeNode<CStyleCastNode>(lhs->arena(), lhs->location(), rhs_type,
+                                     std::move(lhs),
+                                     CStyleCastKind::kArithmetic);
     }
     return rhs_type;
   }
@@ -650,52 +656,71 @@ static std::unique_ptr<BuiltinFunctionDef> GetBuiltinFunctionDef(
     return std::make_unique<BuiltinFunctionDef>(identifier, return_type,
                                                 std::move(arguments));
   }
-  // Not a builtin function.
-  return nullptr;
-}
-
-// Checks whether `target_base` is a virtual base of `type` (direct or
-// indirect). If it is, stores the first virtual base type on the path from
-// `type` to `target_type`.
-static bool IsVirtualBase(TypeSP type, TypeSP target_base, TypeSP* virtual_base,
-                          bool carry_virtual = false) {
-  if (CompareTypes(type, target_base)) {
-    return carry_virtual;
+  //
+  // __findvalue(T* ptr, long long buffer_size, T value) -> int
+  //
+  //   Finds the first object equal to `value` in the array of size
+  //   `buffer_size` pointed by `ptr`. Returns -1 if there is no such object.
+  //
+  if (identifier == "__findvalue") {
+    auto return_type = ctx.GetBasicType(lldb::eBasicTypeInt);
+    std::vector<TypeSP> arguments = {
+        nullptr,
+        ctx.GetBasicType(lldb::eBasicTypeLongLong),
+        nullptr,
+    };
+    return std::make_unique<BuiltinFunctionDef>(identifier, return_type,
+                                                std::move(arguments));
   }
-
-  if (!carry_virtual) {
-    uint32_t num_virtual_bases = type->GetNumberOfVirtualBaseClasses();
-    for (uint32_t i = 0; i < num_virtual_bases; ++i) {
-      auto base = type->GetVirtualBaseClassAtIndex(i);
-      if (IsVirtualBase(base, target_base, virtual_base,
-                        /*carry_virtual*/ true)) {
-        if (virtual_base) {
-          *virtual_base = base;
-        }
-        return true;
-      }
-    }
+  //
+  // __count(T* ptr, long long buffer_size) -> int
+  //
+  //   Counts the non-zero (non-null) objects in the array of size
+  //   `buffer_size` pointed by `ptr`.
+  //
+  if (identifier == "__count") {
+    auto return_type = ctx.GetBasicType(lldb::eBasicTypeInt);
+    std::vector<TypeSP> arguments = {
+        nullptr,
+        ctx.GetBasicType(lldb::eBasicTypeLongLong),
+    };
+    return std::make_unique<BuiltinFunctionDef>(identifier, return_type,
+                                                std::move(arguments));
   }
-
-  uint32_t num_direct_bases = type->GetNumberOfDirectBaseClasses();
-  for (uint32_t i = 0; i < num_direct_bases; ++i) {
-    auto base = type->GetDirectBaseClassAtIndex(i).type;
-    if (IsVirtualBase(base, target_base, virtual_base, carry_virtual)) {
-      return true;
-    }
+  //
+  // __min(T* ptr, long long buffer_size) -> T
+  // __max(T* ptr, long long buffer_size) -> T
+  //
+  //   Finds the smallest (largest) object in the non-empty array of size
+  //   `buffer_size` pointed by `ptr`. `T` must be an arithmetic type or an
+  //   enumeration.
+  //
+  if (identifier == "__min" || identifier == "__max") {
+    std::vector<TypeSP> arguments = {
+        nullptr,
+        ctx.GetBasicType(lldb::eBasicTypeLongLong),
+    };
+    return std::make_unique<BuiltinFunctionDef>(identifier, nullptr,
+                                                std::move(arguments));
   }
-
-  return false;
+  // Not a builtin function.
+  return nullptr;
 }
 
-Parser::Parser(std::shared_ptr<ParserContext> ctx) : ctx_(std::move(ctx)) {
-  clang::SourceManager& sm = ctx_->GetSourceManager();
-  clang::DiagnosticsEngine& de = sm.getDiagnostics();
+ParserEngine::ParserEngine(const std::string& triple) {
+  de_ = std::make_unique<clang::DiagnosticsEngine>(
+      new clang::DiagnosticIDs, new clang::DiagnosticOptions,
+      new clang::IgnoringDiagConsumer);
 
   auto tOpts = std::make_shared<clang::TargetOptions>();
-  tOpts->Triple = llvm::sys::getDefaultTargetTriple();
-
-  ti_.reset(clang::TargetInfo::CreateTargetInfo(de, tOpts));
+  if (!triple.empty()) {
+    tOpts->Triple = triple;
+    ti_.reset(clang::TargetInfo::CreateTargetInfo(*de_, tOpts));
+  }
+  if (!ti_) {
+    tOpts->Triple = llvm::sys::getDefaultTargetTriple();
+    ti_.reset(clang::TargetInfo::CreateTargetInfo(*de_, tOpts));
+  }
 
   lang_opts_ = std::make_unique<clang::LangOptions>();
   lang_opts_->Bool = true;
@@ -705,28 +730,119 @@ Parser::Parser(std::shared_ptr<ParserContext> ctx) : ctx_(std::move(ctx)) {
   lang_opts_->CPlusPlus14 = true;
   lang_opts_->CPlusPlus17 = true;
 
-  tml_ = std::make_unique<clang::TrivialModuleLoader>();
+  keywords_ = std::make_unique<clang::IdentifierTable>(*lang_opts_);
+
+  hs_opts_ = std::make_shared<clang::HeaderSearchOptions>();
+  pp_opts_ = std::make_shared<clang::PreprocessorOptions>();
+}
+
+std::shared_ptr<ParserEngine> ParserEngine::Create() { return Create(""); }
+
+std::shared_ptr<ParserEngine> ParserEngine::Create(const std::string& triple) {
+  return std::shared_ptr<ParserEngine>(new ParserEngine(triple));
+}
 
-  auto hOpts = std::make_shared<clang::HeaderSearchOptions>();
-  hs_ = std::make_unique<clang::HeaderSearch>(hOpts, sm, de, *lang_opts_,
-                                              ti_.get());
+std::shared_ptr<ParserEngine> ParserEngine::GetDefault() {
+  static std::shared_ptr<ParserEngine> engine = Create();
+  return engine;
+}
 
-  auto pOpts = std::make_shared<clang::PreprocessorOptions>();
-  pp_ = std::make_unique<clang::Preprocessor>(pOpts, de, *lang_opts_, sm, *hs_,
-                                              *tml_);
-  pp_->Initialize(*ti_);
-  pp_->EnterMainSourceFile();
+std::shared_ptr<ParserEngine> ParserEngine::GetForTriple(
+    const std::string& triple) {
+  if (triple.empty()) {
+    return GetDefault();
+  }
+  // There are usually only a few distinct triples, the engines are never
+  // released.
+  static std::mutex mutex;
+  static auto* engines =
+      new std::unordered_map<std::string, std::shared_ptr<ParserEngine>>();
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& engine = (*engines)[triple];
+  if (!engine) {
+    engine = Create(triple);
+  }
+  return engine;
+}
+
+Parser::Parser(std::shared_ptr<ParserContext> ctx)
+    : Parser(std::move(ctx), ParserEngine::GetDefault()) {}
+
+Parser::Parser(std::shared_ptr<ParserContext> ctx,
+               std::shared_ptr<ParserEngine> engine, LexerKind lexer)
+    : ctx_(std::move(ctx)),
+      arena_(new AstArena()),
+      engine_(std::move(engine)) {
+  PhaseTimer timer(&EvaluationStats::lex_ns);
+  if (lexer == LexerKind::kBuiltin) {
+    tokens_ = BuiltinLexer(ctx_->GetSourceManager(), engine_->GetKeywords())
+                  .LexAll();
+  } else {
+    clang::Preprocessor& pp = GetPreprocessor();
+    pp.EnterMainSourceFile();
+    do {
+      tokens_.emplace_back();
+      pp.Lex(tokens_.back());
+    } while (tokens_.back().isNot(clang::tok::eof));
+  }
 
   // Initialize the token.
   token_.setKind(clang::tok::unknown);
 }
 
+clang::Preprocessor& Parser::GetPreprocessor() {
+  if (pp_) {
+    return *pp_;
+  }
+
+  clang::SourceManager& sm = ctx_->GetSourceManager();
+  clang::DiagnosticsEngine& de = sm.getDiagnostics();
+
+  // Preprocessor doesn't modify the language options, but older versions of
+  // its interface require a non-const reference.
+  const clang::TargetInfo& ti = engine_->GetTargetInfo();
+  auto& lang_opts = const_cast<clang::LangOptions&>(engine_->GetLangOptions());
+
+  tml_ = std::make_unique<clang::TrivialModuleLoader>();
+
+  hs_ = std::make_unique<clang::HeaderSearch>(
+      engine_->GetHeaderSearchOptions(), sm, de, lang_opts, &ti);
+
+  pp_ = std::make_unique<clang::Preprocessor>(
+      engine_->GetPreprocessorOptions(), de, lang_opts, sm, *hs_, *tml_);
+  pp_->Initialize(ti);
+  return *pp_;
+}
+
+template <typename T, typename Parse>
+T Parser::Memoize(Memo<T>& memo, Parse parse) {
+  // In the bail-out mode the parse results are not reliable.
+  if (error_) {
+    return parse();
+  }
+
+  auto key = std::make_pair(next_token_idx_, token_.getKind());
+  auto it = memo.find(key);
+  if (it != memo.end()) {
+    token_ = it->second.token;
+    next_token_idx_ = it->second.next_token_idx;
+    return it->second.result;
+  }
+
+  T result = parse();
+  if (!error_) {
+    memo.emplace(key, MemoEntry<T>{result, token_, next_token_idx_});
+  }
+  return result;
+}
+
 ExprResult Parser::Run(Error& error) {
+  TraceEvent trace("Parse");
   ConsumeToken();
 
   ExprResult expr;
   if (clang::tok::isStringLiteral(token_.getKind()) &&
-      pp_->LookAhead(0).is(clang::tok::eof)) {
+      LookAhead(0).is(clang::tok::eof)) {
     // A special case to handle a single string-literal token.
     expr = ParseStringLiteral();
   } else {
@@ -742,13 +858,13 @@ ExprResult Parser::Run(Error& error) {
   // Some routines raise an error, but don't change the return value (e.g.
   // Expect).
   if (error) {
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
   return expr;
 }
 
 std::string Parser::TokenDescription(const clang::Token& token) {
-  const auto& spelling = pp_->getSpelling(token);
+  const auto& spelling = GetSpelling(token);
   const auto* kind_name = token.getName();
   return llvm::formatv("<'{0}' ({1})>", spelling, kind_name);
 }
@@ -782,7 +898,25 @@ void Parser::ConsumeToken() {
     // occurred during parsing and we're trying to bail out.
     return;
   }
-  pp_->Lex(token_);
+  token_ = LookAhead(0);
+  ++next_token_idx_;
+}
+
+const clang::Token& Parser::LookAhead(size_t n) const {
+  // All tokens past the end of the expression are `eof`.
+  return tokens_[std::min(next_token_idx_ + n, tokens_.size() - 1)];
+}
+
+std::string Parser::GetSpelling(const clang::Token& token) const {
+  return clang::Lexer::getSpelling(token, ctx_->GetSourceManager(),
+                                   engine_->GetLangOptions());
+}
+
+void Parser::AppendSpelling(const clang::Token& token,
+                            std::string& out) const {
+  llvm::SmallString<64> buffer;
+  out += clang::Lexer::getSpelling(token, buffer, ctx_->GetSourceManager(),
+                                   engine_->GetLangOptions());
 }
 
 void Parser::BailOut(ErrorCode code, const std::string& error,
@@ -793,7 +927,7 @@ void Parser::BailOut(ErrorCode code, const std::string& error,
     return;
   }
 
-  error_.Set(code, FormatDiagnostics(ctx_->GetSourceManager(), error, loc));
+  error_.SetDiagnostic(code, error, loc, ctx_->GetDiagnosticsSource());
   token_.setKind(clang::tok::eof);
 }
 
@@ -1087,7 +1221,7 @@ ExprResult Parser::ParseCastExpression() {
       tentative_parsing.Commit();
 
       if (!type_id.value()->IsValid()) {
-        return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+        return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
       }
 
       Expect(clang::tok::r_paren);
@@ -1200,11 +1334,11 @@ ExprResult Parser::ParseUnaryExpression() {
       operand = ParseUnaryExpression()->result_type_deref();
     }
     if (!operand->IsValid()) {
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
 
     auto result_type = ctx_->GetBasicType(ctx_->GetSizeType());
-    return std::make_unique<SizeOfNode>(sizeof_loc, result_type, operand);
+    return MakeNode<SizeOfNode>(*arena_, sizeof_loc, result_type, operand);
   }
 
   return ParsePostfixExpression();
@@ -1245,10 +1379,10 @@ ExprResult Parser::ParsePostfixExpression() {
     if (!type_id) {
       BailOut(ErrorCode::kInvalidOperandType,
               "type name requires a specifier or qualifier", loc);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
     if (!type_id.value()->IsValid()) {
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
 
     Expect(clang::tok::greater);
@@ -1346,7 +1480,7 @@ ExprResult Parser::ParsePrimaryExpression() {
     // handled by lldb-eval.
     BailOut(ErrorCode::kNotImplemented, "string literals are not supported",
             token_.getLocation());
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   } else if (token_.is(clang::tok::kw_nullptr)) {
     return ParsePointerLiteral();
   } else if (token_.isOneOf(clang::tok::coloncolon, clang::tok::identifier)) {
@@ -1362,7 +1496,7 @@ ExprResult Parser::ParsePrimaryExpression() {
             llvm::formatv("function '{0}' is not a supported builtin intrinsic",
                           identifier),
             loc);
-        return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+        return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
       }
       return ParseBuiltinFunction(loc, std::move(func_def));
     }
@@ -1373,11 +1507,11 @@ ExprResult Parser::ParsePrimaryExpression() {
       BailOut(ErrorCode::kUndeclaredIdentifier,
               llvm::formatv("use of undeclared identifier '{0}'", identifier),
               loc);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
-    return std::make_unique<IdentifierNode>(loc, identifier, std::move(value),
-                                            /*is_rvalue*/ false,
-                                            ctx_->IsContextVar(identifier));
+    return MakeNode<IdentifierNode>(*arena_, loc, identifier, std::move(value),
+                                    /*is_rvalue*/ false,
+                                    ctx_->IsContextVar(identifier));
   } else if (token_.is(clang::tok::kw_this)) {
     // Save the source location for the diagnostics message.
     clang::SourceLocation loc = token_.getLocation();
@@ -1387,12 +1521,12 @@ ExprResult Parser::ParsePrimaryExpression() {
       BailOut(ErrorCode::kUndeclaredIdentifier,
               "invalid use of 'this' outside of a non-static member function",
               loc);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
     // Special case for "this" pointer. As per C++ standard, it's a prvalue.
-    return std::make_unique<IdentifierNode>(loc, "this", std::move(value),
-                                            /*is_rvalue*/ true,
-                                            /*is_context_var*/ false);
+    return MakeNode<IdentifierNode>(*arena_, loc, "this", std::move(value),
+                                    /*is_rvalue*/ true,
+                                    /*is_context_var*/ false);
   } else if (token_.is(clang::tok::l_paren)) {
     ConsumeToken();
     auto expr = ParseExpression();
@@ -1404,7 +1538,7 @@ ExprResult Parser::ParsePrimaryExpression() {
   BailOut(ErrorCode::kInvalidExpressionSyntax,
           llvm::formatv("Unexpected token: {0}", TokenDescription(token_)),
           token_.getLocation());
-  return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+  return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
 }
 
 // Parse a type_id.
@@ -1413,6 +1547,15 @@ ExprResult Parser::ParsePrimaryExpression() {
 //    type_specifier_seq [abstract_declarator]
 //
 std::optional<TypeSP> Parser::ParseTypeId(bool must_be_type_id) {
+  // Type-ids which must be there raise errors, there is no point in memoizing
+  // them.
+  if (must_be_type_id) {
+    return ParseTypeIdImpl(must_be_type_id);
+  }
+  return Memoize(type_id_memo_, [this] { return ParseTypeIdImpl(false); });
+}
+
+std::optional<TypeSP> Parser::ParseTypeIdImpl(bool must_be_type_id) {
   clang::SourceLocation type_loc = token_.getLocation();
   TypeDeclaration type_decl;
 
@@ -1446,6 +1589,12 @@ std::optional<TypeSP> Parser::ParseTypeId(bool must_be_type_id) {
 
   } else {
     assert(type_decl.is_user_type_ && "type_decl must be a user type");
+    // Same-name identifiers are preferred over typenames (see below). Local
+    // identifiers are cheap to look up, so parenthesized expressions like
+    // `(a) + b` don't pay for the type lookup.
+    if (!must_be_type_id && ctx_->IsLocalIdentifier(type_decl.user_typename_)) {
+      return {};
+    }
     type = ctx_->ResolveTypeByName(type_decl.user_typename_);
     if (!type->IsValid()) {
       if (must_be_type_id) {
@@ -1592,9 +1741,15 @@ bool Parser::ParseTypeSpecifier(TypeDeclaration* type_decl) {
 
       // Construct the fully qualified typename.
       type_decl->is_user_type_ = true;
-      type_decl->user_typename_ =
-          llvm::formatv("{0}{1}{2}", global_scope ? "::" : "",
-                        nested_name_specifier, type_name);
+      std::string& user_typename = type_decl->user_typename_;
+      user_typename.clear();
+      user_typename.reserve(2 + nested_name_specifier.size() +
+                            type_name.size());
+      if (global_scope) {
+        user_typename += "::";
+      }
+      user_typename += nested_name_specifier;
+      user_typename += type_name;
       return true;
     }
   }
@@ -1612,49 +1767,56 @@ bool Parser::ParseTypeSpecifier(TypeDeclaration* type_decl) {
 //    nested_name_specifier simple_template_id "::"
 //
 std::string Parser::ParseNestedNameSpecifier() {
-  // The first token in nested_name_specifier is always an identifier.
-  if (token_.isNot(clang::tok::identifier)) {
-    return "";
-  }
+  // The components are appended to the same string one by one, instead of
+  // concatenating the results of the recursive calls.
+  std::string nested_name_specifier;
+
+  // The first token in every component is always an identifier.
+  while (token_.is(clang::tok::identifier)) {
+    // If the next token is scope ("::"), then this is indeed a
+    // nested_name_specifier
+    if (LookAhead(0).is(clang::tok::coloncolon)) {
+      // This component is a single identifier.
+      AppendSpelling(token_, nested_name_specifier);
+      ConsumeToken();
+      Expect(clang::tok::coloncolon);
+      ConsumeToken();
+      nested_name_specifier += "::";
+      // Continue parsing the nested_name_specifier.
+      continue;
+    }
 
-  // If the next token is scope ("::"), then this is indeed a
-  // nested_name_specifier
-  if (pp_->LookAhead(0).is(clang::tok::coloncolon)) {
-    // This nested_name_specifier is a single identifier.
-    std::string identifier = pp_->getSpelling(token_);
-    ConsumeToken();
-    Expect(clang::tok::coloncolon);
-    ConsumeToken();
-    // Continue parsing the nested_name_specifier.
-    return identifier + "::" + ParseNestedNameSpecifier();
-  }
+    // If the next token starts a template argument list, then we have a
+    // simple_template_id here.
+    if (LookAhead(0).is(clang::tok::less)) {
+      // We don't know whether this will be a nested_name_identifier or just a
+      // type_name. Prepare to rollback if this is not a nested_name_identifier.
+      TentativeParsingAction tentative_parsing(this);
 
-  // If the next token starts a template argument list, then we have a
-  // simple_template_id here.
-  if (pp_->LookAhead(0).is(clang::tok::less)) {
-    // We don't know whether this will be a nested_name_identifier or just a
-    // type_name. Prepare to rollback if this is not a nested_name_identifier.
-    TentativeParsingAction tentative_parsing(this);
+      // TODO(werat): Parse just the simple_template_id?
+      auto type_name = ParseTypeName();
 
-    // TODO(werat): Parse just the simple_template_id?
-    auto type_name = ParseTypeName();
+      // If we did parse the type_name successfully and it's followed by the
+      // scope operator ("::"), then this is indeed a nested_name_specifier.
+      // Commit the tentative parsing and continue parsing
+      // nested_name_specifier.
+      if (!type_name.empty() && token_.is(clang::tok::coloncolon)) {
+        tentative_parsing.Commit();
+        ConsumeToken();
+        nested_name_specifier += type_name;
+        nested_name_specifier += "::";
+        continue;
+      }
 
-    // If we did parse the type_name successfully and it's followed by the scope
-    // operator ("::"), then this is indeed a nested_name_specifier. Commit the
-    // tentative parsing and continue parsing nested_name_specifier.
-    if (!type_name.empty() && token_.is(clang::tok::coloncolon)) {
-      tentative_parsing.Commit();
-      ConsumeToken();
-      // Continue parsing the nested_name_specifier.
-      return type_name + "::" + ParseNestedNameSpecifier();
+      // Not a nested_name_specifier, but could be just a type_name or
+      // something else entirely. Rollback the parser and try a different path.
+      tentative_parsing.Rollback();
     }
 
-    // Not a nested_name_specifier, but could be just a type_name or something
-    // else entirely. Rollback the parser and try a different path.
-    tentative_parsing.Rollback();
+    break;
   }
 
-  return "";
+  return nested_name_specifier;
 }
 
 // Parse a type_name.
@@ -1678,6 +1840,12 @@ std::string Parser::ParseNestedNameSpecifier() {
 //    template_name "<" [template_argument_list] ">"
 //
 std::string Parser::ParseTypeName() {
+  // Nested template argument lists are parsed tentatively at every level (see
+  // `ParseNestedNameSpecifier()`), which is exponential without memoization.
+  return Memoize(type_name_memo_, [this] { return ParseTypeNameImpl(); });
+}
+
+std::string Parser::ParseTypeNameImpl() {
   // Typename always starts with an identifier.
   if (token_.isNot(clang::tok::identifier)) {
     return "";
@@ -1685,21 +1853,25 @@ std::string Parser::ParseTypeName() {
 
   // If the next token starts a template argument list, parse this type_name as
   // a simple_template_id.
-  if (pp_->LookAhead(0).is(clang::tok::less)) {
+  if (LookAhead(0).is(clang::tok::less)) {
     // Parse the template_name. In this case it's just an identifier.
-    std::string template_name = pp_->getSpelling(token_);
+    std::string type_name = GetSpelling(token_);
     ConsumeToken();
     // Consume the "<" token.
     ConsumeToken();
+    type_name += '<';
 
     // Short-circuit for missing template_argument_list.
     if (token_.is(clang::tok::greater)) {
       ConsumeToken();
-      return llvm::formatv("{0}<>", template_name);
+      type_name += '>';
+      return type_name;
     }
 
     // Try parsing template_argument_list.
-    auto template_argument_list = ParseTemplateArgumentList();
+    if (!ParseTemplateArgumentList(type_name)) {
+      return "";
+    }
 
     if (token_.is(clang::tok::greater)) {
       // Single closing angle bracket is a valid end of the template argument
@@ -1719,11 +1891,12 @@ std::string Parser::ParseTypeName() {
       return "";
     }
 
-    return llvm::formatv("{0}<{1}>", template_name, template_argument_list);
+    type_name += '>';
+    return type_name;
   }
 
   // Otherwise look for a class_name, enum_name or a typedef_name.
-  std::string identifier = pp_->getSpelling(token_);
+  std::string identifier = GetSpelling(token_);
   ConsumeToken();
 
   return identifier;
@@ -1735,36 +1908,37 @@ std::string Parser::ParseTypeName() {
 //    template_argument
 //    template_argument_list "," template_argument
 //
-std::string Parser::ParseTemplateArgumentList() {
-  // Parse template arguments one by one.
-  std::vector<std::string> arguments;
+bool Parser::ParseTemplateArgumentList(std::string& type_name) {
+  // Parse template arguments one by one and append them to `type_name`.
+  bool first = true;
 
   do {
     // Eat the comma if this is not the first iteration.
-    if (arguments.size() > 0) {
+    if (!first) {
       ConsumeToken();
+      type_name += ", ";
     }
+    first = false;
 
     // Try parsing a template_argument. If this fails, then this is actually not
     // a template_argument_list.
     auto argument = ParseTemplateArgument();
     if (argument.empty()) {
-      return "";
+      return false;
     }
 
-    arguments.push_back(argument);
+    type_name += argument;
 
   } while (token_.is(clang::tok::comma));
 
   // Internally in LLDB/Clang nested template type names have extra spaces to
   // avoid having ">>". Add the extra space before the closing ">" if the
   // template argument is also a template.
-  if (arguments.back().back() == '>') {
-    arguments.back().push_back(' ');
+  if (type_name.back() == '>') {
+    type_name.push_back(' ');
   }
 
-  return llvm::formatv("{0:$[, ]}",
-                       llvm::make_range(arguments.begin(), arguments.end()));
+  return true;
 }
 
 // Parse a template_argument.
@@ -1809,7 +1983,7 @@ std::string Parser::ParseTemplateArgument() {
     if (token_.is(clang::tok::numeric_constant)) {
       // TODO(werat): Actually parse the literal, check if it's valid and
       // canonize it (e.g. 8LL -> 8).
-      std::string numeric_literal = pp_->getSpelling(token_);
+      std::string numeric_literal = GetSpelling(token_);
       ConsumeToken();
 
       if (TokenEndsTemplateArgumentList(token_)) {
@@ -2137,19 +2311,20 @@ std::string Parser::ParseIdExpression() {
   // Follow the first production rule.
   if (!nested_name_specifier.empty()) {
     // Parse unqualified_id and construct a fully qualified id expression.
-    auto unqualified_id = ParseUnqualifiedId();
-
-    return llvm::formatv("{0}{1}{2}", global_scope ? "::" : "",
-                         nested_name_specifier, unqualified_id);
+    std::string id_expression = global_scope ? "::" : "";
+    id_expression += nested_name_specifier;
+    id_expression += ParseUnqualifiedId();
+    return id_expression;
   }
 
   // No nested_name_specifier, but with global scope -- this is also a
   // qualified_id production. Follow the second production rule.
   else if (global_scope) {
     Expect(clang::tok::identifier);
-    std::string identifier = pp_->getSpelling(token_);
+    std::string id_expression = "::";
+    AppendSpelling(token_, id_expression);
     ConsumeToken();
-    return llvm::formatv("{0}{1}", global_scope ? "::" : "", identifier);
+    return id_expression;
   }
 
   // This is unqualified_id production.
@@ -2166,7 +2341,7 @@ std::string Parser::ParseIdExpression() {
 //
 std::string Parser::ParseUnqualifiedId() {
   Expect(clang::tok::identifier);
-  std::string identifier = pp_->getSpelling(token_);
+  std::string identifier = GetSpelling(token_);
   ConsumeToken();
   return identifier;
 }
@@ -2194,9 +2369,9 @@ ExprResult Parser::ParseBooleanLiteral() {
   clang::SourceLocation loc = token_.getLocation();
   bool literal_value = token_.is(clang::tok::kw_true);
   ConsumeToken();
-  return std::make_unique<LiteralNode>(
-      loc, ctx_->GetBasicType(lldb::eBasicTypeBool), literal_value,
-      /*is_literal_zero*/ false);
+  return MakeNode<LiteralNode>(*arena_, loc,
+                               ctx_->GetBasicType(lldb::eBasicTypeBool),
+                               literal_value, /*is_literal_zero*/ false);
 }
 
 ExprResult Parser::ParseCharLiteral() {
@@ -2205,12 +2380,13 @@ ExprResult Parser::ParseCharLiteral() {
               clang::tok::utf32_char_constant);
   clang::SourceLocation loc = token_.getLocation();
 
-  std::string token_spelling = pp_->getSpelling(token_);
+  std::string token_spelling = GetSpelling(token_);
 
   const char* token_begin = token_spelling.c_str();
   clang::CharLiteralParser char_literal(token_begin,
                                         token_begin + token_spelling.size(),
-                                        loc, *pp_, token_.getKind());
+                                        loc, GetPreprocessor(),
+                                        token_.getKind());
 
   if (char_literal.hadError()) {
     // TODO: Add new ErrorCode kInvalidCharLiteral and use it
@@ -2218,7 +2394,7 @@ ExprResult Parser::ParseCharLiteral() {
             llvm::formatv("Failed to parse token as char-constant: {0}",
                           TokenDescription(token_)),
             token_.getLocation());
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   auto ctx_basic_type = ctx_->GetBasicType(PickCharType(char_literal));
@@ -2226,8 +2402,8 @@ ExprResult Parser::ParseCharLiteral() {
                             char_literal.getValue());
 
   ConsumeToken();
-  return std::make_unique<LiteralNode>(loc, ctx_basic_type, literal_value,
-                                       /*is_literal_zero*/ false);
+  return MakeNode<LiteralNode>(*arena_, loc, ctx_basic_type, literal_value,
+                               /*is_literal_zero*/ false);
 }
 
 ExprResult Parser::ParseStringLiteral() {
@@ -2239,7 +2415,7 @@ ExprResult Parser::ParseStringLiteral() {
   // TODO: Support parsing of joined string-literals (e.g. "abc" "def").
   // Currently, only a single token can be parsed into a string.
   clang::StringLiteralParser string_literal(
-      clang::ArrayRef<clang::Token>(token_), *pp_);
+      clang::ArrayRef<clang::Token>(token_), GetPreprocessor());
 
   if (string_literal.hadError) {
     // TODO: Use ErrorCode::kInvalidStringLiteral in the future.
@@ -2247,7 +2423,7 @@ ExprResult Parser::ParseStringLiteral() {
             llvm::formatv("Failed to parse token as string-literal: {0}",
                           TokenDescription(token_)),
             loc);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   auto char_type = ctx_->GetBasicType(PickCharType(string_literal));
@@ -2265,7 +2441,8 @@ ExprResult Parser::ParseStringLiteral() {
          "invalid string literal: unexpected data size");
 
   ConsumeToken();
-  return std::make_unique<LiteralNode>(loc, array_type, std::move(data), false);
+  return MakeNode<LiteralNode>(*arena_, loc, array_type, std::move(data),
+                               false);
 }
 
 // Parse an pointer_literal.
@@ -2278,25 +2455,26 @@ ExprResult Parser::ParsePointerLiteral() {
   clang::SourceLocation loc = token_.getLocation();
   ConsumeToken();
   llvm::APInt raw_value(type_width<uintmax_t>(), 0);
-  return std::make_unique<LiteralNode>(
-      loc, ctx_->GetBasicType(lldb::eBasicTypeNullPtr), raw_value,
-      /*is_literal_zero*/ false);
+  return MakeNode<LiteralNode>(*arena_, loc,
+                               ctx_->GetBasicType(lldb::eBasicTypeNullPtr),
+                               raw_value, /*is_literal_zero*/ false);
 }
 
 ExprResult Parser::ParseNumericConstant(clang::Token token) {
   // Parse numeric constant, it can be either integer or float.
-  std::string tok_spelling = pp_->getSpelling(token);
+  std::string tok_spelling = GetSpelling(token);
 
   clang::NumericLiteralParser literal(
-      tok_spelling, token.getLocation(), pp_->getSourceManager(),
-      pp_->getLangOpts(), pp_->getTargetInfo(), pp_->getDiagnostics());
+      tok_spelling, token.getLocation(), ctx_->GetSourceManager(),
+      engine_->GetLangOptions(), engine_->GetTargetInfo(),
+      ctx_->GetSourceManager().getDiagnostics());
 
   if (literal.hadError) {
     BailOut(
         ErrorCode::kInvalidNumericLiteral,
         "Failed to parse token as numeric-constant: " + TokenDescription(token),
         token.getLocation());
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   // Check for floating-literal and integer-literal. Fail on anything else (i.e.
@@ -2313,7 +2491,7 @@ ExprResult Parser::ParseNumericConstant(clang::Token token) {
           "numeric-constant should be either float or integer literal: " +
               TokenDescription(token),
           token.getLocation());
-  return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+  return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
 }
 
 ExprResult Parser::ParseFloatingLiteral(clang::NumericLiteralParser& literal,
@@ -2332,14 +2510,14 @@ ExprResult Parser::ParseFloatingLiteral(clang::NumericLiteralParser& literal,
             llvm::formatv("float underflow/overflow happened: {0}",
                           TokenDescription(token)),
             token.getLocation());
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   auto basic_type =
       literal.isFloat ? lldb::eBasicTypeFloat : lldb::eBasicTypeDouble;
-  return std::make_unique<LiteralNode>(
-      token.getLocation(), ctx_->GetBasicType(basic_type), raw_value,
-      /*is_literal_zero*/ false);
+  return MakeNode<LiteralNode>(*arena_, token.getLocation(),
+                               ctx_->GetBasicType(basic_type), raw_value,
+                               /*is_literal_zero*/ false);
 }
 
 ExprResult Parser::ParseIntegerLiteral(clang::NumericLiteralParser& literal,
@@ -2353,7 +2531,7 @@ ExprResult Parser::ParseIntegerLiteral(clang::NumericLiteralParser& literal,
                           "any integer type: {0}",
                           TokenDescription(token)),
             token.getLocation());
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   auto [type, is_unsigned] = PickIntegerType(*ctx_, literal, raw_value);
@@ -2364,9 +2542,9 @@ ExprResult Parser::ParseIntegerLiteral(clang::NumericLiteralParser& literal,
   bool is_literal_zero = raw_value.isZero();
 #endif
 
-  return std::make_unique<LiteralNode>(token.getLocation(),
-                                       ctx_->GetBasicType(type), raw_value,
-                                       is_literal_zero);
+  return MakeNode<LiteralNode>(*arena_, token.getLocation(),
+                               ctx_->GetBasicType(type), raw_value,
+                               is_literal_zero);
 }
 
 // Parse a builtin_func.
@@ -2376,6 +2554,11 @@ ExprResult Parser::ParseIntegerLiteral(clang::NumericLiteralParser& literal,
 //
 //  builtin_func_name:
 //    "__log2"
+//    "__findnonnull"
+//    "__findvalue"
+//    "__count"
+//    "__min"
+//    "__max"
 //
 //  builtin_func_argument_list:
 //    builtin_func_argument
@@ -2406,7 +2589,7 @@ ExprResult Parser::ParseBuiltinFunction(
       // don't try parsing the rest of the arguments.
       auto argument = ParseExpression();
       if (argument->is_error()) {
-        return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+        return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
       }
 
       arguments.push_back(std::move(argument));
@@ -2425,26 +2608,84 @@ ExprResult Parser::ParseBuiltinFunction(
                 "argument(s), but {2} argument(s) were provided",
                 func_def->name_, func_def->arguments_.size(), arguments.size()),
             loc);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
+  }
+
+  // Resolve the element type "T" of the buffer functions. The buffer itself is
+  // passed as is (either a pointer or an array).
+  TypeSP element_type;
+  TypeSP return_type = func_def->return_type_;
+  if (!func_def->arguments_.empty() && !func_def->arguments_[0]) {
+    element_type = GetBufferElementType(arguments[0]->result_type_deref(),
+                                        func_def->name_, loc);
+    if (!element_type) {
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
+    }
+    if (!return_type) {
+      return_type = element_type;
+    }
   }
 
   // Now check that all arguments are correct types and perform implicit
   // conversions if possible.
   for (size_t i = 0; i < arguments.size(); ++i) {
+    if (i == 0 && element_type) {
+      continue;
+    }
+    TypeSP arg_type =
+        func_def->arguments_[i] ? func_def->arguments_[i] : element_type;
     // HACK: Void means "any" and we'll check in runtime. The argument will be
     // passed as is without any conversions.
-    if (func_def->arguments_[i]->GetBasicType() == lldb::eBasicTypeVoid) {
+    if (arg_type->GetBasicType() == lldb::eBasicTypeVoid) {
       continue;
     }
-    arguments[i] = InsertImplicitConversion(std::move(arguments[i]),
-                                            func_def->arguments_[i]);
+    arguments[i] = InsertImplicitConversion(std::move(arguments[i]), arg_type);
     if (arguments[i]->is_error()) {
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
   }
 
-  return std::make_unique<BuiltinFunctionCallNode>(
-      loc, func_def->return_type_, func_def->name_, std::move(arguments));
+  return MakeNode<BuiltinFunctionCallNode>(*arena_, loc, return_type,
+                                           func_def->name_,
+                                           std::move(arguments));
+}
+
+TypeSP Parser::GetBufferElementType(TypeSP buffer_type,
+                                    const std::string& func_name,
+                                    clang::SourceLocation loc) {
+  TypeSP element_type;
+  if (buffer_type->IsPointerType()) {
+    element_type = buffer_type->GetPointeeType();
+  } else if (buffer_type->IsArrayType()) {
+    element_type = buffer_type->GetArrayElementType();
+  } else {
+    BailOut(ErrorCode::kInvalidOperandType,
+            llvm::formatv("no known conversion from '{0}' to 'T*' for 1st "
+                          "argument of {1}()",
+                          buffer_type->GetName(), func_name),
+            loc);
+    return nullptr;
+  }
+  element_type = element_type->GetUnqualifiedType();
+
+  // The elements are compared and reduced by the evaluator, which supports
+  // only the types that fit in a scalar. Pointers can only be compared.
+  auto canonical = element_type->GetCanonicalType();
+  bool is_supported =
+      (canonical->IsInteger() || canonical->IsEnum() ||
+       canonical->GetBasicType() == lldb::eBasicTypeFloat ||
+       canonical->GetBasicType() == lldb::eBasicTypeDouble ||
+       (canonical->IsPointerType() && func_name != "__min" &&
+        func_name != "__max"));
+  if (!is_supported) {
+    BailOut(ErrorCode::kInvalidOperandType,
+            llvm::formatv("{0}() is not supported for the elements of type "
+                          "'{1}'",
+                          func_name, element_type->GetName()),
+            loc);
+    return nullptr;
+  }
+  return element_type;
 }
 
 ExprResult Parser::InsertImplicitConversion(ExprResult expr, TypeSP type) {
@@ -2458,13 +2699,15 @@ ExprResult Parser::InsertImplicitConversion(ExprResult expr, TypeSP type) {
   // Check if the implicit conversion is possible and insert a cast.
   if (ImplicitConversionIsAllowed(expr_type, type, expr->is_literal_zero())) {
     if (type->IsBasicType()) {
-      return std::make_unique<CStyleCastNode>(
-          expr->location(), type, std::move(expr), CStyleCastKind::kArithmetic);
+      return MakeNode<CStyleCastNode>(*arena_, expr->location(), type,
+                                      std::move(expr),
+                                      CStyleCastKind::kArithmetic);
     }
 
     if (type->IsPointerType()) {
-      return std::make_unique<CStyleCastNode>(
-          expr->location(), type, std::move(expr), CStyleCastKind::kPointer);
+      return MakeNode<CStyleCastNode>(*arena_, expr->location(), type,
+                                      std::move(expr),
+                                      CStyleCastKind::kPointer);
     }
 
     // TODO(werat): What about if the conversion is not `kArithmetic` or
@@ -2476,7 +2719,7 @@ ExprResult Parser::InsertImplicitConversion(ExprResult expr, TypeSP type) {
           llvm::formatv("no known conversion from {0} to {1}",
                         TypeDescription(expr_type), TypeDescription(type)),
           expr->location());
-  return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+  return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
 }
 
 bool Parser::ImplicitConversionIsAllowed(TypeSP src, TypeSP dst,
@@ -2525,7 +2768,7 @@ ExprResult Parser::BuildCStyleCast(TypeSP type, ExprResult rhs,
                 llvm::formatv("C-style cast from {0} to {1} is not allowed",
                               TypeDescription(rhs_type), TypeDescription(type)),
                 location);
-        return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+        return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
       }
       // Casting pointer to bool is valid. Otherwise check if the result type
       // is at least as big as the pointer size.
@@ -2535,7 +2778,7 @@ ExprResult Parser::BuildCStyleCast(TypeSP type, ExprResult rhs,
                     "cast from pointer to smaller type {0} loses information",
                     TypeDescription(type)),
                 location);
-        return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+        return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
       }
     } else if (!rhs_type->IsScalar() && !rhs_type->IsEnum()) {
       // Otherwise accept only arithmetic types and enums.
@@ -2544,7 +2787,7 @@ ExprResult Parser::BuildCStyleCast(TypeSP type, ExprResult rhs,
                   "cannot convert {0} to {1} without a conversion operator",
                   TypeDescription(rhs_type), TypeDescription(type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
     kind = CStyleCastKind::kArithmetic;
 
@@ -2555,7 +2798,7 @@ ExprResult Parser::BuildCStyleCast(TypeSP type, ExprResult rhs,
               llvm::formatv("C-style cast from {0} to {1} is not allowed",
                             TypeDescription(rhs_type), TypeDescription(type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
     kind = CStyleCastKind::kEnumeration;
 
@@ -2568,7 +2811,7 @@ ExprResult Parser::BuildCStyleCast(TypeSP type, ExprResult rhs,
               llvm::formatv("cannot cast from type {0} to pointer type {1}",
                             TypeDescription(rhs_type), TypeDescription(type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
     kind = CStyleCastKind::kPointer;
 
@@ -2579,7 +2822,7 @@ ExprResult Parser::BuildCStyleCast(TypeSP type, ExprResult rhs,
               llvm::formatv("C-style cast from {0} to {1} is not allowed",
                             TypeDescription(rhs_type), TypeDescription(type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
     kind = CStyleCastKind::kNullptr;
 
@@ -2590,7 +2833,7 @@ ExprResult Parser::BuildCStyleCast(TypeSP type, ExprResult rhs,
               llvm::formatv("C-style cast from rvalue to reference type {0}",
                             TypeDescription(type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
     kind = CStyleCastKind::kReference;
 
@@ -2600,10 +2843,11 @@ ExprResult Parser::BuildCStyleCast(TypeSP type, ExprResult rhs,
             llvm::formatv("casting of {0} to {1} is not implemented yet",
                           TypeDescription(rhs_type), TypeDescription(type)),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
-  return std::make_unique<CStyleCastNode>(location, type, std::move(rhs), kind);
+  return MakeNode<CStyleCastNode>(*arena_, location, type, std::move(rhs),
+                                  kind);
 }
 
 ExprResult Parser::BuildCxxCast(clang::tok::TokenKind kind, TypeSP type,
@@ -2638,9 +2882,9 @@ ExprResult Parser::BuildCxxStaticCast(TypeSP type, ExprResult rhs,
   }
 
   if (CompareTypes(rhs_type, type)) {
-    return std::make_unique<CxxStaticCastNode>(location, type, std::move(rhs),
-                                               CxxStaticCastKind::kNoOp,
-                                               /*is_rvalue*/ true);
+    return MakeNode<CxxStaticCastNode>(*arena_, location, type, std::move(rhs),
+                                       CxxStaticCastKind::kNoOp,
+                                       /*is_rvalue*/ true);
   }
 
   if (type->IsScalar()) {
@@ -2660,7 +2904,7 @@ ExprResult Parser::BuildCxxStaticCast(TypeSP type, ExprResult rhs,
           llvm::formatv("casting of {0} to {1} is not implemented yet",
                         TypeDescription(rhs_type), TypeDescription(type)),
           location);
-  return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+  return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
 }
 
 ExprResult Parser::BuildCxxStaticCastToScalar(TypeSP type, ExprResult rhs,
@@ -2674,7 +2918,7 @@ ExprResult Parser::BuildCxxStaticCastToScalar(TypeSP type, ExprResult rhs,
               llvm::formatv("static_cast from {0} to {1} is not allowed",
                             TypeDescription(rhs_type), TypeDescription(type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
   } else if (!rhs_type->IsScalar() && !rhs_type->IsEnum()) {
     // Otherwise accept only arithmetic types and enums.
@@ -2683,12 +2927,12 @@ ExprResult Parser::BuildCxxStaticCastToScalar(TypeSP type, ExprResult rhs,
         llvm::formatv("cannot convert {0} to {1} without a conversion operator",
                       TypeDescription(rhs_type), TypeDescription(type)),
         location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
-  return std::make_unique<CxxStaticCastNode>(location, type, std::move(rhs),
-                                             CxxStaticCastKind::kArithmetic,
-                                             /*is_rvalue*/ true);
+  return MakeNode<CxxStaticCastNode>(*arena_, location, type, std::move(rhs),
+                                     CxxStaticCastKind::kArithmetic,
+                                     /*is_rvalue*/ true);
 }
 
 ExprResult Parser::BuildCxxStaticCastToEnum(TypeSP type, ExprResult rhs,
@@ -2700,12 +2944,12 @@ ExprResult Parser::BuildCxxStaticCastToEnum(TypeSP type, ExprResult rhs,
             llvm::formatv("static_cast from {0} to {1} is not allowed",
                           TypeDescription(rhs_type), TypeDescription(type)),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
-  return std::make_unique<CxxStaticCastNode>(location, type, std::move(rhs),
-                                             CxxStaticCastKind::kEnumeration,
-                                             /*is_rvalue*/ true);
+  return MakeNode<CxxStaticCastNode>(*arena_, location, type, std::move(rhs),
+                                     CxxStaticCastKind::kEnumeration,
+                                     /*is_rvalue*/ true);
 }
 
 ExprResult Parser::BuildCxxStaticCastToPointer(TypeSP type, ExprResult rhs,
@@ -2726,19 +2970,19 @@ ExprResult Parser::BuildCxxStaticCastToPointer(TypeSP type, ExprResult rhs,
               llvm::formatv("static_cast from {0} to {1} is not allowed",
                             TypeDescription(rhs_type), TypeDescription(type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
   } else if (!rhs_type->IsNullPtrType() && !rhs->is_literal_zero()) {
     BailOut(ErrorCode::kInvalidOperandType,
             llvm::formatv("cannot cast from type {0} to pointer type '{1}'",
                           TypeDescription(rhs_type), TypeDescription(type)),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
-  return std::make_unique<CxxStaticCastNode>(location, type, std::move(rhs),
-                                             CxxStaticCastKind::kPointer,
-                                             /*is_rvalue*/ true);
+  return MakeNode<CxxStaticCastNode>(*arena_, location, type, std::move(rhs),
+                                     CxxStaticCastKind::kPointer,
+                                     /*is_rvalue*/ true);
 }
 
 ExprResult Parser::BuildCxxStaticCastToNullPtr(TypeSP type, ExprResult rhs,
@@ -2750,12 +2994,12 @@ ExprResult Parser::BuildCxxStaticCastToNullPtr(TypeSP type, ExprResult rhs,
             llvm::formatv("static_cast from {0} to {1} is not allowed",
                           TypeDescription(rhs_type), TypeDescription(type)),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
-  return std::make_unique<CxxStaticCastNode>(location, type, std::move(rhs),
-                                             CxxStaticCastKind::kNullptr,
-                                             /*is_rvalue*/ true);
+  return MakeNode<CxxStaticCastNode>(*arena_, location, type, std::move(rhs),
+                                     CxxStaticCastKind::kNullptr,
+                                     /*is_rvalue*/ true);
 }
 
 ExprResult Parser::BuildCxxStaticCastToReference(
@@ -2769,13 +3013,13 @@ ExprResult Parser::BuildCxxStaticCastToReference(
                           "type {1} is not implemented yet",
                           TypeDescription(rhs_type), TypeDescription(type)),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   if (CompareTypes(type_deref, rhs_type)) {
-    return std::make_unique<CxxStaticCastNode>(
-        location, type_deref, std::move(rhs), CxxStaticCastKind::kNoOp,
-        /*is_rvalue*/ false);
+    return MakeNode<CxxStaticCastNode>(*arena_, location, type_deref,
+                                       std::move(rhs), CxxStaticCastKind::kNoOp,
+                                       /*is_rvalue*/ false);
   }
 
   if (type_deref->IsRecordType() && rhs_type->IsRecordType()) {
@@ -2786,7 +3030,7 @@ ExprResult Parser::BuildCxxStaticCastToReference(
           llvm::formatv("static_cast from {0} to {1} is not implemented yet",
                         TypeDescription(rhs_type), TypeDescription(type)),
           location);
-  return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+  return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
 }
 
 ExprResult Parser::BuildCxxStaticCastForInheritedTypes(
@@ -2808,36 +3052,32 @@ ExprResult Parser::BuildCxxStaticCastForInheritedTypes(
   // Result of cast to reference type is an lvalue.
   bool is_rvalue = !type->IsReferenceType();
 
-  // Handle derived-to-base conversion.
-  std::vector<uint32_t> idx;
-  if (GetPathToBaseType(rhs_record_type, record_type, &idx,
-                        /*offset*/ nullptr)) {
-    std::reverse(idx.begin(), idx.end());
-    // At this point `idx` represents indices of direct base classes on path
-    // from the `rhs` type to the target `type`.
-    return std::make_unique<CxxStaticCastNode>(location, type, std::move(rhs),
-                                               std::move(idx), is_rvalue);
+  // Handle derived-to-base conversion. The paths are cached per target, see
+  // `TargetCache::GetBaseClassPath()`.
+  if (auto to_base = ctx_->GetBaseClassPath(rhs_record_type, record_type)) {
+    // `path` represents indices of direct base classes on path from the `rhs`
+    // type to the target `type`.
+    return MakeNode<CxxStaticCastNode>(*arena_, location, type, std::move(rhs),
+                                       to_base->path, is_rvalue);
   }
 
   // Handle base-to-derived conversion.
-  uint64_t offset = 0;
-  if (GetPathToBaseType(record_type, rhs_record_type, /*path*/ nullptr,
-                        &offset)) {
-    TypeSP virtual_base;
-    if (IsVirtualBase(record_type, rhs_record_type, &virtual_base)) {
+  if (auto to_derived = ctx_->GetBaseClassPath(record_type, rhs_record_type)) {
+    if (to_derived->virtual_base) {
       // Base-to-derived conversion isn't possible for virtually inherited
       // types (either directly or indirectly).
-      assert(virtual_base->IsValid() && "virtual base should be valid");
+      assert(to_derived->virtual_base->IsValid() &&
+             "virtual base should be valid");
       BailOut(ErrorCode::kInvalidOperandType,
               llvm::formatv("cannot cast {0} to {1} via virtual base {2}",
                             TypeDescription(rhs_type), TypeDescription(type),
-                            TypeDescription(virtual_base)),
+                            TypeDescription(to_derived->virtual_base)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
 
-    return std::make_unique<CxxStaticCastNode>(location, type, std::move(rhs),
-                                               offset, is_rvalue);
+    return MakeNode<CxxStaticCastNode>(*arena_, location, type, std::move(rhs),
+                                       to_derived->offset, is_rvalue);
   }
 
   BailOut(ErrorCode::kInvalidOperandType,
@@ -2845,7 +3085,7 @@ ExprResult Parser::BuildCxxStaticCastForInheritedTypes(
                         "related by inheritance, is not allowed",
                         TypeDescription(rhs_type), TypeDescription(type)),
           location);
-  return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+  return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
 }
 
 ExprResult Parser::BuildCxxReinterpretCast(TypeSP type, ExprResult rhs,
@@ -2860,7 +3100,7 @@ ExprResult Parser::BuildCxxReinterpretCast(TypeSP type, ExprResult rhs,
               llvm::formatv("reinterpret_cast from {0} to {1} is not allowed",
                             TypeDescription(rhs_type), TypeDescription(type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
 
     // Perform implicit conversions.
@@ -2878,7 +3118,7 @@ ExprResult Parser::BuildCxxReinterpretCast(TypeSP type, ExprResult rhs,
                     "cast from pointer to smaller type {0} loses information",
                     TypeDescription(type)),
                 location);
-        return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+        return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
       }
     } else if (!CompareTypes(type, rhs_type)) {
       // Integral type can be converted to its own type.
@@ -2886,7 +3126,7 @@ ExprResult Parser::BuildCxxReinterpretCast(TypeSP type, ExprResult rhs,
               llvm::formatv("reinterpret_cast from {0} to {1} is not allowed",
                             TypeDescription(rhs_type), TypeDescription(type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
   } else if (type->IsEnum()) {
     // Enumeration type can be converted to its own type.
@@ -2895,7 +3135,7 @@ ExprResult Parser::BuildCxxReinterpretCast(TypeSP type, ExprResult rhs,
               llvm::formatv("reinterpret_cast from {0} to {1} is not allowed",
                             TypeDescription(rhs_type), TypeDescription(type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
 
   } else if (type->IsPointerType()) {
@@ -2908,7 +3148,7 @@ ExprResult Parser::BuildCxxReinterpretCast(TypeSP type, ExprResult rhs,
               llvm::formatv("reinterpret_cast from {0} to {1} is not allowed",
                             TypeDescription(rhs_type), TypeDescription(type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
 
   } else if (type->IsNullPtrType()) {
@@ -2917,7 +3157,7 @@ ExprResult Parser::BuildCxxReinterpretCast(TypeSP type, ExprResult rhs,
             llvm::formatv("reinterpret_cast from {0} to {1} is not allowed",
                           TypeDescription(rhs_type), TypeDescription(type)),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
 
   } else if (type->IsReferenceType()) {
     // L-values can be converted to any reference type.
@@ -2927,7 +3167,7 @@ ExprResult Parser::BuildCxxReinterpretCast(TypeSP type, ExprResult rhs,
           llvm::formatv("reinterpret_cast from rvalue to reference type {0}",
                         TypeDescription(type)),
           location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
     // Casting to reference types gives an L-value result.
     is_rvalue = false;
@@ -2938,11 +3178,11 @@ ExprResult Parser::BuildCxxReinterpretCast(TypeSP type, ExprResult rhs,
             llvm::formatv("casting of {0} to {1} is not implemented yet",
                           TypeDescription(rhs_type), TypeDescription(type)),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
-  return std::make_unique<CxxReinterpretCastNode>(location, type,
-                                                  std::move(rhs), is_rvalue);
+  return MakeNode<CxxReinterpretCastNode>(*arena_, location, type,
+                                          std::move(rhs), is_rvalue);
 }
 
 ExprResult Parser::BuildCxxDynamicCast(TypeSP type, ExprResult rhs,
@@ -2960,7 +3200,7 @@ ExprResult Parser::BuildCxxDynamicCast(TypeSP type, ExprResult rhs,
                       "must be a reference or pointer type to a defined class",
                       TypeDescription(type)),
         location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
   // Dynamic casts are allowed only for record types.
   if (!pointee_type->IsRecordType()) {
@@ -2968,7 +3208,7 @@ ExprResult Parser::BuildCxxDynamicCast(TypeSP type, ExprResult rhs,
         ErrorCode::kInvalidOperandType,
         llvm::formatv("{0} is not a class type", TypeDescription(pointee_type)),
         location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   auto expr_type = rhs->result_type();
@@ -2982,7 +3222,7 @@ ExprResult Parser::BuildCxxDynamicCast(TypeSP type, ExprResult rhs,
             llvm::formatv("cannot use dynamic_cast to convert from {0} to {1}",
                           TypeDescription(expr_type), TypeDescription(type)),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
   // Dynamic casts are allowed only for record types.
   if (!expr_type->IsRecordType()) {
@@ -2990,7 +3230,7 @@ ExprResult Parser::BuildCxxDynamicCast(TypeSP type, ExprResult rhs,
         ErrorCode::kInvalidOperandType,
         llvm::formatv("{0} is not a class type", TypeDescription(expr_type)),
         location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   // Expr type must be polymorphic.
@@ -2998,14 +3238,14 @@ ExprResult Parser::BuildCxxDynamicCast(TypeSP type, ExprResult rhs,
     BailOut(ErrorCode::kInvalidOperandType,
             llvm::formatv("{0} is not polymorphic", TypeDescription(expr_type)),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   // LLDB doesn't support dynamic_cast in the expression evaluator. We disable
   // it too to match the behaviour, but theoretically it can be implemented.
   BailOut(ErrorCode::kInvalidOperandType,
           "dynamic_cast is not supported in this context", location);
-  return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+  return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
 }
 
 ExprResult Parser::BuildUnaryOp(UnaryOpKind kind, ExprResult rhs,
@@ -3029,7 +3269,7 @@ ExprResult Parser::BuildUnaryOp(UnaryOpKind kind, ExprResult rhs,
             llvm::formatv("indirection requires pointer operand ({0} invalid)",
                           TypeDescription(rhs_type)),
             location);
-        return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+        return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
       }
       break;
     }
@@ -3040,12 +3280,12 @@ ExprResult Parser::BuildUnaryOp(UnaryOpKind kind, ExprResult rhs,
             llvm::formatv("cannot take the address of an rvalue of type {0}",
                           TypeDescription(rhs_type)),
             location);
-        return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+        return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
       }
       if (rhs->is_bitfield()) {
         BailOut(ErrorCode::kInvalidOperandType,
                 "address of bit-field requested", location);
-        return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+        return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
       }
       result_type = rhs_type->GetPointerType();
       break;
@@ -3091,11 +3331,11 @@ ExprResult Parser::BuildUnaryOp(UnaryOpKind kind, ExprResult rhs,
             llvm::formatv(kInvalidOperandsToUnaryExpression,
                           TypeDescription(rhs_type)),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
-  return std::make_unique<UnaryOpNode>(location, result_type, kind,
-                                       std::move(rhs));
+  return MakeNode<UnaryOpNode>(*arena_, location, result_type, kind,
+                               std::move(rhs));
 }
 
 ExprResult Parser::BuildIncrementDecrement(UnaryOpKind kind, ExprResult rhs,
@@ -3116,14 +3356,14 @@ ExprResult Parser::BuildIncrementDecrement(UnaryOpKind kind, ExprResult rhs,
   if (rhs->is_rvalue()) {
     BailOut(ErrorCode::kInvalidOperandType,
             llvm::formatv("expression is not assignable"), location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
   if (!rhs->is_context_var() && !ctx_->AllowSideEffects()) {
     BailOut(ErrorCode::kInvalidOperandType,
             llvm::formatv("side effects are not supported in this context: "
                           "trying to modify data at the target process"),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
   llvm::StringRef op_name =
       (kind == UnaryOpKind::PreInc || kind == UnaryOpKind::PostInc)
@@ -3134,18 +3374,18 @@ ExprResult Parser::BuildIncrementDecrement(UnaryOpKind kind, ExprResult rhs,
             llvm::formatv("cannot {0} expression of enum type '{1}'", op_name,
                           rhs_type->GetName()),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
   if (!rhs_type->IsScalar() && !rhs_type->IsPointerType()) {
     BailOut(ErrorCode::kInvalidOperandType,
             llvm::formatv("cannot {0} value of type '{1}'", op_name,
                           rhs_type->GetName()),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
-  return std::make_unique<UnaryOpNode>(location, rhs->result_type(), kind,
-                                       std::move(rhs));
+  return MakeNode<UnaryOpNode>(*arena_, location, rhs->result_type(), kind,
+                               std::move(rhs));
 }
 
 ExprResult Parser::BuildBinaryOp(BinaryOpKind kind, ExprResult lhs,
@@ -3219,7 +3459,7 @@ ExprResult Parser::BuildBinaryOp(BinaryOpKind kind, ExprResult lhs,
       rhs = InsertImplicitConversion(std::move(rhs), lhs->result_type_deref());
       // Shortcut for the case when the implicit conversion is not possible.
       if (rhs->is_error()) {
-        return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+        return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
       }
       comp_assign_type = rhs->result_type_deref();
       break;
@@ -3270,9 +3510,9 @@ ExprResult Parser::BuildBinaryOp(BinaryOpKind kind, ExprResult lhs,
 
   // If the result type is valid, then the binary operation is valid!
   if (result_type->IsValid()) {
-    return std::make_unique<BinaryOpNode>(location, result_type, kind,
-                                          std::move(lhs), std::move(rhs),
-                                          comp_assign_type);
+    return MakeNode<BinaryOpNode>(*arena_, location, result_type, kind,
+                                  std::move(lhs), std::move(rhs),
+                                  comp_assign_type);
   }
 
   BailOut(ErrorCode::kInvalidOperandType,
@@ -3280,7 +3520,7 @@ ExprResult Parser::BuildBinaryOp(BinaryOpKind kind, ExprResult lhs,
                         TypeDescription(orig_lhs_type),
                         TypeDescription(orig_rhs_type)),
           location);
-  return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+  return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
 }
 
 TypeSP Parser::PrepareBinaryAddition(ExprResult& lhs, ExprResult& rhs,
@@ -3614,7 +3854,7 @@ ExprResult Parser::BuildBinarySubscript(ExprResult lhs, ExprResult rhs,
   } else {
     BailOut(ErrorCode::kInvalidOperandType,
             "subscripted value is not an array or pointer", location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   // Index can be a typedef of a typedef of a typedef of a typedef...
@@ -3625,19 +3865,19 @@ ExprResult Parser::BuildBinarySubscript(ExprResult lhs, ExprResult rhs,
   if (!index_type->IsIntegerOrUnscopedEnum()) {
     BailOut(ErrorCode::kInvalidOperandType, "array subscript is not an integer",
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   auto base_type = base->result_type_deref();
   if (base_type->IsPointerToVoid()) {
     BailOut(ErrorCode::kInvalidOperandType,
             "subscript of pointer to incomplete type 'void'", location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
-  return std::make_unique<ArraySubscriptNode>(
-      location, base->result_type_deref()->GetPointeeType(), std::move(base),
-      std::move(index));
+  return MakeNode<ArraySubscriptNode>(
+      *arena_, location, base->result_type_deref()->GetPointeeType(),
+      std::move(base), std::move(index));
 }
 
 TypeSP Parser::PrepareCompositeAssignment(TypeSP comp_assign_type,
@@ -3689,7 +3929,7 @@ ExprResult Parser::BuildTernaryOp(ExprResult cond, ExprResult lhs,
         ErrorCode::kInvalidOperandType,
         llvm::formatv(kValueIsNotConvertibleToBool, TypeDescription(cond_type)),
         location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   auto lhs_type = lhs->result_type_deref();
@@ -3697,8 +3937,8 @@ ExprResult Parser::BuildTernaryOp(ExprResult cond, ExprResult lhs,
 
   // If operands have the same type, don't do any promotions.
   if (CompareTypes(lhs_type, rhs_type)) {
-    return std::make_unique<TernaryOpNode>(location, lhs_type, std::move(cond),
-                                           std::move(lhs), std::move(rhs));
+    return MakeNode<TernaryOpNode>(*arena_, location, lhs_type, std::move(cond),
+                                   std::move(lhs), std::move(rhs));
   }
 
   // If both operands have arithmetic type, apply the usual arithmetic
@@ -3706,8 +3946,9 @@ ExprResult Parser::BuildTernaryOp(ExprResult cond, ExprResult lhs,
   if (lhs_type->IsScalarOrUnscopedEnum() &&
       rhs_type->IsScalarOrUnscopedEnum()) {
     auto result_type = UsualArithmeticConversions(*ctx_, lhs, rhs);
-    return std::make_unique<TernaryOpNode>(
-        location, result_type, std::move(cond), std::move(lhs), std::move(rhs));
+    return MakeNode<TernaryOpNode>(*arena_, location, result_type,
+                                   std::move(cond), std::move(lhs),
+                                   std::move(rhs));
   }
 
   // Apply array-to-pointer implicit conversions.
@@ -3722,51 +3963,51 @@ ExprResult Parser::BuildTernaryOp(ExprResult cond, ExprResult lhs,
 
   // Check if operands have the same pointer type.
   if (CompareTypes(lhs_type, rhs_type)) {
-    return std::make_unique<TernaryOpNode>(location, lhs_type, std::move(cond),
-                                           std::move(lhs), std::move(rhs));
+    return MakeNode<TernaryOpNode>(*arena_, location, lhs_type, std::move(cond),
+                                   std::move(lhs), std::move(rhs));
   }
 
   // If one operand is a pointer and the other is a nullptr or literal zero,
   // convert the nullptr operand to pointer type.
   if (lhs_type->IsPointerType() &&
       (rhs->is_literal_zero() || rhs_type->IsNullPtrType())) {
-    rhs = std::make_unique<CStyleCastNode>(
-        rhs->location(), lhs_type, std::move(rhs), CStyleCastKind::kPointer);
+    rhs = MakeNode<CStyleCastNode>(*arena_, rhs->location(), lhs_type,
+                                   std::move(rhs), CStyleCastKind::kPointer);
 
-    return std::make_unique<TernaryOpNode>(location, lhs_type, std::move(cond),
-                                           std::move(lhs), std::move(rhs));
+    return MakeNode<TernaryOpNode>(*arena_, location, lhs_type, std::move(cond),
+                                   std::move(lhs), std::move(rhs));
   }
   if ((lhs->is_literal_zero() || lhs_type->IsNullPtrType()) &&
       rhs_type->IsPointerType()) {
-    lhs = std::make_unique<CStyleCastNode>(
-        lhs->location(), rhs_type, std::move(lhs), CStyleCastKind::kPointer);
+    lhs = MakeNode<CStyleCastNode>(*arena_, lhs->location(), rhs_type,
+                                   std::move(lhs), CStyleCastKind::kPointer);
 
-    return std::make_unique<TernaryOpNode>(location, rhs_type, std::move(cond),
-                                           std::move(lhs), std::move(rhs));
+    return MakeNode<TernaryOpNode>(*arena_, location, rhs_type, std::move(cond),
+                                   std::move(lhs), std::move(rhs));
   }
 
   // If one operand is nullptr and the other one is literal zero, convert
   // the literal zero to a nullptr type.
   if (lhs_type->IsNullPtrType() && rhs->is_literal_zero()) {
-    rhs = std::make_unique<CStyleCastNode>(
-        rhs->location(), lhs_type, std::move(rhs), CStyleCastKind::kNullptr);
+    rhs = MakeNode<CStyleCastNode>(*arena_, rhs->location(), lhs_type,
+                                   std::move(rhs), CStyleCastKind::kNullptr);
 
-    return std::make_unique<TernaryOpNode>(location, lhs_type, std::move(cond),
-                                           std::move(lhs), std::move(rhs));
+    return MakeNode<TernaryOpNode>(*arena_, location, lhs_type, std::move(cond),
+                                   std::move(lhs), std::move(rhs));
   }
   if (lhs->is_literal_zero() && rhs_type->IsNullPtrType()) {
-    lhs = std::make_unique<CStyleCastNode>(
-        lhs->location(), rhs_type, std::move(lhs), CStyleCastKind::kNullptr);
+    lhs = MakeNode<CStyleCastNode>(*arena_, lhs->location(), rhs_type,
+                                   std::move(lhs), CStyleCastKind::kNullptr);
 
-    return std::make_unique<TernaryOpNode>(location, rhs_type, std::move(cond),
-                                           std::move(lhs), std::move(rhs));
+    return MakeNode<TernaryOpNode>(*arena_, location, rhs_type, std::move(cond),
+                                   std::move(lhs), std::move(rhs));
   }
 
   BailOut(ErrorCode::kInvalidOperandType,
           llvm::formatv("incompatible operand types ({0} and {1})",
                         TypeDescription(lhs_type), TypeDescription(rhs_type)),
           location);
-  return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+  return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
 }
 
 ExprResult Parser::BuildMemberOf(ExprResult lhs, std::string member_id,
@@ -3784,7 +4025,7 @@ ExprResult Parser::BuildMemberOf(ExprResult lhs, std::string member_id,
                             "you mean to use '.'?",
                             TypeDescription(lhs_type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
 
     if (lhs_type->IsSmartPtrType()) {
@@ -3806,7 +4047,7 @@ ExprResult Parser::BuildMemberOf(ExprResult lhs, std::string member_id,
                             "did you mean to use '->'?",
                             TypeDescription(lhs_type)),
               location);
-      return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+      return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
     }
   }
 
@@ -3817,16 +4058,16 @@ ExprResult Parser::BuildMemberOf(ExprResult lhs, std::string member_id,
                 "member reference base type {0} is not a structure or union",
                 TypeDescription(lhs_type)),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
-  auto [member, idx] = ctx_->GetMemberInfo(lhs_type, member_id);
+  auto [member, idx, offset] = ctx_->GetMemberInfo(lhs_type, member_id);
   if (!member) {
     BailOut(ErrorCode::kInvalidOperandType,
             llvm::formatv("no member named '{0}' in {1}", member_id,
                           TypeDescription(lhs_type->GetUnqualifiedType())),
             location);
-    return std::make_unique<ErrorNode>(ctx_->GetEmptyType());
+    return MakeNode<ErrorNode>(*arena_, ctx_->GetEmptyType());
   }
 
   uint32_t bitfield_size =
@@ -3837,9 +4078,9 @@ ExprResult Parser::BuildMemberOf(ExprResult lhs, std::string member_id,
     bitfield_size = member.type->GetByteSize() * CHAR_BIT;
   }
 
-  return std::make_unique<MemberOfNode>(location, member.type, std::move(lhs),
-                                        member.is_bitfield, bitfield_size,
-                                        std::move(idx), is_arrow);
+  return MakeNode<MemberOfNode>(*arena_, location, member.type, std::move(lhs),
+                                member.is_bitfield, bitfield_size,
+                                std::move(idx), offset, is_arrow);
 }
 
 }  // namespace lldb_eval
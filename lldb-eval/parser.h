@@ -17,22 +17,29 @@
 #ifndef LLDB_EVAL_PARSER_H_
 #define LLDB_EVAL_PARSER_H_
 
+#include <map>
 #include <memory>
 #include <optional>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#include "clang/Basic/Diagnostic.h"
 #include "clang/Basic/FileManager.h"
+#include "clang/Basic/IdentifierTable.h"
 #include "clang/Basic/LangOptions.h"
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Basic/TargetInfo.h"
 #include "clang/Lex/HeaderSearch.h"
+#include "clang/Lex/HeaderSearchOptions.h"
 #include "clang/Lex/LiteralSupport.h"
 #include "clang/Lex/ModuleLoader.h"
 #include "clang/Lex/Preprocessor.h"
+#include "clang/Lex/PreprocessorOptions.h"
+#include "clang/Lex/Token.h"
 #include "lldb-eval/ast.h"
 #include "lldb-eval/parser_context.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
 
 namespace lldb_eval {
 
@@ -95,6 +102,8 @@ class TypeDeclaration {
   bool is_user_type_ = false;
 };
 
+// Signature of a builtin function. `nullptr` argument and return types stand
+// for "T", the element type of the buffer passed as the first argument "T*".
 class BuiltinFunctionDef {
  public:
   BuiltinFunctionDef(std::string name, TypeSP return_type,
@@ -108,12 +117,69 @@ class BuiltinFunctionDef {
   std::vector<TypeSP> arguments_;
 };
 
+// ParserEngine holds the parts of the parser configuration that don't depend on
+// the expression being parsed: target information, language options and the
+// preprocessor/header search options. Creating them is relatively expensive,
+// so a single engine is shared by all parsers. The engine is immutable after
+// creation and can be used by multiple parsers concurrently.
+class ParserEngine {
+ public:
+  // Creates an engine for the host triple.
+  static std::shared_ptr<ParserEngine> Create();
+  // Creates an engine for the given target triple. Falls back to the host
+  // triple if `triple` is empty or not supported.
+  static std::shared_ptr<ParserEngine> Create(const std::string& triple);
+
+  // Returns the process-wide engine used by default (for the host triple).
+  static std::shared_ptr<ParserEngine> GetDefault();
+  // Returns the process-wide engine for the given target triple. Engines are
+  // created once per triple.
+  static std::shared_ptr<ParserEngine> GetForTriple(const std::string& triple);
+
+  ParserEngine(const ParserEngine&) = delete;
+  ParserEngine& operator=(const ParserEngine&) = delete;
+
+  const clang::TargetInfo& GetTargetInfo() const { return *ti_; }
+  const clang::LangOptions& GetLangOptions() const { return *lang_opts_; }
+  // Identifier table populated only with keywords, used by BuiltinLexer.
+  const clang::IdentifierTable& GetKeywords() const { return *keywords_; }
+  std::shared_ptr<clang::HeaderSearchOptions> GetHeaderSearchOptions() const {
+    return hs_opts_;
+  }
+  std::shared_ptr<clang::PreprocessorOptions> GetPreprocessorOptions() const {
+    return pp_opts_;
+  }
+
+ private:
+  explicit ParserEngine(const std::string& triple);
+
+ private:
+  // Diagnostics engine used only for creating the target info.
+  std::unique_ptr<clang::DiagnosticsEngine> de_;
+  std::unique_ptr<clang::TargetInfo> ti_;
+  std::unique_ptr<clang::LangOptions> lang_opts_;
+  std::unique_ptr<clang::IdentifierTable> keywords_;
+  std::shared_ptr<clang::HeaderSearchOptions> hs_opts_;
+  std::shared_ptr<clang::PreprocessorOptions> pp_opts_;
+};
+
+enum class LexerKind {
+  // Tokens are produced by clang::Preprocessor.
+  kClang,
+  // Tokens are produced by BuiltinLexer, the preprocessor is created only if
+  // it's required for parsing character and string literals.
+  kBuiltin,
+};
+
 // Pure recursive descent parser for C++ like expressions.
 // EBNF grammar is described here:
 // docs/expr-ebnf.txt
 class Parser {
  public:
   explicit Parser(std::shared_ptr<ParserContext> ctx);
+  Parser(std::shared_ptr<ParserContext> ctx,
+         std::shared_ptr<ParserEngine> engine,
+         LexerKind lexer = LexerKind::kClang);
 
   ExprResult Run(Error& error);
 
@@ -138,12 +204,16 @@ class Parser {
   ExprResult ParsePrimaryExpression();
 
   std::optional<TypeSP> ParseTypeId(bool must_be_type_id = false);
+  std::optional<TypeSP> ParseTypeIdImpl(bool must_be_type_id);
   void ParseTypeSpecifierSeq(TypeDeclaration* type_decl);
   bool ParseTypeSpecifier(TypeDeclaration* type_decl);
   std::string ParseNestedNameSpecifier();
   std::string ParseTypeName();
+  std::string ParseTypeNameImpl();
 
-  std::string ParseTemplateArgumentList();
+  // Appends the parsed arguments to `type_name`. Returns false if this isn't a
+  // template_argument_list.
+  bool ParseTemplateArgumentList(std::string& type_name);
   std::string ParseTemplateArgument();
 
   PtrOperator ParsePtrOperator();
@@ -174,12 +244,22 @@ class Parser {
 
   ExprResult ParseBuiltinFunction(clang::SourceLocation loc,
                                   std::unique_ptr<BuiltinFunctionDef> func_def);
+  // Returns the element type "T" of the buffer "T*" passed to the builtin
+  // function `func_name`, or `nullptr` if the buffer type isn't supported.
+  TypeSP GetBufferElementType(TypeSP buffer_type, const std::string& func_name,
+                              clang::SourceLocation loc);
 
   bool ImplicitConversionIsAllowed(TypeSP src, TypeSP dst,
                                    bool is_src_literal_zero = false);
   ExprResult InsertImplicitConversion(ExprResult expr, TypeSP type);
 
   void ConsumeToken();
+  // Returns the token `n` positions after the current one.
+  const clang::Token& LookAhead(size_t n) const;
+  std::string GetSpelling(const clang::Token& token) const;
+  // Appends the spelling of `token` to `out` without a temporary string.
+  void AppendSpelling(const clang::Token& token, std::string& out) const;
+  clang::Preprocessor& GetPreprocessor();
   void BailOut(ErrorCode error_code, const std::string& error,
                clang::SourceLocation loc);
 
@@ -257,6 +337,26 @@ class Parser {
   ExprResult BuildMemberOf(ExprResult lhs, std::string member_id, bool is_arrow,
                            clang::SourceLocation location);
 
+  // Result of a tentative parse and the parser state after it.
+  template <typename T>
+  struct MemoEntry {
+    T result;
+    clang::Token token;
+    size_t next_token_idx;
+  };
+
+  // Tentative parse results keyed by the position they start at (and the kind
+  // of the current token, which the parser can change, see `ParseTypeName()`).
+  template <typename T>
+  using Memo =
+      std::map<std::pair<size_t, clang::tok::TokenKind>, MemoEntry<T>>;
+
+  // Runs `parse()` at the current position, or replays its memoized result.
+  // Only the parses that don't raise an error are memoized, they don't depend
+  // on anything else than the position.
+  template <typename T, typename Parse>
+  T Memoize(Memo<T>& memo, Parse parse);
+
  private:
   friend class TentativeParsingAction;
 
@@ -265,13 +365,32 @@ class Parser {
   // context will outlive the parser.
   std::shared_ptr<ParserContext> ctx_;
 
+  // Arena for the produced AST nodes. The nodes keep the arena alive, so the
+  // tree can outlive the parser.
+  llvm::IntrusiveRefCntPtr<AstArena> arena_;
+
   // The token lexer is stopped at (aka "current token").
   clang::Token token_;
+  // All tokens of the expression, the last one is always `eof`.
+  std::vector<clang::Token> tokens_;
+  // Index of the token following the current one.
+  size_t next_token_idx_ = 0;
   // Holds an error if it occures during parsing.
   Error error_;
 
-  std::unique_ptr<clang::TargetInfo> ti_;
-  std::unique_ptr<clang::LangOptions> lang_opts_;
+  // The parser tries the same alternatives at the same position many times,
+  // e.g. a parenthesized expression is first tried as a type-id and nested
+  // template argument lists are re-parsed at every level. Every try can do a
+  // type lookup.
+  Memo<std::optional<TypeSP>> type_id_memo_;
+  Memo<std::string> type_name_memo_;
+
+  // Shared configuration, outlives the preprocessor.
+  std::shared_ptr<ParserEngine> engine_;
+
+  // Preprocessor and its dependencies are bound to the source manager of the
+  // expression, so they're created for every parser (lazily, if the builtin
+  // lexer is used).
   std::unique_ptr<clang::HeaderSearch> hs_;
   std::unique_ptr<clang::TrivialModuleLoader> tml_;
   std::unique_ptr<clang::Preprocessor> pp_;
@@ -284,7 +403,7 @@ class TentativeParsingAction {
  public:
   TentativeParsingAction(Parser* parser) : parser_(parser) {
     backtrack_token_ = parser_->token_;
-    parser_->pp_->EnableBacktrackAtThisPos();
+    backtrack_token_idx_ = parser_->next_token_idx_;
     enabled_ = true;
   }
 
@@ -294,20 +413,18 @@ class TentativeParsingAction {
            "Commit() or Rollback()?");
   }
 
-  void Commit() {
-    parser_->pp_->CommitBacktrackedTokens();
-    enabled_ = false;
-  }
+  void Commit() { enabled_ = false; }
   void Rollback() {
-    parser_->pp_->Backtrack();
     parser_->error_.Clear();
     parser_->token_ = backtrack_token_;
+    parser_->next_token_idx_ = backtrack_token_idx_;
     enabled_ = false;
   }
 
  private:
   Parser* parser_;
   clang::Token backtrack_token_;
+  size_t backtrack_token_idx_;
   bool enabled_;
 };
 
@@ -6,89 +6,6 @@
 
 namespace lldb_eval {
 
-static uint32_t GetNumberOfNonEmptyBaseClasses(TypeSP type) {
-  // Go through the base classes and count non-empty ones.
-  uint32_t ret = 0;
-  uint32_t num_direct_bases = type->GetNumberOfDirectBaseClasses();
-
-  for (uint32_t i = 0; i < num_direct_bases; ++i) {
-    TypeSP base_type = type->GetDirectBaseClassAtIndex(i).type;
-    if (base_type->GetNumberOfFields() > 0 ||
-        GetNumberOfNonEmptyBaseClasses(base_type) > 0) {
-      ret += 1;
-    }
-  }
-  return ret;
-}
-
-static Type::MemberInfo GetFieldWithNameIndexPath(TypeSP type,
-                                                  const std::string& name,
-                                                  std::vector<uint32_t>* idx,
-                                                  TypeSP empty_type) {
-  // Go through the fields first.
-  uint32_t num_fields = type->GetNumberOfFields();
-  for (uint32_t i = 0; i < num_fields; ++i) {
-    auto field = type->GetFieldAtIndex(i);
-    // Name can be null if this is a padding field.
-    if (field.name == name) {
-      if (idx) {
-        assert(idx->empty());
-        // Direct base classes are located before fields, so field members
-        // needs to be offset by the number of base classes.
-        idx->push_back(i + GetNumberOfNonEmptyBaseClasses(type));
-      }
-      return field;
-    } else if (field.type->IsAnonymousType()) {
-      // Every member of an anonymous struct is considered to be a member of
-      // the enclosing struct or union. This applies recursively if the
-      // enclosing struct or union is also anonymous.
-      //
-      //  struct S {
-      //    struct {
-      //      int x;
-      //    };
-      //  } s;
-      //
-      //  s.x = 1;
-
-      assert(!field.name && "Field should be unnamed.");
-
-      auto field_in_anon_type =
-          GetFieldWithNameIndexPath(field.type, name, idx, empty_type);
-      if (field_in_anon_type) {
-        if (idx) {
-          idx->push_back(i + GetNumberOfNonEmptyBaseClasses(type));
-        }
-        return field_in_anon_type;
-      }
-    }
-  }
-
-  // LLDB can't access inherited fields of anonymous struct members.
-  if (type->IsAnonymousType()) {
-    return {{}, empty_type, false, 0};
-  }
-
-  // Go through the base classes and look for the field there.
-  uint32_t num_non_empty_bases = 0;
-  uint32_t num_direct_bases = type->GetNumberOfDirectBaseClasses();
-  for (uint32_t i = 0; i < num_direct_bases; ++i) {
-    auto base = type->GetDirectBaseClassAtIndex(i).type;
-    auto field = GetFieldWithNameIndexPath(base, name, idx, empty_type);
-    if (field) {
-      if (idx) {
-        idx->push_back(num_non_empty_bases);
-      }
-      return field;
-    }
-    if (base->GetNumberOfFields() > 0) {
-      num_non_empty_bases += 1;
-    }
-  }
-
-  return {{}, empty_type, false, 0};
-}
-
 std::string FormatDiagnostics(clang::SourceManager& sm,
                               const std::string& message,
                               clang::SourceLocation loc) {
@@ -119,18 +36,49 @@ std::string FormatDiagnostics(clang::SourceManager& sm,
                        llvm::fmt_pad("^", arrow - 1, arrow_rpad));
 }
 
+const std::string& Error::message() const {
+  if (!source_) {
+    return description_;
+  }
+  if (!message_) {
+    message_ = source_->FormatDiagnostics(description_, loc_);
+  }
+  return *message_;
+}
+
 void ParserContext::SetAllowSideEffects(bool allow_side_effects) {
   allow_side_effects_ = allow_side_effects;
 }
 
 bool ParserContext::AllowSideEffects() const { return allow_side_effects_; }
 
-std::tuple<Type::MemberInfo, std::vector<uint32_t>>
-ParserContext::GetMemberInfo(TypeSP type, const std::string& name) const {
-  std::vector<uint32_t> idx;
-  auto member = GetFieldWithNameIndexPath(type, name, &idx, GetEmptyType());
-  std::reverse(idx.begin(), idx.end());
-  return {member, std::move(idx)};
+std::tuple<Type::MemberInfo, std::vector<uint32_t>, std::optional<uint64_t>>
+ParserContext::GetMemberInfo(TypeSP type, llvm::StringRef name) const {
+  auto index = type->GetMemberIndex();
+  auto it = index->members.find(name);
+  if (it == index->members.end()) {
+    return {{{}, GetEmptyType(), false, 0, 0}, {}, {}};
+  }
+  const Type::MemberIndex::Entry& entry = it->getValue();
+  return {entry.member, entry.path, entry.offset};
+}
+
+std::vector<std::pair<std::string, Type::MemberInfo>>
+ParserContext::FindMembersWithPrefix(TypeSP type,
+                                     llvm::StringRef prefix) const {
+  auto index = type->GetMemberIndex();
+  std::vector<std::pair<std::string, Type::MemberInfo>> ret;
+  for (llvm::StringRef name :
+       FindNamesWithPrefix(index->sorted_names, prefix)) {
+    ret.emplace_back(name.str(), index->members.find(name)->getValue().member);
+  }
+  return ret;
+}
+
+std::shared_ptr<const BaseClassPath> ParserContext::GetBaseClassPath(
+    TypeSP type, TypeSP base) const {
+  auto path = FindBaseClassPath(std::move(type), std::move(base));
+  return path ? std::make_shared<BaseClassPath>(std::move(*path)) : nullptr;
 }
 
 }  // namespace lldb_eval
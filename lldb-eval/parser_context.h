@@ -1,9 +1,17 @@
 #ifndef LLDB_EVAL_PARSER_CONTEXT_H_
 #define LLDB_EVAL_PARSER_CONTEXT_H_
 
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
 #include "clang/Basic/SourceManager.h"
 #include "lldb-eval/type.h"
 #include "lldb/lldb-enumerations.h"
+#include "llvm/ADT/StringRef.h"
 
 namespace lldb_eval {
 
@@ -14,6 +22,10 @@ enum class ErrorCode : unsigned char {
   kInvalidOperandType,
   kUndeclaredIdentifier,
   kNotImplemented,
+  // The evaluation has been cancelled or its deadline has passed.
+  kCancelled,
+  // The evaluation has exceeded its budget, see `Options::max_eval_time`.
+  kBudgetExceeded,
   kUnknown,
 };
 
@@ -30,24 +42,60 @@ enum class UbStatus : unsigned char {
   kInvalidPtrDiff,
 };
 
+// Source of the expression the errors refer to, formats their messages (see
+// `Error::SetDiagnostic()`).
+class DiagnosticsSource {
+ public:
+  virtual ~DiagnosticsSource() = default;
+  // Returns "<location>: <message>" followed by the line of the expression
+  // and the caret pointing to `loc`.
+  virtual std::string FormatDiagnostics(const std::string& message,
+                                        clang::SourceLocation loc) const = 0;
+};
+
 class Error {
  public:
   void Set(ErrorCode code, std::string message) {
     code_ = code;
-    message_ = std::move(message);
+    description_ = std::move(message);
+    loc_ = clang::SourceLocation();
+    source_ = nullptr;
+    message_ = std::nullopt;
+  }
+  // Same as above, but the message pointing to `loc` in the expression is
+  // formatted only when it's requested (see `message()`). Failed parses and
+  // evaluations are common when probing candidate expressions (e.g. for
+  // autocompletion), the message is usually thrown away by them.
+  void SetDiagnostic(ErrorCode code, std::string description,
+                     clang::SourceLocation loc,
+                     std::shared_ptr<const DiagnosticsSource> source) {
+    code_ = code;
+    description_ = std::move(description);
+    loc_ = loc;
+    source_ = std::move(source);
+    message_ = std::nullopt;
   }
   void SetUbStatus(UbStatus status) { ub_status_ = status; }
   void Clear() { *this = {}; }
 
   ErrorCode code() const { return code_; }
-  const std::string& message() const { return message_; }
+  // Full message, including the location of the error. Formatted on the first
+  // call if the error has been set by `SetDiagnostic()`. This is not
+  // thread-safe, errors are owned by one evaluation.
+  const std::string& message() const;
+  // Message without the location of the error.
+  const std::string& description() const { return description_; }
+  clang::SourceLocation location() const { return loc_; }
   UbStatus ub_status() const { return ub_status_; }
 
   explicit operator bool() const { return code_ != ErrorCode::kOk; }
 
  private:
   ErrorCode code_ = ErrorCode::kOk;
-  std::string message_;
+  std::string description_;
+  clang::SourceLocation loc_;
+  std::shared_ptr<const DiagnosticsSource> source_;
+  mutable std::optional<std::string> message_;
   UbStatus ub_status_ = UbStatus::kOk;
 };
 
@@ -59,10 +107,18 @@ class ParserContext {
     virtual ~IdentifierInfo() = default;
   };
   virtual clang::SourceManager& GetSourceManager() const = 0;
-  virtual TypeSP ResolveTypeByName(const std::string& name) const = 0;
+  // Formats the messages of the errors pointing to the expression.
+  virtual std::shared_ptr<const DiagnosticsSource> GetDiagnosticsSource()
+      const = 0;
+  virtual TypeSP ResolveTypeByName(llvm::StringRef name) const = 0;
   virtual std::unique_ptr<IdentifierInfo> LookupIdentifier(
-      const std::string& name) const = 0;
-  virtual bool IsContextVar(const std::string& name) const = 0;
+      llvm::StringRef name) const = 0;
+  // Whether the name refers to a context variable, a local variable or a
+  // member of `this` (i.e. an identifier preferred over a same-name type). Much
+  // cheaper than `LookupIdentifier()` and `ResolveTypeByName()`, since the
+  // global variables and the types are not looked up.
+  virtual bool IsLocalIdentifier(llvm::StringRef name) const = 0;
+  virtual bool IsContextVar(llvm::StringRef name) const = 0;
   virtual TypeSP GetBasicType(lldb::BasicType) = 0;
   virtual TypeSP GetEmptyType() const = 0;
   virtual lldb::BasicType GetPtrDiffType() = 0;
@@ -72,8 +128,22 @@ class ParserContext {
   void SetAllowSideEffects(bool allow_side_effects);
   bool AllowSideEffects() const;
 
-  std::tuple<Type::MemberInfo, std::vector<uint32_t>> GetMemberInfo(
-      TypeSP type, const std::string& name) const;
+  // Looks up the member `name` of the record `type`. Returns the member, the
+  // index path to it and its offset from the start of the record (see
+  // `Type::MemberIndex`).
+  std::tuple<Type::MemberInfo, std::vector<uint32_t>, std::optional<uint64_t>>
+  GetMemberInfo(TypeSP type, llvm::StringRef name) const;
+
+  // Returns the members of the record `type` with names starting with
+  // `prefix`, in the lexicographical order of their names.
+  std::vector<std::pair<std::string, Type::MemberInfo>> FindMembersWithPrefix(
+      TypeSP type, llvm::StringRef prefix) const;
+
+  // Returns the path from the record `type` to its base class `base`, null if
+  // it isn't a base. Walks the class hierarchy on every call, implementations
+  // are expected to cache the results.
+  virtual std::shared_ptr<const BaseClassPath> GetBaseClassPath(
+      TypeSP type, TypeSP base) const;
 
  private:
   // Whether side effects should be allowed.
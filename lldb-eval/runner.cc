@@ -90,10 +90,19 @@ lldb::SBProcess LaunchTestProgram(lldb::SBDebugger debugger,
                                   const std::string& binary_path,
                                   const std::string& break_line) {
   auto target = debugger.CreateTarget(binary_path.c_str());
+  return LaunchTestProgram(target, source_path, break_line);
+}
+
+lldb::SBProcess LaunchTestProgram(lldb::SBTarget target,
+                                  const std::string& source_path,
+                                  const std::string& break_line) {
+  target.DeleteAllBreakpoints();
 
   auto source_file = filename_of_source_path(source_path);
 
-  const char* argv[] = {binary_path.c_str(), nullptr};
+  char binary_path[4096];
+  target.GetExecutable().GetPath(binary_path, sizeof(binary_path));
+  const char* argv[] = {binary_path, nullptr};
 
   auto bp = target.BreakpointCreateByLocation(
       source_file.c_str(), FindBreakpointLine(source_path.c_str(), break_line));
@@ -102,7 +111,7 @@ lldb::SBProcess LaunchTestProgram(lldb::SBDebugger debugger,
   auto process = target.LaunchSimple(argv, nullptr, ".");
 
   lldb::SBEvent event;
-  auto listener = debugger.GetListener();
+  auto listener = target.GetDebugger().GetListener();
 
   while (true) {
     if (!listener.WaitForEvent(kWaitForEventTimeout, event)) {
@@ -119,6 +128,12 @@ lldb::SBProcess LaunchTestProgram(lldb::SBDebugger debugger,
       continue;
     }
 
+    // The events of the previous launches of the target may still be queued.
+    if (lldb::SBProcess::GetProcessFromEvent(event).GetUniqueID() !=
+        process.GetUniqueID()) {
+      continue;
+    }
+
     auto state = lldb::SBProcess::GetStateFromEvent(event);
     if (state == lldb::eStateInvalid) {
       std::cerr << "process event: "
@@ -21,6 +21,7 @@
 
 #include "lldb/API/SBDebugger.h"
 #include "lldb/API/SBProcess.h"
+#include "lldb/API/SBTarget.h"
 #include "tools/cpp/runfiles/runfiles.h"
 
 namespace lldb_eval {
@@ -31,6 +32,15 @@ lldb::SBProcess LaunchTestProgram(lldb::SBDebugger debugger,
                                   const std::string& source_path,
                                   const std::string& binary_path,
                                   const std::string& break_line);
+
+// Launches the program of `target` and stops it at `break_line`. The target can
+// be re-used to launch the program many times (e.g. once per test case), which
+// saves loading its debug information every time. The breakpoints set by the
+// previous launches are removed.
+lldb::SBProcess LaunchTestProgram(lldb::SBTarget target,
+                                  const std::string& source_path,
+                                  const std::string& break_line);
+
 }  // namespace lldb_eval
 
 #endif  // LLDB_EVAL_RUNNER_H_
@@ -0,0 +1,749 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/scalar_program.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <variant>
+
+#include "lldb-eval/ast.h"
+#include "lldb-eval/target_cache.h"
+#include "lldb/lldb-enumerations.h"
+#include "llvm/Support/SwapByteOrder.h"
+
+namespace lldb_eval {
+
+namespace {
+
+// How the values of a type are held in the registers.
+struct ScalarType {
+  enum class Kind { kNone, kInteger, kFloat, kPointer };
+
+  Kind kind = Kind::kNone;
+  uint8_t width = 0;
+  bool is_signed = false;
+  bool is_bool = false;
+};
+
+ScalarType GetScalarType(const TypeSP& type) {
+  ScalarType ret;
+  uint64_t size = type->GetByteSize();
+  if (size != 1 && size != 2 && size != 4 && size != 8) {
+    // E.g. records, arrays, `long double` and 128-bit integers.
+    return ret;
+  }
+  if (type->IsPointerType()) {
+    ret.kind = ScalarType::Kind::kPointer;
+  } else if (type->IsInteger() || type->IsEnum()) {
+    ret.kind = ScalarType::Kind::kInteger;
+    ret.is_signed = type->IsSigned();
+    ret.is_bool = type->IsBool();
+  } else if (type->IsFloat()) {
+    lldb::BasicType basic_type = type->GetCanonicalType()->GetBasicType();
+    if ((basic_type == lldb::eBasicTypeFloat && size == 4) ||
+        (basic_type == lldb::eBasicTypeDouble && size == 8)) {
+      ret.kind = ScalarType::Kind::kFloat;
+    }
+  }
+  if (ret.kind != ScalarType::Kind::kNone) {
+    ret.width = static_cast<uint8_t>(size);
+  }
+  return ret;
+}
+
+// Whether evaluating `node` may modify the process memory. Such expressions
+// are not lowered, the program may bail out after the write.
+bool HasSideEffects(const AstNode* node) {
+  switch (node->node_kind()) {
+    case NodeKind::kBuiltinFunctionCall:
+      for (const auto& arg :
+           static_cast<const BuiltinFunctionCallNode*>(node)->arguments()) {
+        if (HasSideEffects(arg.get())) {
+          return true;
+        }
+      }
+      return false;
+    case NodeKind::kCStyleCast:
+      return HasSideEffects(static_cast<const CStyleCastNode*>(node)->rhs());
+    case NodeKind::kCxxStaticCast:
+      return HasSideEffects(
+          static_cast<const CxxStaticCastNode*>(node)->rhs());
+    case NodeKind::kCxxReinterpretCast:
+      return HasSideEffects(
+          static_cast<const CxxReinterpretCastNode*>(node)->rhs());
+    case NodeKind::kMemberOf:
+      return HasSideEffects(static_cast<const MemberOfNode*>(node)->lhs());
+    case NodeKind::kArraySubscript: {
+      auto subscript = static_cast<const ArraySubscriptNode*>(node);
+      return HasSideEffects(subscript->base()) ||
+             HasSideEffects(subscript->index());
+    }
+    case NodeKind::kBinaryOp: {
+      auto binary_op = static_cast<const BinaryOpNode*>(node);
+      return binary_op->kind() == BinaryOpKind::Assign ||
+             binary_op_kind_is_comp_assign(binary_op->kind()) ||
+             HasSideEffects(binary_op->lhs()) ||
+             HasSideEffects(binary_op->rhs());
+    }
+    case NodeKind::kUnaryOp: {
+      auto unary_op = static_cast<const UnaryOpNode*>(node);
+      switch (unary_op->kind()) {
+        case UnaryOpKind::PostInc:
+        case UnaryOpKind::PostDec:
+        case UnaryOpKind::PreInc:
+        case UnaryOpKind::PreDec:
+          return true;
+        default:
+          return HasSideEffects(unary_op->rhs());
+      }
+    }
+    case NodeKind::kTernaryOp: {
+      auto ternary_op = static_cast<const TernaryOpNode*>(node);
+      return HasSideEffects(ternary_op->cond()) ||
+             HasSideEffects(ternary_op->lhs()) ||
+             HasSideEffects(ternary_op->rhs());
+    }
+    case NodeKind::kSmartPtrToPtrDecay:
+      return HasSideEffects(
+          static_cast<const SmartPtrToPtrDecay*>(node)->ptr());
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+class ScalarLowering {
+ public:
+  // What the lowered node is computed for.
+  enum class Want { kValue, kAddress };
+
+  ScalarLowering(ScalarProgram* program, const TargetFacts& facts)
+      : program_(program),
+        address_byte_size_(static_cast<uint8_t>(facts.address_byte_size)) {}
+
+  // Emits the instructions computing the scalar value or the address of
+  // `node`. Returns the register holding it, or nothing if `node` can't be
+  // computed by the program. The subtrees that are not lowered are evaluated
+  // by the interpreter (see `ScalarOp::kEvalValue`).
+  std::optional<uint32_t> Lower(const AstNode* node, Want want) {
+    size_t mark = program_->instructions_.size();
+    std::optional<uint32_t> reg = LowerNode(node, want);
+    if (reg) {
+      return reg;
+    }
+    // Drop the instructions emitted for the children, the interpreter
+    // evaluates them again.
+    program_->instructions_.resize(mark);
+    return EmitEval(node, want);
+  }
+
+ private:
+  std::optional<uint32_t> LowerNode(const AstNode* node, Want want) {
+    if (want == Want::kAddress && node->is_rvalue()) {
+      return {};
+    }
+    switch (node->node_kind()) {
+      case NodeKind::kLiteral:
+        return LowerLiteral(static_cast<const LiteralNode*>(node));
+      case NodeKind::kCStyleCast:
+        return LowerCStyleCast(static_cast<const CStyleCastNode*>(node));
+      case NodeKind::kCxxStaticCast:
+        return LowerCxxStaticCast(static_cast<const CxxStaticCastNode*>(node),
+                                  want);
+      case NodeKind::kCxxReinterpretCast:
+        return LowerCxxReinterpretCast(
+            static_cast<const CxxReinterpretCastNode*>(node), want);
+      case NodeKind::kMemberOf:
+        return LowerMemberOf(static_cast<const MemberOfNode*>(node), want);
+      case NodeKind::kArraySubscript:
+        return LowerArraySubscript(static_cast<const ArraySubscriptNode*>(node),
+                                   want);
+      case NodeKind::kBinaryOp:
+        return LowerBinaryOp(static_cast<const BinaryOpNode*>(node));
+      case NodeKind::kUnaryOp:
+        return LowerUnaryOp(static_cast<const UnaryOpNode*>(node), want);
+      case NodeKind::kTernaryOp:
+        return LowerTernaryOp(static_cast<const TernaryOpNode*>(node), want);
+      default:
+        // Identifiers, builtin functions, etc are evaluated by the
+        // interpreter.
+        return {};
+    }
+  }
+
+  std::optional<uint32_t> LowerLiteral(const LiteralNode* node) {
+    ScalarType type = GetScalarType(node->result_type_deref());
+    if (type.kind == ScalarType::Kind::kNone) {
+      return {};
+    }
+    uint64_t bits = 0;
+    const LiteralNode::ValueType& value = node->value();
+    if (auto v = std::get_if<llvm::APInt>(&value)) {
+      bits = ExtendScalar(v->zextOrTrunc(type.width * 8).getZExtValue(),
+                          type.width, type.is_signed);
+    } else if (auto v = std::get_if<llvm::APFloat>(&value)) {
+      llvm::APInt float_bits = v->bitcastToAPInt();
+      if (float_bits.getBitWidth() != type.width * 8u) {
+        return {};
+      }
+      bits = float_bits.getZExtValue();
+    } else if (auto v = std::get_if<bool>(&value)) {
+      bits = *v ? 1 : 0;
+    } else {
+      // String literals are arrays.
+      return {};
+    }
+    ScalarInstruction inst = MakeInstruction(ScalarOp::kConst, node);
+    inst.imm = bits;
+    return Emit(inst);
+  }
+
+  std::optional<uint32_t> LowerCStyleCast(const CStyleCastNode* node) {
+    switch (node->kind()) {
+      case CStyleCastKind::kArithmetic:
+      case CStyleCastKind::kEnumeration:
+        return LowerConversion(node, node->rhs());
+      case CStyleCastKind::kPointer:
+        return LowerPointerCast(node, node->rhs());
+      default:
+        return {};
+    }
+  }
+
+  std::optional<uint32_t> LowerCxxStaticCast(const CxxStaticCastNode* node,
+                                             Want want) {
+    switch (node->kind()) {
+      case CxxStaticCastKind::kNoOp:
+        return Lower(node->rhs(), want);
+      case CxxStaticCastKind::kArithmetic:
+      case CxxStaticCastKind::kEnumeration:
+        return LowerConversion(node, node->rhs());
+      case CxxStaticCastKind::kPointer:
+        return LowerPointerCast(node, node->rhs());
+      default:
+        // Casts between the base and the derived classes may need the
+        // dynamic type of the object.
+        return {};
+    }
+  }
+
+  std::optional<uint32_t> LowerCxxReinterpretCast(
+      const CxxReinterpretCastNode* node, Want want) {
+    TypeSP type = node->type();
+    TypeSP rhs_type = node->rhs()->result_type_deref();
+    if (type->IsInteger() &&
+        (rhs_type->IsPointerType() || rhs_type->IsNullPtrType())) {
+      return LowerConversion(node, node->rhs());
+    }
+    if (type->IsInteger() || type->IsEnum()) {
+      // Same type, possibly an alias.
+      return Lower(node->rhs(), want);
+    }
+    if (type->IsPointerType()) {
+      return LowerPointerCast(node, node->rhs());
+    }
+    return {};
+  }
+
+  // Converts the value of `rhs` to the type of `node`. Mirrors the casts of
+  // the interpreter (e.g. `CastScalarToBasicType()`).
+  std::optional<uint32_t> LowerConversion(const AstNode* node,
+                                          const AstNode* rhs) {
+    ScalarType to = GetScalarType(node->result_type_deref());
+    ScalarType from = GetScalarType(rhs->result_type_deref());
+    if (to.kind == ScalarType::Kind::kNone ||
+        from.kind == ScalarType::Kind::kNone) {
+      return {};
+    }
+    std::optional<uint32_t> value = Lower(rhs, Want::kValue);
+    if (!value) {
+      return {};
+    }
+
+    bool from_float = from.kind == ScalarType::Kind::kFloat;
+    ScalarInstruction inst = MakeInstruction(ScalarOp::kIntToInt, node);
+    inst.a = *value;
+    inst.width = to.width;
+    inst.is_signed = to.is_signed;
+    inst.operand_width = from.width;
+    inst.operand_signed = from.is_signed;
+    if (to.is_bool) {
+      inst.op = from_float ? ScalarOp::kFloatToBool : ScalarOp::kIntToBool;
+    } else if (to.kind == ScalarType::Kind::kInteger) {
+      inst.op = from_float ? ScalarOp::kFloatToInt : ScalarOp::kIntToInt;
+    } else if (to.kind == ScalarType::Kind::kFloat) {
+      inst.op = from_float ? ScalarOp::kFloatToFloat : ScalarOp::kIntToFloat;
+    } else {
+      return {};
+    }
+    return Emit(inst);
+  }
+
+  // Casts the pointer, the integer or the array `rhs` to the pointer type of
+  // `node`.
+  std::optional<uint32_t> LowerPointerCast(const AstNode* node,
+                                           const AstNode* rhs) {
+    ScalarType to = GetScalarType(node->result_type_deref());
+    if (to.kind != ScalarType::Kind::kPointer) {
+      return {};
+    }
+    // Arrays decay to the pointers to their first element.
+    std::optional<uint32_t> value =
+        rhs->result_type_deref()->IsArrayType() ? Lower(rhs, Want::kAddress)
+                                                : Lower(rhs, Want::kValue);
+    if (!value || to.width == 8) {
+      return value;
+    }
+    ScalarInstruction inst = MakeInstruction(ScalarOp::kIntToInt, node);
+    inst.a = *value;
+    inst.width = to.width;
+    return Emit(inst);
+  }
+
+  std::optional<uint32_t> LowerMemberOf(const MemberOfNode* node, Want want) {
+    // The members without a fixed offset (e.g. in the virtual bases) and the
+    // bitfields are read via lldb::SBValue.
+    if (!node->member_offset() || node->is_bitfield()) {
+      return {};
+    }
+    std::optional<uint32_t> base =
+        Lower(node->lhs(), node->is_arrow() ? Want::kValue : Want::kAddress);
+    if (!base) {
+      return {};
+    }
+    return Access(node, *base, *node->member_offset(), want);
+  }
+
+  std::optional<uint32_t> LowerArraySubscript(const ArraySubscriptNode* node,
+                                              Want want) {
+    uint64_t item_size =
+        node->base()->result_type_deref()->GetPointeeType()->GetByteSize();
+    if (item_size == 0) {
+      return {};
+    }
+    std::optional<uint32_t> base = Lower(node->base(), Want::kValue);
+    if (!base) {
+      return {};
+    }
+    std::optional<uint32_t> index = Lower(node->index(), Want::kValue);
+    if (!index) {
+      return {};
+    }
+    ScalarInstruction inst = MakeInstruction(ScalarOp::kIndex, node);
+    inst.a = *base;
+    inst.b = *index;
+    inst.width = address_byte_size_;
+    inst.imm = item_size;
+    return Access(node, Emit(inst), 0, want);
+  }
+
+  // Computes the lvalue `node` located at `offset` bytes from the address in
+  // register `addr`: either its address or its value read from the memory.
+  std::optional<uint32_t> Access(const AstNode* node, uint32_t addr,
+                                 uint64_t offset, Want want) {
+    if (want == Want::kAddress) {
+      if (offset == 0) {
+        return addr;
+      }
+      ScalarInstruction inst = MakeInstruction(ScalarOp::kAddOffset, node);
+      inst.a = addr;
+      inst.imm = offset;
+      return Emit(inst);
+    }
+    ScalarType type = GetScalarType(node->result_type_deref());
+    if (type.kind == ScalarType::Kind::kNone) {
+      return {};
+    }
+    ScalarInstruction inst = MakeInstruction(ScalarOp::kLoad, node);
+    inst.a = addr;
+    inst.imm = offset;
+    inst.width = type.width;
+    inst.is_signed = type.is_signed;
+    inst.flag = type.is_bool;
+    return Emit(inst);
+  }
+
+  std::optional<uint32_t> LowerUnaryOp(const UnaryOpNode* node, Want want) {
+    if (node->kind() == UnaryOpKind::Deref) {
+      std::optional<uint32_t> ptr = Lower(node->rhs(), Want::kValue);
+      if (!ptr) {
+        return {};
+      }
+      return Access(node, *ptr, 0, want);
+    }
+    if (node->kind() == UnaryOpKind::AddrOf) {
+      // Same as the flow analysis of the interpreter, `&*ptr` and `&arr[i]`
+      // don't read the memory.
+      return Lower(node->rhs(), Want::kAddress);
+    }
+    if (node->kind() == UnaryOpKind::LNot) {
+      return LowerToBool(node, node->rhs(), /*negate*/ true);
+    }
+
+    ScalarType type = GetScalarType(node->result_type_deref());
+    bool is_float = type.kind == ScalarType::Kind::kFloat;
+    if (type.kind != ScalarType::Kind::kInteger && !is_float) {
+      return {};
+    }
+    std::optional<uint32_t> rhs = Lower(node->rhs(), Want::kValue);
+    if (!rhs) {
+      return {};
+    }
+    ScalarInstruction inst = MakeInstruction(ScalarOp::kIntNeg, node);
+    inst.a = *rhs;
+    inst.width = type.width;
+    inst.is_signed = type.is_signed;
+    switch (node->kind()) {
+      case UnaryOpKind::Plus:
+        return rhs;
+      case UnaryOpKind::Minus:
+        inst.op = is_float ? ScalarOp::kFloatNeg : ScalarOp::kIntNeg;
+        return Emit(inst);
+      case UnaryOpKind::Not:
+        if (is_float) {
+          return {};
+        }
+        inst.op = ScalarOp::kIntNot;
+        return Emit(inst);
+      default:
+        return {};
+    }
+  }
+
+  // Converts `operand` to bool, same as `Value::GetBool()`.
+  std::optional<uint32_t> LowerToBool(const AstNode* node,
+                                      const AstNode* operand, bool negate) {
+    TypeSP operand_type = operand->result_type_deref();
+    ScalarType type = GetScalarType(operand_type);
+    std::optional<uint32_t> value;
+    if (type.kind != ScalarType::Kind::kNone) {
+      value = Lower(operand, Want::kValue);
+    } else if (operand_type->IsArrayType()) {
+      // Arrays are converted by their address.
+      value = Lower(operand, Want::kAddress);
+      type.kind = ScalarType::Kind::kPointer;
+      type.width = 8;
+    }
+    if (!value) {
+      return {};
+    }
+    if (type.is_bool && !negate) {
+      return value;
+    }
+    ScalarInstruction inst =
+        MakeInstruction(type.kind == ScalarType::Kind::kFloat
+                            ? ScalarOp::kFloatToBool
+                            : ScalarOp::kIntToBool,
+                        node);
+    inst.a = *value;
+    inst.operand_width = type.width;
+    inst.flag = negate;
+    return Emit(inst);
+  }
+
+  std::optional<uint32_t> LowerBinaryOp(const BinaryOpNode* node) {
+    BinaryOpKind kind = node->kind();
+    if (kind == BinaryOpKind::LAnd || kind == BinaryOpKind::LOr) {
+      // For "&&" break if LHS is "false", for "||" if LHS is "true".
+      uint32_t dst = AllocateRegister();
+      std::optional<uint32_t> lhs = LowerToBool(node, node->lhs(), false);
+      if (!lhs) {
+        return {};
+      }
+      EmitMove(node, dst, *lhs);
+      size_t jump = EmitJumpIf(node, dst, kind == BinaryOpKind::LOr);
+      std::optional<uint32_t> rhs = LowerToBool(node, node->rhs(), false);
+      if (!rhs) {
+        return {};
+      }
+      EmitMove(node, dst, *rhs);
+      PatchJump(jump);
+      return dst;
+    }
+    if (kind == BinaryOpKind::Assign || binary_op_kind_is_comp_assign(kind)) {
+      return {};
+    }
+
+    TypeSP lhs_type = node->lhs()->result_type_deref();
+    TypeSP rhs_type = node->rhs()->result_type_deref();
+    ScalarType lhs_scalar = GetScalarType(lhs_type);
+    ScalarType rhs_scalar = GetScalarType(rhs_type);
+    ScalarType result = GetScalarType(node->result_type_deref());
+    if (lhs_scalar.kind == ScalarType::Kind::kNone ||
+        rhs_scalar.kind == ScalarType::Kind::kNone ||
+        result.kind == ScalarType::Kind::kNone) {
+      return {};
+    }
+    std::optional<uint32_t> lhs = Lower(node->lhs(), Want::kValue);
+    if (!lhs) {
+      return {};
+    }
+    std::optional<uint32_t> rhs = Lower(node->rhs(), Want::kValue);
+    if (!rhs) {
+      return {};
+    }
+
+    ScalarInstruction inst = MakeInstruction(ScalarOp::kIntBinary, node);
+    inst.binary_op = kind;
+    inst.a = *lhs;
+    inst.b = *rhs;
+    inst.width = result.width;
+    inst.is_signed = result.is_signed;
+    inst.operand_width = lhs_scalar.width;
+    inst.operand_signed = lhs_scalar.is_signed;
+
+    switch (kind) {
+      case BinaryOpKind::Add:
+      case BinaryOpKind::Sub: {
+        if (lhs_type->IsScalar() && rhs_type->IsScalar()) {
+          return LowerArithmetic(inst, result);
+        }
+        bool lhs_is_ptr = lhs_type->IsPointerType();
+        uint64_t item_size =
+            (lhs_is_ptr ? lhs_type : rhs_type)->GetPointeeType()->GetByteSize();
+        if (item_size == 0) {
+          return {};
+        }
+        inst.imm = item_size;
+        if (kind == BinaryOpKind::Sub && rhs_type->IsPointerType()) {
+          inst.op = ScalarOp::kPointerDiff;
+          return Emit(inst);
+        }
+        inst.width = address_byte_size_;
+        inst.is_signed = false;
+        if (kind == BinaryOpKind::Sub) {
+          // "pointer - integer" is "pointer + (-integer)", same as the
+          // interpreter does it.
+          ScalarInstruction neg = MakeInstruction(ScalarOp::kIntNeg, node);
+          neg.a = *rhs;
+          neg.width = 8;
+          inst.op = ScalarOp::kIndex;
+          inst.b = Emit(neg);
+          return Emit(inst);
+        }
+        inst.op = ScalarOp::kPointerAdd;
+        if (!lhs_is_ptr) {
+          std::swap(inst.a, inst.b);
+        }
+        return Emit(inst);
+      }
+      case BinaryOpKind::Mul:
+      case BinaryOpKind::Div:
+        return LowerArithmetic(inst, result);
+      case BinaryOpKind::Rem:
+      case BinaryOpKind::And:
+      case BinaryOpKind::Or:
+      case BinaryOpKind::Xor:
+        if (result.kind != ScalarType::Kind::kInteger) {
+          return {};
+        }
+        return Emit(inst);
+      case BinaryOpKind::Shl:
+      case BinaryOpKind::Shr:
+        // The operands are promoted separately, the shift amount has the type
+        // of RHS.
+        if (result.kind != ScalarType::Kind::kInteger ||
+            rhs_scalar.kind != ScalarType::Kind::kInteger) {
+          return {};
+        }
+        inst.operand_width = rhs_scalar.width;
+        inst.operand_signed = rhs_scalar.is_signed;
+        return Emit(inst);
+      case BinaryOpKind::LT:
+      case BinaryOpKind::GT:
+      case BinaryOpKind::LE:
+      case BinaryOpKind::GE:
+      case BinaryOpKind::EQ:
+      case BinaryOpKind::NE:
+        // Mirrors `Interpreter::EvaluateComparison()`.
+        if ((lhs_type->IsInteger() && rhs_type->IsInteger()) ||
+            (lhs_type->IsScopedEnum() && rhs_type->IsScopedEnum())) {
+          inst.op = ScalarOp::kIntCompare;
+        } else if (lhs_type->IsFloat() && rhs_type->IsFloat()) {
+          inst.op = ScalarOp::kFloatCompare;
+        } else {
+          inst.op = ScalarOp::kPointerCompare;
+          inst.width = lhs_scalar.width;
+          inst.operand_width = rhs_scalar.width;
+          inst.imm = address_byte_size_;
+        }
+        return Emit(inst);
+      default:
+        return {};
+    }
+  }
+
+  std::optional<uint32_t> LowerArithmetic(ScalarInstruction inst,
+                                          const ScalarType& result) {
+    if (result.kind == ScalarType::Kind::kFloat) {
+      inst.op = ScalarOp::kFloatBinary;
+    } else if (result.kind != ScalarType::Kind::kInteger) {
+      return {};
+    }
+    return Emit(inst);
+  }
+
+  std::optional<uint32_t> LowerTernaryOp(const TernaryOpNode* node,
+                                         Want want) {
+    uint32_t dst = AllocateRegister();
+    std::optional<uint32_t> cond = LowerToBool(node, node->cond(), false);
+    if (!cond) {
+      return {};
+    }
+    size_t jump_to_rhs = EmitJumpIf(node, *cond, false);
+    std::optional<uint32_t> lhs = Lower(node->lhs(), want);
+    if (!lhs) {
+      return {};
+    }
+    EmitMove(node, dst, *lhs);
+    size_t jump_to_end = EmitJump(node);
+    PatchJump(jump_to_rhs);
+    std::optional<uint32_t> rhs = Lower(node->rhs(), want);
+    if (!rhs) {
+      return {};
+    }
+    EmitMove(node, dst, *rhs);
+    PatchJump(jump_to_end);
+    return dst;
+  }
+
+  std::optional<uint32_t> EmitEval(const AstNode* node, Want want) {
+    if (want == Want::kValue &&
+        GetScalarType(node->result_type_deref()).kind ==
+            ScalarType::Kind::kNone) {
+      return {};
+    }
+    if (want == Want::kAddress && (node->is_rvalue() || node->is_bitfield())) {
+      return {};
+    }
+    return Emit(MakeInstruction(
+        want == Want::kValue ? ScalarOp::kEvalValue : ScalarOp::kEvalAddress,
+        node));
+  }
+
+  uint32_t AllocateRegister() { return program_->num_registers_++; }
+
+  static ScalarInstruction MakeInstruction(ScalarOp op, const AstNode* node) {
+    ScalarInstruction inst;
+    inst.op = op;
+    inst.node = node;
+    return inst;
+  }
+
+  uint32_t Emit(ScalarInstruction inst) {
+    inst.dst = AllocateRegister();
+    program_->instructions_.push_back(inst);
+    return inst.dst;
+  }
+
+  void EmitMove(const AstNode* node, uint32_t dst, uint32_t src) {
+    ScalarInstruction inst = MakeInstruction(ScalarOp::kMove, node);
+    inst.dst = dst;
+    inst.a = src;
+    program_->instructions_.push_back(inst);
+  }
+
+  size_t EmitJumpIf(const AstNode* node, uint32_t reg, bool flag) {
+    ScalarInstruction inst = MakeInstruction(ScalarOp::kJumpIf, node);
+    inst.a = reg;
+    inst.flag = flag;
+    program_->instructions_.push_back(inst);
+    return program_->instructions_.size() - 1;
+  }
+
+  size_t EmitJump(const AstNode* node) {
+    program_->instructions_.push_back(MakeInstruction(ScalarOp::kJump, node));
+    return program_->instructions_.size() - 1;
+  }
+
+  // Makes the given jump point to the next emitted instruction.
+  void PatchJump(size_t jump) {
+    program_->instructions_[jump].imm = program_->instructions_.size();
+  }
+
+ private:
+  ScalarProgram* program_;
+  uint8_t address_byte_size_;
+};
+
+std::shared_ptr<ScalarProgram> ScalarProgram::Compile(
+    const AstNode* tree, const TargetFacts& facts) {
+  // The registers hold the values in the host representation, the memory is
+  // read as is.
+  lldb::ByteOrder host_byte_order = llvm::sys::IsLittleEndianHost
+                                        ? lldb::eByteOrderLittle
+                                        : lldb::eByteOrderBig;
+  if (facts.byte_order != host_byte_order ||
+      (facts.address_byte_size != 4 && facts.address_byte_size != 8) ||
+      HasSideEffects(tree)) {
+    return nullptr;
+  }
+
+  // The lvalue results are created by their address, same as the interpreter
+  // creates the results of these nodes. Other lvalues (e.g. identifiers) are
+  // returned by the interpreter as they are.
+  bool is_address = !tree->is_rvalue();
+  if (is_address) {
+    bool is_deref =
+        tree->node_kind() == NodeKind::kUnaryOp &&
+        static_cast<const UnaryOpNode*>(tree)->kind() == UnaryOpKind::Deref;
+    if (!is_deref && tree->node_kind() != NodeKind::kMemberOf &&
+        tree->node_kind() != NodeKind::kArraySubscript) {
+      return nullptr;
+    }
+  }
+
+  std::shared_ptr<ScalarProgram> program(new ScalarProgram());
+  ScalarLowering lowering(program.get(), facts);
+  std::optional<uint32_t> result = lowering.Lower(
+      tree, is_address ? ScalarLowering::Want::kAddress
+                       : ScalarLowering::Want::kValue);
+  if (!result) {
+    return nullptr;
+  }
+  // Nothing is lowered, the interpreter evaluates the whole tree anyway.
+  const ScalarInstruction& last = program->instructions_.back();
+  if (last.node == tree && (last.op == ScalarOp::kEvalValue ||
+                            last.op == ScalarOp::kEvalAddress)) {
+    return nullptr;
+  }
+
+  program->result_register_ = *result;
+  program->result_is_address_ = is_address;
+  program->result_type_ = tree->result_type();
+  return program;
+}
+
+const ScalarProgram* ScalarTier::Get(const AstNode* tree,
+                                     lldb::SBTarget target) {
+  // Once the expression is hot, the counter isn't updated anymore.
+  if (num_evaluations_.load(std::memory_order_relaxed) < threshold_ &&
+      num_evaluations_.fetch_add(1, std::memory_order_relaxed) < threshold_) {
+    return nullptr;
+  }
+  std::call_once(lowered_, [&]() {
+    program_ = ScalarProgram::Compile(tree, TargetCache::Get(target)->facts());
+    if (program_) {
+      program_bytes_.store(program_->GetMemoryUsage(),
+                           std::memory_order_relaxed);
+    }
+  });
+  return program_.get();
+}
+
+}  // namespace lldb_eval
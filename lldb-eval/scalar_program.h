@@ -0,0 +1,187 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_SCALAR_PROGRAM_H_
+#define LLDB_EVAL_SCALAR_PROGRAM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "lldb-eval/ast.h"
+#include "lldb-eval/target_cache.h"
+#include "lldb/API/SBTarget.h"
+
+namespace lldb_eval {
+
+enum class ScalarOp : uint8_t {
+  // Evaluates `node` with the tree-walking interpreter and stores its scalar
+  // value (`kEvalValue`) or its address (`kEvalAddress`). Used for the leaf
+  // nodes (identifiers, builtin functions, etc) and for the subtrees the
+  // program doesn't lower.
+  kEvalValue,
+  kEvalAddress,
+  // Stores `imm`.
+  kConst,
+  // Reads `width` bytes at the address in register `a` plus `imm`. The value
+  // is sign-extended if `is_signed` is set, `flag` marks a bool.
+  kLoad,
+  // Address in register `a` plus `imm`.
+  kAddOffset,
+  // Address in register `a` plus the signed index in register `b` times `imm`
+  // (the element size). `kPointerAdd` bails out on the null pointer with a
+  // non-zero offset, same as the interpreter reports it.
+  kIndex,
+  kPointerAdd,
+  // Difference of the pointers in registers `a` and `b`, in the elements of
+  // `imm` bytes.
+  kPointerDiff,
+  // `binary_op` on the integer, floating point and pointer operands.
+  // `kPointerCompare` compares the operands of `operand_width` and `width`
+  // bytes as the pointers of `imm` bytes.
+  kIntBinary,
+  kFloatBinary,
+  kIntCompare,
+  kFloatCompare,
+  kPointerCompare,
+  kIntNeg,
+  kIntNot,
+  kFloatNeg,
+  // Converts the value in register `a` to bool, negated if `flag` is set.
+  kIntToBool,
+  kFloatToBool,
+  // Converts the operand of `operand_width` bytes (and `operand_signed`) to
+  // the result of `width` bytes (and `is_signed`).
+  kIntToInt,
+  kIntToFloat,
+  kFloatToInt,
+  kFloatToFloat,
+  // Copies the value in register `a`.
+  kMove,
+  // Jumps to `imm` if the value in register `a` is non-zero and `flag` is set,
+  // or if it is zero and `flag` is unset.
+  kJumpIf,
+  // Jumps to `imm` unconditionally.
+  kJump,
+};
+
+// Extends the value of `width` bytes in the low bits of `bits` to 64 bits, the
+// representation of the scalars in the registers.
+inline uint64_t ExtendScalar(uint64_t bits, uint32_t width, bool is_signed) {
+  if (width >= 8) {
+    return bits;
+  }
+  uint32_t shift = 64 - width * 8;
+  if (is_signed) {
+    return static_cast<uint64_t>(static_cast<int64_t>(bits << shift) >> shift);
+  }
+  return (bits << shift) >> shift;
+}
+
+struct ScalarInstruction {
+  ScalarOp op;
+  BinaryOpKind binary_op = BinaryOpKind::Add;
+  // Size and signedness of the result and of the operand, in bytes.
+  uint8_t width = 0;
+  uint8_t operand_width = 0;
+  bool is_signed = false;
+  bool operand_signed = false;
+  bool flag = false;
+  // Destination and operand registers.
+  uint32_t dst = 0;
+  uint32_t a = 0;
+  uint32_t b = 0;
+  // Constant, offset, element size or jump target, depending on `op`.
+  uint64_t imm = 0;
+  const AstNode* node = nullptr;
+};
+
+// Expression lowered to the operations on the native integers and floats. The
+// registers hold the raw bits of the scalars (sign- or zero-extended to 64
+// bits) or the addresses of the objects, and the memory is read directly via
+// the memory cache, so no intermediate values are created. It's evaluated by
+// `Interpreter::TryEval()`.
+//
+// Only the side effect free expressions over scalars are lowered. The program
+// bails out on anything it doesn't compute the same way as the interpreter
+// (e.g. unreadable memory, undefined behaviour or an error in the leaf nodes),
+// the expression is evaluated by the interpreter then. Instructions refer to
+// the original AST nodes, so the tree must outlive the program.
+class ScalarProgram {
+ public:
+  // Returns null if the tree can't be lowered (or lowering it isn't worth it,
+  // e.g. it's a single identifier).
+  static std::shared_ptr<ScalarProgram> Compile(const AstNode* tree,
+                                                const TargetFacts& facts);
+
+  const std::vector<ScalarInstruction>& instructions() const {
+    return instructions_;
+  }
+  uint32_t num_registers() const { return num_registers_; }
+  uint32_t result_register() const { return result_register_; }
+  // If set, the result register holds the address of the result (the
+  // expression is an lvalue), otherwise its scalar value.
+  bool result_is_address() const { return result_is_address_; }
+  const TypeSP& result_type() const { return result_type_; }
+
+  size_t GetMemoryUsage() const {
+    return sizeof(*this) +
+           instructions_.capacity() * sizeof(ScalarInstruction);
+  }
+
+ private:
+  ScalarProgram() = default;
+
+ private:
+  std::vector<ScalarInstruction> instructions_;
+  uint32_t num_registers_ = 0;
+  uint32_t result_register_ = 0;
+  bool result_is_address_ = false;
+  TypeSP result_type_;
+
+  friend class ScalarLowering;
+};
+
+// Counts the evaluations of a compiled expression and lowers it to a scalar
+// program once it's evaluated more than `threshold` times, so the expressions
+// evaluated only a few times don't pay for the lowering. Thread-safe.
+class ScalarTier {
+ public:
+  explicit ScalarTier(uint32_t threshold) : threshold_(threshold) {}
+
+  // Counts an evaluation of `tree` and returns its program if the expression
+  // is hot and can be lowered, null otherwise.
+  const ScalarProgram* Get(const AstNode* tree, lldb::SBTarget target);
+
+  // Memory held by the tier, including the program once it's lowered.
+  size_t GetMemoryUsage() const {
+    return sizeof(*this) + program_bytes_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  const uint32_t threshold_;
+  std::atomic<uint32_t> num_evaluations_{0};
+  std::once_flag lowered_;
+  std::shared_ptr<const ScalarProgram> program_;
+  // Set once `program_` is lowered, it can't be read before that.
+  std::atomic<size_t> program_bytes_{0};
+};
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_SCALAR_PROGRAM_H_
@@ -0,0 +1,1182 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/serialization.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "clang/Basic/SourceLocation.h"
+#include "lldb-eval/ast.h"
+#include "lldb-eval/bytecode.h"
+#include "lldb-eval/context.h"
+#include "lldb-eval/type.h"
+#include "lldb-eval/value.h"
+#include "lldb/API/SBAddress.h"
+#include "lldb/API/SBData.h"
+#include "lldb/API/SBDeclaration.h"
+#include "lldb/API/SBError.h"
+#include "lldb/API/SBFileSpec.h"
+#include "lldb/API/SBModule.h"
+#include "lldb/API/SBTarget.h"
+#include "lldb/API/SBType.h"
+#include "lldb/API/SBValue.h"
+#include "lldb/lldb-enumerations.h"
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace lldb_eval {
+
+namespace {
+
+constexpr char kMagic[] = {'L', 'E', 'C', 'E'};
+constexpr uint64_t kFormatVersion = 2;
+
+// Trees deeper than this are considered malformed. The parser doesn't produce
+// trees nearly that deep.
+constexpr uint32_t kMaxDepth = 1024;
+
+// Integer literals are at most 128 bits wide, wider ones are malformed.
+constexpr uint64_t kMaxIntBits = 1024;
+
+enum class NodeTag : uint8_t {
+  kLiteral,
+  kIdentifier,
+  kSizeOf,
+  kBuiltinFunctionCall,
+  kCStyleCast,
+  kCxxStaticCast,
+  kCxxReinterpretCast,
+  kMemberOf,
+  kArraySubscript,
+  kBinaryOp,
+  kUnaryOp,
+  kTernaryOp,
+  kSmartPtrToPtrDecay,
+};
+
+enum class TypeTag : uint8_t {
+  kEmpty,
+  kBasic,
+  kNamed,
+  kPointer,
+  kReference,
+  kArray,
+};
+
+enum class LiteralTag : uint8_t {
+  kInt,
+  kFloat,
+  kBool,
+  kBytes,
+};
+
+// How the value of a `Kind::kValue` identifier is written.
+enum class ValueTag : uint8_t {
+  // Module index and file address of the variable.
+  kAddress,
+  // Contents of the value (e.g. enumerators).
+  kData,
+};
+
+// Semantics of the floating point literals, written by their index in the
+// table. `llvm::APFloat::Semantics` isn't used, since its values differ between
+// the versions of LLVM.
+const llvm::fltSemantics* GetFloatSemantics(uint8_t index) {
+  switch (index) {
+    case 0:
+      return &llvm::APFloat::IEEEhalf();
+    case 1:
+      return &llvm::APFloat::IEEEsingle();
+    case 2:
+      return &llvm::APFloat::IEEEdouble();
+    case 3:
+      return &llvm::APFloat::x87DoubleExtended();
+    case 4:
+      return &llvm::APFloat::IEEEquad();
+    case 5:
+      return &llvm::APFloat::PPCDoubleDouble();
+    default:
+      return nullptr;
+  }
+}
+
+std::optional<uint8_t> GetFloatSemanticsIndex(const llvm::fltSemantics& sem) {
+  for (uint8_t i = 0; const llvm::fltSemantics* other = GetFloatSemantics(i);
+       ++i) {
+    if (other == &sem) {
+      return i;
+    }
+  }
+  return {};
+}
+
+llvm::StringRef GetTypeName(lldb::SBType type) {
+  const char* name = type.IsValid() ? type.GetName() : nullptr;
+  return name ? llvm::StringRef(name) : llvm::StringRef();
+}
+
+// Integers are written in LEB128, most of them are small.
+class ByteWriter {
+ public:
+  void WriteU8(uint8_t value) { data_.push_back(value); }
+
+  void WriteVarint(uint64_t value) {
+    do {
+      uint8_t byte = value & 0x7f;
+      value >>= 7;
+      WriteU8(value ? (byte | 0x80) : byte);
+    } while (value);
+  }
+
+  void WriteBytes(const void* bytes, size_t size) {
+    WriteVarint(size);
+    auto begin = static_cast<const uint8_t*>(bytes);
+    data_.insert(data_.end(), begin, begin + size);
+  }
+
+  void WriteString(llvm::StringRef str) { WriteBytes(str.data(), str.size()); }
+
+  void Append(const ByteWriter& other) {
+    data_.insert(data_.end(), other.data_.begin(), other.data_.end());
+  }
+
+  std::vector<uint8_t> TakeData() { return std::move(data_); }
+
+ private:
+  std::vector<uint8_t> data_;
+};
+
+// Reads the data written by `ByteWriter`. Reads past the end of the data set
+// the error flag and return zeros, so the callers check the flag only once in
+// a while. The flag is also set by the callers for the data that doesn't match
+// the target, in both cases the expression is compiled again.
+class ByteReader {
+ public:
+  explicit ByteReader(llvm::ArrayRef<uint8_t> data) : data_(data) {}
+
+  bool failed() const { return failed_; }
+  void Fail() { failed_ = true; }
+
+  uint8_t ReadU8() {
+    if (failed_ || pos_ >= data_.size()) {
+      failed_ = true;
+      return 0;
+    }
+    return data_[pos_++];
+  }
+
+  uint64_t ReadVarint() {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      uint8_t byte = ReadU8();
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    failed_ = true;
+    return 0;
+  }
+
+  llvm::ArrayRef<uint8_t> ReadBytes() {
+    uint64_t size = ReadVarint();
+    if (failed_ || size > data_.size() - pos_) {
+      failed_ = true;
+      return {};
+    }
+    llvm::ArrayRef<uint8_t> ret = data_.slice(pos_, size);
+    pos_ += size;
+    return ret;
+  }
+
+  std::string ReadString() {
+    llvm::ArrayRef<uint8_t> bytes = ReadBytes();
+    return std::string(bytes.begin(), bytes.end());
+  }
+
+  bool ReadBool() { return ReadU8() != 0; }
+
+  std::vector<uint32_t> ReadIndices() {
+    uint64_t size = ReadVarint();
+    // Every index takes at least one byte.
+    if (size > remaining()) {
+      failed_ = true;
+      return {};
+    }
+    std::vector<uint32_t> ret(size);
+    for (auto& idx : ret) {
+      idx = static_cast<uint32_t>(ReadVarint());
+    }
+    return ret;
+  }
+
+  bool AtEnd() const { return pos_ == data_.size(); }
+  size_t remaining() const { return data_.size() - pos_; }
+
+ private:
+  llvm::ArrayRef<uint8_t> data_;
+  size_t pos_ = 0;
+  bool failed_ = false;
+};
+
+void WriteIndices(ByteWriter& out, const std::vector<uint32_t>& indices) {
+  out.WriteVarint(indices.size());
+  for (uint32_t idx : indices) {
+    out.WriteVarint(idx);
+  }
+}
+
+class TreeWriter : public Visitor {
+ public:
+  explicit TreeWriter(lldb::SBTarget target) : target_(target) {}
+
+  void Write(const AstNode* node) { node->Accept(this); }
+
+  // Returns the index of the type in the type table, writing the type (and its
+  // element types) if necessary. Index 0 stands for the null type.
+  uint64_t WriteType(TypeSP type) {
+    if (!type) {
+      return 0;
+    }
+    auto it = type_indices_.find(type.get());
+    if (it != type_indices_.end()) {
+      return it->second;
+    }
+
+    // Element types are written first, so the reader resolves them before the
+    // types composed from them.
+    ByteWriter record;
+    if (!type->IsValid()) {
+      record.WriteU8(static_cast<uint8_t>(TypeTag::kEmpty));
+    } else {
+      TypeTag tag = TypeTag::kNamed;
+      uint64_t element = 0;
+      uint64_t count = 0;
+      if (type->IsPointerType()) {
+        tag = TypeTag::kPointer;
+        element = WriteType(type->GetPointeeType());
+      } else if (type->IsReferenceType()) {
+        tag = TypeTag::kReference;
+        element = WriteType(type->GetDereferencedType());
+      } else if (type->IsArrayType()) {
+        TypeSP element_type = type->GetArrayElementType();
+        uint64_t element_size = element_type->GetByteSize();
+        if (element_size != 0) {
+          tag = TypeTag::kArray;
+          element = WriteType(element_type);
+          count = type->GetByteSize() / element_size;
+        }
+      } else if (type->GetTypeClass() == lldb::eTypeClassBuiltin) {
+        tag = TypeTag::kBasic;
+      }
+
+      record.WriteU8(static_cast<uint8_t>(tag));
+      record.WriteString(type->GetName());
+      record.WriteVarint(type->GetByteSize());
+      switch (tag) {
+        case TypeTag::kBasic:
+          record.WriteVarint(type->GetBasicType());
+          break;
+        case TypeTag::kPointer:
+        case TypeTag::kReference:
+          record.WriteVarint(element);
+          break;
+        case TypeTag::kArray:
+          record.WriteVarint(element);
+          record.WriteVarint(count);
+          break;
+        default:
+          break;
+      }
+    }
+
+    types_.Append(record);
+    uint64_t index = ++num_types_;
+    type_indices_.emplace(type.get(), index);
+    return index;
+  }
+
+  const ByteWriter& types() const { return types_; }
+  uint64_t num_types() const { return num_types_; }
+  const ByteWriter& tree() const { return tree_; }
+  bool is_serializable() const { return is_serializable_; }
+  bool has_side_effects() const { return has_side_effects_; }
+
+  void Visit(const ErrorNode*) override { is_serializable_ = false; }
+
+  void Visit(const LiteralNode* node) override {
+    WriteHeader(NodeTag::kLiteral, node);
+    tree_.WriteVarint(WriteType(node->result_type()));
+    tree_.WriteU8(node->is_literal_zero());
+
+    struct {
+      void operator()(const llvm::APInt& val) {
+        out.WriteU8(static_cast<uint8_t>(LiteralTag::kInt));
+        WriteAPInt(val);
+      }
+      void operator()(const llvm::APFloat& val) {
+        std::optional<uint8_t> semantics =
+            GetFloatSemanticsIndex(val.getSemantics());
+        if (!semantics) {
+          *is_serializable = false;
+          return;
+        }
+        out.WriteU8(static_cast<uint8_t>(LiteralTag::kFloat));
+        out.WriteU8(*semantics);
+        WriteAPInt(val.bitcastToAPInt());
+      }
+      void operator()(bool val) {
+        out.WriteU8(static_cast<uint8_t>(LiteralTag::kBool));
+        out.WriteU8(val);
+      }
+      void operator()(const std::vector<char>& val) {
+        out.WriteU8(static_cast<uint8_t>(LiteralTag::kBytes));
+        out.WriteBytes(val.data(), val.size());
+      }
+      void WriteAPInt(const llvm::APInt& val) {
+        out.WriteVarint(val.getBitWidth());
+        for (unsigned i = 0; i < val.getNumWords(); ++i) {
+          out.WriteVarint(val.getRawData()[i]);
+        }
+      }
+
+      ByteWriter& out;
+      bool* is_serializable;
+    } visitor{tree_, &is_serializable_};
+    std::visit(visitor, node->value());
+  }
+
+  void Visit(const IdentifierNode* node) override {
+    using Kind = Context::IdentifierInfo::Kind;
+    auto& info = static_cast<const Context::IdentifierInfo&>(node->info());
+
+    WriteHeader(NodeTag::kIdentifier, node);
+    tree_.WriteString(node->name());
+    tree_.WriteU8(node->is_rvalue());
+    tree_.WriteU8(node->is_context_var());
+    tree_.WriteU8(static_cast<uint8_t>(info.kind()));
+    tree_.WriteVarint(WriteType(node->result_type()));
+
+    switch (info.kind()) {
+      case Kind::kValue:
+        WriteValue(info.value().inner_value());
+        break;
+      case Kind::kContextArg:
+        tree_.WriteVarint(info.context_slot());
+        break;
+      case Kind::kMemberPath:
+        WriteIndices(tree_, info.path());
+        break;
+      case Kind::kThisKeyword:
+        break;
+      case Kind::kLocalVariable:
+      case Kind::kInstanceVariable:
+      case Kind::kRegister:
+        tree_.WriteString(info.name());
+        break;
+      case Kind::kFrameVariable: {
+        tree_.WriteString(info.name());
+        lldb::SBDeclaration declaration = info.declaration();
+        lldb::SBFileSpec file = declaration.GetFileSpec();
+        tree_.WriteString(file.GetDirectory() ? file.GetDirectory() : "");
+        tree_.WriteString(file.GetFilename() ? file.GetFilename() : "");
+        tree_.WriteVarint(declaration.GetLine());
+        tree_.WriteVarint(declaration.GetColumn());
+        break;
+      }
+    }
+  }
+
+  void Visit(const SizeOfNode* node) override {
+    WriteHeader(NodeTag::kSizeOf, node);
+    tree_.WriteVarint(WriteType(node->result_type()));
+    tree_.WriteVarint(WriteType(node->operand()));
+  }
+
+  void Visit(const BuiltinFunctionCallNode* node) override {
+    WriteHeader(NodeTag::kBuiltinFunctionCall, node);
+    tree_.WriteVarint(WriteType(node->result_type()));
+    tree_.WriteString(node->name());
+    tree_.WriteVarint(node->arguments().size());
+    for (const auto& arg : node->arguments()) {
+      Write(arg.get());
+    }
+  }
+
+  void Visit(const CStyleCastNode* node) override {
+    WriteHeader(NodeTag::kCStyleCast, node);
+    tree_.WriteVarint(WriteType(node->type()));
+    tree_.WriteU8(static_cast<uint8_t>(node->kind()));
+    Write(node->rhs());
+  }
+
+  void Visit(const CxxStaticCastNode* node) override {
+    WriteHeader(NodeTag::kCxxStaticCast, node);
+    tree_.WriteVarint(WriteType(node->type()));
+    tree_.WriteU8(static_cast<uint8_t>(node->kind()));
+    tree_.WriteU8(node->is_rvalue());
+    if (node->kind() == CxxStaticCastKind::kDerivedToBase) {
+      WriteIndices(tree_, node->idx());
+    } else if (node->kind() == CxxStaticCastKind::kBaseToDerived) {
+      tree_.WriteVarint(node->offset());
+    }
+    Write(node->rhs());
+  }
+
+  void Visit(const CxxReinterpretCastNode* node) override {
+    WriteHeader(NodeTag::kCxxReinterpretCast, node);
+    tree_.WriteVarint(WriteType(node->type()));
+    tree_.WriteU8(node->is_rvalue());
+    Write(node->rhs());
+  }
+
+  void Visit(const MemberOfNode* node) override {
+    WriteHeader(NodeTag::kMemberOf, node);
+    tree_.WriteVarint(WriteType(node->result_type()));
+    tree_.WriteU8(node->is_bitfield());
+    tree_.WriteVarint(node->bitfield_size());
+    WriteIndices(tree_, node->member_index());
+    tree_.WriteU8(node->member_offset().has_value());
+    tree_.WriteVarint(node->member_offset().value_or(0));
+    tree_.WriteU8(node->is_arrow());
+    Write(node->lhs());
+  }
+
+  void Visit(const ArraySubscriptNode* node) override {
+    WriteHeader(NodeTag::kArraySubscript, node);
+    tree_.WriteVarint(WriteType(node->result_type()));
+    Write(node->base());
+    Write(node->index());
+  }
+
+  void Visit(const BinaryOpNode* node) override {
+    if (node->kind() >= BinaryOpKind::Assign) {
+      has_side_effects_ = true;
+    }
+    WriteHeader(NodeTag::kBinaryOp, node);
+    tree_.WriteVarint(WriteType(node->result_type()));
+    tree_.WriteU8(static_cast<uint8_t>(node->kind()));
+    tree_.WriteVarint(WriteType(node->comp_assign_type()));
+    Write(node->lhs());
+    Write(node->rhs());
+  }
+
+  void Visit(const UnaryOpNode* node) override {
+    if (node->kind() <= UnaryOpKind::PreDec) {
+      has_side_effects_ = true;
+    }
+    WriteHeader(NodeTag::kUnaryOp, node);
+    tree_.WriteVarint(WriteType(node->result_type()));
+    tree_.WriteU8(static_cast<uint8_t>(node->kind()));
+    Write(node->rhs());
+  }
+
+  void Visit(const TernaryOpNode* node) override {
+    WriteHeader(NodeTag::kTernaryOp, node);
+    tree_.WriteVarint(WriteType(node->result_type()));
+    Write(node->cond());
+    Write(node->lhs());
+    Write(node->rhs());
+  }
+
+  void Visit(const SmartPtrToPtrDecay* node) override {
+    WriteHeader(NodeTag::kSmartPtrToPtrDecay, node);
+    tree_.WriteVarint(WriteType(node->result_type()));
+    Write(node->ptr());
+  }
+
+ private:
+  void WriteHeader(NodeTag tag, const AstNode* node) {
+    tree_.WriteU8(static_cast<uint8_t>(tag));
+    // The reader re-creates the source manager from the same source, so the
+    // raw encodings of the locations stay valid.
+    tree_.WriteVarint(node->location().getRawEncoding());
+  }
+
+  void WriteValue(lldb::SBValue value) {
+    lldb::SBAddress addr = value.GetAddress();
+    if (addr.IsValid()) {
+      lldb::SBModule module = addr.GetModule();
+      for (uint32_t i = 0; i < target_.GetNumModules(); ++i) {
+        if (target_.GetModuleAtIndex(i) == module) {
+          tree_.WriteU8(static_cast<uint8_t>(ValueTag::kAddress));
+          tree_.WriteString(value.GetName() ? value.GetName() : "");
+          tree_.WriteVarint(i);
+          tree_.WriteVarint(addr.GetFileAddress());
+          return;
+        }
+      }
+    }
+
+    lldb::SBData data = value.GetData();
+    std::vector<uint8_t> bytes(data.IsValid() ? data.GetByteSize() : 0);
+    lldb::SBError error;
+    if (bytes.empty() ||
+        data.ReadRawData(error, 0, bytes.data(), bytes.size()) !=
+            bytes.size() ||
+        error.Fail()) {
+      is_serializable_ = false;
+      return;
+    }
+    tree_.WriteU8(static_cast<uint8_t>(ValueTag::kData));
+    tree_.WriteBytes(bytes.data(), bytes.size());
+  }
+
+ private:
+  lldb::SBTarget target_;
+  ByteWriter tree_;
+  ByteWriter types_;
+  uint64_t num_types_ = 0;
+  std::unordered_map<const Type*, uint64_t> type_indices_;
+  bool is_serializable_ = true;
+  bool has_side_effects_ = false;
+};
+
+class TreeReader {
+ public:
+  TreeReader(ByteReader& in, std::shared_ptr<Context> ctx,
+             const std::vector<std::pair<std::string, TypeSP>>& context_args)
+      : in_(in),
+        ctx_(std::move(ctx)),
+        target_(ctx_->GetExecutionContext().GetTarget()),
+        context_args_(context_args),
+        arena_(new AstArena()) {}
+
+  // Reads the type table. Returns false if any of the types doesn't resolve
+  // to a type of the same name and size.
+  bool ReadTypes() {
+    uint64_t num_types = in_.ReadVarint();
+    // Every type takes at least one byte.
+    if (in_.failed() || num_types > in_.remaining()) {
+      in_.Fail();
+      return false;
+    }
+    types_.reserve(num_types + 1);
+    types_.push_back(nullptr);
+    for (uint64_t i = 0; i < num_types && !in_.failed(); ++i) {
+      TypeSP type = ReadTypeRecord();
+      if (!type) {
+        return false;
+      }
+      types_.push_back(std::move(type));
+    }
+    return !in_.failed();
+  }
+
+  // Reads the tree. Returns null if the data is malformed or the tree doesn't
+  // match the target (e.g. a global variable doesn't exist anymore).
+  ExprResult ReadTree() {
+    ExprResult tree = ReadNode(0);
+    return in_.failed() ? nullptr : std::move(tree);
+  }
+
+ private:
+  TypeSP ReadTypeRecord() {
+    auto tag = static_cast<TypeTag>(in_.ReadU8());
+    if (tag == TypeTag::kEmpty) {
+      return ctx_->GetEmptyType();
+    }
+    std::string name = in_.ReadString();
+    uint64_t byte_size = in_.ReadVarint();
+
+    TypeSP type;
+    switch (tag) {
+      case TypeTag::kBasic:
+        type = ctx_->GetBasicType(
+            static_cast<lldb::BasicType>(in_.ReadVarint()));
+        break;
+      case TypeTag::kNamed:
+        type = ctx_->ResolveTypeByName(name);
+        break;
+      case TypeTag::kPointer:
+        if (TypeSP element = ReadElementType()) {
+          type = element->GetPointerType();
+        }
+        break;
+      case TypeTag::kReference:
+        if (TypeSP element = ReadElementType()) {
+          type = element->GetReferenceType();
+        }
+        break;
+      case TypeTag::kArray:
+        if (TypeSP element = ReadElementType()) {
+          type = element->GetArrayType(in_.ReadVarint());
+        }
+        break;
+      default:
+        in_.Fail();
+        break;
+    }
+
+    // The debug information of the target may have changed without changing
+    // the modules (e.g. symbols loaded for a module).
+    if (in_.failed() || !type || !type->IsValid() || type->GetName() != name ||
+        type->GetByteSize() != byte_size) {
+      return nullptr;
+    }
+    return type;
+  }
+
+  // Element types always precede the types composed from them.
+  TypeSP ReadElementType() {
+    uint64_t index = in_.ReadVarint();
+    if (index == 0 || index >= types_.size()) {
+      in_.Fail();
+      return nullptr;
+    }
+    return types_[index];
+  }
+
+  TypeSP ReadType() {
+    uint64_t index = in_.ReadVarint();
+    if (index >= types_.size()) {
+      in_.Fail();
+      return nullptr;
+    }
+    return types_[index];
+  }
+
+  // Same as above, but the type must not be null.
+  TypeSP ReadNonNullType() {
+    TypeSP type = ReadType();
+    if (!type) {
+      in_.Fail();
+    }
+    return type;
+  }
+
+  ExprResult ReadNode(uint32_t depth) {
+    if (depth > kMaxDepth) {
+      in_.Fail();
+    }
+    if (in_.failed()) {
+      return nullptr;
+    }
+
+    auto tag = static_cast<NodeTag>(in_.ReadU8());
+    auto location =
+        clang::SourceLocation::getFromRawEncoding(in_.ReadVarint());
+    ExprResult node;
+
+    switch (tag) {
+      case NodeTag::kLiteral:
+        node = ReadLiteral(location);
+        break;
+
+      case NodeTag::kIdentifier:
+        node = ReadIdentifier(location);
+        break;
+
+      case NodeTag::kSizeOf: {
+        TypeSP type = ReadNonNullType();
+        TypeSP operand = ReadNonNullType();
+        if (!in_.failed()) {
+          node = MakeNode<SizeOfNode>(*arena_, location, std::move(type),
+                                      std::move(operand));
+        }
+        break;
+      }
+
+      case NodeTag::kBuiltinFunctionCall: {
+        TypeSP type = ReadNonNullType();
+        std::string name = in_.ReadString();
+        uint64_t num_args = in_.ReadVarint();
+        std::vector<ExprResult> args;
+        for (uint64_t i = 0; i < num_args && !in_.failed(); ++i) {
+          args.push_back(ReadNode(depth + 1));
+        }
+        if (!in_.failed()) {
+          node = MakeNode<BuiltinFunctionCallNode>(
+              *arena_, location, std::move(type), std::move(name),
+              std::move(args));
+        }
+        break;
+      }
+
+      case NodeTag::kCStyleCast: {
+        TypeSP type = ReadNonNullType();
+        auto kind = static_cast<CStyleCastKind>(in_.ReadU8());
+        if (kind > CStyleCastKind::kReference) {
+          in_.Fail();
+        }
+        ExprResult rhs = ReadNode(depth + 1);
+        if (!in_.failed()) {
+          node = MakeNode<CStyleCastNode>(*arena_, location, std::move(type),
+                                          std::move(rhs), kind);
+        }
+        break;
+      }
+
+      case NodeTag::kCxxStaticCast: {
+        TypeSP type = ReadNonNullType();
+        auto kind = static_cast<CxxStaticCastKind>(in_.ReadU8());
+        bool is_rvalue = in_.ReadBool();
+        if (kind == CxxStaticCastKind::kDerivedToBase) {
+          std::vector<uint32_t> idx = in_.ReadIndices();
+          ExprResult rhs = ReadNode(depth + 1);
+          if (!in_.failed()) {
+            node = MakeNode<CxxStaticCastNode>(*arena_, location,
+                                               std::move(type), std::move(rhs),
+                                               std::move(idx), is_rvalue);
+          }
+        } else if (kind == CxxStaticCastKind::kBaseToDerived) {
+          uint64_t offset = in_.ReadVarint();
+          ExprResult rhs = ReadNode(depth + 1);
+          if (!in_.failed()) {
+            node = MakeNode<CxxStaticCastNode>(*arena_, location,
+                                               std::move(type), std::move(rhs),
+                                               offset, is_rvalue);
+          }
+        } else if (kind < CxxStaticCastKind::kBaseToDerived) {
+          ExprResult rhs = ReadNode(depth + 1);
+          if (!in_.failed()) {
+            node = MakeNode<CxxStaticCastNode>(*arena_, location,
+                                               std::move(type), std::move(rhs),
+                                               kind, is_rvalue);
+          }
+        } else {
+          in_.Fail();
+        }
+        break;
+      }
+
+      case NodeTag::kCxxReinterpretCast: {
+        TypeSP type = ReadNonNullType();
+        bool is_rvalue = in_.ReadBool();
+        ExprResult rhs = ReadNode(depth + 1);
+        if (!in_.failed()) {
+          node = MakeNode<CxxReinterpretCastNode>(
+              *arena_, location, std::move(type), std::move(rhs), is_rvalue);
+        }
+        break;
+      }
+
+      case NodeTag::kMemberOf: {
+        TypeSP type = ReadNonNullType();
+        bool is_bitfield = in_.ReadBool();
+        auto bitfield_size = static_cast<uint32_t>(in_.ReadVarint());
+        std::vector<uint32_t> member_index = in_.ReadIndices();
+        std::optional<uint64_t> member_offset;
+        bool has_member_offset = in_.ReadBool();
+        uint64_t offset = in_.ReadVarint();
+        if (has_member_offset) {
+          member_offset = offset;
+        }
+        bool is_arrow = in_.ReadBool();
+        ExprResult lhs = ReadNode(depth + 1);
+        if (!in_.failed()) {
+          node = MakeNode<MemberOfNode>(
+              *arena_, location, std::move(type), std::move(lhs), is_bitfield,
+              bitfield_size, std::move(member_index), member_offset, is_arrow);
+        }
+        break;
+      }
+
+      case NodeTag::kArraySubscript: {
+        TypeSP type = ReadNonNullType();
+        ExprResult base = ReadNode(depth + 1);
+        ExprResult index = ReadNode(depth + 1);
+        if (!in_.failed()) {
+          node = MakeNode<ArraySubscriptNode>(*arena_, location,
+                                              std::move(type), std::move(base),
+                                              std::move(index));
+        }
+        break;
+      }
+
+      case NodeTag::kBinaryOp: {
+        TypeSP type = ReadNonNullType();
+        auto kind = static_cast<BinaryOpKind>(in_.ReadU8());
+        if (kind > BinaryOpKind::OrAssign) {
+          in_.Fail();
+        }
+        TypeSP comp_assign_type = ReadType();
+        ExprResult lhs = ReadNode(depth + 1);
+        ExprResult rhs = ReadNode(depth + 1);
+        if (!in_.failed()) {
+          node = MakeNode<BinaryOpNode>(*arena_, location, std::move(type),
+                                        kind, std::move(lhs), std::move(rhs),
+                                        std::move(comp_assign_type));
+        }
+        break;
+      }
+
+      case NodeTag::kUnaryOp: {
+        TypeSP type = ReadNonNullType();
+        auto kind = static_cast<UnaryOpKind>(in_.ReadU8());
+        if (kind > UnaryOpKind::LNot) {
+          in_.Fail();
+        }
+        ExprResult rhs = ReadNode(depth + 1);
+        if (!in_.failed()) {
+          node = MakeNode<UnaryOpNode>(*arena_, location, std::move(type), kind,
+                                       std::move(rhs));
+        }
+        break;
+      }
+
+      case NodeTag::kTernaryOp: {
+        TypeSP type = ReadNonNullType();
+        ExprResult cond = ReadNode(depth + 1);
+        ExprResult lhs = ReadNode(depth + 1);
+        ExprResult rhs = ReadNode(depth + 1);
+        if (!in_.failed()) {
+          node = MakeNode<TernaryOpNode>(*arena_, location, std::move(type),
+                                         std::move(cond), std::move(lhs),
+                                         std::move(rhs));
+        }
+        break;
+      }
+
+      case NodeTag::kSmartPtrToPtrDecay: {
+        TypeSP type = ReadNonNullType();
+        ExprResult ptr = ReadNode(depth + 1);
+        if (!in_.failed()) {
+          node = MakeNode<SmartPtrToPtrDecay>(*arena_, location,
+                                              std::move(type), std::move(ptr));
+        }
+        break;
+      }
+
+      default:
+        in_.Fail();
+        break;
+    }
+
+    // A missing child fails the whole tree, the nodes don't accept nulls.
+    if (!node) {
+      in_.Fail();
+    }
+    return node;
+  }
+
+  ExprResult ReadLiteral(clang::SourceLocation location) {
+    TypeSP type = ReadNonNullType();
+    bool is_literal_zero = in_.ReadBool();
+    switch (static_cast<LiteralTag>(in_.ReadU8())) {
+      case LiteralTag::kInt: {
+        llvm::APInt value = ReadAPInt();
+        if (in_.failed()) {
+          return nullptr;
+        }
+        return MakeNode<LiteralNode>(*arena_, location, std::move(type),
+                                     std::move(value), is_literal_zero);
+      }
+      case LiteralTag::kFloat: {
+        const llvm::fltSemantics* sem = GetFloatSemantics(in_.ReadU8());
+        llvm::APInt bits = ReadAPInt();
+        if (in_.failed() || !sem ||
+            llvm::APFloat::getSizeInBits(*sem) != bits.getBitWidth()) {
+          in_.Fail();
+          return nullptr;
+        }
+        return MakeNode<LiteralNode>(*arena_, location, std::move(type),
+                                     llvm::APFloat(*sem, bits),
+                                     is_literal_zero);
+      }
+      case LiteralTag::kBool: {
+        bool value = in_.ReadBool();
+        if (in_.failed()) {
+          return nullptr;
+        }
+        return MakeNode<LiteralNode>(*arena_, location, std::move(type), value,
+                                     is_literal_zero);
+      }
+      case LiteralTag::kBytes: {
+        llvm::ArrayRef<uint8_t> bytes = in_.ReadBytes();
+        if (in_.failed()) {
+          return nullptr;
+        }
+        std::vector<char> value(bytes.begin(), bytes.end());
+        return MakeNode<LiteralNode>(*arena_, location, std::move(type),
+                                     std::move(value), is_literal_zero);
+      }
+    }
+    in_.Fail();
+    return nullptr;
+  }
+
+  llvm::APInt ReadAPInt() {
+    uint64_t bit_width = in_.ReadVarint();
+    if (bit_width == 0 || bit_width > kMaxIntBits) {
+      in_.Fail();
+      return llvm::APInt();
+    }
+    std::vector<uint64_t> words(llvm::APInt::getNumWords(bit_width));
+    for (auto& word : words) {
+      word = in_.ReadVarint();
+    }
+    return llvm::APInt(static_cast<unsigned>(bit_width), words);
+  }
+
+  ExprResult ReadIdentifier(clang::SourceLocation location) {
+    using Kind = Context::IdentifierInfo::Kind;
+
+    std::string name = in_.ReadString();
+    bool is_rvalue = in_.ReadBool();
+    bool is_context_var = in_.ReadBool();
+    auto kind = static_cast<Kind>(in_.ReadU8());
+    TypeSP type = ReadNonNullType();
+    if (in_.failed()) {
+      return nullptr;
+    }
+
+    std::unique_ptr<ParserContext::IdentifierInfo> info;
+    switch (kind) {
+      case Kind::kValue:
+        info = ReadValue(type);
+        break;
+
+      case Kind::kContextArg: {
+        uint64_t slot = in_.ReadVarint();
+        // The context arguments are given by the user, their types must be
+        // the same as for the compilation.
+        if (slot >= context_args_.size() ||
+            !CompareTypes(context_args_[slot].second, type)) {
+          in_.Fail();
+          return nullptr;
+        }
+        info = Context::IdentifierInfo::FromContextArg(
+            std::move(type), static_cast<uint32_t>(slot));
+        break;
+      }
+
+      case Kind::kMemberPath:
+        info = Context::IdentifierInfo::FromMemberPath(std::move(type),
+                                                       in_.ReadIndices());
+        break;
+
+      case Kind::kThisKeyword:
+        info = Context::IdentifierInfo::FromThisKeyword(std::move(type));
+        break;
+
+      case Kind::kLocalVariable:
+      case Kind::kInstanceVariable:
+      case Kind::kRegister:
+        info = Context::IdentifierInfo::FromFrameValue(kind, in_.ReadString(),
+                                                       std::move(type));
+        break;
+
+      case Kind::kFrameVariable: {
+        std::string variable = in_.ReadString();
+        std::string directory = in_.ReadString();
+        std::string filename = in_.ReadString();
+        lldb::SBFileSpec file;
+        file.SetDirectory(directory.c_str());
+        file.SetFilename(filename.c_str());
+        lldb::SBDeclaration declaration;
+        declaration.SetFileSpec(file);
+        declaration.SetLine(static_cast<uint32_t>(in_.ReadVarint()));
+        declaration.SetColumn(static_cast<uint32_t>(in_.ReadVarint()));
+        info = Context::IdentifierInfo::FromFrameVariable(
+            std::move(variable), std::move(declaration), std::move(type));
+        break;
+      }
+
+      default:
+        in_.Fail();
+        break;
+    }
+
+    if (in_.failed() || !info) {
+      return nullptr;
+    }
+    return MakeNode<IdentifierNode>(*arena_, location, std::move(name),
+                                    std::move(info), is_rvalue,
+                                    is_context_var);
+  }
+
+  std::unique_ptr<ParserContext::IdentifierInfo> ReadValue(TypeSP type) {
+    lldb::SBValue value;
+    switch (static_cast<ValueTag>(in_.ReadU8())) {
+      case ValueTag::kAddress: {
+        std::string name = in_.ReadString();
+        uint64_t module_index = in_.ReadVarint();
+        uint64_t file_addr = in_.ReadVarint();
+        if (in_.failed() || module_index >= target_.GetNumModules()) {
+          in_.Fail();
+          return nullptr;
+        }
+        lldb::SBAddress addr =
+            target_.GetModuleAtIndex(static_cast<uint32_t>(module_index))
+                .ResolveFileAddress(file_addr);
+        value = target_.CreateValueFromAddress(name.c_str(), addr,
+                                               ToSBType(type));
+        break;
+      }
+
+      case ValueTag::kData: {
+        llvm::ArrayRef<uint8_t> bytes = in_.ReadBytes();
+        if (in_.failed() || bytes.size() != type->GetByteSize()) {
+          in_.Fail();
+          return nullptr;
+        }
+        value = CreateValueFromBytes(target_, bytes.data(), ToSBType(type))
+                    .inner_value();
+        break;
+      }
+
+      default:
+        in_.Fail();
+        return nullptr;
+    }
+
+    if (!value.IsValid()) {
+      in_.Fail();
+      return nullptr;
+    }
+    // Types of the table are created by the context, i.e. they're LLDB
+    // types.
+    return Context::IdentifierInfo::FromValue(
+        std::move(value), std::static_pointer_cast<LLDBType>(type));
+  }
+
+ private:
+  ByteReader& in_;
+  std::shared_ptr<Context> ctx_;
+  lldb::SBTarget target_;
+  const std::vector<std::pair<std::string, TypeSP>>& context_args_;
+  llvm::IntrusiveRefCntPtr<AstArena> arena_;
+  std::vector<TypeSP> types_;
+};
+
+}  // namespace
+
+uint64_t TargetFingerprint(lldb::SBTarget target) {
+  // FNV-1a, the fingerprint must be stable across processes.
+  uint64_t hash = 0xcbf29ce484222325;
+  auto add = [&hash](llvm::StringRef str) {
+    for (char c : str) {
+      hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+    }
+    // Separator, so that the consecutive strings don't mix.
+    hash = (hash ^ 0xff) * 0x100000001b3;
+  };
+  for (uint32_t i = 0; i < target.GetNumModules(); ++i) {
+    lldb::SBModule module = target.GetModuleAtIndex(i);
+    lldb::SBFileSpec file = module.GetFileSpec();
+    const char* uuid = module.GetUUIDString();
+    add(uuid ? uuid : "");
+    add(file.GetDirectory() ? file.GetDirectory() : "");
+    add(file.GetFilename() ? file.GetFilename() : "");
+  }
+  return hash;
+}
+
+std::vector<uint8_t> WriteCompiledExpr(lldb::SBTarget target,
+                                       const CompiledExpr& expression) {
+  ByteWriter out;
+  for (char c : kMagic) {
+    out.WriteU8(static_cast<uint8_t>(c));
+  }
+  out.WriteVarint(kFormatVersion);
+  out.WriteString(expression.source->expr());
+
+  TreeWriter writer(target);
+  writer.Write(expression.tree.get());
+  if (!writer.is_serializable()) {
+    // Only the source, the reader compiles the expression again.
+    out.WriteU8(false);
+    return out.TakeData();
+  }
+
+  out.WriteU8(true);
+  out.WriteVarint(TargetFingerprint(target));
+  out.WriteString(GetTypeName(expression.scope));
+  out.WriteVarint(expression.context_slots.size());
+  for (const auto& slot : expression.context_slots) {
+    out.WriteString(slot);
+  }
+  out.WriteU8(writer.has_side_effects());
+  out.WriteVarint(writer.num_types());
+  out.Append(writer.types());
+  out.Append(writer.tree());
+  return out.TakeData();
+}
+
+std::shared_ptr<CompiledExpr> ReadCompiledExpr(
+    lldb::SBTarget target, lldb::SBType scope, llvm::ArrayRef<uint8_t> data,
+    const std::vector<std::pair<std::string, TypeSP>>& context_args,
+    const Options& opts, std::optional<std::string>* source) {
+  source->reset();
+  if (data.size() < sizeof(kMagic) ||
+      std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+    return nullptr;
+  }
+
+  ByteReader in(data.drop_front(sizeof(kMagic)));
+  uint64_t version = in.ReadVarint();
+  std::string expr = in.ReadString();
+  if (in.failed()) {
+    return nullptr;
+  }
+  *source = expr;
+
+  if (version != kFormatVersion || !in.ReadBool() ||
+      in.ReadVarint() != TargetFingerprint(target) ||
+      in.ReadString() != GetTypeName(scope)) {
+    return nullptr;
+  }
+
+  uint64_t num_slots = in.ReadVarint();
+  if (in.failed() || num_slots != context_args.size()) {
+    return nullptr;
+  }
+  std::vector<std::string> context_slots;
+  context_slots.reserve(num_slots);
+  for (uint64_t i = 0; i < num_slots; ++i) {
+    context_slots.push_back(in.ReadString());
+    if (context_slots.back() != context_args[i].first) {
+      return nullptr;
+    }
+  }
+
+  // Compile again to report the error if the side effects aren't allowed.
+  bool has_side_effects = in.ReadBool();
+  if (in.failed() || (has_side_effects && !opts.allow_side_effects)) {
+    return nullptr;
+  }
+
+  auto sm = SourceManager::Create(std::move(expr));
+  auto ctx = Context::Create(sm, target, LLDBType::CreateSP(scope));
+  TreeReader reader(in, ctx, context_args);
+  if (!reader.ReadTypes()) {
+    return nullptr;
+  }
+  ExprResult tree = reader.ReadTree();
+  if (!tree || !in.AtEnd()) {
+    return nullptr;
+  }
+
+  std::shared_ptr<const Bytecode> bytecode;
+  if (opts.use_bytecode) {
+    bytecode = Bytecode::Compile(tree.get());
+  }
+  return std::make_shared<CompiledExpr>(std::move(sm), std::move(tree), scope,
+                                        std::move(bytecode),
+                                        std::move(context_slots));
+}
+
+}  // namespace lldb_eval
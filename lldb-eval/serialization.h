@@ -0,0 +1,71 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_SERIALIZATION_H_
+#define LLDB_EVAL_SERIALIZATION_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lldb-eval/api.h"
+#include "lldb-eval/type.h"
+#include "lldb/API/SBTarget.h"
+#include "lldb/API/SBType.h"
+#include "llvm/ADT/ArrayRef.h"
+
+namespace lldb_eval {
+
+// Binary format of the compiled expressions (see `SerializeCompiledExpr()` in
+// api.h). The data starts with a fixed header: the magic, the format version
+// and the expression source. Therefore the source can be recovered from the
+// data written by any version of the format. The rest of the data is:
+//
+//   * the fingerprint of the modules loaded in the target;
+//   * the scope type name and the names of the context slots;
+//   * the table of the types the tree refers to. Types are written by their
+//     names, the pointer, reference and array types are composed from their
+//     element types;
+//   * the tree in the pre-order.
+//
+// Global variables are written by their module and file address, so they don't
+// depend on where the module is loaded.
+
+// Fingerprint of the modules loaded in `target` (their UUIDs and paths).
+uint64_t TargetFingerprint(lldb::SBTarget target);
+
+// Writes the compiled expression. Trees referring to the values that can't be
+// written (e.g. variables without an address) are written without the tree,
+// only the source is kept for recompiling.
+std::vector<uint8_t> WriteCompiledExpr(lldb::SBTarget target,
+                                       const CompiledExpr& expression);
+
+// Rehydrates the compiled expression without parsing it. Returns null if the
+// expression must be compiled again, because the modules of `target`, the
+// scope, the context arguments or any of the types differ from the ones used
+// for the compilation. `source` is set to the expression source if the data is
+// well-formed.
+std::shared_ptr<CompiledExpr> ReadCompiledExpr(
+    lldb::SBTarget target, lldb::SBType scope, llvm::ArrayRef<uint8_t> data,
+    const std::vector<std::pair<std::string, TypeSP>>& context_args,
+    const Options& opts, std::optional<std::string>* source);
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_SERIALIZATION_H_
@@ -0,0 +1,142 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/stats.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "lldb-eval/api.h"
+#include "lldb-eval/trace.h"
+#include "lldb/API/SBError.h"
+#include "lldb/API/SBProcess.h"
+#include "lldb/lldb-types.h"
+#include "llvm/Support/FormatVariadic.h"
+
+namespace lldb_eval {
+
+namespace {
+
+thread_local EvaluationStats* current_stats = nullptr;
+
+class AggregateStats {
+ public:
+  static AggregateStats& Instance() {
+    static AggregateStats* stats = new AggregateStats();
+    return *stats;
+  }
+
+  bool is_enabled() const { return enabled_.load(std::memory_order_relaxed); }
+  void SetEnabled(bool enabled) { enabled_ = enabled; }
+
+  void Add(const EvaluationStats& stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_ += stats;
+  }
+
+  EvaluationStats Get() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+  void Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_ = EvaluationStats();
+  }
+
+ private:
+  std::atomic<bool> enabled_{false};
+  std::mutex mutex_;
+  EvaluationStats stats_;
+};
+
+}  // namespace
+
+EvaluationStats& EvaluationStats::operator+=(const EvaluationStats& other) {
+  num_compilations += other.num_compilations;
+  num_evaluations += other.num_evaluations;
+  total_ns += other.total_ns;
+  lex_ns += other.lex_ns;
+  parse_ns += other.parse_ns;
+  type_lookup_ns += other.type_lookup_ns;
+  identifier_lookup_ns += other.identifier_lookup_ns;
+  eval_ns += other.eval_ns;
+  memory_read_ns += other.memory_read_ns;
+  find_types_calls += other.find_types_calls;
+  find_global_variables_calls += other.find_global_variables_calls;
+  create_value_from_data_calls += other.create_value_from_data_calls;
+  memory_read_calls += other.memory_read_calls;
+  memory_bytes_read += other.memory_bytes_read;
+  ast_nodes += other.ast_nodes;
+  scalar_evaluations += other.scalar_evaluations;
+  return *this;
+}
+
+StatsScope::StatsScope(EvaluationStats* sink) : sink_(sink) {
+  if (current_stats || (!sink_ && !AggregateStats::Instance().is_enabled())) {
+    return;
+  }
+  is_active_ = true;
+  current_stats = &stats_;
+  start_ = std::chrono::steady_clock::now();
+}
+
+StatsScope::~StatsScope() {
+  if (!is_active_) {
+    return;
+  }
+  current_stats = nullptr;
+  stats_.total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start_)
+                         .count();
+  if (sink_) {
+    *sink_ += stats_;
+  }
+  if (AggregateStats::Instance().is_enabled()) {
+    AggregateStats::Instance().Add(stats_);
+  }
+}
+
+EvaluationStats* StatsScope::Current() { return current_stats; }
+
+WorkerStatsScope::WorkerStatsScope(EvaluationStats* stats)
+    : previous_(current_stats) {
+  current_stats = stats;
+}
+
+WorkerStatsScope::~WorkerStatsScope() { current_stats = previous_; }
+
+size_t ReadProcessMemory(lldb::SBProcess process, lldb::addr_t addr, void* buf,
+                         size_t size, lldb::SBError& error) {
+  PhaseTimer timer(&EvaluationStats::memory_read_ns);
+  TraceEvent trace("ReadMemory");
+  if (trace.enabled()) {
+    trace.SetDetail(llvm::formatv("{0:x}, {1} bytes", addr, size).str());
+  }
+  size_t read = process.ReadMemory(addr, buf, size, error);
+  CountStat(&EvaluationStats::memory_read_calls);
+  CountStat(&EvaluationStats::memory_bytes_read, read);
+  return read;
+}
+
+void SetAggregateStatsEnabled(bool enabled) {
+  AggregateStats::Instance().SetEnabled(enabled);
+}
+
+EvaluationStats GetAggregateStats() { return AggregateStats::Instance().Get(); }
+
+void ResetAggregateStats() { AggregateStats::Instance().Reset(); }
+
+}  // namespace lldb_eval
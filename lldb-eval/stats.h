@@ -0,0 +1,114 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_STATS_H_
+#define LLDB_EVAL_STATS_H_
+
+#include <chrono>
+#include <cstdint>
+
+#include "lldb-eval/api.h"
+#include "lldb/API/SBError.h"
+#include "lldb/API/SBProcess.h"
+#include "lldb/lldb-types.h"
+
+namespace lldb_eval {
+
+// Stats are collected per thread: the API call sets up a `StatsScope` and the
+// code deep down the call stack (e.g. the value creation or the memory reads)
+// updates the stats of the current thread, without passing them around.
+using StatsField = uint64_t EvaluationStats::*;
+
+// Collects the stats of the API call on the current thread. When the scope
+// ends, the stats are added to `sink` (if not null) and to the process-wide
+// aggregate (if enabled). Nested scopes (e.g. `CompileExpression()` called by
+// `EvaluateExpression()`) do nothing, the outermost scope collects everything.
+class StatsScope {
+ public:
+  explicit StatsScope(EvaluationStats* sink);
+  ~StatsScope();
+
+  StatsScope(const StatsScope&) = delete;
+  StatsScope& operator=(const StatsScope&) = delete;
+
+  // Returns the stats collected on the current thread, or null if they are not
+  // collected.
+  static EvaluationStats* Current();
+
+ private:
+  bool is_active_ = false;
+  EvaluationStats* sink_;
+  EvaluationStats stats_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Collects the stats of the work done on a worker thread to `*stats` (if not
+// null). The caller adds them to its own stats when the worker is done.
+class WorkerStatsScope {
+ public:
+  explicit WorkerStatsScope(EvaluationStats* stats);
+  ~WorkerStatsScope();
+
+  WorkerStatsScope(const WorkerStatsScope&) = delete;
+  WorkerStatsScope& operator=(const WorkerStatsScope&) = delete;
+
+ private:
+  EvaluationStats* previous_;
+};
+
+// Adds the wall time of the enclosing block to a phase of the current stats.
+// The clock isn't read if the stats are not collected.
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(StatsField phase) : stats_(StatsScope::Current()) {
+    if (stats_) {
+      phase_ = phase;
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~PhaseTimer() {
+    if (stats_) {
+      auto elapsed = std::chrono::steady_clock::now() - start_;
+      stats_->*phase_ +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+  }
+
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+ private:
+  EvaluationStats* stats_;
+  StatsField phase_ = nullptr;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Adds `n` to a counter of the current stats.
+inline void CountStat(StatsField counter, uint64_t n = 1) {
+  if (EvaluationStats* stats = StatsScope::Current()) {
+    stats->*counter += n;
+  }
+}
+
+// Same as `SBProcess::ReadMemory()`, but the read is counted in the current
+// stats.
+size_t ReadProcessMemory(lldb::SBProcess process, lldb::addr_t addr, void* buf,
+                         size_t size, lldb::SBError& error);
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_STATS_H_
@@ -0,0 +1,631 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/target_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lldb-eval/type.h"
+#include "lldb-eval/value.h"
+#include "lldb/API/SBProcess.h"
+#include "lldb/API/SBTarget.h"
+#include "lldb/API/SBType.h"
+#include "lldb/API/SBTypeEnumMember.h"
+#include "lldb/API/SBValue.h"
+#include "lldb/lldb-enumerations.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+
+#if LLVM_VERSION_MAJOR < 16
+#include "llvm/ADT/Triple.h"
+#else
+#include "llvm/TargetParser/Triple.h"
+#endif
+
+namespace lldb_eval {
+
+namespace {
+
+TargetFacts ComputeTargetFacts(lldb::SBTarget target) {
+  TargetFacts facts;
+  const char* triple_str = target.GetTriple();
+  facts.triple = triple_str ? triple_str : "";
+  facts.byte_order = target.GetByteOrder();
+  facts.address_byte_size = target.GetAddressByteSize();
+
+  // Determine "size_t" and "ptrdiff_t" based on OS and architecture. They are
+  // "unsigned int" and "int" on most 32-bit architectures and "unsigned long"
+  // and "long" on most 64-bit architectures. On 64-bit Windows, they are
+  // "unsigned long long" and "long long". To see a complete definition for all
+  // architectures, refer to
+  // https://github.com/llvm/llvm-project/blob/main/clang/lib/Basic/Targets.
+  llvm::Triple triple(llvm::Twine(facts.triple));
+  if (triple.isOSWindows()) {
+    facts.size_type = triple.isArch64Bit() ? lldb::eBasicTypeUnsignedLongLong
+                                           : lldb::eBasicTypeUnsignedInt;
+    facts.ptrdiff_type =
+        triple.isArch64Bit() ? lldb::eBasicTypeLongLong : lldb::eBasicTypeInt;
+  } else {
+    facts.size_type = triple.isArch64Bit() ? lldb::eBasicTypeUnsignedLong
+                                           : lldb::eBasicTypeUnsignedInt;
+    facts.ptrdiff_type =
+        triple.isArch64Bit() ? lldb::eBasicTypeLong : lldb::eBasicTypeInt;
+  }
+  facts.itanium_cxx_abi = !triple.isWindowsMSVCEnvironment();
+  return facts;
+}
+
+// Looks for the field of `type` (or of its bases and record fields) pointing to
+// `pointee`, and returns its offset from the start of `type`. Both libc++ and
+// libstdc++ wrap the raw pointer into a few layers of helper classes (e.g.
+// `__compressed_pair` or `std::tuple`), but don't store other pointers to the
+// element type.
+std::optional<uint64_t> FindPointerOffset(lldb::SBType type,
+                                          llvm::StringRef pointee,
+                                          uint32_t depth) {
+  // The helper classes are nested only a few levels deep.
+  static constexpr uint32_t kMaxDepth = 8;
+  if (depth > kMaxDepth) {
+    return {};
+  }
+  type = type.GetCanonicalType();
+  for (uint32_t i = 0; i < type.GetNumberOfDirectBaseClasses(); ++i) {
+    lldb::SBTypeMember base = type.GetDirectBaseClassAtIndex(i);
+    if (auto offset = FindPointerOffset(base.GetType(), pointee, depth + 1)) {
+      return base.GetOffsetInBytes() + *offset;
+    }
+  }
+  for (uint32_t i = 0; i < type.GetNumberOfFields(); ++i) {
+    lldb::SBTypeMember field = type.GetFieldAtIndex(i);
+    if (field.IsBitfield()) {
+      continue;
+    }
+    lldb::SBType field_type = field.GetType().GetCanonicalType();
+    if (field_type.IsPointerType()) {
+      const char* name =
+          field_type.GetPointeeType().GetUnqualifiedType().GetName();
+      if (name && pointee == name) {
+        return field.GetOffsetInBytes();
+      }
+    } else if (field_type.GetTypeClass() &
+               (lldb::eTypeClassClass | lldb::eTypeClassStruct)) {
+      if (auto offset = FindPointerOffset(field_type, pointee, depth + 1)) {
+        return field.GetOffsetInBytes() + *offset;
+      }
+    }
+  }
+  return {};
+}
+
+// Estimated overhead of a node of the maps (the links and the hash), on top of
+// the key and the value stored in it.
+constexpr size_t kNodeOverhead = 2 * sizeof(void*);
+
+// Estimated size of a node of `Map`, not counting the characters of the string
+// keys.
+template <typename Map>
+constexpr size_t NodeBytes() {
+  return sizeof(typename Map::value_type) + kNodeOverhead;
+}
+
+size_t GetGlobalNamesBytes(const TargetCache::GlobalNames* names) {
+  if (!names) {
+    return 0;
+  }
+  size_t bytes = sizeof(*names) +
+                 names->sorted_names.capacity() * sizeof(llvm::StringRef);
+  for (const auto& global : names->globals) {
+    bytes += NodeBytes<decltype(names->globals)>() + global.getKeyLength();
+  }
+  return bytes;
+}
+
+size_t GetEnumTableBytes(const TargetCache::EnumTable& table) {
+  size_t bytes = sizeof(table);
+  for (const auto& enumerator : table.enumerators) {
+    bytes += NodeBytes<decltype(table.enumerators)>() +
+             enumerator.getKeyLength();
+  }
+  return bytes;
+}
+
+// Erases the entries of `map` last used at `cutoff` or before, returns their
+// total size.
+template <typename Map>
+size_t EraseUsedBefore(Map& map, uint64_t cutoff) {
+  size_t bytes = 0;
+  for (auto it = map.begin(); it != map.end();) {
+    auto current = it++;
+    if (current->second.last_use <= cutoff) {
+      bytes += current->second.bytes;
+      map.erase(current);
+    }
+  }
+  return bytes;
+}
+
+// Registry of the target caches. The entries of the deleted targets (see
+// `SBDebugger::DeleteTarget()`) are dropped on every lookup, so the registry
+// doesn't keep them alive and holds one entry per target of the debuggers,
+// rarely more than a handful. The targets can't be hashed, they are only
+// comparable.
+class TargetCacheRegistry {
+ public:
+  static TargetCacheRegistry& Instance() {
+    static TargetCacheRegistry* registry = new TargetCacheRegistry();
+    return *registry;
+  }
+
+  template <typename Factory>
+  std::shared_ptr<TargetCache> Get(lldb::SBTarget target, Factory factory) {
+    // Changes in the number of modules are detected automatically. This
+    // covers the common cases (e.g. shared libraries loaded at runtime), the
+    // rest has to be reported via `Invalidate()`.
+    uint32_t num_modules = target.GetNumModules();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    llvm::erase_if(caches_,
+                   [](const Entry& entry) { return !entry.target.IsValid(); });
+    for (auto& entry : caches_) {
+      if (entry.target == target) {
+        if (entry.num_modules != num_modules) {
+          entry.num_modules = num_modules;
+          entry.cache = factory();
+        }
+        return entry.cache;
+      }
+    }
+    caches_.push_back({target, num_modules, factory()});
+    return caches_.back().cache;
+  }
+
+  std::shared_ptr<TargetCache> Find(lldb::SBTarget target) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : caches_) {
+      if (entry.target == target) {
+        return entry.cache;
+      }
+    }
+    return nullptr;
+  }
+
+  void Invalidate(lldb::SBTarget target) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = caches_.begin(); it != caches_.end(); ++it) {
+      if (it->target == target) {
+        caches_.erase(it);
+        return;
+      }
+    }
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    caches_.clear();
+  }
+
+  template <typename F>
+  void ForEach(F f) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : caches_) {
+      f(*entry.cache);
+    }
+  }
+
+ private:
+  struct Entry {
+    lldb::SBTarget target;
+    uint32_t num_modules;
+    std::shared_ptr<TargetCache> cache;
+  };
+
+  std::mutex mutex_;
+  std::vector<Entry> caches_;
+};
+
+}  // namespace
+
+std::optional<uint64_t> TargetCache::EnumTable::Find(
+    llvm::StringRef name) const {
+  auto it = enumerators.find(name);
+  if (it == enumerators.end()) {
+    return {};
+  }
+  return it->second;
+}
+
+TargetCache::TargetCache(lldb::SBTarget target)
+    : facts_(ComputeTargetFacts(target)) {}
+
+std::shared_ptr<TargetCache> TargetCache::Get(lldb::SBTarget target) {
+  return TargetCacheRegistry::Instance().Get(target, [target] {
+    return std::shared_ptr<TargetCache>(new TargetCache(target));
+  });
+}
+
+void TargetCache::Invalidate(lldb::SBTarget target) {
+  TargetCacheRegistry::Instance().Invalidate(target);
+}
+
+void TargetCache::InvalidateProcessData(lldb::SBTarget target) {
+  std::shared_ptr<TargetCache> cache =
+      TargetCacheRegistry::Instance().Find(target);
+  if (!cache) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(cache->mutex_);
+  cache->usage_[kGlobals] -= EraseUsedBefore(cache->globals_, UINT64_MAX);
+  cache->usage_[kGlobals] -= EraseUsedBefore(cache->global_names_, UINT64_MAX);
+  cache->usage_[kMemberPaths] -=
+      EraseUsedBefore(cache->virtual_base_offsets_, UINT64_MAX);
+}
+
+void TargetCache::Clear() { TargetCacheRegistry::Instance().Clear(); }
+
+std::atomic<size_t> TargetCache::memory_limits_[kNumKinds];
+
+TargetCache::MemoryUsage TargetCache::GetTotalMemoryUsage() {
+  MemoryUsage total;
+  TargetCacheRegistry::Instance().ForEach([&total](TargetCache& cache) {
+    MemoryUsage usage = cache.GetMemoryUsage();
+    total.types += usage.types;
+    total.globals += usage.globals;
+    total.member_paths += usage.member_paths;
+  });
+  return total;
+}
+
+void TargetCache::SetMemoryLimits(const MemoryUsage& limits) {
+  memory_limits_[kTypes] = limits.types;
+  memory_limits_[kGlobals] = limits.globals;
+  memory_limits_[kMemberPaths] = limits.member_paths;
+  TargetCacheRegistry::Instance().ForEach([](TargetCache& cache) {
+    std::lock_guard<std::mutex> lock(cache.mutex_);
+    for (size_t kind = 0; kind < kNumKinds; ++kind) {
+      cache.EvictIfNeeded(static_cast<Kind>(kind));
+    }
+  });
+}
+
+TargetCache::MemoryUsage TargetCache::GetMemoryUsage() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MemoryUsage usage;
+  usage.types = usage_[kTypes];
+  usage.globals = usage_[kGlobals];
+  usage.member_paths = usage_[kMemberPaths];
+  return usage;
+}
+
+template <typename Map, typename Key, typename T>
+T TargetCache::Insert(Kind kind, Map& map, const Key& key, T value,
+                      size_t bytes) {
+  auto [it, inserted] =
+      map.try_emplace(key, Entry<T>{std::move(value), bytes, ++tick_});
+  if (!inserted) {
+    return Use(it->second);
+  }
+  // Copy the value, the entry itself may be evicted if it's over the limit.
+  T ret = it->second.value;
+  usage_[kind] += bytes;
+  EvictIfNeeded(kind);
+  return ret;
+}
+
+template <typename F>
+void TargetCache::ForEachMap(Kind kind, F f) {
+  switch (kind) {
+    case kTypes:
+      f(types_);
+      f(interned_types_);
+      f(enum_tables_);
+      f(smart_ptr_offsets_);
+      break;
+    case kGlobals:
+      f(globals_);
+      f(global_names_);
+      break;
+    case kMemberPaths:
+      f(base_class_paths_);
+      f(virtual_base_offsets_);
+      break;
+    case kNumKinds:
+      break;
+  }
+}
+
+void TargetCache::EvictIfNeeded(Kind kind) {
+  size_t limit = memory_limits_[kind].load(std::memory_order_relaxed);
+  if (limit == 0 || usage_[kind] <= limit) {
+    return;
+  }
+
+  // Finding the least recently used entries scans the maps, so evict down to
+  // 3/4 of the limit to amortize the scans over many insertions.
+  size_t low_watermark = limit / 4 * 3;
+  std::vector<std::pair<uint64_t, size_t>> uses;
+  ForEachMap(kind, [&uses](const auto& map) {
+    for (const auto& entry : map) {
+      uses.emplace_back(entry.second.last_use, entry.second.bytes);
+    }
+  });
+  std::sort(uses.begin(), uses.end());
+
+  // The ticks are unique, evict the entries used before the cutoff.
+  size_t usage = usage_[kind];
+  uint64_t cutoff = 0;
+  for (const auto& [last_use, bytes] : uses) {
+    if (usage <= low_watermark || last_use == tick_) {
+      break;
+    }
+    usage -= bytes;
+    cutoff = last_use;
+  }
+  if (cutoff == 0) {
+    return;
+  }
+  ForEachMap(kind, [this, kind, cutoff](auto& map) {
+    usage_[kind] -= EraseUsedBefore(map, cutoff);
+  });
+}
+
+std::optional<lldb::SBType> TargetCache::LookupType(llvm::StringRef name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = types_.find(name);
+  if (it == types_.end()) {
+    return {};
+  }
+  return Use(it->second);
+}
+
+void TargetCache::InsertType(llvm::StringRef name, lldb::SBType type) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Insert(kTypes, types_, name, std::move(type),
+         NodeBytes<decltype(types_)>() + name.size());
+}
+
+void TargetCache::SetGlobalsProcess(uint32_t process_id) {
+  if (process_id == globals_process_) {
+    return;
+  }
+  usage_[kGlobals] -= EraseUsedBefore(globals_, UINT64_MAX);
+  usage_[kGlobals] -= EraseUsedBefore(global_names_, UINT64_MAX);
+  globals_process_ = process_id;
+}
+
+std::optional<lldb::SBValue> TargetCache::LookupGlobal(lldb::SBProcess process,
+                                                       llvm::StringRef name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (process.GetUniqueID() != globals_process_) {
+    return {};
+  }
+  auto it = globals_.find(name);
+  if (it == globals_.end()) {
+    return {};
+  }
+  return Use(it->second);
+}
+
+void TargetCache::InsertGlobal(lldb::SBProcess process, llvm::StringRef name,
+                               lldb::SBValue value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The values of the previous process refer to its memory.
+  SetGlobalsProcess(process.GetUniqueID());
+  Insert(kGlobals, globals_, name, std::move(value),
+         NodeBytes<decltype(globals_)>() + name.size());
+}
+
+std::shared_ptr<const TargetCache::GlobalNames> TargetCache::LookupGlobalNames(
+    lldb::SBProcess process, llvm::StringRef prefix) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (process.GetUniqueID() != globals_process_) {
+    return nullptr;
+  }
+  for (size_t size = prefix.size(); size > 0; --size) {
+    auto it = global_names_.find(prefix.take_front(size));
+    if (it != global_names_.end()) {
+      return Use(it->second);
+    }
+  }
+  return nullptr;
+}
+
+void TargetCache::InsertGlobalNames(lldb::SBProcess process,
+                                    llvm::StringRef prefix,
+                                    std::shared_ptr<const GlobalNames> names) {
+  size_t bytes = NodeBytes<decltype(global_names_)>() + prefix.size() +
+                 GetGlobalNamesBytes(names.get());
+  std::lock_guard<std::mutex> lock(mutex_);
+  SetGlobalsProcess(process.GetUniqueID());
+  Insert(kGlobals, global_names_, prefix, std::move(names), bytes);
+}
+
+std::shared_ptr<LLDBType> TargetCache::InternType(lldb::SBType type) {
+  if (!type.IsValid()) {
+    return LLDBType::CreateSP(type);
+  }
+
+  const char* name = type.GetName();
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = interned_types_.try_emplace(name);
+  auto& bucket = it->second;
+  for (const auto& interned : Use(bucket)) {
+    // Comparison of SBType objects may give false negatives (see
+    // `LLDBType::CompareTo()`), in which case the type is just interned twice.
+    if (interned->type_ == type) {
+      return interned;
+    }
+  }
+  auto interned = LLDBType::CreateSP(type);
+  interned->cache_ = weak_from_this();
+  bucket.value.push_back(interned);
+
+  size_t bytes = sizeof(LLDBType) + sizeof(interned);
+  if (inserted) {
+    bytes += NodeBytes<decltype(interned_types_)>();
+  }
+  bucket.bytes += bytes;
+  usage_[kTypes] += bytes;
+  EvictIfNeeded(kTypes);
+  return interned;
+}
+
+std::shared_ptr<const TargetCache::EnumTable> TargetCache::GetEnumTable(
+    lldb::SBType type) {
+  // Returns the table of `type` from the bucket. Requires `mutex_`.
+  auto find_in_bucket = [&type](const auto& bucket) {
+    for (const auto& table : bucket) {
+      lldb::SBType table_type = table->type;
+      if (table_type == type) {
+        return table;
+      }
+    }
+    return std::shared_ptr<const EnumTable>();
+  };
+
+  const char* name = type.GetName();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = enum_tables_.find(name);
+    if (it != enum_tables_.end()) {
+      if (auto table = find_in_bucket(Use(it->second))) {
+        return table;
+      }
+    }
+  }
+
+  // Read the enumerators without holding the lock, concurrent callers may read
+  // them too and the first one wins.
+  auto table = std::make_shared<EnumTable>();
+  table->type = type;
+  lldb::SBTypeEnumMemberList members = type.GetEnumMembers();
+  for (uint32_t i = 0; i < members.GetSize(); ++i) {
+    lldb::SBTypeEnumMember member = members.GetTypeEnumMemberAtIndex(i);
+    const char* member_name = member.GetName();
+    table->enumerators.try_emplace(member_name ? member_name : "",
+                                   member.GetValueAsUnsigned());
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = enum_tables_.try_emplace(name);
+  auto& bucket = it->second;
+  if (auto existing = find_in_bucket(Use(bucket))) {
+    return existing;
+  }
+  bucket.value.push_back(table);
+
+  size_t bytes = sizeof(table) + GetEnumTableBytes(*table);
+  if (inserted) {
+    bytes += NodeBytes<decltype(enum_tables_)>();
+  }
+  bucket.bytes += bytes;
+  usage_[kTypes] += bytes;
+  EvictIfNeeded(kTypes);
+  return table;
+}
+
+std::optional<uint64_t> TargetCache::GetSmartPtrOffset(lldb::SBType type) {
+  const char* name = type.GetName();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = smart_ptr_offsets_.find(name);
+    if (it != smart_ptr_offsets_.end()) {
+      return Use(it->second);
+    }
+  }
+
+  // Same as the enumerators, the layout is inspected without holding the lock.
+  std::optional<uint64_t> offset;
+  lldb::SBType pointee = type.GetCanonicalType()
+                             .GetTemplateArgumentType(0)
+                             .GetCanonicalType()
+                             .GetUnqualifiedType();
+  const char* pointee_name = pointee.IsValid() ? pointee.GetName() : nullptr;
+  if (pointee_name) {
+    offset = FindPointerOffset(type, pointee_name, /*depth*/ 0);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  return Insert(kTypes, smart_ptr_offsets_, name, offset,
+                NodeBytes<decltype(smart_ptr_offsets_)>());
+}
+
+// Pooled name of the canonical unqualified type, identifying the type in the
+// target.
+static const char* GetCanonicalName(const TypeSP& type) {
+  return type->GetCanonicalType()->GetUnqualifiedType()->GetName().data();
+}
+
+std::shared_ptr<const BaseClassPath> TargetCache::GetBaseClassPath(
+    TypeSP type, TypeSP base) {
+  auto key = std::make_pair(GetCanonicalName(type), GetCanonicalName(base));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = base_class_paths_.find(key);
+    if (it != base_class_paths_.end()) {
+      return Use(it->second);
+    }
+  }
+
+  // Same as the enumerators, the hierarchy is walked without holding the lock.
+  std::shared_ptr<const BaseClassPath> path;
+  size_t bytes = NodeBytes<decltype(base_class_paths_)>();
+  if (auto found = FindBaseClassPath(std::move(type), std::move(base))) {
+    bytes += sizeof(BaseClassPath) +
+             found->path.capacity() * sizeof(found->path.front());
+    path = std::make_shared<BaseClassPath>(std::move(*found));
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  return Insert(kMemberPaths, base_class_paths_, key, std::move(path), bytes);
+}
+
+std::optional<int64_t> TargetCache::LookupVirtualBaseOffset(
+    lldb::SBProcess process, lldb::addr_t vtable_addr, TypeSP base) {
+  auto key = std::make_pair(vtable_addr, GetCanonicalName(base));
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (process.GetUniqueID() != virtual_base_offsets_process_) {
+    return std::nullopt;
+  }
+  auto it = virtual_base_offsets_.find(key);
+  if (it == virtual_base_offsets_.end()) {
+    return std::nullopt;
+  }
+  return Use(it->second);
+}
+
+void TargetCache::InsertVirtualBaseOffset(lldb::SBProcess process,
+                                          lldb::addr_t vtable_addr,
+                                          TypeSP base, int64_t offset) {
+  auto key = std::make_pair(vtable_addr, GetCanonicalName(base));
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The vtables are at other addresses in a new process.
+  if (process.GetUniqueID() != virtual_base_offsets_process_) {
+    usage_[kMemberPaths] -= EraseUsedBefore(virtual_base_offsets_, UINT64_MAX);
+    virtual_base_offsets_process_ = process.GetUniqueID();
+  }
+  Insert(kMemberPaths, virtual_base_offsets_, key, offset,
+         NodeBytes<decltype(virtual_base_offsets_)>());
+}
+
+}  // namespace lldb_eval
@@ -0,0 +1,287 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_TARGET_CACHE_H_
+#define LLDB_EVAL_TARGET_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "lldb-eval/type.h"
+#include "lldb-eval/value.h"
+#include "lldb/API/SBProcess.h"
+#include "lldb/API/SBTarget.h"
+#include "lldb/API/SBType.h"
+#include "lldb/API/SBValue.h"
+#include "lldb/lldb-enumerations.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace lldb_eval {
+
+// Properties of the target architecture. They don't change during the
+// lifetime of the target, so they are computed only once (see
+// `TargetCache::facts()`).
+struct TargetFacts {
+  // Target triple, e.g. "x86_64-unknown-linux-gnu". Empty if the target
+  // doesn't have an executable yet.
+  std::string triple;
+  lldb::ByteOrder byte_order = lldb::eByteOrderInvalid;
+  uint32_t address_byte_size = 0;
+  // Types of "size_t" and "ptrdiff_t".
+  lldb::BasicType size_type = lldb::eBasicTypeUnsignedLong;
+  lldb::BasicType ptrdiff_type = lldb::eBasicTypeLong;
+  // Whether the C++ ABI is the Itanium one (i.e. not MSVC): the dynamic classes
+  // have the vtable pointer at the offset zero, and the offsets of the virtual
+  // bases are stored in the vtables.
+  bool itanium_cxx_abi = true;
+};
+
+// Cache of the lookup results that depend only on the target (i.e. on the
+// debug information of the loaded modules), but not on the scope of the
+// expression. It outlives individual contexts and is shared by all of them.
+// Negative results are cached too (as invalid types/values).
+//
+// The cache is re-created when the number of modules in the target changes.
+// Other changes (e.g. symbols loaded for an existing module) have to be
+// reported by the user (see `InvalidateCaches()` in api.h). The data bound to
+// the process of the target (global variables and the offsets of the virtual
+// bases) is cached for one process at a time and dropped when the process
+// changes, e.g. when it's relaunched. The memory held by the cache can be
+// limited, the least recently used entries are evicted then (see
+// `SetMemoryLimits()`). All methods are thread-safe.
+class TargetCache : public std::enable_shared_from_this<TargetCache> {
+ public:
+  // Enumerators of an enum type keyed by their names, with their values as
+  // returned by `SBTypeEnumMember::GetValueAsUnsigned()`. Some enums have
+  // thousands of enumerators (e.g. the opcodes of an instruction set).
+  struct EnumTable {
+    // The enum type the table is built for.
+    lldb::SBType type;
+    llvm::StringMap<uint64_t> enumerators;
+
+    // Returns the value of the enumerator `name`, if there is one.
+    std::optional<uint64_t> Find(llvm::StringRef name) const;
+  };
+
+  // Global variables with the names starting with a prefix, for the
+  // completion of the identifiers (see `Context::CompleteIdentifier()`).
+  struct GlobalNames {
+    llvm::StringMap<lldb::SBValue> globals;
+    // Keys of `globals` in the lexicographical order.
+    std::vector<llvm::StringRef> sorted_names;
+  };
+
+  // Estimated memory held by the cache in bytes, per kind of the cached data.
+  // Only the data owned by the cache is counted, not the objects LLDB keeps
+  // for the cached handles (e.g. the debug information behind the types).
+  struct MemoryUsage {
+    // Types resolved by name, interned types, enumerators and the layouts of
+    // the smart pointers.
+    size_t types = 0;
+    // Global variables resolved by name and the names for the completion.
+    size_t globals = 0;
+    // Paths to the base classes and the offsets of the virtual bases.
+    size_t member_paths = 0;
+  };
+
+  // Returns the cache for the given target, creating it if necessary.
+  static std::shared_ptr<TargetCache> Get(lldb::SBTarget target);
+
+  // Returns the memory held by the caches of all targets.
+  static MemoryUsage GetTotalMemoryUsage();
+
+  // Sets the limits of the memory held by the cache of each target, zero means
+  // no limit. When a kind of the cached data exceeds its limit, its least
+  // recently used entries are evicted. Applies to the existing caches too.
+  static void SetMemoryLimits(const MemoryUsage& limits);
+
+  // Drops the cache of the given target. Contexts holding a reference to the
+  // old cache can still use it.
+  static void Invalidate(lldb::SBTarget target);
+
+  // Drops the data of the cache of the given target bound to its process,
+  // e.g. when the process exits. The data of the next process is told apart
+  // anyway, this only releases the old data earlier.
+  static void InvalidateProcessData(lldb::SBTarget target);
+
+  // Drops the caches of all targets.
+  static void Clear();
+
+  TargetCache(const TargetCache&) = delete;
+  TargetCache& operator=(const TargetCache&) = delete;
+
+  const TargetFacts& facts() const { return facts_; }
+
+  MemoryUsage GetMemoryUsage();
+
+  // Results of `Context::ResolveTypeByName()`.
+  std::optional<lldb::SBType> LookupType(llvm::StringRef name);
+  void InsertType(llvm::StringRef name, lldb::SBType type);
+
+  // Results of the global/static variable lookup in `process`.
+  std::optional<lldb::SBValue> LookupGlobal(lldb::SBProcess process,
+                                            llvm::StringRef name);
+  void InsertGlobal(lldb::SBProcess process, llvm::StringRef name,
+                    lldb::SBValue value);
+
+  // Results of the global variable lookups by a prefix in `process`. Returns
+  // the names found for the longest cached prefix of `prefix`, so the names
+  // typed one character at a time are looked up only once.
+  std::shared_ptr<const GlobalNames> LookupGlobalNames(lldb::SBProcess process,
+                                                       llvm::StringRef prefix);
+  void InsertGlobalNames(lldb::SBProcess process, llvm::StringRef prefix,
+                         std::shared_ptr<const GlobalNames> names);
+
+  // Returns the unique type object for `type`, so the cached type properties
+  // (see `LLDBType`) are computed only once per target. Invalid types are not
+  // interned.
+  std::shared_ptr<LLDBType> InternType(lldb::SBType type);
+
+  // Returns the enumerators of the enum `type`. They are read from the debug
+  // information on the first call for each enum type.
+  std::shared_ptr<const EnumTable> GetEnumTable(lldb::SBType type);
+
+  // Returns the offset of the raw pointer in the smart pointer `type` (see
+  // `Type::IsSmartPtrType()`), so it can be read without the synthetic
+  // children. The offset is found in the layout of the specialization on the
+  // first call for each type, and isn't set if the layout isn't recognized.
+  std::optional<uint64_t> GetSmartPtrOffset(lldb::SBType type);
+
+  // Returns the path from the record `type` to its base class `base`, null if
+  // it isn't a base. The class hierarchy is walked on the first call for each
+  // pair of the (canonical) types, see `FindBaseClassPath()`.
+  std::shared_ptr<const BaseClassPath> GetBaseClassPath(TypeSP type,
+                                                        TypeSP base);
+
+  // Offsets of the base classes reached via the virtual bases (see
+  // `BaseClassPath::virtual_base`), relative to the subobject with the vtable
+  // at `vtable_addr`. The vtable identifies the most derived type of the
+  // object, so the offset is the same for all the objects sharing it. The
+  // offsets are found by the previous casts and dropped when the process
+  // changes.
+  std::optional<int64_t> LookupVirtualBaseOffset(lldb::SBProcess process,
+                                                 lldb::addr_t vtable_addr,
+                                                 TypeSP base);
+  void InsertVirtualBaseOffset(lldb::SBProcess process,
+                               lldb::addr_t vtable_addr, TypeSP base,
+                               int64_t offset);
+
+ private:
+  // Kinds of the cached data, accounted and limited separately (see
+  // `MemoryUsage`).
+  enum Kind : size_t {
+    kTypes,
+    kGlobals,
+    kMemberPaths,
+    kNumKinds,
+  };
+
+  // Cached value with the bookkeeping of the memory limits.
+  template <typename T>
+  struct Entry {
+    T value;
+    // Estimated size of the entry, including the key.
+    size_t bytes = 0;
+    // Tick of the last use, the entries with the lowest ticks are evicted
+    // first.
+    uint64_t last_use = 0;
+  };
+
+  explicit TargetCache(lldb::SBTarget target);
+
+  // Returns the value of `entry` and marks it as used. Requires `mutex_`.
+  template <typename T>
+  const T& Use(Entry<T>& entry) {
+    entry.last_use = ++tick_;
+    return entry.value;
+  }
+
+  // Inserts the entry unless `map` already has one for `key` (the first
+  // insertion wins), and returns the value of the entry in the map. Evicts
+  // the older entries of `kind` if it exceeds its limit. Requires `mutex_`.
+  template <typename Map, typename Key, typename T>
+  T Insert(Kind kind, Map& map, const Key& key, T value, size_t bytes);
+
+  // Calls `f` with each map holding the data of `kind`.
+  template <typename F>
+  void ForEachMap(Kind kind, F f);
+
+  // Evicts the least recently used entries of `kind` if it exceeds its limit.
+  // The last used entry is never evicted. Requires `mutex_`.
+  void EvictIfNeeded(Kind kind);
+
+  // Drops the global variables if they were cached for a process other than
+  // the one with `process_id`, and records the new process. Requires
+  // `mutex_`.
+  void SetGlobalsProcess(uint32_t process_id);
+
+ private:
+  const TargetFacts facts_;
+
+  // See `SetMemoryLimits()`, indexed by the kinds.
+  static std::atomic<size_t> memory_limits_[kNumKinds];
+
+  std::mutex mutex_;
+  uint64_t tick_ = 0;
+  size_t usage_[kNumKinds] = {};
+
+  // Keyed by the names, which can be looked up without copying them.
+  llvm::StringMap<Entry<lldb::SBType>> types_;
+  // The values are bound to the process with the unique ID `globals_process_`
+  // (zero if there's no process).
+  llvm::StringMap<Entry<lldb::SBValue>> globals_;
+  llvm::StringMap<Entry<std::shared_ptr<const GlobalNames>>> global_names_;
+  uint32_t globals_process_ = 0;
+  // Interned types, bucketed by their names. LLDB keeps the type names in a
+  // pool of unique strings, so the pointers can be used as keys.
+  std::unordered_map<const char*,
+                     Entry<std::vector<std::shared_ptr<LLDBType>>>>
+      interned_types_;
+  // Enumerators of the enum types, bucketed by the (pooled) type names the
+  // same way as the interned types. Distinct enums can have the same name
+  // (e.g. function-local enums), the tables are told apart by their types.
+  std::unordered_map<const char*,
+                     Entry<std::vector<std::shared_ptr<const EnumTable>>>>
+      enum_tables_;
+  // Offsets of the raw pointers in the smart pointers, keyed by the (pooled)
+  // type names.
+  std::unordered_map<const char*, Entry<std::optional<uint64_t>>>
+      smart_ptr_offsets_;
+  // Paths to the base classes (null if the type isn't a base), keyed by the
+  // (pooled) names of the derived and the base types.
+  std::map<std::pair<const char*, const char*>,
+           Entry<std::shared_ptr<const BaseClassPath>>>
+      base_class_paths_;
+  // Offsets of the base classes keyed by the vtable addresses and the (pooled)
+  // names of the bases, valid for the process with the given unique ID.
+  std::map<std::pair<lldb::addr_t, const char*>, Entry<int64_t>>
+      virtual_base_offsets_;
+  uint32_t virtual_base_offsets_process_ = 0;
+};
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_TARGET_CACHE_H_
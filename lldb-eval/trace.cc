@@ -0,0 +1,173 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lldb-eval/trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "lldb-eval/api.h"
+#include "llvm/Support/FormatVariadic.h"
+
+namespace lldb_eval {
+
+namespace {
+
+thread_local TraceSink* current_sink = nullptr;
+std::atomic<TraceSink*> global_sink{nullptr};
+
+// Small sequential ids of the threads reporting the events, easier to tell
+// apart in the trace viewers than the native thread ids.
+uint32_t CurrentThreadId() {
+  static std::atomic<uint32_t> next_id{1};
+  thread_local uint32_t id = next_id++;
+  return id;
+}
+
+// Appends `str` escaped as a JSON string (without the quotes) to `out`.
+void AppendJsonEscaped(std::string& out, const std::string& str) {
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x",
+                        static_cast<unsigned>(c));
+          out += escaped;
+        } else {
+          out += c;
+        }
+    }
+  }
+}
+
+}  // namespace
+
+TraceScope::TraceScope(TraceSink* sink) {
+  if (current_sink || !sink) {
+    return;
+  }
+  is_active_ = true;
+  current_sink = sink;
+}
+
+TraceScope::~TraceScope() {
+  if (is_active_) {
+    current_sink = nullptr;
+  }
+}
+
+TraceSink* TraceScope::Current() {
+  if (current_sink) {
+    return current_sink;
+  }
+  return global_sink.load(std::memory_order_relaxed);
+}
+
+void TraceEvent::Finish() {
+  auto end = std::chrono::steady_clock::now();
+  sink_->AddEvent(name_, detail_,
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      start_.time_since_epoch()),
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      end - start_),
+                  CurrentThreadId());
+}
+
+class ChromeTraceSink::Writer {
+ public:
+  explicit Writer(std::FILE* file)
+      : file_(file), start_(std::chrono::steady_clock::now()) {
+    std::fputs("[\n", file_);
+  }
+
+  ~Writer() {
+    std::fputs("\n]\n", file_);
+    std::fclose(file_);
+  }
+
+  void Write(const char* name, const std::string& detail,
+             std::chrono::nanoseconds begin, std::chrono::nanoseconds duration,
+             uint32_t thread_id) {
+    // The timestamps are in microseconds since the sink was created.
+    double ts = static_cast<double>(
+                    (begin - start_.time_since_epoch()).count()) /
+                1000;
+    std::string event = llvm::formatv(
+        "{{\"name\":\"{0}\",\"cat\":\"lldb-eval\",\"ph\":\"X\",\"ts\":{1:f3},"
+        "\"dur\":{2:f3},\"pid\":1,\"tid\":{3}",
+        name, ts, static_cast<double>(duration.count()) / 1000, thread_id);
+    if (!detail.empty()) {
+      event += ",\"args\":{\"detail\":\"";
+      AppendJsonEscaped(event, detail);
+      event += "\"}";
+    }
+    event += "}";
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (num_events_++ > 0) {
+      std::fputs(",\n", file_);
+    }
+    std::fputs(event.c_str(), file_);
+  }
+
+ private:
+  std::mutex mutex_;
+  std::FILE* file_;
+  std::chrono::steady_clock::time_point start_;
+  uint64_t num_events_ = 0;
+};
+
+std::unique_ptr<ChromeTraceSink> ChromeTraceSink::Create(
+    const std::string& path) {
+  std::FILE* file = std::fopen(path.c_str(), "w");
+  if (!file) {
+    return nullptr;
+  }
+  return std::unique_ptr<ChromeTraceSink>(
+      new ChromeTraceSink(std::make_unique<Writer>(file)));
+}
+
+ChromeTraceSink::ChromeTraceSink(std::unique_ptr<Writer> writer)
+    : writer_(std::move(writer)) {}
+
+ChromeTraceSink::~ChromeTraceSink() = default;
+
+void ChromeTraceSink::AddEvent(const char* name, const std::string& detail,
+                               std::chrono::nanoseconds begin,
+                               std::chrono::nanoseconds duration,
+                               uint32_t thread_id) {
+  writer_->Write(name, detail, begin, duration, thread_id);
+}
+
+void SetTraceSink(TraceSink* sink) { global_sink = sink; }
+
+}  // namespace lldb_eval
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LLDB_EVAL_TRACE_H_
+#define LLDB_EVAL_TRACE_H_
+
+#include <chrono>
+#include <string>
+#include <utility>
+
+#include "lldb-eval/api.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace lldb_eval {
+
+// Trace events are reported the same way as the stats are collected: the API
+// call sets up a `TraceScope` with the sink of its options and the code deep
+// down the call stack reports the events to the sink of the current thread.
+
+// Sets up the trace sink of the API call on the current thread. Nested scopes
+// (and the scopes without a sink) do nothing, the events are reported to the
+// sink of the outermost one, or to the global sink (see `SetTraceSink()`).
+class TraceScope {
+ public:
+  explicit TraceScope(TraceSink* sink);
+  ~TraceScope();
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  // Returns the sink of the current thread, or null if the events are not
+  // traced.
+  static TraceSink* Current();
+
+ private:
+  bool is_active_ = false;
+};
+
+// Reports the wall time of the enclosing block as a trace event named `name`,
+// which must be a string literal. The clock isn't read and the detail isn't
+// copied if the events are not traced.
+class TraceEvent {
+ public:
+  explicit TraceEvent(const char* name, llvm::StringRef detail = {})
+      : sink_(TraceScope::Current()) {
+    if (sink_) {
+      name_ = name;
+      detail_ = detail.str();
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~TraceEvent() {
+    if (sink_) {
+      Finish();
+    }
+  }
+
+  TraceEvent(const TraceEvent&) = delete;
+  TraceEvent& operator=(const TraceEvent&) = delete;
+
+  bool enabled() const { return sink_ != nullptr; }
+
+  // Sets the detail of the event, for the details that are expensive to
+  // compute. Only called if `enabled()`.
+  void SetDetail(std::string detail) { detail_ = std::move(detail); }
+
+ private:
+  void Finish();
+
+ private:
+  TraceSink* sink_;
+  const char* name_ = nullptr;
+  std::string detail_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace lldb_eval
+
+#endif  // LLDB_EVAL_TRACE_H_
@@ -1,5 +1,7 @@
 #include "lldb-eval/type.h"
 
+#include <algorithm>
+
 #include "lldb-eval/traits.h"
 #include "lldb/lldb-enumerations.h"
 #include "llvm/Support/FormatAdapters.h"
@@ -114,8 +116,133 @@ bool Type::IsContextuallyConvertibleToBool() {
          IsArrayType();
 }
 
-bool CompareTypes(TypeSP lhs, TypeSP rhs) {
-  if (&lhs == &rhs) {
+static uint32_t GetNumberOfNonEmptyBaseClasses(Type& type) {
+  // Go through the base classes and count non-empty ones.
+  uint32_t ret = 0;
+  uint32_t num_direct_bases = type.GetNumberOfDirectBaseClasses();
+
+  for (uint32_t i = 0; i < num_direct_bases; ++i) {
+    TypeSP base_type = type.GetDirectBaseClassAtIndex(i).type;
+    if (base_type->GetNumberOfFields() > 0 ||
+        GetNumberOfNonEmptyBaseClasses(*base_type) > 0) {
+      ret += 1;
+    }
+  }
+  return ret;
+}
+
+static void SortMemberNames(Type::MemberIndex& index) {
+  index.sorted_names.reserve(index.members.size());
+  for (const auto& member : index.members) {
+    index.sorted_names.push_back(member.getKey());
+  }
+  std::sort(index.sorted_names.begin(), index.sorted_names.end());
+}
+
+std::shared_ptr<const Type::MemberIndex> Type::GetMemberIndex() {
+  auto index = std::make_shared<MemberIndex>();
+
+  // Adds the members of an anonymous field or a base class, which is the
+  // `idx`-th child of this type located at `offset` (if it's known). The names
+  // already in the index take precedence, since they were found earlier.
+  auto add_nested = [&index](const MemberIndex& nested, uint32_t idx,
+                             std::optional<uint64_t> offset) {
+    for (const auto& nested_entry : nested.members) {
+      llvm::StringRef name = nested_entry.getKey();
+      const MemberIndex::Entry& entry = nested_entry.getValue();
+      if (index->members.count(name) > 0) {
+        continue;
+      }
+      std::vector<uint32_t> path;
+      path.reserve(entry.path.size() + 1);
+      path.push_back(idx);
+      path.insert(path.end(), entry.path.begin(), entry.path.end());
+      std::optional<uint64_t> member_offset;
+      if (offset && entry.offset) {
+        member_offset = *offset + *entry.offset;
+      }
+      index->members.try_emplace(
+          name, MemberIndex::Entry{entry.member, path, member_offset});
+    }
+  };
+
+  // Go through the fields first. Direct base classes are located before
+  // fields, so field members needs to be offset by the number of base classes.
+  uint32_t num_fields = GetNumberOfFields();
+  uint32_t fields_offset =
+      num_fields > 0 ? GetNumberOfNonEmptyBaseClasses(*this) : 0;
+  for (uint32_t i = 0; i < num_fields; ++i) {
+    MemberInfo field = GetFieldAtIndex(i);
+    if (field.name) {
+      std::optional<uint64_t> offset;
+      if (!field.is_bitfield && !field.type->IsReferenceType()) {
+        offset = field.offset_in_bytes;
+      }
+      index->members.try_emplace(
+          *field.name, MemberIndex::Entry{field, {i + fields_offset}, offset});
+    } else if (field.type->IsAnonymousType()) {
+      // Every member of an anonymous struct is considered to be a member of
+      // the enclosing struct or union. This applies recursively if the
+      // enclosing struct or union is also anonymous.
+      //
+      //  struct S {
+      //    struct {
+      //      int x;
+      //    };
+      //  } s;
+      //
+      //  s.x = 1;
+      add_nested(*field.type->GetMemberIndex(), i + fields_offset,
+                 field.offset_in_bytes);
+    }
+    // Otherwise it's a padding field, which can't be accessed.
+  }
+
+  // LLDB can't access inherited fields of anonymous struct members.
+  if (IsAnonymousType()) {
+    SortMemberNames(*index);
+    return index;
+  }
+
+  // Go through the base classes and look for the members there. Offsets of the
+  // virtual bases depend on the most derived type. The base classes don't
+  // tell whether they are virtual, so don't use the offsets if there are any.
+  bool has_virtual_bases = GetNumberOfVirtualBaseClasses() > 0;
+  uint32_t num_non_empty_bases = 0;
+  uint32_t num_direct_bases = GetNumberOfDirectBaseClasses();
+  for (uint32_t i = 0; i < num_direct_bases; ++i) {
+    BaseInfo base_info = GetDirectBaseClassAtIndex(i);
+    TypeSP base = base_info.type;
+    std::optional<uint64_t> base_offset;
+    if (!has_virtual_bases) {
+      base_offset = base_info.offset;
+    }
+    add_nested(*base->GetMemberIndex(), num_non_empty_bases, base_offset);
+    if (base->GetNumberOfFields() > 0) {
+      num_non_empty_bases += 1;
+    }
+  }
+
+  SortMemberNames(*index);
+  return index;
+}
+
+llvm::ArrayRef<llvm::StringRef> FindNamesWithPrefix(
+    llvm::ArrayRef<llvm::StringRef> sorted_names, llvm::StringRef prefix) {
+  // The names starting with `prefix` are contiguous and not less than it.
+  auto begin = std::lower_bound(sorted_names.begin(), sorted_names.end(),
+                                prefix);
+  auto end = std::partition_point(
+      begin, sorted_names.end(),
+      [prefix](llvm::StringRef name) { return name.startswith(prefix); });
+  return llvm::makeArrayRef(begin, end);
+}
+
+bool CompareTypes(const TypeSP& lhs, const TypeSP& rhs) {
+  // Interned types are unique, so usually the same type is the same object.
+  // Not all types are interned though (e.g. types of the values created during
+  // the evaluation), so fallback to the full comparison.
+  if (lhs == rhs) {
     return true;
   }
 
@@ -162,4 +289,70 @@ bool GetPathToBaseType(TypeSP type, TypeSP target_base,
   return false;
 }
 
+// Direct base class on the path to a base, see `FindBaseSteps()`.
+struct BaseStep {
+  TypeSP type;
+  Type::BaseInfo base;
+  uint32_t child_index;
+};
+
+// Same as `GetPathToBaseType()`, but stores the steps of the path (in the
+// reverse order).
+static bool FindBaseSteps(TypeSP type, const TypeSP& target_base,
+                          std::vector<BaseStep>& steps) {
+  if (CompareTypes(type, target_base)) {
+    return true;
+  }
+
+  uint32_t num_non_empty_bases = 0;
+  uint32_t num_direct_bases = type->GetNumberOfDirectBaseClasses();
+  for (uint32_t i = 0; i < num_direct_bases; ++i) {
+    auto member = type->GetDirectBaseClassAtIndex(i);
+    if (FindBaseSteps(member.type, target_base, steps)) {
+      steps.push_back({type, member, num_non_empty_bases});
+      return true;
+    }
+    if (member.type->GetNumberOfFields() > 0) {
+      num_non_empty_bases++;
+    }
+  }
+
+  return false;
+}
+
+// The direct base classes don't tell whether they are virtual, but the virtual
+// ones are listed among all the virtual bases of the type.
+static bool IsVirtualBaseOf(Type& type, const TypeSP& base) {
+  uint32_t num_virtual_bases = type.GetNumberOfVirtualBaseClasses();
+  for (uint32_t i = 0; i < num_virtual_bases; ++i) {
+    if (CompareTypes(type.GetVirtualBaseClassAtIndex(i), base)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::optional<BaseClassPath> FindBaseClassPath(TypeSP type,
+                                               TypeSP target_base) {
+  std::vector<BaseStep> steps;
+  if (!FindBaseSteps(type, target_base, steps)) {
+    return std::nullopt;
+  }
+
+  BaseClassPath ret;
+  ret.path.reserve(steps.size());
+  for (auto it = steps.rbegin(); it != steps.rend(); ++it) {
+    ret.path.push_back(it->child_index);
+    if (ret.virtual_base) {
+      continue;
+    }
+    if (IsVirtualBaseOf(*it->type, it->base.type)) {
+      ret.virtual_base = it->base.type;
+    } else {
+      ret.offset += it->base.offset;
+    }
+  }
+  return ret;
+}
+
 }  // namespace lldb_eval
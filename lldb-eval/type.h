@@ -3,10 +3,14 @@
 
 #include <cstdint>
 #include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
 #include "lldb/lldb-enumerations.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 
 namespace lldb_eval {
@@ -56,10 +60,34 @@ class Type {
     TypeSP type;
     bool is_bitfield;
     uint32_t bitfield_size_in_bits;
+    // Offset of the field in the enclosing record.
+    uint64_t offset_in_bytes;
 
     explicit operator bool() const { return type->IsValid(); }
   };
   virtual MemberInfo GetFieldAtIndex(uint32_t) = 0;
+
+  // Members of the record type accessible by name: the fields, the members of
+  // the anonymous fields and the members of the base classes. Maps the name to
+  // the member and the index path to it (see `ParserContext::GetMemberInfo()`).
+  // If the name is ambiguous, the member found first by the lookup order
+  // (fields before base classes, in the declaration order) is kept.
+  struct MemberIndex {
+    struct Entry {
+      MemberInfo member;
+      std::vector<uint32_t> path;
+      // Offset of the member from the start of the record. Not set if the
+      // member can't be accessed by its address: bitfields, references and
+      // members of the virtual base classes.
+      std::optional<uint64_t> offset;
+    };
+    llvm::StringMap<Entry> members;
+    // Names of the members in the lexicographical order, for the prefix
+    // searches (see `FindNamesWithPrefix()`). Refer to the keys of `members`.
+    std::vector<llvm::StringRef> sorted_names;
+  };
+  // Builds the index on every call, implementations are expected to cache it.
+  virtual std::shared_ptr<const MemberIndex> GetMemberIndex();
   virtual bool IsValid() const = 0;
   virtual bool CompareTo(TypeSP) = 0;
 
@@ -69,7 +97,7 @@ class Type {
   bool IsInteger();
   bool IsFloat();
   bool IsPointerToVoid();
-  bool IsSmartPtrType();
+  virtual bool IsSmartPtrType();
   bool IsNullPtrType();
   bool IsSigned();
   bool IsEnum();
@@ -81,7 +109,13 @@ class Type {
   bool IsContextuallyConvertibleToBool();
 };
 
-bool CompareTypes(TypeSP lhs, TypeSP rhs);
+bool CompareTypes(const TypeSP& lhs, const TypeSP& rhs);
+
+// Returns the names starting with `prefix`, `sorted_names` must be sorted in
+// the lexicographical order.
+llvm::ArrayRef<llvm::StringRef> FindNamesWithPrefix(
+    llvm::ArrayRef<llvm::StringRef> sorted_names, llvm::StringRef prefix);
+
 std::string TypeDescription(TypeSP type);
 
 // Checks whether `target_base` is a direct or indirect base of `type`.
@@ -90,6 +124,27 @@ std::string TypeDescription(TypeSP type);
 bool GetPathToBaseType(TypeSP type, TypeSP target_base,
                        std::vector<uint32_t>* path, uint64_t* offset);
 
+// Path from a record type to its direct or indirect base class, see
+// `FindBaseClassPath()`.
+struct BaseClassPath {
+  // Indices of the direct base classes on the path from the derived type to the
+  // base, as the children of the values (same as `GetPathToBaseType()`).
+  std::vector<uint32_t> path;
+  // First virtual base class on the path, null if there is none.
+  TypeSP virtual_base;
+  // Offset of the base class in the derived type if there are no virtual bases
+  // on the path. Otherwise the offset of the subobject inheriting
+  // `virtual_base`, the offset of the base relative to it depends on the most
+  // derived type of the object.
+  uint64_t offset = 0;
+};
+
+// Returns the path from `type` to `target_base`, or nothing if `target_base`
+// isn't a base of `type`. Walks the class hierarchy on every call, the results
+// are cached by `TargetCache::GetBaseClassPath()`.
+std::optional<BaseClassPath> FindBaseClassPath(TypeSP type,
+                                               TypeSP target_base);
+
 }  // namespace lldb_eval
 
 #endif  // LLDB_EVAL_TYPE_H_
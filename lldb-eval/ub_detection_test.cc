@@ -15,6 +15,7 @@
 #include <ostream>
 #include <string>
 
+#include "lldb-eval/constant_folding.h"
 #include "lldb-eval/context.h"
 #include "lldb-eval/eval.h"
 #include "lldb-eval/parser.h"
@@ -64,19 +65,13 @@ std::ostream& operator<<(std::ostream& os, UbStatus status) {
 
 class UbDetectionTest : public ::testing::Test {
  protected:
+  // All test cases stop at the same line and don't modify the debuggee, so
+  // they share one long-lived process.
   static void SetUpTestSuite() {
     runfiles_ = Runfiles::CreateForTest();
     lldb_eval::SetupLLDBServerEnv(*runfiles_);
     lldb::SBDebugger::Initialize();
-  }
-
-  static void TearDownTestSuite() {
-    lldb::SBDebugger::Terminate();
-    delete runfiles_;
-    runfiles_ = nullptr;
-  }
 
-  void SetUp() {
     std::string break_line = "// BREAK HERE";
 
     auto binary_path =
@@ -87,15 +82,20 @@ class UbDetectionTest : public ::testing::Test {
     debugger_ = lldb::SBDebugger::Create(false);
     process_ = lldb_eval::LaunchTestProgram(debugger_, source_path, binary_path,
                                             break_line);
-    frame_ = process_.GetSelectedThread().GetSelectedFrame();
   }
 
-  void TearDown() {
+  static void TearDownTestSuite() {
     process_.Destroy();
+    process_ = lldb::SBProcess();
     lldb::SBDebugger::Destroy(debugger_);
+    lldb::SBDebugger::Terminate();
+    delete runfiles_;
+    runfiles_ = nullptr;
   }
 
-  UbStatus GetUbStatus(const std::string& expr) {
+  void SetUp() { frame_ = process_.GetSelectedThread().GetSelectedFrame(); }
+
+  UbStatus GetUbStatus(const std::string& expr, bool fold_constants = false) {
     auto sm = lldb_eval::SourceManager::Create(expr);
     auto ctx = lldb_eval::Context::Create(sm, frame_);
 
@@ -105,7 +105,12 @@ class UbDetectionTest : public ::testing::Test {
 
     assert(!err && "Error while parsing expression!");
 
+    if (fold_constants) {
+      lldb_eval::FoldConstants(tree, process_.GetTarget(), sm);
+    }
+
     lldb_eval::Interpreter eval(process_.GetTarget(), sm);
+    eval.SetFrame(frame_);
     lldb_eval::Value ret = eval.Eval(tree.get(), err);
 
     assert(!err && "Error while evaluating expression!");
@@ -114,14 +119,16 @@ class UbDetectionTest : public ::testing::Test {
   }
 
  protected:
-  lldb::SBDebugger debugger_;
-  lldb::SBProcess process_;
   lldb::SBFrame frame_;
 
   static Runfiles* runfiles_;
+  static lldb::SBDebugger debugger_;
+  static lldb::SBProcess process_;
 };
 
 Runfiles* UbDetectionTest::runfiles_ = nullptr;
+lldb::SBDebugger UbDetectionTest::debugger_;
+lldb::SBProcess UbDetectionTest::process_;
 
 TEST_F(UbDetectionTest, TestDivisionByZero) {
   EXPECT_EQ(GetUbStatus("1 / 0"), UbStatus::kDivisionByZero);
@@ -341,4 +348,21 @@ TEST_F(UbDetectionTest, TestInvalidPtrDiff) {
   EXPECT_EQ(GetUbStatus("(int*)7 - (int*)6"), UbStatus::kOk);
 }
 
+TEST_F(UbDetectionTest, TestConstantFolding) {
+  // Constant subexpressions with UB are not folded.
+  EXPECT_EQ(GetUbStatus("(1 + 1) / (2 - 2)", true), UbStatus::kDivisionByZero);
+  EXPECT_EQ(GetUbStatus("sizeof(int) % 0 + 1", true),
+            UbStatus::kDivisionByZero);
+  EXPECT_EQ(GetUbStatus("(-2147483647 -1) / -1", true),
+            UbStatus::kDivisionByMinusOne);
+  EXPECT_EQ(GetUbStatus("(int)2147483648.0 + 1", true),
+            UbStatus::kInvalidCast);
+  EXPECT_EQ(GetUbStatus("1 << (30 + 2)", true), UbStatus::kInvalidShift);
+  EXPECT_EQ(GetUbStatus("(int*)0 + (1 + 1)", true),
+            UbStatus::kNullptrArithmetic);
+
+  EXPECT_EQ(GetUbStatus("(1 + 1) / (2 - 1)", true), UbStatus::kOk);
+  EXPECT_EQ(GetUbStatus("1 / (i - 1)", true), UbStatus::kDivisionByZero);
+}
+
 // TODO: Add tests with composite assignments (e.g. `i /= 0`, `i -= fmax`).
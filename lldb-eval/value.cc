@@ -15,14 +15,25 @@
 #include "lldb-eval/value.h"
 
 #include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
 
 #include "lldb-eval/context.h"
 #include "lldb-eval/defines.h"
+#include "lldb-eval/memory_cache.h"
+#include "lldb-eval/stats.h"
+#include "lldb-eval/target_cache.h"
 #include "lldb-eval/traits.h"
+#include "lldb/API/SBData.h"
 #include "lldb/API/SBTarget.h"
 #include "lldb/API/SBType.h"
 #include "lldb/API/SBValue.h"
+#include "lldb/lldb-defines.h"
 #include "lldb/lldb-enumerations.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Regex.h"
 
 namespace lldb_eval {
@@ -88,10 +99,7 @@ bool LLDBType::IsEnumerationIntegerTypeSigned() {
 }
 
 bool LLDBType::CompareTo(TypeSP other) {
-  auto rhs = ToSBType(other);
-  if (type_ == rhs) {
-    return true;
-  }
+  auto& rhs = static_cast<LLDBType&>(*other);
 
   // Comparing two lldb::SBType doesn't always work reliably:
   // https://github.com/google/lldb-eval/blob/master/docs/lldb-bugs.md#comparing-lldbsbtype-objects-representing-the-same-type-doesnt-always-work
@@ -102,9 +110,173 @@ bool LLDBType::CompareTo(TypeSP other) {
   // Note that `GetCanonicalType()` and `GetUnqualifiedType()` fully
   // canonizes and removes qualifiers from the type, e.g. "int **" and
   // "int const * const * const" will be matched as the same type.
-  const char* name = type_.GetCanonicalType().GetUnqualifiedType().GetName();
-  const char* rhs_name = rhs.GetCanonicalType().GetUnqualifiedType().GetName();
-  return name == rhs_name;
+  if (properties().canonical_unqualified_name ==
+      rhs.properties().canonical_unqualified_name) {
+    return true;
+  }
+  return type_ == rhs.type_;
+}
+
+const LLDBType::Properties& LLDBType::properties() {
+  std::call_once(properties_once_, [this] {
+    lldb::SBType canonical = type_.GetCanonicalType();
+    properties_.type_flags = type_.GetTypeFlags();
+    properties_.byte_size = type_.GetByteSize();
+    properties_.basic_type = type_.GetBasicType();
+    properties_.type_class = type_.GetTypeClass();
+    properties_.is_smart_ptr = Type::IsSmartPtrType();
+    properties_.canonical_unqualified_name =
+        canonical.GetUnqualifiedType().GetName();
+  });
+  return properties_;
+}
+
+TypeSP LLDBType::GetCanonicalType() {
+  std::call_once(canonical_once_, [this] {
+    lldb::SBType canonical = type_.GetCanonicalType();
+    if (!(canonical == type_)) {
+      canonical_ = Wrap(canonical);
+    }
+  });
+  if (canonical_) {
+    return canonical_;
+  }
+  return shared_from_this();
+}
+
+std::shared_ptr<const Type::MemberIndex> LLDBType::GetMemberIndex() {
+  // Typedefs and qualifiers don't change the members, so the index is built
+  // only for the canonical unqualified type. Interned types are shared by all
+  // contexts of the target, and so is the index.
+  if (properties().canonical_unqualified_name != type_.GetName()) {
+    lldb::SBType canonical = type_.GetCanonicalType().GetUnqualifiedType();
+    return Wrap(canonical)->GetMemberIndex();
+  }
+  std::call_once(member_index_once_,
+                 [this] { member_index_ = Type::GetMemberIndex(); });
+  return member_index_;
+}
+
+TypeSP LLDBType::Wrap(lldb::SBType type) {
+  if (auto cache = cache_.lock()) {
+    return cache->InternType(type);
+  }
+  return CreateSP(type);
+}
+
+Value Value::CreateScalar(lldb::SBTarget target, lldb::SBType type,
+                          llvm::APInt bytes) {
+  Value ret;
+  ret.type_ = LLDBType::CreateSP(type);
+  assert(bytes.getBitWidth() == ret.type_->GetByteSize() * CHAR_BIT &&
+         "illegal argument: value should be of the same size as the type");
+  ret.is_inline_ = true;
+  ret.has_scalar_ = true;
+  ret.scalar_ = std::move(bytes);
+  ret.target_ = std::move(target);
+  return ret;
+}
+
+static bool CanBeStoredInline(lldb::SBType type);
+
+// Reads the scalar of type `type` located at `addr` via the `cache`.
+static std::optional<llvm::APInt> ReadScalar(lldb::addr_t addr, Type& type,
+                                             MemoryCache& cache) {
+  uint64_t byte_size = type.GetByteSize();
+  llvm::SmallVector<uint64_t, 2> words((byte_size + 7) / 8, 0);
+  if (!cache.Read(addr, words.data(), byte_size)) {
+    return {};
+  }
+  llvm::APInt ret(static_cast<unsigned>(byte_size * CHAR_BIT), words);
+  if (type.IsBool()) {
+    // Same as reading the value via lldb::SBValue, see `GetValueAsUnsigned()`.
+    ret = ret.getBoolValue() ? 1 : 0;
+  }
+  return ret;
+}
+
+Value Value::CreateFromMemory(lldb::SBValue value, MemoryCache& cache) {
+  Value ret(value);
+  lldb::SBType type = ToSBType(ret.type_);
+  if (!CanBeStoredInline(type)) {
+    return ret;
+  }
+  lldb::addr_t addr = value.GetLoadAddress();
+  if (addr == LLDB_INVALID_ADDRESS) {
+    // E.g. the value is in a register.
+    return ret;
+  }
+
+  std::optional<llvm::APInt> scalar = ReadScalar(addr, *ret.type_, cache);
+  if (!scalar) {
+    return ret;
+  }
+  ret.scalar_ = std::move(*scalar);
+  ret.has_scalar_ = true;
+  ret.target_ = value.GetTarget();
+  return ret;
+}
+
+Value Value::CreateFromAddress(lldb::SBTarget target, lldb::addr_t addr,
+                               TypeSP type, MemoryCache& cache) {
+  Value ret;
+  ret.type_ = std::static_pointer_cast<LLDBType>(type);
+  ret.target_ = std::move(target);
+  ret.has_address_ = true;
+  ret.address_ = addr;
+  if (!CanBeStoredInline(ToSBType(type))) {
+    return ret;
+  }
+  // If the memory can't be read, the value is materialized on the first use
+  // and reports the error the same way as any other value.
+  std::optional<llvm::APInt> scalar = ReadScalar(addr, *type, cache);
+  if (scalar) {
+    ret.scalar_ = std::move(*scalar);
+    ret.has_scalar_ = true;
+  }
+  return ret;
+}
+
+Value Value::CreateFromRegister(lldb::SBValue value, llvm::APInt contents) {
+  Value ret(value);
+  assert(contents.getBitWidth() == ret.type_->GetByteSize() * CHAR_BIT &&
+         "illegal argument: contents should be of the same size as the type");
+  ret.scalar_ = std::move(contents);
+  ret.has_scalar_ = true;
+  ret.target_ = value.GetTarget();
+  return ret;
+}
+
+lldb::addr_t Value::GetLoadAddress() const {
+  if (has_address_) {
+    return address_;
+  }
+  if (is_inline_) {
+    return LLDB_INVALID_ADDRESS;
+  }
+  return value_.GetLoadAddress();
+}
+
+lldb::SBValue Value::inner_value() const {
+  if (has_address_ && !value_.IsValid()) {
+    // Same as dereferencing the pointer to the value.
+    value_ = CreateValueFromPointer(target_, address_,
+                                    ToSBType(type_->GetPointerType()))
+                 .inner_value()
+                 .Dereference();
+  }
+  if (is_inline_ && !value_.IsValid()) {
+    lldb::SBError ignore;
+    lldb::SBData data;
+    data.SetData(ignore, scalar_.getRawData(), type_->GetByteSize(),
+                 target_.GetByteOrder(),
+                 static_cast<uint8_t>(target_.GetAddressByteSize()));
+    // Force static value, otherwise we can end up with the "real" type.
+    CountStat(&EvaluationStats::create_value_from_data_calls);
+    value_ = target_.CreateValueFromData("$result", data, ToSBType(type_))
+                 .GetStaticValue();
+  }
+  return value_;
 }
 
 bool Value::IsScalar() { return type_->IsScalar(); }
@@ -142,41 +314,74 @@ bool Value::GetBool() {
 }
 
 uint64_t Value::GetUInt64() {
+  if (has_scalar_) {
+    return static_cast<uint64_t>(GetValueAsSigned());
+  }
   // GetValueAsUnsigned performs overflow according to the underlying type. For
   // example, if the underlying type is `int32_t` and the value is `-1`,
   // GetValueAsUnsigned will return 4294967295.
-  return IsSigned() ? value_.GetValueAsSigned() : GetValueAsUnsigned(value_);
+  lldb::SBValue value = inner_value();
+  return IsSigned() ? value.GetValueAsSigned() : GetValueAsUnsigned(value);
 }
 
-int64_t Value::GetValueAsSigned() { return value_.GetValueAsSigned(); }
+int64_t Value::GetValueAsSigned() {
+  if (has_scalar_) {
+    // Same as lldb::SBValue::GetValueAsSigned(), the value is extended
+    // according to the signedness of its type.
+    llvm::APInt v =
+        IsSigned() ? scalar_.sextOrTrunc(64) : scalar_.zextOrTrunc(64);
+    return static_cast<int64_t>(v.getZExtValue());
+  }
+  return inner_value().GetValueAsSigned();
+}
 
-Value Value::AddressOf() { return Value(value_.AddressOf()); }
+Value Value::AddressOf() {
+  if (has_address_) {
+    return CreateValueFromPointer(target_, address_,
+                                  ToSBType(type_->GetPointerType()));
+  }
+  return Value(inner_value().AddressOf());
+}
 
-Value Value::Dereference() { return Value(value_.Dereference()); }
+Value Value::Dereference() { return Value(inner_value().Dereference()); }
 
 llvm::APSInt Value::GetInteger() {
-  unsigned bit_width = static_cast<unsigned>(type_->GetByteSize() * CHAR_BIT);
-  uint64_t value = GetValueAsUnsigned(value_);
   bool is_signed = IsSigned();
+  if (has_scalar_) {
+    return llvm::APSInt(scalar_, !is_signed);
+  }
+
+  unsigned bit_width = static_cast<unsigned>(type_->GetByteSize() * CHAR_BIT);
+  lldb::SBValue inner = inner_value();
+  uint64_t value = GetValueAsUnsigned(inner);
 
   return llvm::APSInt(llvm::APInt(bit_width, value, is_signed), !is_signed);
 }
 
 llvm::APFloat Value::GetFloat() {
   lldb::BasicType basic_type = type_->GetCanonicalType()->GetBasicType();
-  lldb::SBError ignore;
+
+  // Reads the raw bytes of the value into `v`.
+  auto read = [this](void* v, size_t size) {
+    if (has_scalar_) {
+      memcpy(v, scalar_.getRawData(), size);
+    } else {
+      lldb::SBError ignore;
+      inner_value().GetData().ReadRawData(ignore, 0, v, size);
+    }
+  };
 
   switch (basic_type) {
     case lldb::eBasicTypeFloat: {
       float v = 0;
-      value_.GetData().ReadRawData(ignore, 0, &v, sizeof(float));
+      read(&v, sizeof(float));
       return llvm::APFloat(v);
     }
     case lldb::eBasicTypeDouble:
       // No way to get more precision at the moment.
     case lldb::eBasicTypeLongDouble: {
       double v = 0;
-      value_.GetData().ReadRawData(ignore, 0, &v, sizeof(double));
+      read(&v, sizeof(double));
       return llvm::APFloat(v);
     }
     default:
@@ -185,11 +390,16 @@ llvm::APFloat Value::GetFloat() {
 }
 
 Value Value::Clone() {
-  lldb::SBData data = value_.GetData();
+  if (has_scalar_) {
+    return CreateScalar(target_, ToSBType(type_), scalar_);
+  }
+
+  lldb::SBValue value = inner_value();
+  lldb::SBData data = value.GetData();
   lldb::SBError ignore;
   auto raw_data = std::make_unique<uint8_t[]>(data.GetByteSize());
   data.ReadRawData(ignore, 0, raw_data.get(), data.GetByteSize());
-  return CreateValueFromBytes(value_.GetTarget(), raw_data.get(),
+  return CreateValueFromBytes(value.GetTarget(), raw_data.get(),
                               ToSBType(type_));
 }
 
@@ -197,13 +407,23 @@ void Value::Update(const llvm::APInt& v) {
   assert(v.getBitWidth() == type_->GetByteSize() * CHAR_BIT &&
          "illegal argument: new value should be of the same size");
 
+  if (is_inline_) {
+    scalar_ = v;
+    // Drop the materialized value, it will be re-created when needed.
+    value_ = lldb::SBValue();
+    return;
+  }
+
   lldb::SBData data;
   lldb::SBError ignore;
-  lldb::SBTarget target = value_.GetTarget();
+  lldb::SBValue value = inner_value();
+  lldb::SBTarget target = value.GetTarget();
   data.SetData(ignore, v.getRawData(), type_->GetByteSize(),
                target.GetByteOrder(),
                static_cast<uint8_t>(target.GetAddressByteSize()));
-  value_.SetData(data, ignore);
+  value.SetData(data, ignore);
+  // The contents read from memory are stale now.
+  has_scalar_ = false;
 }
 
 void Value::Update(Value v) {
@@ -380,15 +600,39 @@ Value CastFloatToEnumType(lldb::SBTarget target, Value val, TypeSP type,
   return CreateValueFromAPInt(target, integer, ToSBType(type));
 }
 
+// Returns true if the values of the given type can be stored inline (see
+// `Value::CreateScalar()`).
+static bool CanBeStoredInline(lldb::SBType type) {
+  uint32_t flags = type.GetTypeFlags();
+  if (flags & (lldb::eTypeIsVector | lldb::eTypeIsReference)) {
+    return false;
+  }
+  return type.GetByteSize() > 0 &&
+         ((flags & (lldb::eTypeIsScalar | lldb::eTypeIsEnumeration |
+                    lldb::eTypeIsPointer)) ||
+          type.GetCanonicalType().GetBasicType() == lldb::eBasicTypeNullPtr);
+}
+
 Value CreateValueFromBytes(lldb::SBTarget target, const void* bytes,
                            lldb::SBType type) {
+  uint64_t byte_size = type.GetByteSize();
+
+  if (CanBeStoredInline(type)) {
+    llvm::SmallVector<uint64_t, 2> words((byte_size + 7) / 8, 0);
+    memcpy(words.data(), bytes, byte_size);
+    return Value::CreateScalar(
+        target, type,
+        llvm::APInt(static_cast<unsigned>(byte_size * CHAR_BIT), words));
+  }
+
   lldb::SBError ignore;
   lldb::SBData data;
-  data.SetData(ignore, bytes, type.GetByteSize(), target.GetByteOrder(),
+  data.SetData(ignore, bytes, byte_size, target.GetByteOrder(),
                static_cast<uint8_t>(target.GetAddressByteSize()));
 
   // CreateValueFromData copies the data referenced by `bytes` to its own
   // storage. `value` should be valid up until this point.
+  CountStat(&EvaluationStats::create_value_from_data_calls);
   return Value(
       // Force static value, otherwise we can end up with the "real" type.
       target.CreateValueFromData("$result", data, type).GetStaticValue());
@@ -401,6 +645,10 @@ Value CreateValueFromBytes(lldb::SBTarget target, const void* bytes,
 
 Value CreateValueFromAPInt(lldb::SBTarget target, const llvm::APInt& v,
                            lldb::SBType type) {
+  if (CanBeStoredInline(type)) {
+    unsigned bit_width = static_cast<unsigned>(type.GetByteSize() * CHAR_BIT);
+    return Value::CreateScalar(target, type, v.zextOrTrunc(bit_width));
+  }
   return CreateValueFromBytes(target, v.getRawData(), type);
 }
 
@@ -419,9 +667,30 @@ Value CreateValueFromBool(lldb::SBTarget target, bool value) {
 }
 
 Value CreateValueNullptr(lldb::SBTarget target, lldb::SBType type) {
-  assert(LLDBType(type).IsNullPtrType() && "target type must be nullptr");
+  assert(type.GetCanonicalType().GetBasicType() == lldb::eBasicTypeNullPtr &&
+         "target type must be nullptr");
   uintptr_t zero = 0;
   return CreateValueFromBytes(target, &zero, type);
 }
 
+std::optional<llvm::APInt> ReadRegisterContents(lldb::SBValue value) {
+  lldb::SBType type = value.GetType();
+  if (!CanBeStoredInline(type)) {
+    return {};
+  }
+  uint64_t byte_size = type.GetByteSize();
+  lldb::SBData data = value.GetData();
+  if (data.GetByteSize() != byte_size) {
+    return {};
+  }
+  // Same layout as the scalars read from the memory, see `ReadScalar()`.
+  llvm::SmallVector<uint64_t, 2> words((byte_size + 7) / 8, 0);
+  lldb::SBError error;
+  if (data.ReadRawData(error, 0, words.data(), byte_size) != byte_size ||
+      error.Fail()) {
+    return {};
+  }
+  return llvm::APInt(static_cast<unsigned>(byte_size * CHAR_BIT), words);
+}
+
 }  // namespace lldb_eval
@@ -18,61 +18,68 @@
 #define LLDB_EVAL_VALUE_H_
 
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
 
 #include "lldb/API/SBTarget.h"
 #include "lldb/API/SBType.h"
 #include "lldb/API/SBValue.h"
+#include "lldb/lldb-types.h"
 #include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/APInt.h"
 #include "llvm/ADT/APSInt.h"
 #include "type.h"
 
 namespace lldb_eval {
 
 class Error;
+class MemoryCache;
+
+class TargetCache;
 
 /// Wrapper for lldb::SBType adding some convenience methods.
-class LLDBType : public Type {
+///
+/// The commonly queried properties (type flags, byte size, etc) and the
+/// canonical type are computed on the first use and cached. Types created via
+/// `TargetCache::InternType()` are unique per target, so the cached properties
+/// are shared by all users of the type. Types derived from an interned type
+/// (e.g. its pointer type) are interned in the same cache.
+class LLDBType : public Type, public std::enable_shared_from_this<LLDBType> {
  public:
   LLDBType() = default;
   LLDBType(const lldb::SBType& t) : type_(t) {}
 
-  uint64_t GetByteSize() override { return type_.GetByteSize(); }
-  uint32_t GetTypeFlags() override { return type_.GetTypeFlags(); }
+  uint64_t GetByteSize() override { return properties().byte_size; }
+  uint32_t GetTypeFlags() override { return properties().type_flags; }
   bool IsArrayType() override { return type_.IsArrayType(); }
   bool IsPointerType() override { return type_.IsPointerType(); }
   bool IsReferenceType() override { return type_.IsReferenceType(); }
   bool IsPolymorphicClass() override { return type_.IsPolymorphicClass(); }
   bool IsScopedEnum() override;
   bool IsAnonymousType() override { return type_.IsAnonymousType(); }
+  bool IsSmartPtrType() override { return properties().is_smart_ptr; }
   bool IsValid() const override { return type_.IsValid(); }
   bool CompareTo(TypeSP other) override;
   llvm::StringRef GetName() override { return type_.GetName(); }
   TypeSP GetArrayElementType() override {
-    return CreateSP(type_.GetArrayElementType());
+    return Wrap(type_.GetArrayElementType());
   }
   TypeSP GetArrayType(uint64_t size) override {
-    return CreateSP(type_.GetArrayType(size));
-  }
-  TypeSP GetPointerType() override {
-    return LLDBType::CreateSP(type_.GetPointerType());
-  }
-  TypeSP GetPointeeType() override {
-    return LLDBType::CreateSP(type_.GetPointeeType());
-  }
-  TypeSP GetReferenceType() override {
-    return LLDBType::CreateSP(type_.GetReferenceType());
+    return Wrap(type_.GetArrayType(size));
   }
+  TypeSP GetPointerType() override { return Wrap(type_.GetPointerType()); }
+  TypeSP GetPointeeType() override { return Wrap(type_.GetPointeeType()); }
+  TypeSP GetReferenceType() override { return Wrap(type_.GetReferenceType()); }
   TypeSP GetDereferencedType() override {
-    return LLDBType::CreateSP(type_.GetDereferencedType());
-  }
-  TypeSP GetCanonicalType() override {
-    return LLDBType::CreateSP(type_.GetCanonicalType());
+    return Wrap(type_.GetDereferencedType());
   }
+  TypeSP GetCanonicalType() override;
   TypeSP GetUnqualifiedType() override {
-    return LLDBType::CreateSP(type_.GetUnqualifiedType());
+    return Wrap(type_.GetUnqualifiedType());
   }
-  lldb::BasicType GetBasicType() override { return type_.GetBasicType(); }
-  lldb::TypeClass GetTypeClass() override { return type_.GetTypeClass(); }
+  lldb::BasicType GetBasicType() override { return properties().basic_type; }
+  lldb::TypeClass GetTypeClass() override { return properties().type_class; }
   uint32_t GetNumberOfDirectBaseClasses() override {
     return type_.GetNumberOfDirectBaseClasses();
   }
@@ -82,10 +89,10 @@ class LLDBType : public Type {
   uint32_t GetNumberOfFields() override { return type_.GetNumberOfFields(); }
   BaseInfo GetDirectBaseClassAtIndex(uint32_t idx) override {
     auto member = type_.GetDirectBaseClassAtIndex(idx);
-    return {LLDBType::CreateSP(member.GetType()), member.GetOffsetInBytes()};
+    return {Wrap(member.GetType()), member.GetOffsetInBytes()};
   }
   TypeSP GetVirtualBaseClassAtIndex(uint32_t idx) override {
-    return LLDBType::CreateSP(type_.GetVirtualBaseClassAtIndex(idx).GetType());
+    return Wrap(type_.GetVirtualBaseClassAtIndex(idx).GetType());
   }
   TypeSP GetEnumerationIntegerType(ParserContext&) override;
   bool IsEnumerationIntegerTypeSigned() override;
@@ -93,24 +100,55 @@ class LLDBType : public Type {
     auto member = type_.GetFieldAtIndex(idx);
     auto name = member.GetName() ? std::string(member.GetName())
                                  : llvm::Optional<std::string>();
-    return {name, LLDBType::CreateSP(member.GetType()), member.IsBitfield(),
-            member.GetBitfieldSizeInBits()};
+    return {name, Wrap(member.GetType()), member.IsBitfield(),
+            member.GetBitfieldSizeInBits(), member.GetOffsetInBytes()};
   }
+  std::shared_ptr<const MemberIndex> GetMemberIndex() override;
   TypeSP GetSmartPtrPointeeType() override {
     assert(
         IsSmartPtrType() &&
         "the type should be a smart pointer (std::unique_ptr, std::shared_ptr "
         "or std::weak_ptr");
-    return LLDBType::CreateSP(type_.GetTemplateArgumentType(0));
+    return Wrap(type_.GetTemplateArgumentType(0));
   }
 
+  // Creates a type, which is not interned.
   static std::shared_ptr<LLDBType> CreateSP(lldb::SBType type) {
     return std::make_shared<LLDBType>(type);
   }
 
+ private:
+  struct Properties {
+    uint32_t type_flags;
+    uint64_t byte_size;
+    lldb::BasicType basic_type;
+    lldb::TypeClass type_class;
+    bool is_smart_ptr;
+    // Used for comparing the types, see `CompareTo()`.
+    const char* canonical_unqualified_name;
+  };
+
+  const Properties& properties();
+
+  // Creates a type derived from this one, interning it in the same cache.
+  TypeSP Wrap(lldb::SBType type);
+
  private:
   lldb::SBType type_;
+  // Cache this type is interned in, if any.
+  std::weak_ptr<TargetCache> cache_;
+
+  std::once_flag properties_once_;
+  Properties properties_;
+
+  std::once_flag canonical_once_;
+  // Canonical type, `nullptr` if this type is canonical itself.
+  TypeSP canonical_;
+
+  std::once_flag member_index_once_;
+  std::shared_ptr<const MemberIndex> member_index_;
 
+  friend class TargetCache;
   friend lldb::SBType ToSBType(TypeSP type);
 };
 
@@ -123,12 +161,49 @@ class Value {
     type_ = LLDBType::CreateSP(value_.GetType());
   }
 
+  // Same as above, but with the type of `value` already known (e.g. interned
+  // in the target cache).
+  Value(lldb::SBValue value, std::shared_ptr<LLDBType> type)
+      : value_(std::move(value)), type_(std::move(type)) {}
+
+  // Creates a scalar (integer, floating point, enum or pointer) value, which
+  // contents are stored inline. Such values don't allocate lldb::SBValue until
+  // it's actually needed (see `inner_value()`). `bytes` should have the same
+  // bit width as the `type`.
+  static Value CreateScalar(lldb::SBTarget target, lldb::SBType type,
+                            llvm::APInt bytes);
+
+  // Creates a value backed by `value`. If `value` is a scalar located in the
+  // process memory, its contents are read via the `cache` (and later served
+  // without calling into lldb::SBValue). `value` must not be a bitfield.
+  static Value CreateFromMemory(lldb::SBValue value, MemoryCache& cache);
+
+  // Creates a value backed by the register `value` with the `contents` already
+  // read (see `ReadRegisterContents()`), which are served without calling into
+  // lldb::SBValue. Writes to the value still go to the register.
+  static Value CreateFromRegister(lldb::SBValue value, llvm::APInt contents);
+
+  // Creates an lvalue of `type` located at `addr` in the process memory (e.g.
+  // the result of a pointer dereference). lldb::SBValue isn't created until
+  // it's actually needed (see `inner_value()`), scalars are read via the
+  // `cache` and their address is known without calling into LLDB either.
+  static Value CreateFromAddress(lldb::SBTarget target, lldb::addr_t addr,
+                                 TypeSP type, MemoryCache& cache);
+
  public:
-  bool IsValid() { return value_.IsValid(); }
+  bool IsValid() { return is_inline_ || has_address_ || value_.IsValid(); }
   explicit operator bool() { return IsValid(); }
 
-  lldb::SBValue inner_value() const { return value_; }
-  std::shared_ptr<LLDBType> type() { return type_; }
+  // Returns lldb::SBValue representing this value. Values stored inline are
+  // materialized (i.e. lldb::SBValue is created) on the first call.
+  lldb::SBValue inner_value() const;
+  // Whether the value is created by the interpreter rather than read from the
+  // process (see `CreateScalar()`).
+  bool is_inline() const { return is_inline_; }
+  std::shared_ptr<LLDBType> type() const { return type_; }
+  // Returns the address of the value in the process memory, or
+  // LLDB_INVALID_ADDRESS if it's not located in the memory.
+  lldb::addr_t GetLoadAddress() const;
 
   bool IsScalar();
   bool IsInteger();
@@ -155,8 +230,24 @@ class Value {
   void Update(Value v);
 
  private:
-  lldb::SBValue value_;
+  mutable lldb::SBValue value_;
   std::shared_ptr<LLDBType> type_;
+
+  // Inline representation of the scalar values created by the interpreter
+  // (e.g. literals and results of arithmetic operations). `target_` is used
+  // for materializing the value.
+  bool is_inline_ = false;
+  // Whether `scalar_` holds the contents of the value. Always true for the
+  // inline values, for the other values it's the contents read from the
+  // memory cache or from the register (see `CreateFromMemory()` and
+  // `CreateFromRegister()`).
+  bool has_scalar_ = false;
+  llvm::APInt scalar_;
+  lldb::SBTarget target_;
+  // Address of the value created by `CreateFromAddress()`, used for
+  // materializing it.
+  bool has_address_ = false;
+  lldb::addr_t address_ = 0;
 };
 
 Value CastScalarToBasicType(lldb::SBTarget target, Value val, TypeSP type,
@@ -191,6 +282,10 @@ Value CreateValueFromBool(lldb::SBTarget target, bool value);
 
 Value CreateValueNullptr(lldb::SBTarget target, lldb::SBType type);
 
+// Reads the contents of the register `value`. Returns nullopt if the register
+// isn't a scalar (e.g. it's a vector register) or can't be read.
+std::optional<llvm::APInt> ReadRegisterContents(lldb::SBValue value);
+
 inline lldb::SBType ToSBType(TypeSP type) {
   return static_cast<LLDBType&>(*type).type_;
 }
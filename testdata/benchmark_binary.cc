@@ -1,7 +1,62 @@
 #include <iostream>
+#include <memory>
+
+struct Point {
+  int x;
+  int y;
+};
+
+struct Node {
+  int value;
+  Node* next;
+};
+
+struct Base {
+  int b;
+  virtual ~Base() = default;
+};
+
+struct Mid : Base {
+  int m;
+};
+
+struct Derived : Mid {
+  int d;
+};
+
+namespace ns {
+namespace inner {
+
+struct Config {
+  static int instances;
+  int level;
+};
+
+int Config::instances = 3;
+
+}  // namespace inner
+}  // namespace ns
+
+int global_counter = 42;
 
 int main() {
   int arr[] = {1, 2, 3};
+  Point points[] = {{1, 2}, {3, 4}, {5, 6}, {7, 8}};
+
+  Node nodes[8];
+  for (int i = 0; i < 8; ++i) {
+    nodes[i] = {i, i + 1 < 8 ? &nodes[i + 1] : nullptr};
+  }
+  Node* head = &nodes[0];
+
+  Derived derived;
+  derived.b = 1;
+  derived.m = 2;
+  derived.d = 3;
+  Base* base_ptr = &derived;
+
+  auto point_ptr = std::make_unique<Point>(Point{9, 10});
+  ns::inner::Config config{1};
 
   // BREAK HERE
 
@@ -0,0 +1,51 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Generates thousands of types and global variables, so that the lookups in
+// the benchmarks search through the debug information of a realistic size.
+// Every `nsNNNN` namespace (NNNN is in [1000, 3000)) contains:
+//
+//   struct Type { int value; Type* next; };
+//   enum class Kind { kFirst, kSecond };
+//   Type global;
+//   Kind global_kind;
+
+#define BM_DEFINE_TYPES(n)               \
+  namespace ns##n {                      \
+  struct Type {                          \
+    int value;                           \
+    Type* next;                          \
+  };                                     \
+  enum class Kind { kFirst, kSecond };   \
+  Type global = {1, nullptr};            \
+  Kind global_kind = Kind::kSecond;      \
+  }
+
+#define BM_REPEAT_10(m, p) \
+  m(p##0) m(p##1) m(p##2) m(p##3) m(p##4) m(p##5) m(p##6) m(p##7) m(p##8) \
+      m(p##9)
+#define BM_REPEAT_100(m, p)                                             \
+  BM_REPEAT_10(m, p##0)                                                 \
+  BM_REPEAT_10(m, p##1) BM_REPEAT_10(m, p##2) BM_REPEAT_10(m, p##3)     \
+      BM_REPEAT_10(m, p##4) BM_REPEAT_10(m, p##5) BM_REPEAT_10(m, p##6) \
+          BM_REPEAT_10(m, p##7) BM_REPEAT_10(m, p##8) BM_REPEAT_10(m, p##9)
+#define BM_REPEAT_1000(m, p)                                               \
+  BM_REPEAT_100(m, p##0)                                                   \
+  BM_REPEAT_100(m, p##1) BM_REPEAT_100(m, p##2) BM_REPEAT_100(m, p##3)     \
+      BM_REPEAT_100(m, p##4) BM_REPEAT_100(m, p##5) BM_REPEAT_100(m, p##6) \
+          BM_REPEAT_100(m, p##7) BM_REPEAT_100(m, p##8)                    \
+              BM_REPEAT_100(m, p##9)
+
+BM_REPEAT_1000(BM_DEFINE_TYPES, 1)
+BM_REPEAT_1000(BM_DEFINE_TYPES, 2)
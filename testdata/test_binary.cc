@@ -43,6 +43,9 @@ static void TestArithmetic() {
   auto fdenorm = 0x0.1p-145f;
 
   // BREAK(TestArithmetic)
+  // BREAK(TestBuiltinLexer)
+  // BREAK(TestConstantFolding)
+  // BREAK(TestBatchEvaluation)
   // BREAK(TestZeroDivision)
 }
 
@@ -140,6 +143,66 @@ static void TestMemberOf() {
   SxAlias sa{3, x, 4};
 
   // BREAK(TestMemberOf)
+  // BREAK(TestMemoryCache)
+  // BREAK(TestBytecode)
+  // BREAK(TestScalarTier)
+  // BREAK(TestCompiledExprConcurrentEvaluation)
+}
+
+static void TestEvaluateOverRange() {
+  struct Base {
+    int b;
+  };
+  struct Item : Base {
+    int x;
+    int y;
+  };
+
+  Item items[300];
+  for (int i = 0; i < 300; ++i) {
+    items[i].b = i;
+    items[i].x = i * 2;
+    items[i].y = i % 7;
+  }
+  int ints[] = {1, 2, 3};
+
+  // BREAK(TestEvaluateOverRange)
+  // BREAK(TestCompiledExprScopeCast)
+  // BREAK(TestReevaluateExpression)
+  // BREAK(TestEvaluationStats)
+  // BREAK(TestTraceEvents)
+  // BREAK(TestDereferenceByAddress)
+  // BREAK(TestTargetFacts)
+  // BREAK(TestBorrowedSourceManager)
+  // BREAK(TestRecompileExpression)
+  // BREAK(TestLazyErrorMessages)
+  // BREAK(TestTentativeParsing)
+  // BREAK(TestSerializeCompiledExpr)
+}
+
+static int TestFrameIdentifiers(int depth) {
+  if (depth > 0) {
+    return TestFrameIdentifiers(depth - 1) + depth;
+  }
+  int local = 10;
+
+  // BREAK(TestFrameIdentifiers)
+  return local;
+}
+
+static int TestFrameCompiledExpr(int depth) {
+  int x = depth;
+  if (depth > 0) {
+    return TestFrameCompiledExpr(depth - 1) + x;
+  }
+  {
+    int x = 42;
+
+    // BREAK(TestFrameCompiledExpr)
+    // BREAK(TestFrameCompiledExprWithoutBlock)
+    // BREAK(TestEvaluateInFrames)
+    return x;
+  }
 }
 
 static void TestMemberOfInheritance() {
@@ -217,6 +280,8 @@ static void TestMemberOfInheritance() {
   Parent* parent = &obj;
 
   // BREAK(TestMemberOfInheritance)
+  // BREAK(TestMemberIndex)
+  // BREAK(TestMemberOfOffsets)
 }
 
 static void TestMemberOfAnonymousMember() {
@@ -327,8 +392,12 @@ int& globalRef = globalVar;
 
 void TestGlobalVariableLookup() {
   // BREAK(TestGlobalVariableLookup)
+  // BREAK(TestTargetCache)
 }
 
+// Used by TestFrameIndex, shadowed by the member of TestMethods.
+int shadowed_by_member = 3;
+
 class TestMethods {
  public:
   void TestInstanceVariables() {
@@ -339,6 +408,24 @@ class TestMethods {
     C* c_ptr = &c;
 
     // BREAK(TestInstanceVariables)
+    // BREAK(TestEvaluateCondition)
+    // BREAK(TestCompleteExpression)
+  }
+
+  int TestShadowedIdentifiers() {
+    C c;
+    c.field_ = -1;
+
+    C& c_ref = c;
+    C* c_ptr = &c;
+
+    int shadowed = 1;
+    {
+      int shadowed = 2;
+
+      // BREAK(TestFrameIndex)
+      return shadowed + c_ref.field_ + c_ptr->field_;
+    }
   }
 
   void TestAddressOf(int param) {
@@ -360,6 +447,7 @@ class TestMethods {
 
  private:
   int field_ = 1;
+  int shadowed_by_member = 4;
 };
 
 static void TestSubscript() {
@@ -400,6 +488,7 @@ static void TestSubscript() {
   Enum& enum_ref = enum_one;
 
   // BREAK(TestSubscript)
+  // BREAK(TestTypeInterning)
 }
 
 static void TestArrayDereference() {
@@ -583,6 +672,7 @@ void TestCastInheritedTypes() {
 
   // BREAK(TestCastBaseToDerived)
   // BREAK(TestCastDerivedToBase)
+  // BREAK(TestBaseClassPathCache)
 }
 
 // Referenced by TestQualifiedId.
@@ -903,6 +993,7 @@ void TestScopedEnum() {
   // BREAK(TestScopedEnum)
   // BREAK(TestScopedEnumArithmetic)
   // BREAK(TestScopedEnumWithUnderlyingType)
+  // BREAK(TestEnumeratorLookup)
 }
 
 enum UnscopedEnum { kZero, kOne, kTwo };
@@ -982,9 +1073,34 @@ void TestBuiltinFunction_findnonnull() {
   int* array_of_pointers[] = {(int*)1, (int*)1, (int*)0, (int*)0, (int*)1};
   int** pointer_to_pointers = array_of_pointers;
 
+  // Spans several chunks of the memory reads done by `__findnonnull`.
+  static int* large_array_of_pointers[20000];
+  large_array_of_pointers[17000] = (int*)1;
+
   // BREAK(TestBuiltinFunction_findnonnull)
 }
 
+void TestBuiltinFunction_bufferScans() {
+  int array_of_int[] = {3, -1, 0, 7, 0, -1, 5};
+  int* pointer_to_int = array_of_int;
+  uint16_t array_of_uint16[] = {200, 0, 7, 65535, 0};
+  double array_of_double[] = {1.5, -0.0, 2.5, 0.0, -3.5};
+
+  struct S {
+    int x;
+  } array_of_s[] = {{1}, {2}};
+
+  // Spans several chunks of the memory reads.
+  static int large_array_of_int[20000];
+  large_array_of_int[17000] = 42;
+  large_array_of_int[19999] = -5;
+
+  // BREAK(TestBuiltinFunction_bufferScans)
+  // BREAK(TestSnapshotMemoryProvider)
+  // BREAK(TestAsyncEvaluation)
+  // BREAK(TestEvaluationBudget)
+}
+
 void TestPrefixIncDec() {
   auto enum_foo = ScopedEnum::kFoo;
   int i = 1;
@@ -1083,6 +1199,7 @@ void TestSharedPtr() {
   // BREAK(TestSharedPtr)
   // BREAK(TestSharedPtrDeref)
   // BREAK(TestSharedPtrCompare)
+  // BREAK(TestSmartPtrOffset)
 }
 
 void TestTypeComparison() {
@@ -1168,6 +1285,9 @@ static void TestSeparateParsing() {
 
   // BREAK(TestSeparateParsing)
   // BREAK(TestSeparateParsingWithContextVars)
+  // BREAK(TestBoundContextVars)
+  // BREAK(TestCompiledExprCache)
+  // BREAK(TestCacheMemoryLimits)
 }
 
 // Used by TestRegistersNoDollar
@@ -1181,6 +1301,8 @@ struct RegisterCtx {
 
     // BREAK(TestRegisters)
     // BREAK(TestRegistersNoDollar)
+    // BREAK(TestRegistersFrameIndex)
+    // BREAK(TestRegisterWrites)
   }
 };
 
@@ -1205,10 +1327,14 @@ void main() {
   TestLogicalOperators();
   TestLocalVariables();
   TestMemberOf();
+  TestEvaluateOverRange();
+  TestFrameIdentifiers(2);
+  TestFrameCompiledExpr(2);
   TestMemberOfInheritance();
   TestMemberOfAnonymousMember();
   TestGlobalVariableLookup();
   tm.TestInstanceVariables();
+  tm.TestShadowedIdentifiers();
   TestIndirection();
   tm.TestAddressOf(42);
   TestSubscript();
@@ -1230,6 +1356,7 @@ void main() {
   TestSizeOf();
   TestBuiltinFunction_Log2();
   TestBuiltinFunction_findnonnull();
+  TestBuiltinFunction_bufferScans();
   TestArrayDereference();
   TestDereferencedType();
   TestMemberFunctionCall();
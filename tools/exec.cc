@@ -13,9 +13,13 @@
 // limitations under the License.
 
 #include <chrono>
+#include <cstdint>
+#include <iomanip>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "cpp-linenoise/linenoise.hpp"
 #include "lldb-eval/api.h"
@@ -42,12 +46,42 @@ const char* maybe_null(const char* str) {
   return str == nullptr ? "NULL" : str;
 }
 
+void PrintStats(const lldb_eval::EvaluationStats& stats) {
+  const std::pair<const char*, uint64_t> times[] = {
+      {"lex", stats.lex_ns},
+      {"parse", stats.parse_ns},
+      {"type lookup", stats.type_lookup_ns},
+      {"identifier lookup", stats.identifier_lookup_ns},
+      {"eval", stats.eval_ns},
+      {"memory read", stats.memory_read_ns},
+  };
+  const std::pair<const char*, uint64_t> counters[] = {
+      {"FindTypes", stats.find_types_calls},
+      {"FindGlobalVariables", stats.find_global_variables_calls},
+      {"CreateValueFromData", stats.create_value_from_data_calls},
+      {"memory reads", stats.memory_read_calls},
+      {"memory bytes read", stats.memory_bytes_read},
+      {"AST nodes", stats.ast_nodes},
+      {"scalar evaluations", stats.scalar_evaluations},
+  };
+  for (const auto& [name, ns] : times) {
+    std::cerr << "  " << std::left << std::setw(20) << name << "= " << ns / 1000
+              << "us" << std::endl;
+  }
+  for (const auto& [name, count] : counters) {
+    std::cerr << "  " << std::left << std::setw(20) << name << "= " << count
+              << std::endl;
+  }
+}
+
 void EvalExpr(lldb::SBFrame frame, const std::string& expr) {
   lldb::SBError error;
   lldb::SBValue value;
+  lldb_eval::EvaluationStats stats;
 
   lldb_eval::Options opts;
   opts.allow_side_effects = true;
+  opts.stats = &stats;
 
   auto elapsed = timer([&]() {
     value = lldb_eval::EvaluateExpression(frame, expr.c_str(), opts, error);
@@ -68,6 +102,7 @@ void EvalExpr(lldb::SBFrame frame, const std::string& expr) {
 
   std::cerr << "----------" << std::endl
             << "elapsed = " << elapsed << "us" << std::endl;
+  PrintStats(stats);
 }
 
 void EvalExprLLDB(lldb::SBFrame frame, const std::string& expr) {
@@ -123,13 +158,33 @@ int main(int argc, char** argv) {
   std::string break_line = "// BREAK HERE";
   std::string expr;
 
-  if (argc == 1) {
+  // `--trace=file.json` writes the trace events of the evaluations to the
+  // file, in the Chrome trace event format.
+  std::unique_ptr<lldb_eval::ChromeTraceSink> trace_sink;
+  std::vector<std::string> args;
+  const std::string trace_flag = "--trace=";
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.rfind(trace_flag, 0) == 0) {
+      std::string trace_path = arg.substr(trace_flag.size());
+      trace_sink = lldb_eval::ChromeTraceSink::Create(trace_path);
+      if (!trace_sink) {
+        std::cerr << "Can't open the trace file: " << trace_path << std::endl;
+        return 1;
+      }
+      lldb_eval::SetTraceSink(trace_sink.get());
+    } else {
+      args.push_back(arg);
+    }
+  }
+
+  if (args.empty()) {
     repl_mode = true;
-  } else if (argc == 2) {
-    expr = argv[1];
+  } else if (args.size() == 1) {
+    expr = args[0];
   } else {
-    break_line = "// BREAK(" + std::string(argv[1]) + ")";
-    expr = argv[2];
+    break_line = "// BREAK(" + args[0] + ")";
+    expr = args[1];
   }
 
   lldb_eval::SetupLLDBServerEnv(*runfiles);
@@ -154,5 +209,7 @@ int main(int argc, char** argv) {
   process.Destroy();
   lldb::SBDebugger::Terminate();
 
+  lldb_eval::SetTraceSink(nullptr);
+
   return 0;
 }
@@ -17,13 +17,14 @@
 #include "tools/fuzzer/ast.h"
 
 #include <cassert>
+#include <cinttypes>
 #include <climits>
 #include <cstdint>
 #include <cstdio>
-#include <ios>
 #include <memory>
 #include <optional>
-#include <sstream>
+#include <ostream>
+#include <string>
 #include <type_traits>
 #include <utility>
 #include <variant>
@@ -88,31 +89,361 @@ static const char* SCALAR_TYPES_STRINGS[NUM_SCALAR_TYPES] = {
     "long double",         // ScalarType::LongDouble
 };
 
-std::ostream& operator<<(std::ostream& os, CvQualifiers qualifiers) {
-  const char* to_print;
-  bool is_const = qualifiers[CvQualifier::Const];
-  bool is_volatile = qualifiers[CvQualifier::Volatile];
-  if (is_const && is_volatile) {
-    to_print = "const volatile";
-  } else if (is_const) {
-    to_print = "const";
-  } else if (is_volatile) {
-    to_print = "volatile";
-  } else {
-    return os;
+/**
+ * A visitor that appends the source of expressions and types to a string.
+ * All the `operator<<` of this file are implemented with it, callers printing
+ * many expressions use it directly (see `print_expr()`) to reuse one buffer
+ * instead of going through a stream.
+ */
+class ExprPrinter {
+ public:
+  explicit ExprPrinter(std::string& out) : out_(out) {}
+
+  void operator()(const Type& type) { std::visit(*this, type); }
+  void operator()(const Expr& expr) { std::visit(*this, expr); }
+
+  void operator()(CvQualifiers qualifiers) {
+    bool is_const = qualifiers[CvQualifier::Const];
+    bool is_volatile = qualifiers[CvQualifier::Volatile];
+    if (is_const && is_volatile) {
+      out_ += "const volatile";
+    } else if (is_const) {
+      out_ += "const";
+    } else if (is_volatile) {
+      out_ += "volatile";
+    }
+  }
+
+  void operator()(ScalarType type) {
+    out_ += SCALAR_TYPES_STRINGS[(size_t)type];
+  }
+
+  void operator()(const TaggedType& type) { out_ += type.name(); }
+
+  void operator()(const PointerType& type) {
+    (*this)(type.type());
+    out_ += '*';
+  }
+
+  void operator()(const NullptrType&) { out_ += "std::nullptr_t"; }
+
+  void operator()(const EnumType& type) { out_ += type.name(); }
+
+  void operator()(const ArrayType& type) {
+    // TODO: Fix formatting of types consisting of arrays and pointers.
+    // E.g. the correct formatting of pointer to array of ints is `int (*)[N]`,
+    // while the current formatting outputs `int[N]*`. Right now, this isn't
+    // critical since casting to array types isn't supported yet.
+    (*this)(type.type());
+    append_format("[%zu]", type.size());
+  }
+
+  void operator()(const QualifiedType& type) {
+    const auto& inner_type = type.type();
+    if (std::holds_alternative<PointerType>(inner_type)) {
+      (*this)(inner_type);
+      if (type.cv_qualifiers().any()) {
+        out_ += ' ';
+        (*this)(type.cv_qualifiers());
+      }
+    } else {
+      if (type.cv_qualifiers().any()) {
+        (*this)(type.cv_qualifiers());
+        out_ += ' ';
+      }
+      (*this)(inner_type);
+    }
+  }
+
+  void operator()(const BinaryExpr& e) {
+    (*this)(e.lhs());
+    out_ += ' ';
+    out_ += BIN_OP_TABLE[(size_t)e.op()].symbol;
+    out_ += ' ';
+    (*this)(e.rhs());
+  }
+
+  void operator()(const VariableExpr& e) { out_ += e.name(); }
+
+  void operator()(const UnaryExpr& e) {
+    out_ += UN_OP_TABLE[(size_t)e.op()];
+
+    const auto* inner_as_unary = std::get_if<UnaryExpr>(&e.expr());
+    if (inner_as_unary != nullptr) {
+      // Avoid emitting cases such as `++3` or `--3`, print `+ +3` and `- -3`
+      // instead.
+      bool needs_space = (e.op() == UnOp::Plus || e.op() == UnOp::Neg) &&
+                         e.op() == inner_as_unary->op();
+      if (needs_space) {
+        out_ += ' ';
+      }
+    }
+    (*this)(e.expr());
+  }
+
+  void operator()(const IntegerConstant& e) {
+    using Base = IntegerConstant::Base;
+    using Length = IntegerConstant::Length;
+    using Signedness = IntegerConstant::Signedness;
+
+    switch (e.base()) {
+      case Base::Bin: {
+        // printf doesn't support binary numbers, so we'll do it ourselves.
+        out_ += "0b";
+        uint64_t value = e.value();
+        int bit = CHAR_BIT * sizeof(value) - 1;
+        // Print from the first '1' onward (or print `0` if the value is zero).
+        while (bit > 0 && (value >> bit) == 0) {
+          --bit;
+        }
+        for (; bit >= 0; --bit) {
+          out_ += ((value >> bit) & 1) ? '1' : '0';
+        }
+        break;
+      }
+
+      // Same as `std::showbase`, zero is printed without a prefix.
+      case Base::Hex:
+        append_format("%#" PRIx64, e.value());
+        break;
+
+      case Base::Oct:
+        append_format("%#" PRIo64, e.value());
+        break;
+
+      case Base::Dec:
+        append_format("%" PRIu64, e.value());
+        break;
+    }
+
+    switch (e.length()) {
+      case Length::Int:
+        break;
+
+      case Length::Long:
+        out_ += 'L';
+        break;
+
+      case Length::LongLong:
+        out_ += "LL";
+        break;
+    }
+
+    switch (e.signedness()) {
+      case Signedness::Signed:
+        break;
+
+      case Signedness::Unsigned:
+        out_ += 'U';
+        break;
+    }
+  }
+
+  void operator()(const DoubleConstant& e) {
+    using Format = DoubleConstant::Format;
+    using Length = DoubleConstant::Length;
+
+    // The conversions match the ones of `std::defaultfloat`, `std::fixed` and
+    // `std::hexfloat` with the default precision.
+    switch (e.format()) {
+      case Format::Default: {
+        size_t begin = out_.size();
+        append_format("%g", e.value());
+        // Handle a corner case where the double constant is an integer
+        // (doesn't contain a decimal point) in order to prevent expressions
+        // such as `1f` which isn't well formed (it should be `1.f` instead).
+        if (out_.find_first_of(".eE", begin) == std::string::npos) {
+          out_ += '.';
+        }
+      } break;
+
+      case Format::Scientific:
+        append_format("%f", e.value());
+        break;
+
+      case Format::Hex:
+        append_format("%a", e.value());
+        break;
+    }
+
+    switch (e.length()) {
+      case Length::Float:
+        out_ += 'f';
+        break;
+
+      case Length::Double:
+        break;
+    }
+  }
+
+  void operator()(const ParenthesizedExpr& e) {
+    out_ += '(';
+    (*this)(e.expr());
+    out_ += ')';
+  }
+
+  void operator()(const AddressOf& e) {
+    out_ += '&';
+    if (std::holds_alternative<AddressOf>(e.expr())) {
+      // Avoid accidentally printing e.g. `&&x`, print `& &x` instead.
+      out_ += ' ';
+    }
+    (*this)(e.expr());
+  }
+
+  void operator()(const MemberOf& e) {
+    (*this)(e.expr());
+    out_ += '.';
+    out_ += e.field();
+  }
+
+  void operator()(const MemberOfPtr& e) {
+    (*this)(e.expr());
+    out_ += "->";
+    out_ += e.field();
+  }
+
+  void operator()(const ArrayIndex& e) {
+    (*this)(e.expr());
+    out_ += '[';
+    (*this)(e.idx());
+    out_ += ']';
+  }
+
+  void operator()(const TernaryExpr& e) {
+    (*this)(e.cond());
+    out_ += " ? ";
+    (*this)(e.lhs());
+    out_ += " : ";
+    (*this)(e.rhs());
+  }
+
+  void operator()(const CastExpr& e) {
+    using Kind = CastExpr::Kind;
+    switch (e.kind()) {
+      case Kind::CStyleCast:
+        out_ += '(';
+        (*this)(e.type());
+        out_ += ") ";
+        (*this)(e.expr());
+        return;
+      case Kind::StaticCast:
+        out_ += "static_cast<";
+        break;
+      case Kind::ReinterpretCast:
+        out_ += "reinterpret_cast<";
+        break;
+
+      default:
+        assert(false && "Did you introduce a new cast kind?");
+        return;
+    }
+    (*this)(e.type());
+    out_ += ">(";
+    (*this)(e.expr());
+    out_ += ')';
+  }
+
+  void operator()(const DereferenceExpr& e) {
+    out_ += '*';
+    (*this)(e.expr());
+  }
+
+  void operator()(const FunctionCallExpr& e) {
+    out_ += e.name();
+    out_ += '(';
+    const auto& args = e.args();
+    for (size_t i = 0; i < args.size(); ++i) {
+      if (i > 0) {
+        out_ += ", ";
+      }
+      (*this)(*args[i]);
+    }
+    out_ += ')';
+  }
+
+  void operator()(const SizeofExpr& e) {
+    out_ += "sizeof";
+    auto maybe_expr = e.maybe_expr();
+    if (maybe_expr.has_value()) {
+      const Expr& child = maybe_expr.value();
+      // If the child isn't a parenthesized expression, separate the expression
+      // and 'sizeof' with a space.
+      if (!std::holds_alternative<ParenthesizedExpr>(child)) {
+        out_ += ' ';
+      }
+      (*this)(child);
+      return;
+    }
+    auto maybe_type = e.maybe_type();
+    if (maybe_type.has_value()) {
+      out_ += '(';
+      (*this)(maybe_type.value().get());
+      out_ += ')';
+      return;
+    }
+    assert(false && "Did you introduce a new alternative?");
+  }
+
+  void operator()(const BooleanConstant& e) {
+    out_ += e.value() ? "true" : "false";
+  }
+
+  void operator()(const NullptrConstant&) { out_ += "nullptr"; }
+
+  void operator()(const EnumConstant& e) {
+    // TODO: Support unscoped enum literals. Currently, unscoped enums aren't
+    // supported well by LLDB.
+    (*this)(e.type());
+    out_ += "::";
+    out_ += e.literal();
   }
 
-  return os << to_print;
+ private:
+  // Appends a number formatted by `snprintf`. The longest conversion (`%f`
+  // of the largest double) fits into the buffer.
+  template <typename T>
+  void append_format(const char* format, T value) {
+    char buf[512];
+    int len = snprintf(buf, sizeof(buf), format, value);
+    assert(len >= 0 && (size_t)len < sizeof(buf) && "Number doesn't fit!");
+    out_.append(buf, len);
+  }
+
+  std::string& out_;
+};
+
+// Prints `value` through `ExprPrinter`.
+template <typename T>
+static std::ostream& print_to_stream(std::ostream& os, const T& value) {
+  std::string out;
+  ExprPrinter printer(out);
+  printer(value);
+  return os << out;
+}
+
+void print_expr(const Expr& expr, std::string& out) {
+  ExprPrinter printer(out);
+  printer(expr);
+}
+
+void print_type(const Type& type, std::string& out) {
+  ExprPrinter printer(out);
+  printer(type);
+}
+
+std::ostream& operator<<(std::ostream& os, CvQualifiers qualifiers) {
+  return print_to_stream(os, qualifiers);
 }
 
 std::ostream& operator<<(std::ostream& os, ScalarType type) {
-  return os << SCALAR_TYPES_STRINGS[(size_t)type];
+  return print_to_stream(os, type);
 }
 
 TaggedType::TaggedType(std::string name) : name_(std::move(name)) {}
 const std::string& TaggedType::name() const { return name_; }
 std::ostream& operator<<(std::ostream& os, const TaggedType& type) {
-  return os << type.name();
+  return print_to_stream(os, type);
 }
 bool TaggedType::operator==(const TaggedType& rhs) const {
   return name_ == rhs.name_;
@@ -124,7 +455,7 @@ bool TaggedType::operator!=(const TaggedType& rhs) const {
 PointerType::PointerType(QualifiedType type) : type_(std::move(type)) {}
 const QualifiedType& PointerType::type() const { return type_; }
 std::ostream& operator<<(std::ostream& os, const PointerType& type) {
-  return os << type.type() << "*";
+  return print_to_stream(os, type);
 }
 bool PointerType::operator==(const PointerType& rhs) const {
   return type_ == rhs.type_;
@@ -133,8 +464,8 @@ bool PointerType::operator!=(const PointerType& rhs) const {
   return type_ != rhs.type_;
 }
 
-std::ostream& operator<<(std::ostream& os, const NullptrType&) {
-  return os << "std::nullptr_t";
+std::ostream& operator<<(std::ostream& os, const NullptrType& value) {
+  return print_to_stream(os, value);
 }
 bool NullptrType::operator==(const NullptrType&) const { return true; }
 bool NullptrType::operator!=(const NullptrType&) const { return false; }
@@ -144,7 +475,7 @@ EnumType::EnumType(std::string name, bool scoped)
 const std::string& EnumType::name() const { return name_; }
 bool EnumType::is_scoped() const { return scoped_; }
 std::ostream& operator<<(std::ostream& os, const EnumType& type) {
-  return os << type.name();
+  return print_to_stream(os, type);
 }
 bool EnumType::operator==(const EnumType& rhs) const {
   return name_ == rhs.name_ && scoped_ == rhs.scoped_;
@@ -158,11 +489,7 @@ ArrayType::ArrayType(Type type, size_t size)
 const Type& ArrayType::type() const { return *type_; }
 size_t ArrayType::size() const { return size_; }
 std::ostream& operator<<(std::ostream& os, const ArrayType& type) {
-  // TODO: Fix formatting of types consisting of arrays and pointers.
-  // E.g. the correct formatting of pointer to array of ints is `int (*)[N]`,
-  // while the current formatting outputs `int[N]*`. Right now, this isn't
-  // critical since casting to array types isn't supported yet.
-  return os << type.type() << "[" << type.size() << "]";
+  return print_to_stream(os, type);
 }
 bool ArrayType::operator==(const ArrayType& rhs) const {
   return size_ == rhs.size_ && *type_ == *rhs.type_;
@@ -184,24 +511,11 @@ bool QualifiedType::operator!=(const QualifiedType& rhs) const {
 }
 
 std::ostream& operator<<(std::ostream& os, const QualifiedType& type) {
-  const auto& inner_type = type.type();
-  if (std::holds_alternative<PointerType>(inner_type)) {
-    os << inner_type;
-    if (type.cv_qualifiers().any()) {
-      os << " " << type.cv_qualifiers();
-    }
-  } else {
-    if (type.cv_qualifiers().any()) {
-      os << type.cv_qualifiers() << " ";
-    }
-    os << inner_type;
-  }
-  return os;
+  return print_to_stream(os, type);
 }
 
 std::ostream& operator<<(std::ostream& os, const Type& type) {
-  std::visit([&os](const auto& type) { os << type; }, type);
-  return os;
+  return print_to_stream(os, type);
 }
 
 BinaryExpr::BinaryExpr(Expr lhs, BinOp op, Expr rhs)
@@ -221,14 +535,13 @@ int BinaryExpr::precedence() const {
   return BIN_OP_TABLE[(size_t)op_].precedence;
 }
 std::ostream& operator<<(std::ostream& os, const BinaryExpr& e) {
-  const char* symbol = BIN_OP_TABLE[(size_t)e.op()].symbol;
-  return os << e.lhs() << " " << symbol << " " << e.rhs();
+  return print_to_stream(os, e);
 }
 
 VariableExpr::VariableExpr(std::string name) : name_(std::move(name)) {}
 const std::string& VariableExpr::name() const { return name_; }
 std::ostream& operator<<(std::ostream& os, const VariableExpr& e) {
-  return os << e.name();
+  return print_to_stream(os, e);
 }
 
 UnaryExpr::UnaryExpr(UnOp op, Expr expr)
@@ -236,136 +549,29 @@ UnaryExpr::UnaryExpr(UnOp op, Expr expr)
 UnOp UnaryExpr::op() const { return op_; }
 const Expr& UnaryExpr::expr() const { return *expr_; }
 std::ostream& operator<<(std::ostream& os, const UnaryExpr& e) {
-  os << UN_OP_TABLE[(size_t)e.op()];
-
-  const auto* inner_as_unary = std::get_if<UnaryExpr>(&e.expr());
-  if (inner_as_unary != nullptr) {
-    // Avoid emitting cases such as `++3` or `--3`, print `+ +3` and `- -3`
-    // instead.
-    bool needs_space = (e.op() == UnOp::Plus || e.op() == UnOp::Neg) &&
-                       e.op() == inner_as_unary->op();
-    if (needs_space) {
-      os << " ";
-    }
-  }
-  return os << e.expr();
+  return print_to_stream(os, e);
 }
 
 std::ostream& operator<<(std::ostream& os, const IntegerConstant& e) {
-  using Base = IntegerConstant::Base;
-  using Length = IntegerConstant::Length;
-  using Signedness = IntegerConstant::Signedness;
-
-  auto saved_flags = os.flags();
-  switch (e.base_) {
-    case Base::Bin: {
-      // iostream doesn't support binary numbers yet, so we'll do it ourselves.
-      std::bitset<CHAR_BIT * sizeof(e.value())> bits(e.value());
-      auto str = bits.to_string();
-      auto idx = str.find('1');
-      // Print from the first '1' onward (or print `0` if the value is zero).
-      const char* to_print = (idx != std::string::npos) ? &str[idx] : "0";
-
-      os << "0b" << to_print;
-      break;
-    }
-
-    case Base::Hex:
-      os << std::hex << std::showbase << e.value();
-      break;
-
-    case Base::Oct:
-      os << std::oct << std::showbase << e.value();
-      break;
-
-    case Base::Dec:
-      os << std::dec << e.value();
-      break;
-  }
-
-  switch (e.length_) {
-    case Length::Int:
-      break;
-
-    case Length::Long:
-      os << "L";
-      break;
-
-    case Length::LongLong:
-      os << "LL";
-      break;
-  }
-
-  switch (e.signedness_) {
-    case Signedness::Signed:
-      break;
-
-    case Signedness::Unsigned:
-      os << "U";
-      break;
-  }
-
-  os.flags(saved_flags);
-  return os;
+  return print_to_stream(os, e);
 }
 
 std::ostream& operator<<(std::ostream& os, const DoubleConstant& e) {
-  using Format = DoubleConstant::Format;
-  using Length = DoubleConstant::Length;
-
-  auto saved_flags = os.flags();
-  switch (e.format_) {
-    case Format::Default: {
-      std::ostringstream sstream;
-      sstream << std::defaultfloat << e.value_;
-      os << sstream.str();
-      // Handle a corner case where the double constant is an integer (doesn't
-      // contain a decimal point) in order to prevent expressions such as `1f`
-      // which isn't well formed (it should be `1.f` instead).
-      if (sstream.str().find_first_of(".eE") == std::string::npos) {
-        os << ".";
-      }
-    } break;
-
-    case Format::Scientific:
-      os << std::fixed << e.value_;
-      break;
-
-    case Format::Hex:
-      os << std::hexfloat << e.value_;
-      break;
-  }
-
-  switch (e.length_) {
-    case Length::Float:
-      os << "f";
-      break;
-
-    case Length::Double:
-      break;
-  }
-
-  os.flags(saved_flags);
-  return os;
+  return print_to_stream(os, e);
 }
 
 ParenthesizedExpr::ParenthesizedExpr(Expr expr)
     : expr_(std::make_shared<Expr>(std::move(expr))) {}
 const Expr& ParenthesizedExpr::expr() const { return *expr_; }
 std::ostream& operator<<(std::ostream& os, const ParenthesizedExpr& e) {
-  return os << "(" << e.expr() << ")";
+  return print_to_stream(os, e);
 }
 
 AddressOf::AddressOf(Expr expr)
     : expr_(std::make_shared<Expr>(std::move(expr))) {}
 const Expr& AddressOf::expr() const { return *expr_; }
 std::ostream& operator<<(std::ostream& os, const AddressOf& e) {
-  os << "&";
-  if (std::holds_alternative<AddressOf>(e.expr())) {
-    // Avoid accidentally printing e.g. `&&x`, print `& &x` instead.
-    os << " ";
-  }
-  return os << e.expr();
+  return print_to_stream(os, e);
 }
 
 MemberOf::MemberOf(Expr expr, std::string field)
@@ -378,7 +584,7 @@ MemberOf::MemberOf(Expr expr, std::string field, TaggedType expr_type)
 const Expr& MemberOf::expr() const { return *expr_; }
 const std::string& MemberOf::field() const { return field_; }
 std::ostream& operator<<(std::ostream& os, const MemberOf& e) {
-  return os << e.expr() << "." << e.field();
+  return print_to_stream(os, e);
 }
 
 MemberOfPtr::MemberOfPtr(Expr expr, std::string field)
@@ -391,7 +597,7 @@ MemberOfPtr::MemberOfPtr(Expr expr, std::string field, TaggedType expr_type)
 const Expr& MemberOfPtr::expr() const { return *expr_; }
 const std::string& MemberOfPtr::field() const { return field_; }
 std::ostream& operator<<(std::ostream& os, const MemberOfPtr& e) {
-  return os << e.expr() << "->" << e.field();
+  return print_to_stream(os, e);
 }
 
 ArrayIndex::ArrayIndex(Expr expr, Expr idx)
@@ -400,7 +606,7 @@ ArrayIndex::ArrayIndex(Expr expr, Expr idx)
 const Expr& ArrayIndex::expr() const { return *expr_; }
 const Expr& ArrayIndex::idx() const { return *idx_; }
 std::ostream& operator<<(std::ostream& os, const ArrayIndex& e) {
-  return os << e.expr() << "[" << e.idx() << "]";
+  return print_to_stream(os, e);
 }
 
 TernaryExpr::TernaryExpr(Expr cond, Expr lhs, Expr rhs)
@@ -417,7 +623,7 @@ const Expr& TernaryExpr::lhs() const { return *lhs_; }
 const Expr& TernaryExpr::rhs() const { return *rhs_; }
 const Type* TernaryExpr::expr_type() const { return expr_type_.get(); }
 std::ostream& operator<<(std::ostream& os, const TernaryExpr& e) {
-  return os << e.cond() << " ? " << e.lhs() << " : " << e.rhs();
+  return print_to_stream(os, e);
 }
 
 CastExpr::CastExpr(Kind kind, Type type, Expr expr)
@@ -429,26 +635,14 @@ const Type& CastExpr::type() const { return type_; }
 const Expr& CastExpr::expr() const { return *expr_; }
 int CastExpr::precedence() const { return cast_kind_precedence(kind_); }
 std::ostream& operator<<(std::ostream& os, const CastExpr& e) {
-  using Kind = CastExpr::Kind;
-  switch (e.kind()) {
-    case Kind::CStyleCast:
-      return os << "(" << e.type() << ") " << e.expr();
-    case Kind::StaticCast:
-      return os << "static_cast<" << e.type() << ">(" << e.expr() << ")";
-    case Kind::ReinterpretCast:
-      return os << "reinterpret_cast<" << e.type() << ">(" << e.expr() << ")";
-
-    default:
-      assert(false && "Did you introduce a new cast kind?");
-  }
-  return os;
+  return print_to_stream(os, e);
 }
 
 DereferenceExpr::DereferenceExpr(Expr expr)
     : expr_(std::make_shared<Expr>(std::move(expr))) {}
 const Expr& DereferenceExpr::expr() const { return *expr_; }
 std::ostream& operator<<(std::ostream& os, const DereferenceExpr& expr) {
-  return os << "*" << expr.expr();
+  return print_to_stream(os, expr);
 }
 
 FunctionCallExpr::FunctionCallExpr(std::string name,
@@ -459,15 +653,7 @@ const std::vector<std::shared_ptr<Expr>>& FunctionCallExpr::args() const {
   return args_;
 }
 std::ostream& operator<<(std::ostream& os, const FunctionCallExpr& expr) {
-  os << expr.name() << "(";
-  const auto& args = expr.args();
-  for (size_t i = 0; i < args.size(); ++i) {
-    if (i > 0) {
-      os << ", ";
-    }
-    os << *args[i];
-  }
-  return os << ")";
+  return print_to_stream(os, expr);
 }
 
 SizeofExpr::SizeofExpr(Expr expr)
@@ -490,43 +676,23 @@ std::optional<std::reference_wrapper<const Type>> SizeofExpr::maybe_type()
   return {};
 }
 std::ostream& operator<<(std::ostream& os, const SizeofExpr& expr) {
-  os << "sizeof";
-  auto maybe_expr = expr.maybe_expr();
-  if (maybe_expr.has_value()) {
-    const Expr& child = maybe_expr.value();
-    // If the child isn't a parenthesized expression, separate the expression
-    // and 'sizeof' with a space.
-    if (!std::holds_alternative<ParenthesizedExpr>(child)) {
-      os << " ";
-    }
-    return os << child;
-  }
-  auto maybe_type = expr.maybe_type();
-  if (maybe_type.has_value()) {
-    return os << "(" << maybe_type.value() << ")";
-  }
-  assert(false && "Did you introduce a new alternative?");
-  return os;
+  return print_to_stream(os, expr);
 }
 
 std::ostream& operator<<(std::ostream& os, const BooleanConstant& expr) {
-  const char* to_print = expr.value() ? "true" : "false";
-  return os << to_print;
+  return print_to_stream(os, expr);
 }
 
-std::ostream& operator<<(std::ostream& os, const NullptrConstant&) {
-  return os << "nullptr";
+std::ostream& operator<<(std::ostream& os, const NullptrConstant& value) {
+  return print_to_stream(os, value);
 }
 
 std::ostream& operator<<(std::ostream& os, const EnumConstant& expr) {
-  // TODO: Support unscoped enum literals. Currently, unscoped enums aren't
-  // supported well by LLDB.
-  return os << expr.type() << "::" << expr.literal();
+  return print_to_stream(os, expr);
 }
 
 std::ostream& operator<<(std::ostream& os, const Expr& e) {
-  std::visit([&os](const auto& expr) { os << expr; }, e);
-  return os;
+  return print_to_stream(os, e);
 }
 
 /**
@@ -642,9 +808,9 @@ class ExprDumper {
 
   void operator()(const CastExpr& e) {
     emit_marked_indentation();
-    std::ostringstream os;
-    os << e.type();
-    printf("Cast expression into type: `%s`\n", os.str().c_str());
+    std::string type;
+    print_type(e.type(), type);
+    printf("Cast expression into type: `%s`\n", type.c_str());
 
     indented_visit(e.expr());
   }
@@ -676,9 +842,9 @@ class ExprDumper {
 
     auto maybe_type = e.maybe_type();
     if (maybe_type.has_value()) {
-      std::ostringstream os;
-      os << maybe_type.value();
-      printf("  Type: %s\n", os.str().c_str());
+      std::string type;
+      print_type(maybe_type.value(), type);
+      printf("  Type: %s\n", type.c_str());
       return;
     }
 
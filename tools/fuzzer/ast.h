@@ -248,6 +248,12 @@ inline constexpr size_t NUM_EXPR_KINDS = std::variant_size_v<Expr>;
 void dump_expr(const Expr& expr);
 std::ostream& operator<<(std::ostream& os, const Expr& expr);
 
+// Append the source of `expr` (`type`) to `out`. The output is the same as of
+// `operator<<`, but it doesn't go through a stream, so callers printing many
+// expressions can reuse one buffer for all of them.
+void print_expr(const Expr& expr, std::string& out);
+void print_type(const Type& type, std::string& out);
+
 class BinaryExpr {
  public:
   BinaryExpr() = default;
@@ -378,6 +384,8 @@ class DoubleConstant {
       : value_(value), format_(format), length_(length) {}
 
   double value() const { return value_; }
+  Format format() const { return format_; }
+  Length length() const { return length_; }
   int precedence() const { return PRECEDENCE; }
 
   friend std::ostream& operator<<(std::ostream& os, const DoubleConstant& expr);
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2021 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/fuzzer/candidate_tables.h"
+
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "tools/fuzzer/ast.h"
+#include "tools/fuzzer/constraints.h"
+#include "tools/fuzzer/symbol_table.h"
+
+namespace fuzzer {
+
+CandidateTables::CandidateTables(SymbolTable symtab)
+    : symtab_(std::move(symtab)) {
+  tagged_types_.reserve(symtab_.tagged_types().size());
+  for (const auto& tagged_type : symtab_.tagged_types()) {
+    tagged_types_.emplace_back(tagged_type);
+  }
+}
+
+const std::vector<std::reference_wrapper<const VariableExpr>>&
+CandidateTables::vars(const ExprConstraints& constraints,
+                      bool long_double_enabled) {
+  const auto& memory_constraints = constraints.memory_constraints();
+  std::string key = constraints.type_constraints().cache_key();
+  key += constraints.must_be_lvalue() ? 'L' : 'R';
+  key += long_double_enabled ? 'D' : '-';
+  key += std::to_string(memory_constraints.required_freedom_index());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = vars_.try_emplace(std::move(key));
+  if (!inserted) {
+    return it->second;
+  }
+
+  for (const auto& [k, v] : symtab_.vars()) {
+    // Skip long double variables if long double isn't enabled.
+    if (!long_double_enabled && k == Type(ScalarType::LongDouble)) {
+      continue;
+    }
+
+    if (constraints.type_constraints().allows_type(k)) {
+      for (const auto& var : v) {
+        if (var.expr.name() == "this" && constraints.must_be_lvalue()) {
+          // "this" is an rvalue.
+          continue;
+        }
+        if (var.freedom_index >= memory_constraints.required_freedom_index()) {
+          it->second.emplace_back(var.expr);
+        }
+      }
+    }
+  }
+  return it->second;
+}
+
+const std::vector<std::reference_wrapper<const Field>>& CandidateTables::fields(
+    const TypeConstraints& constraints) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = fields_.try_emplace(constraints.cache_key());
+  if (inserted) {
+    for (const auto& [k, v] : symtab_.fields_by_type()) {
+      if (constraints.allows_type(k)) {
+        it->second.insert(it->second.end(), v.begin(), v.end());
+      }
+    }
+  }
+  return it->second;
+}
+
+const std::vector<std::reference_wrapper<const Function>>&
+CandidateTables::functions(const TypeConstraints& constraints) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = functions_.try_emplace(constraints.cache_key());
+  if (inserted) {
+    for (const auto& [k, v] : symtab_.functions()) {
+      if (constraints.allows_type(k)) {
+        it->second.insert(it->second.end(), v.begin(), v.end());
+      }
+    }
+  }
+  return it->second;
+}
+
+const std::vector<std::reference_wrapper<const EnumConstant>>&
+CandidateTables::enum_literals(const TypeConstraints& constraints) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = enum_literals_.try_emplace(constraints.cache_key());
+  if (inserted) {
+    for (const auto& [k, v] : symtab_.enums()) {
+      if (constraints.allows_type(k)) {
+        it->second.insert(it->second.end(), v.begin(), v.end());
+      }
+    }
+  }
+  return it->second;
+}
+
+const std::vector<std::reference_wrapper<const EnumType>>&
+CandidateTables::enum_types(const TypeConstraints& constraints) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = enum_types_.try_emplace(constraints.cache_key());
+  if (inserted) {
+    for (const auto& [enum_type, _] : symtab_.enums()) {
+      if (constraints.allows_type(enum_type)) {
+        it->second.emplace_back(enum_type);
+      }
+    }
+  }
+  return it->second;
+}
+
+const std::vector<std::reference_wrapper<const ArrayType>>&
+CandidateTables::array_types(const TypeConstraints& constraints) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = array_types_.try_emplace(constraints.cache_key());
+  if (inserted) {
+    for (const auto& type : symtab_.array_types()) {
+      if (constraints.allows_type(type)) {
+        it->second.emplace_back(type);
+      }
+    }
+  }
+  return it->second;
+}
+
+}  // namespace fuzzer
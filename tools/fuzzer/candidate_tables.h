@@ -0,0 +1,102 @@
+/*
+ * Copyright 2021 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDE_CANDIDATE_TABLES_H
+#define INCLUDE_CANDIDATE_TABLES_H
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tools/fuzzer/ast.h"
+#include "tools/fuzzer/constraints.h"
+#include "tools/fuzzer/symbol_table.h"
+
+namespace fuzzer {
+
+// Symbols of a symbol table that satisfy given constraints, memoized per
+// distinct constraints. The expression generator asks for the same
+// constraints over and over (e.g. for every integer leaf), so instead of
+// checking every variable, field and function of the symbol table against the
+// constraints each time, the candidates are computed once and the generator
+// samples from the flat arrays.
+//
+// The candidates are listed in the iteration order of the symbol table, so
+// the generated expressions are the same as with filtering the symbol table
+// directly. The tables can be shared by multiple generators, all methods are
+// thread-safe. The returned arrays are valid as long as the tables are.
+class CandidateTables {
+ public:
+  explicit CandidateTables(SymbolTable symtab);
+
+  CandidateTables(const CandidateTables&) = delete;
+  CandidateTables& operator=(const CandidateTables&) = delete;
+
+  const SymbolTable& symtab() const { return symtab_; }
+
+  // Variables of the types allowed by `constraints`, with the freedom index
+  // the constraints require. "this" is left out if the expression must be an
+  // lvalue, long double variables are left out unless `long_double_enabled`.
+  const std::vector<std::reference_wrapper<const VariableExpr>>& vars(
+      const ExprConstraints& constraints, bool long_double_enabled);
+
+  // Fields of the types allowed by `constraints`.
+  const std::vector<std::reference_wrapper<const Field>>& fields(
+      const TypeConstraints& constraints);
+
+  // Functions returning the types allowed by `constraints`.
+  const std::vector<std::reference_wrapper<const Function>>& functions(
+      const TypeConstraints& constraints);
+
+  // Enum literals of the types allowed by `constraints`.
+  const std::vector<std::reference_wrapper<const EnumConstant>>& enum_literals(
+      const TypeConstraints& constraints);
+
+  // Enum types allowed by `constraints`.
+  const std::vector<std::reference_wrapper<const EnumType>>& enum_types(
+      const TypeConstraints& constraints);
+
+  // Array types allowed by `constraints`.
+  const std::vector<std::reference_wrapper<const ArrayType>>& array_types(
+      const TypeConstraints& constraints);
+
+  // All tagged types of the symbol table.
+  const std::vector<std::reference_wrapper<const TaggedType>>& tagged_types()
+      const {
+    return tagged_types_;
+  }
+
+ private:
+  template <typename T>
+  using Candidates = std::vector<std::reference_wrapper<const T>>;
+
+  SymbolTable symtab_;
+  Candidates<TaggedType> tagged_types_;
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, Candidates<VariableExpr>> vars_;
+  std::unordered_map<std::string, Candidates<Field>> fields_;
+  std::unordered_map<std::string, Candidates<Function>> functions_;
+  std::unordered_map<std::string, Candidates<EnumConstant>> enum_literals_;
+  std::unordered_map<std::string, Candidates<EnumType>> enum_types_;
+  std::unordered_map<std::string, Candidates<ArrayType>> array_types_;
+};
+
+}  // namespace fuzzer
+
+#endif  // INCLUDE_CANDIDATE_TABLES_H
@@ -14,6 +14,7 @@
 
 #include "tools/fuzzer/constraints.h"
 
+#include <string>
 #include <variant>
 
 #include "tools/fuzzer/ast.h"
@@ -245,6 +246,66 @@ TypeConstraints TypeConstraints::allowed_to_point_to() const {
   return retval;
 }
 
+static void append_key(std::string& key,
+                       const std::variant<NoType, AnyType, EnumType>& types) {
+  if (std::holds_alternative<NoType>(types)) {
+    key += 'N';
+  } else if (std::holds_alternative<AnyType>(types)) {
+    key += 'A';
+  } else {
+    key += 'E';
+    key += std::get<EnumType>(types).name();
+    key += '\0';
+  }
+}
+
+static void append_key(std::string& key,
+                       const std::variant<NoType, AnyType, TaggedType>& types) {
+  if (std::holds_alternative<NoType>(types)) {
+    key += 'N';
+  } else if (std::holds_alternative<AnyType>(types)) {
+    key += 'A';
+  } else {
+    key += 'T';
+    key += std::get<TaggedType>(types).name();
+    key += '\0';
+  }
+}
+
+static void append_key(
+    std::string& key,
+    const std::variant<NoType, AnyType, std::shared_ptr<TypeConstraints>>&
+        types) {
+  if (std::holds_alternative<NoType>(types)) {
+    key += 'N';
+  } else if (std::holds_alternative<AnyType>(types)) {
+    key += 'A';
+  } else {
+    key += '(';
+    key += std::get<std::shared_ptr<TypeConstraints>>(types)->cache_key();
+    key += ')';
+  }
+}
+
+std::string TypeConstraints::cache_key() const {
+  std::string key;
+  for (size_t i = 0; i < scalar_types_.size(); i++) {
+    key += scalar_types_[i] ? '1' : '0';
+  }
+  append_key(key, unscoped_enum_types_);
+  append_key(key, scoped_enum_types_);
+  append_key(key, tagged_types_);
+  append_key(key, ptr_types_);
+  append_key(key, array_types_);
+  key += allows_void_pointer_ ? '1' : '0';
+  key += allows_nullptr_ ? '1' : '0';
+  key += allows_literal_zero_ ? '1' : '0';
+  if (array_size_.has_value()) {
+    key += std::to_string(array_size_.value());
+  }
+  return key;
+}
+
 bool TypeConstraints::allows_tagged_type(const TaggedType& tagged_type) const {
   if (std::holds_alternative<NoType>(tagged_types_)) {
     return false;
@@ -19,6 +19,7 @@
 
 #include <cassert>
 #include <memory>
+#include <string>
 #include <unordered_set>
 #include <utility>
 #include <variant>
@@ -246,6 +247,11 @@ class TypeConstraints {
   // What kind of types do these constraints allow a pointer to?
   TypeConstraints allowed_to_point_to() const;
 
+  // A string that is equal for two constraints if and only if they allow the
+  // same types. Used to memoize the symbols satisfying the constraints (see
+  // `CandidateTables`).
+  std::string cache_key() const;
+
  private:
   ScalarMask scalar_types_;
   std::variant<NoType, AnyType, EnumType> unscoped_enum_types_;
@@ -20,6 +20,7 @@
 #include <array>
 #include <cassert>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <random>
 #include <type_traits>
@@ -29,6 +30,7 @@
 
 #include "lldb-eval/defines.h"
 #include "tools/fuzzer/ast.h"
+#include "tools/fuzzer/candidate_tables.h"
 #include "tools/fuzzer/constraints.h"
 #include "tools/fuzzer/enum_bitset.h"
 #include "tools/fuzzer/symbol_table.h"
@@ -206,13 +208,8 @@ std::optional<Expr> ExprGenerator::gen_enum_constant_impl(
     return {};
   }
 
-  std::vector<std::reference_wrapper<const EnumConstant>> enums;
-  for (const auto& [k, v] : symtab_.enums()) {
-    if (constraints.type_constraints().allows_type(k)) {
-      enums.insert(enums.end(), v.begin(), v.end());
-    }
-  }
-
+  const auto& enums =
+      candidates_->enum_literals(constraints.type_constraints());
   if (enums.empty()) {
     return {};
   }
@@ -222,29 +219,7 @@ std::optional<Expr> ExprGenerator::gen_enum_constant_impl(
 
 std::optional<Expr> ExprGenerator::gen_variable_expr_impl(
     const ExprConstraints& constraints) {
-  const auto& type_constraints = constraints.type_constraints();
-  const auto& memory_constraints = constraints.memory_constraints();
-
-  std::vector<std::reference_wrapper<const VariableExpr>> vars;
-  for (const auto& [k, v] : symtab_.vars()) {
-    // Skip long double variables if long double isn't enabled.
-    if (!cfg_.long_double_enabled && k == Type(ScalarType::LongDouble)) {
-      continue;
-    }
-
-    if (type_constraints.allows_type(k)) {
-      for (const auto& var : v) {
-        if (var.expr.name() == "this" && constraints.must_be_lvalue()) {
-          // "this" is an rvalue.
-          continue;
-        }
-        if (var.freedom_index >= memory_constraints.required_freedom_index()) {
-          vars.emplace_back(var.expr);
-        }
-      }
-    }
-  }
-
+  const auto& vars = candidates_->vars(constraints, cfg_.long_double_enabled);
   if (vars.empty()) {
     return {};
   }
@@ -709,13 +684,7 @@ std::optional<Expr> ExprGenerator::gen_member_of_expr_impl(
     return {};
   }
 
-  std::vector<std::reference_wrapper<const Field>> fields;
-  for (const auto& [k, v] : symtab_.fields_by_type()) {
-    if (type_constraints.allows_type(k)) {
-      fields.insert(fields.end(), v.begin(), v.end());
-    }
-  }
-
+  const auto& fields = candidates_->fields(type_constraints);
   if (fields.empty()) {
     return {};
   }
@@ -748,14 +717,7 @@ std::optional<Expr> ExprGenerator::gen_member_of_ptr_expr_impl(
     return {};
   }
 
-  std::vector<std::reference_wrapper<const Field>> fields;
-
-  for (const auto& [k, v] : symtab_.fields_by_type()) {
-    if (type_constraints.allows_type(k)) {
-      fields.insert(fields.end(), v.begin(), v.end());
-    }
-  }
-
+  const auto& fields = candidates_->fields(type_constraints);
   if (fields.empty()) {
     return {};
   }
@@ -906,13 +868,7 @@ std::optional<Expr> ExprGenerator::gen_function_call_expr_impl(
 
   const auto& type_constraints = constraints.type_constraints();
 
-  std::vector<std::reference_wrapper<const Function>> functions;
-  for (const auto& [k, v] : symtab_.functions()) {
-    if (type_constraints.allows_type(k)) {
-      functions.insert(functions.end(), v.begin(), v.end());
-    }
-  }
-
+  const auto& functions = candidates_->functions(type_constraints);
   if (functions.empty()) {
     return {};
   }
@@ -1290,22 +1246,18 @@ std::optional<Type> ExprGenerator::gen_tagged_type(
     return {};
   }
 
-  std::vector<std::reference_wrapper<const TaggedType>> tagged_types;
-
   const auto& allowed_types = constraints.allowed_tagged_types();
 
+  if (std::holds_alternative<AnyType>(allowed_types)) {
+    return rng_->pick_tagged_type(candidates_->tagged_types());
+  }
+
+  std::vector<std::reference_wrapper<const TaggedType>> tagged_types;
   const auto* tagged_type = std::get_if<TaggedType>(&allowed_types);
   if (tagged_type != nullptr) {
     tagged_types.push_back(*tagged_type);
   }
 
-  if (std::holds_alternative<AnyType>(allowed_types)) {
-    tagged_types.reserve(symtab_.tagged_types().size());
-    for (const auto& tagged_type : symtab_.tagged_types()) {
-      tagged_types.emplace_back(tagged_type);
-    }
-  }
-
   return rng_->pick_tagged_type(tagged_types);
 }
 
@@ -1326,13 +1278,7 @@ std::optional<Type> ExprGenerator::gen_scalar_type(
 
 std::optional<Type> ExprGenerator::gen_enum_type(
     const TypeConstraints& constraints) {
-  std::vector<std::reference_wrapper<const EnumType>> enum_types;
-  for (const auto& [enum_type, _] : symtab_.enums()) {
-    if (constraints.allows_type(enum_type)) {
-      enum_types.emplace_back(enum_type);
-    }
-  }
-
+  const auto& enum_types = candidates_->enum_types(constraints);
   if (enum_types.empty()) {
     return {};
   }
@@ -1345,13 +1291,7 @@ std::optional<Type> ExprGenerator::gen_array_type(
   // Instead of constructing a random array type, we rely on set of
   // array types from symbol table. This will increase chances to match
   // variables of array types.
-  std::vector<std::reference_wrapper<const ArrayType>> array_types;
-  for (const auto& type : symtab_.array_types()) {
-    if (constraints.allows_type(type)) {
-      array_types.emplace_back(type);
-    }
-  }
-
+  const auto& array_types = candidates_->array_types(constraints);
   if (array_types.empty()) {
     return {};
   }
@@ -1366,6 +1306,11 @@ CvQualifiers ExprGenerator::gen_cv_qualifiers() {
   return CvQualifiers();  // empty set
 }
 
+ExprGenerator::ExprGenerator(std::unique_ptr<GeneratorRng> rng,
+                             GenConfig cfg, SymbolTable symtab)
+    : ExprGenerator(std::move(rng), std::move(cfg),
+                    std::make_shared<CandidateTables>(std::move(symtab))) {}
+
 std::optional<Expr> ExprGenerator::generate() {
   Weights weights;
 
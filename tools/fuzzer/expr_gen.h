@@ -74,6 +74,7 @@ using TypeKindMask = EnumBitset<TypeKind>;
 using CastKindMask = EnumBitset<CastExpr::Kind>;
 
 class Weights;
+class CandidateTables;
 class ExprConstraints;
 class TypeConstraints;
 
@@ -295,8 +296,16 @@ class DefaultGeneratorRng : public GeneratorRng {
 class ExprGenerator {
  public:
   ExprGenerator(std::unique_ptr<GeneratorRng> rng, GenConfig cfg,
-                SymbolTable symtab)
-      : rng_(std::move(rng)), cfg_(std::move(cfg)), symtab_(std::move(symtab)) {
+                SymbolTable symtab);
+
+  // Creates a generator sampling the symbols from `candidates`, which can be
+  // shared by many generators (e.g. one per fuzzer input) so that the
+  // candidates for the constraints are computed only once.
+  ExprGenerator(std::unique_ptr<GeneratorRng> rng, GenConfig cfg,
+                std::shared_ptr<CandidateTables> candidates)
+      : rng_(std::move(rng)),
+        cfg_(std::move(cfg)),
+        candidates_(std::move(candidates)) {
     rng_->set_rng_callback([this](uint8_t byte) { on_consume_byte(byte); });
   }
 
@@ -415,7 +424,7 @@ class ExprGenerator {
  private:
   std::unique_ptr<GeneratorRng> rng_;
   GenConfig cfg_;
-  SymbolTable symtab_;
+  std::shared_ptr<CandidateTables> candidates_;
 
   std::stack<std::shared_ptr<GenNode>> stack_;
   std::shared_ptr<GenNode> node_;
@@ -749,6 +749,11 @@ TEST_P(OperatorPrecedence, CorrectAst) {
 
   EXPECT_THAT(expr, MatchesAst(std::cref(param.expr)));
   EXPECT_THAT(os.str(), StrEq(param.str));
+
+  // `print_expr()` appends to the buffer.
+  std::string out = "expr: ";
+  print_expr(expr, out);
+  EXPECT_THAT(out, StrEq("expr: " + param.str));
 }
 
 std::vector<PrecedenceTestParam> gen_precedence_params() {
@@ -1034,6 +1039,10 @@ TEST_P(TypePrinting, CorrectStrType) {
   std::ostringstream os;
   os << param.type;
   EXPECT_THAT(os.str(), StrEq(param.str));
+
+  std::string out;
+  print_type(param.type, out);
+  EXPECT_THAT(out, StrEq(param.str));
 }
 
 std::vector<TypePrintTestParam> gen_typing_params() {
@@ -2,8 +2,9 @@
 
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
 #include <memory>
-#include <sstream>
+#include <string>
 
 #include "lldb-eval/runner.h"
 #include "lldb/API/SBDebugger.h"
@@ -11,12 +12,16 @@
 #include "lldb/API/SBProcess.h"
 #include "lldb/API/SBTarget.h"
 #include "lldb/API/SBThread.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Path.h"
 #include "tools/cpp/runfiles/runfiles.h"
 #include "tools/fuzzer/ast.h"
+#include "tools/fuzzer/candidate_tables.h"
 #include "tools/fuzzer/expr_gen.h"
 #include "tools/fuzzer/fixed_rng.h"
 #include "tools/fuzzer/gen_node.h"
 #include "tools/fuzzer/symbol_table.h"
+#include "tools/fuzzer/symbol_table_cache.h"
 
 namespace fuzzer {
 
@@ -52,12 +57,12 @@ class GenNodeWriter : public GenTreeVisitor {
   ByteWriter& writer_;
 };
 
-ExprGenerator create_generator(SymbolTable symtab,
+ExprGenerator create_generator(std::shared_ptr<CandidateTables> candidates,
                                std::unique_ptr<GeneratorRng> rng) {
   auto cfg = GenConfig();
   cfg.max_depth = 12;
 
-  return ExprGenerator(std::move(rng), cfg, symtab);
+  return ExprGenerator(std::move(rng), cfg, std::move(candidates));
 }
 
 template <class Rng>
@@ -97,12 +102,33 @@ int LibfuzzerState::init(int* /*argc*/, char*** argv) {
   target_ = process.GetTarget();
   frame_ = process.GetSelectedThread().GetSelectedFrame();
 
-  symtab_ = fuzzer::SymbolTable::create_from_frame(
-      frame_, /*ignore_qualified_types*/ true);
+  // The symbol table is cached on disk, libFuzzer restarts the process often.
+  // `LLDB_EVAL_FUZZER_SYMTAB_CACHE` overrides the cache path, an empty value
+  // disables the cache.
+  std::string cache_path;
+  if (const char* env = std::getenv("LLDB_EVAL_FUZZER_SYMTAB_CACHE")) {
+    cache_path = env;
+  } else {
+    llvm::SmallString<128> tmp_dir;
+    llvm::sys::path::system_temp_directory(/*erasedOnReboot*/ true, tmp_dir);
+    llvm::sys::path::append(tmp_dir, "lldb_eval_fuzzer_symtab.cache");
+    cache_path = std::string(tmp_dir.str());
+  }
+  SymbolTable symtab;
+  if (cache_path.empty()) {
+    symtab = fuzzer::SymbolTable::create_from_frame(
+        frame_, /*ignore_qualified_types*/ true);
+  } else {
+    symtab = fuzzer::create_from_frame_cached(
+        frame_, /*ignore_qualified_types*/ true, cache_path);
+  }
 
   // Add lldb-eval functions.
-  symtab_.add_function(ScalarType::UnsignedInt, "__log2",
-                       {ScalarType::UnsignedInt});
+  symtab.add_function(ScalarType::UnsignedInt, "__log2",
+                      {ScalarType::UnsignedInt});
+
+  // The generators of all the inputs share the candidate tables.
+  candidates_ = std::make_shared<CandidateTables>(std::move(symtab));
 
   return 0;
 }
@@ -110,7 +136,7 @@ int LibfuzzerState::init(int* /*argc*/, char*** argv) {
 size_t LibfuzzerState::custom_mutate(uint8_t* data, size_t size,
                                      size_t max_size, unsigned int seed) {
   auto fixed_rng = std::make_unique<FixedGeneratorRng>(data, size);
-  auto fixed_generator = create_generator(symtab_, std::move(fixed_rng));
+  auto fixed_generator = create_generator(candidates_, std::move(fixed_rng));
 
   auto maybe_expr = fixed_generator.generate();
   assert(maybe_expr.has_value() && "Expression could not be generated!");
@@ -120,7 +146,8 @@ size_t LibfuzzerState::custom_mutate(uint8_t* data, size_t size,
   auto mutable_node = pick_random_node(root, rng);
 
   auto random_generator =
-      create_generator(symtab_, std::make_unique<DefaultGeneratorRng>(rng()));
+      create_generator(candidates_,
+                       std::make_unique<DefaultGeneratorRng>(rng()));
   if (!random_generator.mutate_gen_node(mutable_node)) {
     return size;
   }
@@ -137,16 +164,17 @@ size_t LibfuzzerState::custom_mutate(uint8_t* data, size_t size,
   return writer.size();
 }
 
-std::string LibfuzzerState::input_to_expr(const uint8_t* data, size_t size) {
+const std::string& LibfuzzerState::input_to_expr(const uint8_t* data,
+                                                 size_t size) {
   auto rng = std::make_unique<FixedGeneratorRng>(data, size);
-  auto generator = create_generator(symtab_, std::move(rng));
+  auto generator = create_generator(candidates_, std::move(rng));
   auto maybe_expr = generator.generate();
 
   assert(maybe_expr.has_value() && "Expression could not be generated!");
 
-  std::ostringstream os;
-  os << maybe_expr.value();
-  return os.str();
+  expr_.clear();
+  print_expr(maybe_expr.value(), expr_);
+  return expr_;
 }
 
 }  // namespace fuzzer
@@ -3,12 +3,13 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 
 #include "lldb/API/SBDebugger.h"
 #include "lldb/API/SBFrame.h"
 #include "lldb/API/SBTarget.h"
-#include "tools/fuzzer/symbol_table.h"
+#include "tools/fuzzer/candidate_tables.h"
 
 namespace fuzzer {
 
@@ -22,7 +23,9 @@ class LibfuzzerState {
   size_t custom_mutate(uint8_t* data, size_t size, size_t max_size,
                        unsigned int seed);
 
-  std::string input_to_expr(const uint8_t* data, size_t size);
+  // Returns the expression generated from `data`. The returned string is
+  // overwritten by the next call.
+  const std::string& input_to_expr(const uint8_t* data, size_t size);
 
   lldb::SBFrame& frame() { return frame_; }
 
@@ -32,7 +35,9 @@ class LibfuzzerState {
   lldb::SBDebugger debugger_;
   lldb::SBFrame frame_;
   lldb::SBTarget target_;
-  SymbolTable symtab_;
+  std::shared_ptr<CandidateTables> candidates_;
+  // Reused by `input_to_expr()` for all the inputs.
+  std::string expr_;
 };
 
 }  // namespace fuzzer
@@ -33,7 +33,7 @@ extern "C" size_t LLVMFuzzerCustomMutator(uint8_t* data, size_t size,
 }
 
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
-  std::string expr = g_state.input_to_expr(data, size);
+  const std::string& expr = g_state.input_to_expr(data, size);
   lldb::SBError error;
   lldb_eval::EvaluateExpression(g_state.frame(), expr.c_str(), error);
   return 0;
@@ -141,9 +141,10 @@ extern "C" size_t LLVMFuzzerCustomMutator(uint8_t* data, size_t size,
 }
 
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
-  std::string expr = g_state.input_to_expr(data, size);
+  const std::string& expr = g_state.input_to_expr(data, size);
 
-  auto sm = lldb_eval::SourceManager::Create(expr);
+  // `expr` stays valid until the end of this function, don't copy it.
+  auto sm = lldb_eval::SourceManager::CreateBorrowed(expr);
   auto ctx = lldb_eval::Context::Create(sm, g_state.frame());
 
   // lldb-eval evaluation.
@@ -156,6 +157,7 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
   }
 
   lldb_eval::Interpreter eval(g_state.target(), sm);
+  eval.SetFrame(g_state.frame());
   lldb::SBValue lldb_eval_value = eval.Eval(tree.get(), err).inner_value();
   if (err) {
     log_lldb_eval_error(expr, err);
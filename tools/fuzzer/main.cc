@@ -15,13 +15,23 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <random>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
+#include <variant>
+#include <vector>
 
 #include "cpp-linenoise/linenoise.hpp"
 #include "lldb-eval/api.h"
@@ -38,8 +48,10 @@
 #include "lldb/API/SBValue.h"
 #include "tools/cpp/runfiles/runfiles.h"
 #include "tools/fuzzer/ast.h"
+#include "tools/fuzzer/candidate_tables.h"
 #include "tools/fuzzer/expr_gen.h"
 #include "tools/fuzzer/symbol_table.h"
+#include "tools/fuzzer/symbol_table_cache.h"
 
 using bazel::tools::cpp::runfiles::Runfiles;
 
@@ -51,6 +63,17 @@ enum Verbosity {
   ShowEverything,
 };
 
+// Configuration of the performance mode. Instead of comparing the results with
+// LLDB, the fuzzer measures how long lldb-eval takes to parse and evaluate each
+// generated expression and reports the ones slower than the threshold.
+struct PerfConfig {
+  bool enabled = false;
+  uint64_t threshold_us = 1000;
+  // If not empty, the slow expressions are appended to this file. The file can
+  // be replayed by `eval_benchmark --perf_corpus=<path>`.
+  std::string corpus_path;
+};
+
 // Compares LLDB types ignoring type qualifiers (const, volatile).
 bool compare_types(lldb::SBType lhs, lldb::SBType rhs) {
   if (!lhs.IsValid() || !rhs.IsValid()) {
@@ -65,6 +88,10 @@ bool compare_types(lldb::SBType lhs, lldb::SBType rhs) {
 
 using EvaluationContext = std::variant<lldb::SBFrame, lldb::SBValue>;
 
+const char* maybe_null(const char* str) {
+  return str == nullptr ? "NULL" : str;
+}
+
 lldb::SBValue evaluate_expression_lldb(EvaluationContext eval_ctx,
                                        const std::string& expr) {
   // Disable auto fix-its in LLDB evaluations.
@@ -85,8 +112,11 @@ lldb::SBValue evaluate_expression_lldb_eval(EvaluationContext eval_ctx,
       eval_ctx);
 }
 
-void eval_and_print_expr(EvaluationContext eval_ctx, const std::string& expr,
-                         Verbosity verbosity) {
+// Writes the report of `expr` to `os` if the results of LLDB and lldb-eval
+// differ, if either reports an error, or if `verbosity` asks for it. Returns
+// true if the expression has been reported.
+bool eval_and_print_expr(EvaluationContext eval_ctx, const std::string& expr,
+                         Verbosity verbosity, std::ostream& os) {
   auto lldb_value = evaluate_expression_lldb(eval_ctx, expr);
   auto lldb_err = lldb_value.GetError();
 
@@ -115,56 +145,118 @@ void eval_and_print_expr(EvaluationContext eval_ctx, const std::string& expr,
   bool must_print = value_mismatch || type_mismatch || has_error ||
                     verbosity == Verbosity::ShowEverything;
   if (!must_print) {
-    return;
+    return false;
   }
-  printf("expr : `%s`\n", expr.c_str());
+  os << "expr : `" << expr << "`\n";
 
   if (value_mismatch) {
     if (lldb_value.GetValue() != nullptr) {
-      printf("lldb value     : `%s`\n", lldb_value.GetValue());
+      os << "lldb value     : `" << lldb_value.GetValue() << "`\n";
     } else {
-      printf("lldb value     : No value returned\n");
+      os << "lldb value     : No value returned\n";
     }
     if (lldb_eval_value.GetValue() != nullptr) {
-      printf("lldb-eval value: `%s`\n", lldb_eval_value.GetValue());
+      os << "lldb-eval value: `" << lldb_eval_value.GetValue() << "`\n";
     } else {
-      printf("lldb-eval value: No value returned\n");
+      os << "lldb-eval value: No value returned\n";
     }
   } else if (verbosity == Verbosity::ShowEverything) {
-    printf("value: `%s`\n", lldb_value.GetValue());
+    os << "value: `" << maybe_null(lldb_value.GetValue()) << "`\n";
   }
 
   if (type_mismatch) {
     if (lldb_value.GetTypeName() != nullptr) {
-      printf("lldb type     : `%s`\n", lldb_value.GetTypeName());
+      os << "lldb type     : `" << lldb_value.GetTypeName() << "`\n";
     } else {
-      printf("lldb type     : No type name\n");
+      os << "lldb type     : No type name\n";
     }
     if (lldb_eval_value.GetTypeName() != nullptr) {
-      printf("lldb-eval type: `%s`\n", lldb_eval_value.GetTypeName());
+      os << "lldb-eval type: `" << lldb_eval_value.GetTypeName() << "`\n";
     } else {
-      printf("lldb-eval type: No type name\n");
+      os << "lldb-eval type: No type name\n";
     }
   } else if (verbosity == Verbosity::ShowEverything) {
-    printf("type: `%s`\n", lldb_value.GetTypeName());
+    os << "type: `" << maybe_null(lldb_value.GetTypeName()) << "`\n";
   }
 
   if (has_error) {
-    printf("== Reported errors ==\n");
+    os << "== Reported errors ==\n";
     if (lldb_err.GetCString() != nullptr) {
-      printf("lldb     : %s\n", lldb_err.GetCString());
+      os << "lldb     : " << lldb_err.GetCString() << "\n";
     } else {
-      printf("lldb     : No error reported\n");
+      os << "lldb     : No error reported\n";
     }
 
     if (lldb_eval_err.GetCString() != nullptr) {
-      printf("lldb-eval: %s\n", lldb_eval_err.GetCString());
+      os << "lldb-eval: " << lldb_eval_err.GetCString() << "\n";
     } else {
-      printf("lldb-eval: No error reported\n");
+      os << "lldb-eval: No error reported\n";
     }
   }
 
-  printf("============================================================\n");
+  os << "============================================================\n";
+  return true;
+}
+
+struct PerfSample {
+  uint64_t parse_us;
+  uint64_t eval_us;
+};
+
+PerfSample measure_expr(EvaluationContext eval_ctx, const std::string& expr) {
+  lldb_eval::EvaluationStats stats;
+  lldb_eval::Options opts;
+  opts.stats = &stats;
+
+  std::visit(
+      [&](auto&& ctx) {
+        lldb::SBError error;
+        lldb_eval::EvaluateExpression(ctx, expr.c_str(), opts, error);
+      },
+      eval_ctx);
+
+  // Parsing includes the lexing and the identifier and type lookups.
+  return PerfSample{(stats.lex_ns + stats.parse_ns) / 1000,
+                    stats.eval_ns / 1000};
+}
+
+void run_perf(EvaluationContext eval_ctx, const std::vector<std::string>& exprs,
+              const PerfConfig& perf, unsigned seed) {
+  FILE* corpus = nullptr;
+  if (!perf.corpus_path.empty()) {
+    corpus = fopen(perf.corpus_path.c_str(), "a");
+    if (corpus == nullptr) {
+      fprintf(stderr, "Could not open the corpus file `%s`\n",
+              perf.corpus_path.c_str());
+    }
+  }
+
+  size_t num_slow = 0;
+  uint64_t max_total_us = 0;
+  for (const auto& expr : exprs) {
+    PerfSample sample = measure_expr(eval_ctx, expr);
+    uint64_t total_us = sample.parse_us + sample.eval_us;
+    max_total_us = std::max(max_total_us, total_us);
+    if (total_us < perf.threshold_us) {
+      continue;
+    }
+
+    ++num_slow;
+    printf("slow expr (parse %" PRIu64 "us, eval %" PRIu64 "us): `%s`\n",
+           sample.parse_us, sample.eval_us, expr.c_str());
+    if (corpus != nullptr) {
+      fprintf(corpus,
+              "# seed %u, parse %" PRIu64 "us, eval %" PRIu64 "us\n%s\n",
+              seed, sample.parse_us, sample.eval_us, expr.c_str());
+    }
+  }
+
+  if (corpus != nullptr) {
+    fclose(corpus);
+  }
+  printf("==== %zu of %zu expressions took at least %" PRIu64
+         "us (max %" PRIu64 "us) ====\n",
+         num_slow, exprs.size(), perf.threshold_us, max_total_us);
 }
 
 void run_repl(EvaluationContext eval_ctx) {
@@ -176,17 +268,25 @@ void run_repl(EvaluationContext eval_ctx) {
       break;
     }
 
-    eval_and_print_expr(eval_ctx, expr, Verbosity::ShowEverything);
+    eval_and_print_expr(eval_ctx, expr, Verbosity::ShowEverything, std::cout);
+    std::cout.flush();
     linenoise::AddHistory(expr.c_str());
   }
 }
 
+// Path of the symbol table cache file (see `symbol_table_cache.h`), empty if
+// the symbol table isn't cached.
+std::string symtab_cache_path;
+
 fuzzer::SymbolTable gen_symtab(EvaluationContext& eval_ctx,
                                bool ignore_qualified_types) {
   fuzzer::SymbolTable symtab;
 
   auto* frame = std::get_if<lldb::SBFrame>(&eval_ctx);
-  if (frame) {
+  if (frame && !symtab_cache_path.empty()) {
+    symtab = fuzzer::create_from_frame_cached(*frame, ignore_qualified_types,
+                                              symtab_cache_path);
+  } else if (frame) {
     symtab =
         fuzzer::SymbolTable::create_from_frame(*frame, ignore_qualified_types);
   }
@@ -204,27 +304,27 @@ fuzzer::SymbolTable gen_symtab(EvaluationContext& eval_ctx,
   return symtab;
 }
 
-void run_fuzzer(EvaluationContext& eval_ctx, const unsigned* seed_ptr) {
-  std::random_device rd;
-  unsigned seed = seed_ptr ? *seed_ptr : rd();
-  printf("==== Seed for this run is: %u ====\n", seed);
-
-  auto rng = std::make_unique<fuzzer::DefaultGeneratorRng>(seed);
-  // Fuzzer configuration. Refer to `tools/fuzzer/expr_gen.h` to see what
-  // parameters are available.
+// Fuzzer configuration. Refer to `tools/fuzzer/expr_gen.h` to see what
+// parameters are available.
+fuzzer::GenConfig make_gen_config() {
   auto cfg = fuzzer::GenConfig();
   // Disable shift and division for now
   cfg.bin_op_mask[fuzzer::BinOp::Shl] = false;
   cfg.bin_op_mask[fuzzer::BinOp::Shr] = false;
+  return cfg;
+}
 
-  // Symbol table
-  fuzzer::SymbolTable symtab = gen_symtab(
-      eval_ctx, /*ignore_qualified_types*/ !cfg.cv_qualifiers_enabled);
+std::vector<std::string> generate_exprs(
+    std::shared_ptr<fuzzer::CandidateTables> candidates, unsigned seed) {
+  auto rng = std::make_unique<fuzzer::DefaultGeneratorRng>(seed);
+  auto cfg = make_gen_config();
+  int num_exprs = cfg.num_exprs_to_generate;
 
-  fuzzer::ExprGenerator gen(std::move(rng), std::move(cfg), std::move(symtab));
+  fuzzer::ExprGenerator gen(std::move(rng), std::move(cfg),
+                            std::move(candidates));
   std::vector<std::string> exprs;
 
-  for (int i = 0; i < cfg.num_exprs_to_generate; i++) {
+  for (int i = 0; i < num_exprs; i++) {
     auto maybe_gen_expr = gen.generate();
     if (!maybe_gen_expr.has_value()) {
       fprintf(stderr, "Warning: Could not generate expression #:%d\n", i);
@@ -232,16 +332,159 @@ void run_fuzzer(EvaluationContext& eval_ctx, const unsigned* seed_ptr) {
     }
     const auto& gen_expr = maybe_gen_expr.value();
 
-    std::ostringstream os;
-    os << gen_expr;
-    auto str = os.str();
+    std::string str;
+    fuzzer::print_expr(gen_expr, str);
 
     exprs.emplace_back(std::move(str));
   }
 
+  return exprs;
+}
+
+void run_fuzzer(EvaluationContext& eval_ctx, unsigned seed,
+                const PerfConfig& perf) {
+  printf("==== Seed for this run is: %u ====\n", seed);
+
+  // Symbol table
+  fuzzer::SymbolTable symtab =
+      gen_symtab(eval_ctx, /*ignore_qualified_types*/ !make_gen_config()
+                               .cv_qualifiers_enabled);
+  std::vector<std::string> exprs = generate_exprs(
+      std::make_shared<fuzzer::CandidateTables>(std::move(symtab)), seed);
+
+  if (perf.enabled) {
+    run_perf(eval_ctx, exprs, perf, seed);
+    return;
+  }
+
   for (const auto& e : exprs) {
-    eval_and_print_expr(eval_ctx, e, Verbosity::ShowMismatchesOrErrors);
+    eval_and_print_expr(eval_ctx, e, Verbosity::ShowMismatchesOrErrors,
+                        std::cout);
   }
+  std::cout.flush();
+}
+
+// Returns the evaluation context of the fuzzer: `frame`, or the variable
+// `value_expr` of it if not empty. Returns nullopt if the variable isn't a
+// valid struct or class.
+std::optional<EvaluationContext> make_eval_ctx(lldb::SBFrame frame,
+                                               const std::string& value_expr) {
+  if (value_expr.empty()) {
+    return EvaluationContext(frame);
+  }
+
+  // We are going to evaluate in the value context!
+  lldb::SBValue value = frame.FindVariable(value_expr.c_str());
+  if (!value.IsValid()) {
+    fprintf(stderr, "Value `%s` isn't valid!", value_expr.c_str());
+    return std::nullopt;
+  }
+
+  lldb::TypeClass type_class = value.GetType().GetTypeClass();
+  if (type_class != lldb::eTypeClassStruct &&
+      type_class != lldb::eTypeClassClass) {
+    fprintf(stderr, "Value `%s` isn't a struct or class!", value_expr.c_str());
+    return std::nullopt;
+  }
+
+  return EvaluationContext(value);
+}
+
+// Configuration of the parallel mode. The fuzzer runs with the seeds
+// `first_seed`, ..., `first_seed + num_runs - 1` are distributed between
+// `num_jobs` workers.
+struct ParallelConfig {
+  unsigned num_jobs = 1;
+  unsigned num_runs = 0;
+};
+
+// Runs the fuzzer in parallel. Evaluations in one target are serialized by
+// LLDB, so each worker evaluates in its own debugger and debuggee. The symbol
+// table and its candidate tables are built once (from `eval_ctx`) and shared
+// by all workers. The reports
+// of the runs are printed in the order of the seeds, followed by the number of
+// the reported expressions.
+void run_parallel_fuzzer(EvaluationContext& eval_ctx,
+                         const std::string& source_path,
+                         const std::string& binary_path,
+                         const std::string& value_expr, unsigned first_seed,
+                         const ParallelConfig& parallel) {
+  auto candidates = std::make_shared<fuzzer::CandidateTables>(
+      gen_symtab(eval_ctx, /*ignore_qualified_types*/ !make_gen_config()
+                               .cv_qualifiers_enabled));
+
+  struct Run {
+    std::string report;
+    size_t num_reported = 0;
+    bool done = false;
+  };
+  std::vector<Run> runs(parallel.num_runs);
+  std::atomic<unsigned> next_run{0};
+  std::mutex mutex;
+  std::condition_variable run_done;
+
+  auto worker = [&](EvaluationContext ctx) {
+    for (unsigned i = next_run++; i < parallel.num_runs; i = next_run++) {
+      unsigned seed = first_seed + i;
+      std::vector<std::string> exprs = generate_exprs(candidates, seed);
+      std::ostringstream os;
+      size_t num_reported = 0;
+      for (const auto& e : exprs) {
+        num_reported +=
+            eval_and_print_expr(ctx, e, Verbosity::ShowMismatchesOrErrors, os);
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      runs[i].report = os.str();
+      runs[i].num_reported = num_reported;
+      runs[i].done = true;
+      run_done.notify_one();
+    }
+  };
+
+  std::mutex launch_mutex;
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < parallel.num_jobs; ++i) {
+    threads.emplace_back([&] {
+      lldb::SBDebugger debugger;
+      lldb::SBProcess proc;
+      {
+        // Launch the debuggees one at a time, LLDB doesn't cope well with
+        // concurrent launches.
+        std::lock_guard<std::mutex> lock(launch_mutex);
+        debugger = lldb::SBDebugger::Create();
+        proc = lldb_eval::LaunchTestProgram(debugger, source_path,
+                                            binary_path, "// BREAK HERE");
+      }
+      auto ctx = make_eval_ctx(proc.GetSelectedThread().GetSelectedFrame(),
+                               value_expr);
+      if (ctx) {
+        worker(*ctx);
+      }
+      proc.Destroy();
+      lldb::SBDebugger::Destroy(debugger);
+    });
+  }
+  std::thread main_worker(worker, eval_ctx);
+
+  // Print the reports as soon as the runs of all the preceding seeds are done.
+  size_t total_reported = 0;
+  for (unsigned i = 0; i < parallel.num_runs; ++i) {
+    std::unique_lock<std::mutex> lock(mutex);
+    run_done.wait(lock, [&] { return runs[i].done; });
+    printf("==== Seed for this run is: %u ====\n", first_seed + i);
+    fputs(runs[i].report.c_str(), stdout);
+    fflush(stdout);
+    total_reported += runs[i].num_reported;
+    runs[i].report.clear();
+  }
+
+  main_worker.join();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  printf("==== %zu expressions reported in %u runs ====\n", total_reported,
+         parallel.num_runs);
 }
 
 int main(int argc, char** argv) {
@@ -256,6 +499,8 @@ int main(int argc, char** argv) {
   bool custom_seed = false;
   bool print_help = false;
   std::string value_expr;
+  PerfConfig perf;
+  ParallelConfig parallel;
 
   unsigned seed = 0;
   for (int i = 1; i < argc; i++) {
@@ -276,15 +521,61 @@ int main(int argc, char** argv) {
       i++;
       value_expr = argv[i];
     }
+    if (strcmp(argv[i], "--perf") == 0) {
+      perf.enabled = true;
+    }
+    if (strcmp(argv[i], "--perf-threshold-us") == 0 && i < argc - 1) {
+      i++;
+      perf.threshold_us = std::stoull(argv[i]);
+    }
+    if (strcmp(argv[i], "--perf-corpus") == 0 && i < argc - 1) {
+      i++;
+      perf.corpus_path = argv[i];
+    }
+    if (strcmp(argv[i], "--jobs") == 0 && i < argc - 1) {
+      i++;
+      parallel.num_jobs =
+          std::max(1u, static_cast<unsigned>(std::stoul(argv[i])));
+    }
+    if (strcmp(argv[i], "--symtab-cache") == 0 && i < argc - 1) {
+      i++;
+      symtab_cache_path = argv[i];
+    }
+    if (strcmp(argv[i], "--runs") == 0 && i < argc - 1) {
+      i++;
+      parallel.num_runs = static_cast<unsigned>(std::stoul(argv[i]));
+    }
+  }
+  if (parallel.num_runs == 0) {
+    parallel.num_runs = parallel.num_jobs;
   }
   if (print_help) {
-    printf("Usage: %s [--repl] [--help] [--seed <rng_seed>]\n", argv[0]);
+    printf(
+        "Usage: %s [--repl] [--help] [--seed <rng_seed>] [--jobs <n>] "
+        "[--runs <n>] [--symtab-cache <path>] [--perf "
+        "[--perf-threshold-us <us>] [--perf-corpus <path>]]\n",
+        argv[0]);
     printf("--help: Print this message\n");
     printf("--repl: REPL mode, evaluate expressions on lldb and lldb-eval\n");
     printf("--seed <rng_seed>: Specify the RNG seed to use\n");
+    printf("--jobs <n>: Number of parallel workers, each with its own "
+           "debuggee (default: 1)\n");
+    printf("--runs <n>: Number of fuzzer runs, with consecutive seeds "
+           "starting at the RNG seed (default: number of jobs)\n");
+    printf("--symtab-cache <path>: Cache the symbol table in this file\n");
+    printf("--perf: Performance mode, report slow lldb-eval evaluations\n");
+    printf("--perf-threshold-us <us>: Report expressions slower than this "
+           "(default: %" PRIu64 ")\n",
+           perf.threshold_us);
+    printf("--perf-corpus <path>: Append the slow expressions to this file\n");
 
     return 0;
   }
+  if (perf.enabled && parallel.num_runs > 1) {
+    // The measurements would be skewed by the other workers.
+    fprintf(stderr, "--perf can't be combined with --jobs or --runs\n");
+    return 1;
+  }
 
   lldb_eval::SetupLLDBServerEnv(*runfiles);
 
@@ -299,37 +590,22 @@ int main(int argc, char** argv) {
     auto thread = proc.GetSelectedThread();
     auto frame = thread.GetSelectedFrame();
 
-    lldb::SBValue value;
-    if (value_expr != "") {
-      // We are going to evaluate in the value context!
-
-      value = frame.FindVariable(value_expr.c_str());
-      if (!value.IsValid()) {
-        fprintf(stderr, "Value `%s` isn't valid!", value_expr.c_str());
-        proc.Destroy();
-        lldb::SBDebugger::Terminate();
-        return 1;
-      }
-
-      lldb::TypeClass type_class = value.GetType().GetTypeClass();
-      if (type_class != lldb::eTypeClassStruct &&
-          type_class != lldb::eTypeClassClass) {
-        fprintf(stderr, "Value `%s` isn't a struct or class!",
-                value_expr.c_str());
-        proc.Destroy();
-        lldb::SBDebugger::Terminate();
-        return 1;
-      }
+    auto eval_ctx = make_eval_ctx(frame, value_expr);
+    if (!eval_ctx) {
+      proc.Destroy();
+      lldb::SBDebugger::Terminate();
+      return 1;
     }
 
-    EvaluationContext eval_ctx =
-        value.IsValid() ? EvaluationContext(value) : EvaluationContext(frame);
-
+    std::random_device rd;
+    unsigned first_seed = custom_seed ? seed : rd();
     if (repl_mode) {
-      run_repl(eval_ctx);
+      run_repl(*eval_ctx);
+    } else if (parallel.num_runs > 1) {
+      run_parallel_fuzzer(*eval_ctx, source_path, binary_path, value_expr,
+                          first_seed, parallel);
     } else {
-      const unsigned* seed_ptr = custom_seed ? &seed : nullptr;
-      run_fuzzer(eval_ctx, seed_ptr);
+      run_fuzzer(*eval_ctx, first_seed, perf);
     }
 
     proc.Destroy();
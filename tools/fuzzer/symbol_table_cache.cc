@@ -0,0 +1,413 @@
+/*
+ * Copyright 2021 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/fuzzer/symbol_table_cache.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "lldb/API/SBFrame.h"
+#include "lldb/API/SBModule.h"
+#include "lldb/API/SBTarget.h"
+#include "lldb/API/SBThread.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "tools/fuzzer/ast.h"
+#include "tools/fuzzer/symbol_table.h"
+
+namespace fuzzer {
+namespace {
+
+constexpr char MAGIC[] = {'L', 'E', 'S', 'T'};
+// Bump when the format changes, the old caches are then rebuilt.
+constexpr uint64_t FORMAT_VERSION = 1;
+
+// Index of the alternative `T` in `Type`, which tags the types in the cache.
+template <typename T, size_t I = 0>
+constexpr size_t variant_index() {
+  if constexpr (std::is_same_v<std::variant_alternative_t<I, Type>, T>) {
+    return I;
+  } else {
+    return variant_index<T, I + 1>();
+  }
+}
+
+class CacheWriter {
+ public:
+  void write_byte(uint8_t byte) { data_.push_back(static_cast<char>(byte)); }
+
+  void write_varint(uint64_t value) {
+    do {
+      uint8_t byte = value & 0x7f;
+      value >>= 7;
+      write_byte(value ? (byte | 0x80) : byte);
+    } while (value);
+  }
+
+  void write_string(const std::string& str) {
+    write_varint(str.size());
+    data_ += str;
+  }
+
+  void write_cv_qualifiers(CvQualifiers qualifiers) {
+    write_byte((qualifiers[CvQualifier::Const] ? 1 : 0) |
+               (qualifiers[CvQualifier::Volatile] ? 2 : 0));
+  }
+
+  void write_type(const Type& type) {
+    write_byte(static_cast<uint8_t>(type.index()));
+    std::visit([this](const auto& type) { write(type); }, type);
+  }
+
+  const std::string& data() const { return data_; }
+
+ private:
+  void write(ScalarType type) { write_byte(static_cast<uint8_t>(type)); }
+  void write(const TaggedType& type) { write_string(type.name()); }
+  void write(const PointerType& type) {
+    write_cv_qualifiers(type.type().cv_qualifiers());
+    write_type(type.type().type());
+  }
+  void write(const NullptrType&) {}
+  void write(const EnumType& type) {
+    write_string(type.name());
+    write_byte(type.is_scoped());
+  }
+  void write(const ArrayType& type) {
+    write_type(type.type());
+    write_varint(type.size());
+  }
+
+  std::string data_;
+};
+
+// Reads the data written by `CacheWriter`. Reading past the end of the data or
+// invalid values set the `failed()` flag and return default values.
+class CacheReader {
+ public:
+  CacheReader(const char* begin, const char* end) : pos_(begin), end_(end) {}
+
+  bool failed() const { return failed_; }
+  bool at_end() const { return pos_ == end_; }
+
+  uint8_t read_byte() {
+    if (pos_ == end_) {
+      failed_ = true;
+      return 0;
+    }
+    return static_cast<uint8_t>(*pos_++);
+  }
+
+  uint64_t read_varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t byte = read_byte();
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    failed_ = true;
+    return 0;
+  }
+
+  // Reads a count of the entries following it. Each entry takes at least one
+  // byte, so larger counts mean the data is malformed.
+  size_t read_count() {
+    uint64_t count = read_varint();
+    if (count > static_cast<uint64_t>(end_ - pos_)) {
+      failed_ = true;
+      return 0;
+    }
+    return static_cast<size_t>(count);
+  }
+
+  std::string read_string() {
+    size_t size = read_count();
+    std::string str(pos_, size);
+    pos_ += size;
+    return str;
+  }
+
+  CvQualifiers read_cv_qualifiers() {
+    uint8_t bits = read_byte();
+    CvQualifiers qualifiers;
+    qualifiers[CvQualifier::Const] = (bits & 1) != 0;
+    qualifiers[CvQualifier::Volatile] = (bits & 2) != 0;
+    return qualifiers;
+  }
+
+  Type read_type() {
+    // Types are nested only through pointers and arrays, the depth is small
+    // for well-formed data.
+    if (++depth_ > MAX_TYPE_DEPTH) {
+      failed_ = true;
+    }
+    Type type = read_type_impl();
+    --depth_;
+    return type;
+  }
+
+ private:
+  static constexpr int MAX_TYPE_DEPTH = 64;
+
+  Type read_type_impl() {
+    if (failed_) {
+      return ScalarType::Void;
+    }
+    switch (read_byte()) {
+      case variant_index<ScalarType>(): {
+        uint8_t scalar = read_byte();
+        if (scalar > static_cast<uint8_t>(ScalarType::EnumLast)) {
+          failed_ = true;
+          return ScalarType::Void;
+        }
+        return static_cast<ScalarType>(scalar);
+      }
+      case variant_index<TaggedType>():
+        return TaggedType(read_string());
+      case variant_index<PointerType>(): {
+        CvQualifiers qualifiers = read_cv_qualifiers();
+        Type pointee = read_type();
+        return PointerType(QualifiedType(std::move(pointee), qualifiers));
+      }
+      case variant_index<NullptrType>():
+        return NullptrType();
+      case variant_index<EnumType>(): {
+        std::string name = read_string();
+        bool scoped = read_byte() != 0;
+        return EnumType(std::move(name), scoped);
+      }
+      case variant_index<ArrayType>(): {
+        Type element = read_type();
+        uint64_t size = read_varint();
+        return ArrayType(std::move(element), static_cast<size_t>(size));
+      }
+    }
+    failed_ = true;
+    return ScalarType::Void;
+  }
+
+  const char* pos_;
+  const char* end_;
+  int depth_ = 0;
+  bool failed_ = false;
+};
+
+std::string serialize(const SymbolTable& symtab, const std::string& key) {
+  CacheWriter out;
+  for (char c : MAGIC) {
+    out.write_byte(static_cast<uint8_t>(c));
+  }
+  out.write_varint(FORMAT_VERSION);
+  out.write_string(key);
+
+  out.write_varint(symtab.vars().size());
+  for (const auto& [type, vars] : symtab.vars()) {
+    out.write_type(type);
+    out.write_varint(vars.size());
+    for (const auto& var : vars) {
+      out.write_string(var.expr.name());
+      out.write_varint(static_cast<uint64_t>(var.freedom_index));
+    }
+  }
+
+  out.write_varint(symtab.fields_by_type().size());
+  for (const auto& [type, fields] : symtab.fields_by_type()) {
+    out.write_type(type);
+    out.write_varint(fields.size());
+    for (const auto& field : fields) {
+      out.write_string(field.containing_type().name());
+      out.write_string(field.name());
+      out.write_byte(field.is_reference_or_virtual());
+    }
+  }
+
+  out.write_varint(symtab.functions().size());
+  for (const auto& [type, functions] : symtab.functions()) {
+    out.write_type(type);
+    out.write_varint(functions.size());
+    for (const auto& function : functions) {
+      out.write_string(function.name());
+      out.write_varint(function.argument_types().size());
+      for (const auto& arg : function.argument_types()) {
+        out.write_type(arg);
+      }
+    }
+  }
+
+  out.write_varint(symtab.enums().size());
+  for (const auto& [type, literals] : symtab.enums()) {
+    out.write_string(type.name());
+    out.write_byte(type.is_scoped());
+    out.write_varint(literals.size());
+    for (const auto& literal : literals) {
+      out.write_string(literal.literal());
+    }
+  }
+
+  return out.data();
+}
+
+std::optional<SymbolTable> deserialize(CacheReader& in,
+                                       const std::string& key) {
+  for (char c : MAGIC) {
+    if (in.read_byte() != static_cast<uint8_t>(c)) {
+      return {};
+    }
+  }
+  if (in.read_varint() != FORMAT_VERSION || in.read_string() != key) {
+    return {};
+  }
+
+  SymbolTable symtab;
+
+  size_t num_var_types = in.read_count();
+  for (size_t i = 0; i < num_var_types && !in.failed(); ++i) {
+    Type type = in.read_type();
+    size_t num_vars = in.read_count();
+    for (size_t j = 0; j < num_vars && !in.failed(); ++j) {
+      std::string name = in.read_string();
+      int freedom_index = static_cast<int>(in.read_varint());
+      symtab.add_var(type, VariableExpr(std::move(name)), freedom_index);
+    }
+  }
+
+  size_t num_field_types = in.read_count();
+  for (size_t i = 0; i < num_field_types && !in.failed(); ++i) {
+    Type type = in.read_type();
+    size_t num_fields = in.read_count();
+    for (size_t j = 0; j < num_fields && !in.failed(); ++j) {
+      TaggedType containing_type(in.read_string());
+      std::string name = in.read_string();
+      bool reference_or_virtual = in.read_byte() != 0;
+      symtab.add_field(std::move(containing_type), std::move(name), type,
+                       reference_or_virtual);
+    }
+  }
+
+  size_t num_return_types = in.read_count();
+  for (size_t i = 0; i < num_return_types && !in.failed(); ++i) {
+    Type type = in.read_type();
+    size_t num_functions = in.read_count();
+    for (size_t j = 0; j < num_functions && !in.failed(); ++j) {
+      std::string name = in.read_string();
+      size_t num_args = in.read_count();
+      std::vector<Type> args;
+      for (size_t k = 0; k < num_args && !in.failed(); ++k) {
+        args.push_back(in.read_type());
+      }
+      symtab.add_function(type, std::move(name), std::move(args));
+    }
+  }
+
+  size_t num_enums = in.read_count();
+  for (size_t i = 0; i < num_enums && !in.failed(); ++i) {
+    std::string name = in.read_string();
+    bool scoped = in.read_byte() != 0;
+    EnumType type(std::move(name), scoped);
+    size_t num_literals = in.read_count();
+    for (size_t j = 0; j < num_literals && !in.failed(); ++j) {
+      symtab.add_enum_literal(type, in.read_string());
+    }
+  }
+
+  if (in.failed() || !in.at_end()) {
+    return {};
+  }
+  return symtab;
+}
+
+// Writes `data` to the file at `path`.
+bool write_cache_file(const std::string& data, const std::string& path) {
+  // Write to a temporary file first, other fuzzer processes may be reading
+  // the cache at the same time.
+  std::string tmp_path = path + ".tmp" + std::to_string(std::random_device()());
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!file) {
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+std::string get_build_id(lldb::SBTarget target) {
+  const char* uuid = target.GetModuleAtIndex(0).GetUUIDString();
+  return uuid ? uuid : "";
+}
+
+bool save_symbol_table(const SymbolTable& symtab, const std::string& key,
+                       const std::string& path) {
+  return write_cache_file(serialize(symtab, key), path);
+}
+
+std::optional<SymbolTable> load_symbol_table(const std::string& path,
+                                             const std::string& key) {
+  // `MemoryBuffer` maps the file if it's large enough.
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    return {};
+  }
+  CacheReader reader((*buffer)->getBufferStart(), (*buffer)->getBufferEnd());
+  return deserialize(reader, key);
+}
+
+SymbolTable create_from_frame_cached(lldb::SBFrame& frame,
+                                     bool ignore_qualified_types,
+                                     const std::string& cache_path) {
+  std::string build_id =
+      get_build_id(frame.GetThread().GetProcess().GetTarget());
+  if (build_id.empty()) {
+    // Can't tell whether the cache belongs to this binary.
+    return SymbolTable::create_from_frame(frame, ignore_qualified_types);
+  }
+  std::string key = build_id + (ignore_qualified_types ? ":unqualified:frame"
+                                                       : ":qualified:frame");
+
+  auto cached = load_symbol_table(cache_path, key);
+  if (cached) {
+    return std::move(*cached);
+  }
+
+  SymbolTable symtab =
+      SymbolTable::create_from_frame(frame, ignore_qualified_types);
+  std::string data = serialize(symtab, key);
+  write_cache_file(data, cache_path);
+
+  // Return the table as the other processes will read it from the cache.
+  CacheReader reader(data.data(), data.data() + data.size());
+  cached = deserialize(reader, key);
+  return cached ? std::move(*cached) : std::move(symtab);
+}
+
+}  // namespace fuzzer
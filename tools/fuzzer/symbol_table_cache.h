@@ -0,0 +1,63 @@
+/*
+ * Copyright 2021 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDE_SYMBOL_TABLE_CACHE_H_
+#define INCLUDE_SYMBOL_TABLE_CACHE_H_
+
+#include <optional>
+#include <string>
+
+#include "lldb/API/SBFrame.h"
+#include "lldb/API/SBTarget.h"
+#include "tools/fuzzer/symbol_table.h"
+
+namespace fuzzer {
+
+// On-disk cache of the symbol tables. Building a symbol table walks all the
+// variables, fields and enums of the binary through the LLDB API, which takes
+// seconds for larger binaries and is repeated on every fuzzer start.
+//
+// The cache file starts with a key identifying the binary (its build ID) and
+// the way the table was built. The file is memory-mapped when read.
+
+// Returns the build ID (the UUID) of the main module of `target`, or an empty
+// string if it's unknown.
+std::string get_build_id(lldb::SBTarget target);
+
+// Writes `symtab` to the file at `path`, tagged with `key`. The file is
+// replaced atomically, so concurrent readers see either the old or the new
+// table. Returns false if the file can't be written.
+bool save_symbol_table(const SymbolTable& symtab, const std::string& key,
+                       const std::string& path);
+
+// Reads the symbol table from the file at `path`. Returns nullopt if the file
+// doesn't exist, is malformed or was written with a different `key`.
+std::optional<SymbolTable> load_symbol_table(const std::string& path,
+                                             const std::string& key);
+
+// Same as `SymbolTable::create_from_frame()`, but the table is read from the
+// cache file at `cache_path` if it was written for the same binary. Otherwise
+// the table is built and the cache is (re-)written. The table is always
+// returned as read from the cache, so that the order of its entries (which
+// affects the generated expressions) doesn't depend on whether the cache was
+// hit.
+SymbolTable create_from_frame_cached(lldb::SBFrame& frame,
+                                     bool ignore_qualified_types,
+                                     const std::string& cache_path);
+
+}  // namespace fuzzer
+
+#endif  // INCLUDE_SYMBOL_TABLE_CACHE_H_
@@ -16,6 +16,7 @@
 
 #include "tools/fuzzer/symbol_table.h"
 
+#include <string>
 #include <unordered_set>
 
 #include "gmock/gmock.h"
@@ -28,6 +29,7 @@
 #include "lldb/API/SBThread.h"
 #include "lldb/API/SBType.h"
 #include "tools/cpp/runfiles/runfiles.h"
+#include "tools/fuzzer/symbol_table_cache.h"
 
 using namespace fuzzer;
 using namespace testing;
@@ -400,3 +402,33 @@ TEST_F(PopulateSymbolTableTest, Enums) {
                               EnumConstant(type, "ns::EnumClass::THREE")));
   }
 }
+
+TEST_F(PopulateSymbolTableTest, Cache) {
+  std::string path = TempDir() + "/symtab.cache";
+  ASSERT_TRUE(save_symbol_table(symtab_, "build-id", path));
+
+  // The cache is keyed.
+  EXPECT_FALSE(load_symbol_table(path, "other-build-id").has_value());
+
+  auto loaded = load_symbol_table(path, "build-id");
+  ASSERT_TRUE(loaded.has_value());
+  ASSERT_EQ(loaded->vars().size(), symtab_.vars().size());
+  for (const auto& [type, vars] : symtab_.vars()) {
+    auto it = loaded->vars().find(type);
+    ASSERT_NE(it, loaded->vars().end());
+    ASSERT_EQ(it->second.size(), vars.size());
+    for (size_t i = 0; i < vars.size(); ++i) {
+      EXPECT_EQ(it->second[i].expr.name(), vars[i].expr.name());
+      EXPECT_EQ(it->second[i].freedom_index, vars[i].freedom_index);
+    }
+  }
+  EXPECT_EQ(loaded->fields_by_type().size(), symtab_.fields_by_type().size());
+  EXPECT_EQ(loaded->functions().size(), symtab_.functions().size());
+  EXPECT_EQ(loaded->tagged_types(), symtab_.tagged_types());
+  EXPECT_EQ(loaded->array_types(), symtab_.array_types());
+  for (const auto& [type, literals] : symtab_.enums()) {
+    auto it = loaded->enums().find(type);
+    ASSERT_NE(it, loaded->enums().end());
+    EXPECT_THAT(it->second, ElementsAreArray(literals));
+  }
+}
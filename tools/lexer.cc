@@ -12,27 +12,59 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "clang/Basic/Diagnostic.h"
-#include "clang/Basic/IdentifierTable.h"
 #include "clang/Basic/LangOptions.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Basic/TargetInfo.h"
-#include "clang/Basic/TargetOptions.h"
 #include "clang/Basic/TokenKinds.h"
 #include "clang/Lex/HeaderSearch.h"
-#include "clang/Lex/HeaderSearchOptions.h"
+#include "clang/Lex/Lexer.h"
 #include "clang/Lex/ModuleLoader.h"
 #include "clang/Lex/Preprocessor.h"
-#include "clang/Lex/PreprocessorOptions.h"
 #include "clang/Lex/Token.h"
-#include "llvm/Support/Host.h"
+#include "lldb-eval/lexer.h"
+#include "lldb-eval/parser.h"
+
+std::vector<clang::Token> LexWithPreprocessor(
+    clang::SourceManager& sm, const lldb_eval::ParserEngine& engine) {
+  clang::DiagnosticsEngine& de = sm.getDiagnostics();
+  auto& lang_opts = const_cast<clang::LangOptions&>(engine.GetLangOptions());
+
+  clang::HeaderSearch hs(engine.GetHeaderSearchOptions(), sm, de, lang_opts,
+                         &engine.GetTargetInfo());
+  clang::TrivialModuleLoader tml;
+  clang::Preprocessor pp(engine.GetPreprocessorOptions(), de, lang_opts, sm,
+                         hs, tml);
+
+  pp.Initialize(engine.GetTargetInfo());
+  pp.EnterMainSourceFile();
+
+  std::vector<clang::Token> tokens;
+  do {
+    tokens.emplace_back();
+    pp.Lex(tokens.back());
+  } while (tokens.back().isNot(clang::tok::eof));
+  return tokens;
+}
+
+void DumpToken(const clang::Token& token, const clang::SourceManager& sm,
+               const clang::LangOptions& lang_opts) {
+  std::cerr << token.getName() << " '"
+            << clang::Lexer::getSpelling(token, sm, lang_opts) << "' at "
+            << sm.getFileOffset(token.getLocation()) << std::endl;
+}
 
 int main(int argc, char** argv) {
-  (void)argc;
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <expr>" << std::endl;
+    return 1;
+  }
 
   // "parse" command line arguments.
   std::string expr = argv[1];
@@ -40,42 +72,40 @@ int main(int argc, char** argv) {
   clang::SourceManagerForFile smff("<expr>", expr);
 
   clang::SourceManager& sm = smff.get();
-  clang::DiagnosticsEngine& de = sm.getDiagnostics();
-  de.setClient(new clang::IgnoringDiagConsumer);
-
-  // Create default target info.
-  auto tOpts = std::make_shared<clang::TargetOptions>();
-  tOpts->Triple = llvm::sys::getDefaultTargetTriple();
-  std::unique_ptr<clang::TargetInfo> ti(
-      clang::TargetInfo::CreateTargetInfo(de, tOpts));
-
-  clang::LangOptions lang_opts;
-  lang_opts.Bool = true;
-  lang_opts.WChar = true;
-  lang_opts.CPlusPlus = true;
-  lang_opts.CPlusPlus11 = true;
-  lang_opts.CPlusPlus14 = true;
-  lang_opts.CPlusPlus17 = true;
-
-  auto hOpts = std::make_shared<clang::HeaderSearchOptions>();
-  clang::HeaderSearch hs(hOpts, sm, de, lang_opts, ti.get());
-  clang::TrivialModuleLoader tml;
+  sm.getDiagnostics().setClient(new clang::IgnoringDiagConsumer);
 
-  auto pOpts = std::make_shared<clang::PreprocessorOptions>();
-  clang::Preprocessor pp(pOpts, de, lang_opts, sm, hs, tml);
+  auto engine = lldb_eval::ParserEngine::GetDefault();
+  const clang::LangOptions& lang_opts = engine->GetLangOptions();
 
-  pp.Initialize(*ti);
-  pp.EnterMainSourceFile();
+  // Lex the expression with both lexers and compare the results.
+  std::vector<clang::Token> clang_tokens = LexWithPreprocessor(sm, *engine);
+  std::vector<clang::Token> builtin_tokens =
+      lldb_eval::BuiltinLexer(sm, engine->GetKeywords()).LexAll();
 
-  clang::Token token;
-  token.setKind(clang::tok::unknown);
+  bool mismatch = false;
+  size_t size = std::max(clang_tokens.size(), builtin_tokens.size());
+  for (size_t i = 0; i < size; ++i) {
+    const clang::Token* expected =
+        i < clang_tokens.size() ? &clang_tokens[i] : nullptr;
+    const clang::Token* actual =
+        i < builtin_tokens.size() ? &builtin_tokens[i] : nullptr;
 
-  while (token.isNot(clang::tok::eof)) {
-    pp.Lex(token);
+    if (expected) {
+      DumpToken(*expected, sm, lang_opts);
+    }
 
-    pp.DumpToken(token);
-    std::cerr << std::endl;
+    if (!expected || !actual || expected->getKind() != actual->getKind() ||
+        expected->getLocation() != actual->getLocation() ||
+        expected->getLength() != actual->getLength()) {
+      std::cerr << "  mismatch, builtin lexer produced: ";
+      if (actual) {
+        DumpToken(*actual, sm, lang_opts);
+      } else {
+        std::cerr << "<none>" << std::endl;
+      }
+      mismatch = true;
+    }
   }
 
-  return 0;
+  return mismatch ? 1 : 0;
 }